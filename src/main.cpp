@@ -1,12 +1,19 @@
+#include <algorithm>
 #include <iostream>
 #include <memory>
+#include <optional>
+#include <string>
 #include <boost/asio/io_service.hpp>
 #include <boost/asio/signal_set.hpp>
 
 //#include "net/server/server.hpp"
 //#include "net/client/connection.hpp"
+#include "net/capture.hpp"
+#include "net/handover.hpp"
 #include "proxy/server.hpp"
 #include "proxy/pool.hpp"
+#include "stratum/protocol.hpp"
+#include "util/sharetrace.hpp"
 
 //class MainServerHandler : public ses::net::server::ServerHandler,
 //                          public ses::net::ConnectionHandler
@@ -40,10 +47,9 @@
 //  ses::net::Connection::Ptr connection_;
 //};
 
-void waitForSignal()
+void waitForSignal(boost::asio::io_service& ioService)
 {
   // waits for signals ending program
-  boost::asio::io_service ioService;
   boost::asio::signal_set signals(ioService);
   signals.add(SIGINT);
   signals.add(SIGTERM);
@@ -57,8 +63,126 @@ void waitForSignal()
   ioService.run();
 }
 
-int main()
+int main(int argc, char* argv[])
 {
+  // --handover <path> : takes over sockets of a running instance listening on path and
+  //                     listens there for a successor itself
+  // --pool-protocol <cryptonote|bitcoin> : stratum dialect of the pool, miners are served in the same one
+  // --pool-protocol binary : the pool is another instance of this proxy, miners are served cryptonote
+  // --port <port>, --pool-port <port> : listening port and pool port, for running tiers side by side
+  // --unix <path|@name>, --pool-unix <path|@name> : serves miners on the UNIX socket instead of the
+  //                                                 port, reaches the pool on it respectively, a name
+  //                                                 with '@' is an abstract socket without file
+  // --pool-tls <userspace|kernel> : TLS to the pool, encrypted by OpenSSL or after the handshake by
+  //                                 the kernel where it supports that
+  // --share-journal <directory> : journals every share there, see ses_proxy_sharereport
+  // --share-trace <file> : traces the stages of sampled shares there, see ses_proxy_tracereport
+  // --share-trace-sample <n> : traces the shares of every n-th read, 100 by default
+  // --capture <file> : records the messages of miners and pools there, see ses_proxy_replay
+  // --verify-shares <rate> : recomputes the CryptoNight hash of this share of the shares, 0 to 1
+  // --verify-threads <n> : worker threads verifying shares, 2 by default
+  // --verify-miner <login>=<rate> : sample rate for one miner, may be repeated
+  // --verify-max-major-version <n> : last block major version hashed with cn/0, 6 by default as
+  //                                  Monero moved on from it with version 7, later ones go unverified
+  // --session-grace <seconds> : keeps slot and job of a disconnected miner this long for it to
+  //                             resume its session, 60 by default, 0 releases them right away
+  std::string handOverPath;
+  std::string capturePath;
+  std::string shareJournalPath;
+  std::string shareTracePath;
+  uint32_t shareTraceSample = 100;
+  std::chrono::seconds sessionGracePeriod = ses::proxy::Server::SESSION_GRACE_PERIOD;
+  std::optional<ses::proxy::ShareVerification> shareVerification;
+  ses::stratum::Protocol poolProtocol = ses::stratum::PROTOCOL_CRYPTONOTE;
+  ses::net::ConnectionType poolConnectionType = ses::net::CONNECTION_TYPE_AUTO;
+  uint16_t port = 12345;
+  uint16_t poolPort = 5555;
+  std::string unixPath;
+  std::string poolUnixPath;
+  for (int i = 1; i + 1 < argc; ++i)
+  {
+    if (std::string(argv[i]) == "--handover")
+    {
+      handOverPath = argv[i + 1];
+    }
+    else if (std::string(argv[i]) == "--pool-protocol" && std::string(argv[i + 1]) == "bitcoin")
+    {
+      poolProtocol = ses::stratum::PROTOCOL_BITCOIN;
+    }
+    else if (std::string(argv[i]) == "--pool-protocol" && std::string(argv[i + 1]) == "binary")
+    {
+      poolProtocol = ses::stratum::PROTOCOL_BINARY;
+    }
+    else if (std::string(argv[i]) == "--pool-tls")
+    {
+      poolConnectionType = std::string(argv[i + 1]) == "kernel" ? ses::net::CONNECTION_TYPE_TLS_KERNEL
+                                                                : ses::net::CONNECTION_TYPE_TLS;
+    }
+    else if (std::string(argv[i]) == "--share-journal")
+    {
+      shareJournalPath = argv[i + 1];
+    }
+    else if (std::string(argv[i]) == "--share-trace")
+    {
+      shareTracePath = argv[i + 1];
+    }
+    else if (std::string(argv[i]) == "--share-trace-sample")
+    {
+      shareTraceSample = static_cast<uint32_t>(std::max(1ul, std::stoul(argv[i + 1])));
+    }
+    else if (std::string(argv[i]) == "--verify-shares" || std::string(argv[i]) == "--verify-threads" ||
+             std::string(argv[i]) == "--verify-miner" || std::string(argv[i]) == "--verify-max-major-version")
+    {
+      if (!shareVerification)
+      {
+        shareVerification = ses::proxy::ShareVerification{0.0, 2, {}, 6};
+      }
+      std::string value = argv[i + 1];
+      std::size_t separator = value.rfind('=');
+      if (std::string(argv[i]) == "--verify-shares")
+      {
+        shareVerification->sampleRate_ = std::clamp(std::stod(value), 0.0, 1.0);
+      }
+      else if (std::string(argv[i]) == "--verify-threads")
+      {
+        shareVerification->threadCount_ = std::max(1ul, std::stoul(value));
+      }
+      else if (std::string(argv[i]) == "--verify-max-major-version")
+      {
+        shareVerification->maxMajorVersion_ = std::stoull(value);
+      }
+      else if (separator != std::string::npos)
+      {
+        shareVerification->minerSampleRates_[value.substr(0, separator)] =
+          std::clamp(std::stod(value.substr(separator + 1)), 0.0, 1.0);
+      }
+    }
+    else if (std::string(argv[i]) == "--session-grace")
+    {
+      sessionGracePeriod = std::chrono::seconds(std::stoul(argv[i + 1]));
+    }
+    else if (std::string(argv[i]) == "--capture")
+    {
+      capturePath = argv[i + 1];
+    }
+    else if (std::string(argv[i]) == "--port")
+    {
+      port = static_cast<uint16_t>(std::stoul(argv[i + 1]));
+    }
+    else if (std::string(argv[i]) == "--pool-port")
+    {
+      poolPort = static_cast<uint16_t>(std::stoul(argv[i + 1]));
+    }
+    else if (std::string(argv[i]) == "--unix")
+    {
+      unixPath = argv[i + 1];
+    }
+    else if (std::string(argv[i]) == "--pool-unix")
+    {
+      poolUnixPath = argv[i + 1];
+    }
+  }
+
 //  std::shared_ptr<MainServerHandler> handler = std::make_shared<MainServerHandler>();
 //  ses::net::server::Server::Ptr server =
 //    ses::net::server::createServer(handler, "127.0.0.1", 55555);
@@ -71,19 +195,64 @@ int main()
 //  sleep(1);
 
 
-  ses::proxy::Server::Ptr proxyServer = std::make_shared<ses::proxy::Server>();
-  proxyServer->start("127.0.0.1", 12345);
+  boost::asio::io_service ioService;
 
+  ses::proxy::Server::Ptr proxyServer = std::make_shared<ses::proxy::Server>();
+  proxyServer->setPool({poolUnixPath.empty() ? "127.0.0.1" : poolUnixPath,
+                        poolPort,
+                        "WmtUmjUrDQNdqTtau95gJN6YTUd9GWxK4AmgqXeAXLwX8U6eX9zECuALB1Fcwoa8pJJNoniFPo5Kdix8EUuFsUaz1rwKfhCw4",
+                        "ses-proxy-test",
+                        poolUnixPath.empty() ? poolConnectionType : ses::net::CONNECTION_TYPE_UNIX,
+                        poolProtocol});
+  if (!shareJournalPath.empty())
+  {
+    ses::proxy::ShareJournal::Ptr shareJournal = ses::proxy::ShareJournal::open(shareJournalPath);
+    if (!shareJournal)
+    {
+      return 1;
+    }
+    proxyServer->setShareJournal(shareJournal);
+  }
+  if (shareVerification)
+  {
+    proxyServer->setShareVerification(*shareVerification);
+  }
+  proxyServer->setSessionGracePeriod(sessionGracePeriod);
+  if (!capturePath.empty() && !ses::net::Capture::start(capturePath))
+  {
+    return 1;
+  }
+  if (!shareTracePath.empty() && !ses::util::ShareTrace::startExport(shareTracePath, shareTraceSample))
+  {
+    return 1;
+  }
+  if (handOverPath.empty() || !proxyServer->takeOver(handOverPath))
+  {
+    if (unixPath.empty())
+    {
+      proxyServer->start("127.0.0.1", port);
+    }
+    else
+    {
+      proxyServer->start(unixPath, 0, ses::net::CONNECTION_TYPE_UNIX);
+    }
+  }
 
-  ses::proxy::Pool::Ptr pool = std::make_shared<ses::proxy::Pool>();
-  pool->connect("127.0.0.1",
-                5555,
-                "WmtUmjUrDQNdqTtau95gJN6YTUd9GWxK4AmgqXeAXLwX8U6eX9zECuALB1Fcwoa8pJJNoniFPo5Kdix8EUuFsUaz1rwKfhCw4",
-                "ses-proxy-test");
+  ses::net::handover::Listener::Ptr handOverListener;
+  if (!handOverPath.empty())
+  {
+    handOverListener = ses::net::handover::listen(
+      handOverPath,
+      [&](int channel)
+      {
+        std::cout << "Successor connected ... handing over" << std::endl;
+        proxyServer->handOver(channel);
+        ioService.stop();
+      });
+  }
 
-  pool->submit("f8010020", "32823cde080e1877baa3c023a17f4d250d8fa4b3128b08f507d0afea9de10000");
 
-  waitForSignal();
+  waitForSignal(ioService);
 
   return 0;
 }
\ No newline at end of file
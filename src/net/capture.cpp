@@ -0,0 +1,146 @@
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "net/capture.hpp"
+
+namespace ses {
+namespace net {
+
+namespace {
+const char MAGIC[8] = {'S', 'E', 'S', 'C', 'A', 'P', 'T', '\0'};
+const uint32_t VERSION = 1;
+
+struct State
+{
+  std::mutex bufferMutex;
+  std::vector<char> buffer;
+  std::atomic<uint64_t> nextConnectionId{1};
+  std::atomic<uint64_t> droppedRecords{0};
+};
+
+State& state()
+{
+  // never destroyed, connections may still record while the process exits
+  static State* state = new State();
+  return *state;
+}
+
+void flush(std::FILE* file)
+{
+  State& captureState = state();
+  std::vector<char> pending;
+  for (;;)
+  {
+    std::this_thread::sleep_for(Capture::FLUSH_INTERVAL);
+    {
+      std::lock_guard<std::mutex> lock(captureState.bufferMutex);
+      pending.swap(captureState.buffer);
+    }
+    if (!pending.empty())
+    {
+      std::fwrite(pending.data(), 1, pending.size(), file);
+      std::fflush(file);
+      pending.clear();
+    }
+  }
+}
+}
+
+constexpr std::chrono::milliseconds Capture::FLUSH_INTERVAL;
+std::atomic<bool> Capture::active_{false};
+
+bool Capture::start(const std::string& path)
+{
+  std::FILE* file = std::fopen(path.c_str(), "wb");
+  if (!file)
+  {
+    std::cerr << "net::Capture::start, cannot open " << path << std::endl;
+    return false;
+  }
+
+  FileHeader header;
+  std::memset(&header, 0, sizeof(header));
+  std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+  header.version = VERSION;
+  header.recordHeaderSize = sizeof(RecordHeader);
+  std::fwrite(&header, sizeof(header), 1, file);
+  std::fflush(file);
+
+  std::thread(flush, file).detach();
+  active_.store(true, std::memory_order_relaxed);
+  return true;
+}
+
+uint64_t Capture::createConnectionId()
+{
+  return state().nextConnectionId.fetch_add(1, std::memory_order_relaxed);
+}
+
+void Capture::record(uint64_t connectionId, Side side, Event event, const char* data, std::size_t size)
+{
+  RecordHeader header;
+  header.timestamp = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+    std::chrono::steady_clock::now().time_since_epoch()).count());
+  header.connectionId = connectionId;
+  header.side = side;
+  header.event = event;
+  header.reserved = 0;
+  header.size = static_cast<uint32_t>(size);
+
+  State& captureState = state();
+  std::lock_guard<std::mutex> lock(captureState.bufferMutex);
+  if (captureState.buffer.size() + sizeof(header) + size > BUFFER_LIMIT)
+  {
+    captureState.droppedRecords.fetch_add(1, std::memory_order_relaxed);
+    return;
+  }
+  const char* headerBytes = reinterpret_cast<const char*>(&header);
+  captureState.buffer.insert(captureState.buffer.end(), headerBytes, headerBytes + sizeof(header));
+  captureState.buffer.insert(captureState.buffer.end(), data, data + size);
+}
+
+bool Capture::read(const std::string& path,
+                   const std::function<void(const RecordHeader& header, const char* data)>& recordHandler)
+{
+  std::FILE* file = std::fopen(path.c_str(), "rb");
+  if (!file)
+  {
+    return false;
+  }
+
+  FileHeader fileHeader;
+  if (std::fread(&fileHeader, sizeof(fileHeader), 1, file) != 1 ||
+      std::memcmp(fileHeader.magic, MAGIC, sizeof(MAGIC)) != 0 || fileHeader.version != VERSION ||
+      fileHeader.recordHeaderSize != sizeof(RecordHeader))
+  {
+    std::fclose(file);
+    return false;
+  }
+
+  RecordHeader header;
+  std::vector<char> data;
+  // a record cut off by a crash ends the capture
+  while (std::fread(&header, sizeof(header), 1, file) == 1)
+  {
+    data.resize(header.size);
+    if (header.size > 0 && std::fread(data.data(), 1, header.size, file) != header.size)
+    {
+      break;
+    }
+    recordHandler(header, data.data());
+  }
+  std::fclose(file);
+  return true;
+}
+
+uint64_t Capture::getDroppedRecords()
+{
+  return state().droppedRecords.load(std::memory_order_relaxed);
+}
+
+} // namespace net
+} // namespace ses
@@ -0,0 +1,87 @@
+#ifndef SES_NET_CAPTURE_HPP
+#define SES_NET_CAPTURE_HPP
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <string>
+
+namespace ses {
+namespace net {
+
+/**
+ * Capture of the messages miners and pools send to the proxy, for replaying the same traffic with
+ * ses_proxy_replay.
+ *
+ * Each message is recorded as a RecordHeader followed by the message as framed, a line without its
+ * newline or a whole binary frame. Connections are numbered in the order they deliver their first
+ * message and record a close event when destroyed. Recording appends to a buffer a writer thread
+ * flushes to the file every FLUSH_INTERVAL; records arriving while BUFFER_LIMIT bytes are pending
+ * are dropped and counted. Until start() a message costs a load and a branch.
+ */
+class Capture
+{
+public:
+  enum Side : uint8_t
+  {
+    SIDE_CLIENT,
+    SIDE_POOL
+  };
+
+  enum Event : uint8_t
+  {
+    EVENT_MESSAGE,
+    EVENT_CLOSE
+  };
+
+  struct FileHeader
+  {
+    char magic[8];
+    uint32_t version;
+    uint32_t recordHeaderSize;
+  };
+
+  struct RecordHeader
+  {
+    // steady clock nanoseconds
+    uint64_t timestamp;
+    uint64_t connectionId;
+    Side side;
+    Event event;
+    uint16_t reserved;
+    uint32_t size;
+  };
+  static_assert(sizeof(RecordHeader) == 24, "capture records have a fixed header");
+
+  static const std::size_t BUFFER_LIMIT = 64 * 1024 * 1024;
+  static constexpr std::chrono::milliseconds FLUSH_INTERVAL{100};
+
+public:
+  // captures to path from now on, false if it is not writable
+  static bool start(const std::string& path);
+
+  static bool isActive()
+  {
+    return active_.load(std::memory_order_relaxed);
+  }
+
+  static uint64_t createConnectionId();
+
+  // safe to call from any thread
+  static void record(uint64_t connectionId, Side side, Event event, const char* data, std::size_t size);
+
+  // reads a capture in recording order, false if it is not readable
+  static bool read(const std::string& path,
+                   const std::function<void(const RecordHeader& header, const char* data)>& recordHandler);
+
+  static uint64_t getDroppedRecords();
+
+private:
+  static std::atomic<bool> active_;
+};
+
+} // namespace net
+} // namespace ses
+
+#endif //SES_NET_CAPTURE_HPP
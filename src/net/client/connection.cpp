@@ -16,50 +16,222 @@
  *   along with this program. If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <cstring>
 #include <iostream>
-#include <boost/exception/diagnostic_information.hpp>
+#include <thread>
+#include <utility>
 
-#include "net/client/connection.hpp"
-#include "net/client/boosttlsconnection.hpp"
-#include "net/client/boosttcpconnection.hpp"
+#include <boost/asio/co_spawn.hpp>
+#include <boost/asio/detached.hpp>
+#include <boost/asio/executor_work_guard.hpp>
+#include <boost/asio/ip/tcp.hpp>
+#include <boost/asio/redirect_error.hpp>
+#include <boost/asio/use_awaitable.hpp>
+#include <boost/asio/write.hpp>
 
+#include "net/client/connection.hpp"
+#include "net/unixendpoint.hpp"
+#include "util/allocationaccounting.hpp"
 
 namespace ses {
 namespace net {
 namespace client {
 
-Connection::Ptr establishConnection(const ConnectionHandler::Ptr &listener, const std::string &host, uint16_t port,
-                                    ConnectionType type)
+using boost::asio::use_awaitable;
+
+boost::asio::io_context& getIoContext()
 {
-  Connection::Ptr connection;
+  // never destroyed, the upstream thread runs for the rest of the process' lifetime
+  static boost::asio::io_context* ioContext =
+    []()
+    {
+      auto context = new boost::asio::io_context(1);
+      std::thread(
+        [context]()
+        {
+          auto work = boost::asio::make_work_guard(*context);
+          context->run();
+        }).detach();
+      return context;
+    }();
+  return *ioContext;
+}
 
-  if (type == CONNECTION_TYPE_AUTO)
+UpstreamConnection::UpstreamConnection(const ConnectionHandler::Ptr& handler, ConnectionType type)
+  : Connection(handler)
+  , type_(type)
+  , socket_(getIoContext())
+{
+}
+
+boost::asio::awaitable<void> UpstreamConnection::connect(std::string host, uint16_t port)
+{
+  if (type_ == CONNECTION_TYPE_UNIX)
   {
-    type = (port == 443) ? CONNECTION_TYPE_TLS : CONNECTION_TYPE_TCP;
+    std::cout << "net::client::UpstreamConnection::connect, unix, " << host << std::endl;
+    co_await socket_.async_connect(makeUnixEndpoint(host), use_awaitable);
+    co_return;
   }
 
+  std::cout << "net::client::UpstreamConnection::connect, " << host << ":" << port << std::endl;
+  boost::asio::ip::tcp::resolver resolver(socket_.get_executor());
+  auto endpoints = co_await resolver.async_resolve(host, std::to_string(port), use_awaitable);
+  // the socket takes any family, so the resolved endpoints are tried one by one
+  boost::system::error_code error = boost::asio::error::host_not_found;
+  for (const auto& entry : endpoints)
+  {
+    socket_.close(error);
+    co_await socket_.async_connect(entry.endpoint(), boost::asio::redirect_error(use_awaitable, error));
+    if (!error)
+    {
+      break;
+    }
+  }
+  if (error)
+  {
+    throw boost::system::system_error(error);
+  }
+  socket_.set_option(boost::asio::ip::tcp::no_delay(true));
+  socket_.set_option(boost::asio::socket_base::keep_alive(true));
+
+  if (type_ == CONNECTION_TYPE_TLS || type_ == CONNECTION_TYPE_TLS_KERNEL ||
+      (type_ == CONNECTION_TYPE_AUTO && port == 443))
+  {
+    tlsContext_.reset(new boost::asio::ssl::context(boost::asio::ssl::context::sslv23_client));
+    if (type_ == CONNECTION_TYPE_TLS_KERNEL)
+    {
+      kernelTls_.prepare(tlsContext_->native_handle());
+    }
+    tlsStream_.reset(new boost::asio::ssl::stream<boost::asio::generic::stream_protocol::socket&>(socket_,
+                                                                                                   *tlsContext_));
+    tlsStream_->set_verify_mode(boost::asio::ssl::verify_none);
+    co_await tlsStream_->async_handshake(boost::asio::ssl::stream_base::client, use_awaitable);
+    if (type_ == CONNECTION_TYPE_TLS_KERNEL)
+    {
+      kernelTlsOffload_ = kernelTls_.install(socket_.native_handle(), tlsStream_->native_handle());
+      std::cout << "net::client::UpstreamConnection::connect, kernel tls, send, " << kernelTlsOffload_.send
+                << ", receive, " << kernelTlsOffload_.receive << std::endl;
+    }
+  }
+}
+
+boost::asio::awaitable<std::string> UpstreamConnection::receive()
+{
+  // keeps the connection alive while its handler is called
+  Ptr self = shared_from_this();
   try
   {
-    switch (type)
+    for (;;)
     {
-      case CONNECTION_TYPE_TLS:
-        connection = establishBoostTlsConnection(listener, host, port);
-        break;
+      std::size_t size = tlsStream_ && !kernelTlsOffload_.receive ?
+        co_await tlsStream_->async_read_some(boost::asio::buffer(receiveBuffer_), use_awaitable) :
+        co_await socket_.async_read_some(boost::asio::buffer(receiveBuffer_), use_awaitable);
+      notifyRead(receiveBuffer_, size);
+    }
+  }
+  catch (const boost::system::system_error& error)
+  {
+    close();
+    co_return error.code().message();
+  }
+}
 
-      case CONNECTION_TYPE_TCP:
-        connection = establishBoostTcpConnection(listener, host, port);
+bool UpstreamConnection::connected() const
+{
+  return socket_.is_open();
+}
 
-      default:
-        break;
+std::string UpstreamConnection::connectedIp() const
+{
+  boost::system::error_code error;
+  auto endpoint = socket_.remote_endpoint(error);
+  if (error || endpoint.size() > sizeof(sockaddr_in6))
+  {
+    return "";
+  }
+  if (type_ == CONNECTION_TYPE_UNIX)
+  {
+    return "localhost";
+  }
+  boost::asio::ip::tcp::endpoint ipEndpoint;
+  std::memcpy(ipEndpoint.data(), endpoint.data(), endpoint.size());
+  return ipEndpoint.address().to_string();
+}
+
+int UpstreamConnection::nativeHandle() const
+{
+  return const_cast<boost::asio::generic::stream_protocol::socket&>(socket_).native_handle();
+}
+
+void UpstreamConnection::stopReading()
+{
+  boost::system::error_code error;
+  socket_.cancel(error);
+}
+
+void UpstreamConnection::disconnect()
+{
+  Ptr self = shared_from_this();
+  boost::asio::post(socket_.get_executor(), [self]() { self->close(); });
+}
+
+bool UpstreamConnection::send(const char* data, std::size_t size)
+{
+  util::AllocationAccounting::Scope accountingScope(util::AllocationAccounting::SUBSYSTEM_NET);
+  std::cout << "net::client::UpstreamConnection::send:" << std::endl << "  ";
+  std::cout.write(data, size);
+  std::cout << "\n";
+
+  if (!socket_.is_open())
+  {
+    return false;
+  }
+  pendingData_.append(data, size);
+  util::AllocationAccounting::recordCopy(size);
+  if (!writing_)
+  {
+    writing_ = true;
+    boost::asio::co_spawn(socket_.get_executor(), write(shared_from_this()), boost::asio::detached);
+  }
+  return true;
+}
+
+boost::asio::awaitable<void> UpstreamConnection::write(Ptr self)
+{
+  std::string data;
+  try
+  {
+    while (!self->pendingData_.empty())
+    {
+      data.swap(self->pendingData_);
+      if (self->tlsStream_ && !self->kernelTlsOffload_.send)
+      {
+        co_await boost::asio::async_write(*self->tlsStream_, boost::asio::buffer(data), use_awaitable);
+      }
+      else
+      {
+        co_await boost::asio::async_write(self->socket_, boost::asio::buffer(data), use_awaitable);
+      }
+      data.clear();
     }
   }
-  catch (...)
+  catch (const boost::system::system_error& error)
   {
-    std::cout << boost::current_exception_diagnostic_information();
+    // ends receive(), which reports the failure
+    std::cout << "net::client::UpstreamConnection write failed: " << error.what() << std::endl;
+    self->close();
   }
-  return connection;
+  self->writing_ = false;
+}
+
+void UpstreamConnection::close()
+{
+  boost::system::error_code error;
+  socket_.shutdown(boost::asio::socket_base::shutdown_both, error);
+  socket_.close(error);
+  pendingData_.clear();
 }
 
 } //namespace client
-} //namespace ses
 } //namespace net
+} //namespace ses
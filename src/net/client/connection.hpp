@@ -22,9 +22,16 @@
 #include <cstdint>
 #include <memory>
 #include <string>
+// Boost 1.74's awaitable.hpp uses std::exchange without including <utility>
+#include <utility>
 
-#include <boost/noncopyable.hpp>
+#include <boost/asio/awaitable.hpp>
+#include <boost/asio/generic/stream_protocol.hpp>
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/ssl/context.hpp>
+#include <boost/asio/ssl/stream.hpp>
 
+#include "net/client/kerneltls.hpp"
 #include "net/connection.hpp"
 #include "net/connectiontype.hpp"
 
@@ -32,9 +39,65 @@ namespace ses {
 namespace net {
 namespace client {
 
-Connection::Ptr establishConnection(const ConnectionHandler::Ptr &listener,
-                                    const std::string &host, uint16_t port,
-                                    ConnectionType type = CONNECTION_TYPE_AUTO);
+// runs all upstream connections on a single thread, started with the first call
+boost::asio::io_context& getIoContext();
+
+/**
+ * Connection to an upstream pool, driven by coroutines on the upstream thread.
+ *
+ * connect() and receive() are awaited by the owner's session coroutine, receive() hands the
+ * messages to the handler until the connection fails or is disconnected. Sends are queued and
+ * written by a coroutine of their own, so they never block. Except for disconnect(), everything
+ * must be called on the upstream thread.
+ */
+class UpstreamConnection : public Connection,
+                           public std::enable_shared_from_this<UpstreamConnection>
+{
+public:
+  typedef std::shared_ptr<UpstreamConnection> Ptr;
+
+public:
+  // CONNECTION_TYPE_AUTO uses TLS for port 443, CONNECTION_TYPE_TLS_KERNEL hands the records to the
+  // kernel once the handshake is done and reads and writes the plain socket for what it took over,
+  // CONNECTION_TYPE_UNIX connects to the UNIX socket at the path given as host
+  UpstreamConnection(const ConnectionHandler::Ptr& handler, ConnectionType type);
+
+  // resolves, connects and for TLS handshakes, throws boost::system::system_error on failure
+  boost::asio::awaitable<void> connect(std::string host, uint16_t port);
+
+  // returns the reason the connection ended
+  boost::asio::awaitable<std::string> receive();
+
+  bool connected() const override;
+  std::string connectedIp() const override;
+  int nativeHandle() const override;
+  void stopReading() override;
+  // safe to call from any thread
+  void disconnect() override;
+  bool send(const char* data, std::size_t size) override;
+  using Connection::send;
+
+protected:
+  Capture::Side getCaptureSide() const override {return Capture::SIDE_POOL;}
+
+private:
+  static boost::asio::awaitable<void> write(Ptr self);
+  void close();
+
+private:
+  ConnectionType type_;
+  // TCP or UNIX stream socket
+  boost::asio::generic::stream_protocol::socket socket_;
+  std::unique_ptr<boost::asio::ssl::context> tlsContext_;
+  std::unique_ptr<boost::asio::ssl::stream<boost::asio::generic::stream_protocol::socket&>> tlsStream_;
+  KernelTls kernelTls_;
+  KernelTls::Offload kernelTlsOffload_ = {false, false};
+  char receiveBuffer_[2048];
+
+  // appended to while the writer sends the previous data
+  std::string pendingData_;
+  bool writing_ = false;
+};
 
 } //namespace client
 } //namespace net
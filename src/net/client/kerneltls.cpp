@@ -0,0 +1,227 @@
+#include <cstdint>
+#include <cstring>
+#include <vector>
+#include <linux/tls.h>
+#include <netinet/tcp.h>
+#include <openssl/core_names.h>
+#include <openssl/crypto.h>
+#include <openssl/evp.h>
+#include <openssl/kdf.h>
+#include <sys/socket.h>
+
+#include "net/client/kerneltls.hpp"
+#include "util/hex.hpp"
+
+namespace ses {
+namespace net {
+namespace client {
+
+namespace {
+const char TRAFFIC_SECRET_LABEL[] = "CLIENT_TRAFFIC_SECRET_0 ";
+const char KEY_EXPANSION_LABEL[] = "key expansion";
+
+struct KeyMaterial
+{
+  uint8_t key[32];
+  uint8_t iv[12];
+};
+
+union CryptoInfo
+{
+  tls12_crypto_info_aes_gcm_128 aesGcm128;
+  tls12_crypto_info_aes_gcm_256 aesGcm256;
+  tls12_crypto_info_chacha20_poly1305 chaCha20Poly1305;
+};
+
+int contextIndex()
+{
+  static int index = SSL_CTX_get_ex_new_index(0, nullptr, nullptr, nullptr, nullptr);
+  return index;
+}
+
+bool derive(const char* algorithm, const OSSL_PARAM* params, uint8_t* out, std::size_t size)
+{
+  EVP_KDF* kdf = EVP_KDF_fetch(nullptr, algorithm, nullptr);
+  EVP_KDF_CTX* context = kdf ? EVP_KDF_CTX_new(kdf) : nullptr;
+  bool derived = context && EVP_KDF_derive(context, out, size, params) > 0;
+  EVP_KDF_CTX_free(context);
+  EVP_KDF_free(kdf);
+  return derived;
+}
+
+// the TLS 1.2 key block is client write key, server write key, client write IV and server write IV
+bool deriveTls12(SSL* ssl, const char* digest, std::size_t keySize, std::size_t ivSize,
+                 KeyMaterial& client, KeyMaterial& server)
+{
+  uint8_t masterKey[SSL_MAX_MASTER_KEY_LENGTH];
+  std::size_t masterKeySize = SSL_SESSION_get_master_key(SSL_get_session(ssl), masterKey, sizeof(masterKey));
+  std::size_t labelSize = sizeof(KEY_EXPANSION_LABEL) - 1;
+  uint8_t seed[sizeof(KEY_EXPANSION_LABEL) - 1 + 2 * SSL3_RANDOM_SIZE];
+  std::memcpy(seed, KEY_EXPANSION_LABEL, labelSize);
+  SSL_get_server_random(ssl, seed + labelSize, SSL3_RANDOM_SIZE);
+  SSL_get_client_random(ssl, seed + labelSize + SSL3_RANDOM_SIZE, SSL3_RANDOM_SIZE);
+
+  OSSL_PARAM params[] = {
+    OSSL_PARAM_construct_utf8_string(OSSL_KDF_PARAM_DIGEST, const_cast<char*>(digest), 0),
+    OSSL_PARAM_construct_octet_string(OSSL_KDF_PARAM_SECRET, masterKey, masterKeySize),
+    OSSL_PARAM_construct_octet_string(OSSL_KDF_PARAM_SEED, seed, sizeof(seed)),
+    OSSL_PARAM_construct_end()};
+  uint8_t keyBlock[2 * sizeof(KeyMaterial::key) + 2 * sizeof(KeyMaterial::iv)];
+  bool derived = derive(OSSL_KDF_NAME_TLS1_PRF, params, keyBlock, 2 * keySize + 2 * ivSize);
+  if (derived)
+  {
+    std::memcpy(client.key, keyBlock, keySize);
+    std::memcpy(server.key, keyBlock + keySize, keySize);
+    std::memcpy(client.iv, keyBlock + 2 * keySize, ivSize);
+    std::memcpy(server.iv, keyBlock + 2 * keySize + ivSize, ivSize);
+  }
+  OPENSSL_cleanse(masterKey, sizeof(masterKey));
+  OPENSSL_cleanse(keyBlock, sizeof(keyBlock));
+  return derived;
+}
+
+// HKDF-Expand-Label of TLS 1.3 with an empty context
+bool expandLabel(const char* digest, const std::string& secret, const std::string& label, uint8_t* out,
+                 std::size_t size)
+{
+  std::string fullLabel = "tls13 " + label;
+  std::vector<uint8_t> info{static_cast<uint8_t>(size >> 8), static_cast<uint8_t>(size),
+                            static_cast<uint8_t>(fullLabel.size())};
+  info.insert(info.end(), fullLabel.begin(), fullLabel.end());
+  info.push_back(0);
+
+  int mode = EVP_KDF_HKDF_MODE_EXPAND_ONLY;
+  OSSL_PARAM params[] = {
+    OSSL_PARAM_construct_int(OSSL_KDF_PARAM_MODE, &mode),
+    OSSL_PARAM_construct_utf8_string(OSSL_KDF_PARAM_DIGEST, const_cast<char*>(digest), 0),
+    OSSL_PARAM_construct_octet_string(OSSL_KDF_PARAM_KEY, const_cast<char*>(secret.data()), secret.size()),
+    OSSL_PARAM_construct_octet_string(OSSL_KDF_PARAM_INFO, info.data(), info.size()),
+    OSSL_PARAM_construct_end()};
+  return derive(OSSL_KDF_NAME_HKDF, params, out, size);
+}
+
+// the kernel takes the implicit part of the nonce as salt and the explicit part as iv, a TLS 1.2
+// explicit nonce only has to be unique and starts with the sequence number
+std::size_t fillCryptoInfo(CryptoInfo& info, int version, int cipher, const KeyMaterial& keys, uint64_t sequence)
+{
+  uint8_t recordSequence[8];
+  for (int i = 0; i < 8; ++i)
+  {
+    recordSequence[7 - i] = static_cast<uint8_t>(sequence >> (8 * i));
+  }
+  const uint8_t* explicitIv = version == TLS1_2_VERSION ? recordSequence : keys.iv + 4;
+
+  std::memset(&info, 0, sizeof(info));
+  switch (cipher)
+  {
+    case NID_aes_128_gcm:
+      info.aesGcm128.info.version = static_cast<uint16_t>(version);
+      info.aesGcm128.info.cipher_type = TLS_CIPHER_AES_GCM_128;
+      std::memcpy(info.aesGcm128.key, keys.key, sizeof(info.aesGcm128.key));
+      std::memcpy(info.aesGcm128.salt, keys.iv, sizeof(info.aesGcm128.salt));
+      std::memcpy(info.aesGcm128.iv, explicitIv, sizeof(info.aesGcm128.iv));
+      std::memcpy(info.aesGcm128.rec_seq, recordSequence, sizeof(recordSequence));
+      return sizeof(info.aesGcm128);
+    case NID_aes_256_gcm:
+      info.aesGcm256.info.version = static_cast<uint16_t>(version);
+      info.aesGcm256.info.cipher_type = TLS_CIPHER_AES_GCM_256;
+      std::memcpy(info.aesGcm256.key, keys.key, sizeof(info.aesGcm256.key));
+      std::memcpy(info.aesGcm256.salt, keys.iv, sizeof(info.aesGcm256.salt));
+      std::memcpy(info.aesGcm256.iv, explicitIv, sizeof(info.aesGcm256.iv));
+      std::memcpy(info.aesGcm256.rec_seq, recordSequence, sizeof(recordSequence));
+      return sizeof(info.aesGcm256);
+    case NID_chacha20_poly1305:
+      // the whole nonce is implicit
+      info.chaCha20Poly1305.info.version = static_cast<uint16_t>(version);
+      info.chaCha20Poly1305.info.cipher_type = TLS_CIPHER_CHACHA20_POLY1305;
+      std::memcpy(info.chaCha20Poly1305.key, keys.key, sizeof(info.chaCha20Poly1305.key));
+      std::memcpy(info.chaCha20Poly1305.iv, keys.iv, sizeof(info.chaCha20Poly1305.iv));
+      std::memcpy(info.chaCha20Poly1305.rec_seq, recordSequence, sizeof(recordSequence));
+      return sizeof(info.chaCha20Poly1305);
+    default:
+      return 0;
+  }
+}
+}
+
+void KernelTls::prepare(SSL_CTX* context)
+{
+  SSL_CTX_set_ex_data(context, contextIndex(), this);
+  SSL_CTX_set_keylog_callback(context, &KernelTls::logKey);
+}
+
+KernelTls::Offload KernelTls::install(int socket, SSL* ssl) const
+{
+  Offload offload{false, false};
+  const SSL_CIPHER* cipher = SSL_get_current_cipher(ssl);
+  int cipherNid = cipher ? SSL_CIPHER_get_cipher_nid(cipher) : NID_undef;
+  std::size_t keySize = cipherNid == NID_aes_128_gcm ? 16 :
+                        cipherNid == NID_aes_256_gcm || cipherNid == NID_chacha20_poly1305 ? 32 : 0;
+  const EVP_MD* handshakeDigest = cipher ? SSL_CIPHER_get_handshake_digest(cipher) : nullptr;
+  if (keySize == 0 || !handshakeDigest)
+  {
+    return offload;
+  }
+  const char* digest = EVP_MD_get0_name(handshakeDigest);
+
+  int version = SSL_version(ssl);
+  KeyMaterial client;
+  KeyMaterial server;
+  bool receive = false;
+  if (version == TLS1_2_VERSION)
+  {
+    std::size_t ivSize = cipherNid == NID_chacha20_poly1305 ? 12 : 4;
+    if (!deriveTls12(ssl, digest, keySize, ivSize, client, server))
+    {
+      return offload;
+    }
+    // the server's records only go to the kernel if OpenSSL holds none of them yet
+    receive = SSL_pending(ssl) == 0 && BIO_ctrl_pending(SSL_get_rbio(ssl)) == 0;
+  }
+  else if (version != TLS1_3_VERSION || clientTrafficSecret_.empty() ||
+           !expandLabel(digest, clientTrafficSecret_, "key", client.key, keySize) ||
+           !expandLabel(digest, clientTrafficSecret_, "iv", client.iv, sizeof(client.iv)))
+  {
+    return offload;
+  }
+
+  // fails with ENOENT if the tls module is not loaded
+  if (setsockopt(socket, SOL_TCP, TCP_ULP, "tls", sizeof("tls")) == 0)
+  {
+    // the Finished messages took the first TLS 1.2 sequence numbers, TLS 1.3 starts over with the
+    // application traffic keys
+    uint64_t sequence = version == TLS1_2_VERSION ? 1 : 0;
+    CryptoInfo info;
+    std::size_t size = fillCryptoInfo(info, version, cipherNid, client, sequence);
+    offload.send = size > 0 && setsockopt(socket, SOL_TLS, TLS_TX, &info, size) == 0;
+    if (receive)
+    {
+      size = fillCryptoInfo(info, version, cipherNid, server, sequence);
+      offload.receive = size > 0 && setsockopt(socket, SOL_TLS, TLS_RX, &info, size) == 0;
+    }
+    OPENSSL_cleanse(&info, sizeof(info));
+  }
+  OPENSSL_cleanse(&client, sizeof(client));
+  OPENSSL_cleanse(&server, sizeof(server));
+  return offload;
+}
+
+void KernelTls::logKey(const SSL* ssl, const char* line)
+{
+  // lines are "<label> <client random> <secret>" in hex
+  KernelTls* kernelTls = static_cast<KernelTls*>(SSL_CTX_get_ex_data(SSL_get_SSL_CTX(ssl), contextIndex()));
+  const char* secret = std::strrchr(line, ' ');
+  if (kernelTls && secret && std::strncmp(line, TRAFFIC_SECRET_LABEL, sizeof(TRAFFIC_SECRET_LABEL) - 1) == 0)
+  {
+    std::string secretHex(secret + 1);
+    kernelTls->clientTrafficSecret_.assign(secretHex.size() / 2, '\0');
+    if (!util::hex::decode(secretHex, reinterpret_cast<uint8_t*>(&kernelTls->clientTrafficSecret_[0])))
+    {
+      kernelTls->clientTrafficSecret_.clear();
+    }
+  }
+}
+
+} //namespace client
+} //namespace net
+} //namespace ses
@@ -0,0 +1,48 @@
+#ifndef SES_NET_CLIENT_KERNELTLS_HPP
+#define SES_NET_CLIENT_KERNELTLS_HPP
+
+#include <string>
+#include <openssl/ssl.h>
+
+namespace ses {
+namespace net {
+namespace client {
+
+/**
+ * Offload of an established TLS session to the kernel: its keys are installed with
+ * setsockopt(SOL_TLS), from then on the kernel encrypts, and decrypts, the records while the
+ * connection writes and reads plain data on the socket.
+ *
+ * Sending is offloaded for TLS 1.2 and 1.3, receiving for TLS 1.2 only, since TLS 1.3 servers send
+ * session tickets after the handshake and OpenSSL does not tell how many records it consumed.
+ * AES-GCM and ChaCha20-Poly1305 are supported. Without the kernel's tls module, for other ciphers
+ * or if the kernel refuses the keys, the direction stays with OpenSSL.
+ */
+class KernelTls
+{
+public:
+  struct Offload
+  {
+    bool send;
+    bool receive;
+  };
+
+public:
+  // to be called on the context before the handshake, captures the secret TLS 1.3 keys derive from
+  void prepare(SSL_CTX* context);
+
+  // to be called right after the handshake, before anything is sent
+  Offload install(int socket, SSL* ssl) const;
+
+private:
+  static void logKey(const SSL* ssl, const char* line);
+
+private:
+  std::string clientTrafficSecret_;
+};
+
+} //namespace client
+} //namespace net
+} //namespace ses
+
+#endif //SES_NET_CLIENT_KERNELTLS_HPP
@@ -16,26 +16,43 @@
  *   along with this program. If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <algorithm>
+#include <cstring>
 #include <iostream>
 #include <boost/exception/diagnostic_information.hpp>
 
-#include "net/client/connection.hpp"
-#include "net/client/boosttlsconnection.hpp"
-#include "net/client/boosttcpconnection.hpp"
+#include "net/frame.hpp"
+#include "net/connection.hpp"
+#include "util/allocationaccounting.hpp"
+#include "util/arena.hpp"
 
 
 namespace ses {
 namespace net {
 
 Connection::Connection()
+  : framing_(FRAMING_UNKNOWN)
+  , captureId_(0)
+  , captureSide_(Capture::SIDE_CLIENT)
 {
 }
 
 Connection::Connection(const ConnectionHandler::Ptr &handler)
   : handler_(handler)
+  , framing_(FRAMING_UNKNOWN)
+  , captureId_(0)
+  , captureSide_(Capture::SIDE_CLIENT)
 {
 }
 
+Connection::~Connection()
+{
+  if (captureId_ != 0)
+  {
+    Capture::record(captureId_, captureSide_, Capture::EVENT_CLOSE, nullptr, 0);
+  }
+}
+
 void Connection::setHandler(const ConnectionHandler::Ptr &handler)
 {
   handler_ = handler;
@@ -43,6 +60,147 @@ void Connection::setHandler(const ConnectionHandler::Ptr &handler)
 
 void Connection::notifyRead(char *data, size_t size)
 {
+  util::AllocationAccounting::Scope accountingScope(util::AllocationAccounting::SUBSYSTEM_NET);
+  if (framing_ == FRAMING_UNKNOWN && size > 0)
+  {
+    framing_ = static_cast<uint8_t>(data[0]) == frame::MAGIC ? FRAMING_BINARY : FRAMING_LINES;
+  }
+
+  if (framing_ == FRAMING_BINARY)
+  {
+    notifyFrames(data, size);
+  }
+  else
+  {
+    notifyLines(data, size);
+  }
+}
+
+void Connection::notifyLines(char *data, size_t size)
+{
+  // a read may end within a message or carry several, handlers get one line each
+  char* end = data + size;
+  while (data < end)
+  {
+    char* newline = static_cast<char*>(std::memchr(data, '\n', end - data));
+    if (!newline)
+    {
+      if (pendingMessage_.size() + (end - data) > MAX_MESSAGE_SIZE)
+      {
+        pendingMessage_.clear();
+        notifyError("message exceeds " + std::to_string(MAX_MESSAGE_SIZE) + " bytes");
+        return;
+      }
+      pendingMessage_.append(data, end - data);
+      util::AllocationAccounting::recordCopy(end - data);
+      break;
+    }
+
+    if (pendingMessage_.empty())
+    {
+      notifyMessage(data, newline - data);
+    }
+    else
+    {
+      pendingMessage_.append(data, newline - data);
+      util::AllocationAccounting::recordCopy(newline - data);
+      notifyMessage(&pendingMessage_[0], pendingMessage_.size());
+      // released rather than cleared, a message spanning reads is rare and idle connections keep no capacity
+      std::string().swap(pendingMessage_);
+    }
+    data = newline + 1;
+  }
+}
+
+void Connection::notifyFrames(char *data, size_t size)
+{
+  // handlers get one whole frame including its header, frames completely within the read are not copied
+  char* end = data + size;
+  while (data < end)
+  {
+    const char* frameStart = data;
+    std::size_t available = end - data;
+    if (!pendingMessage_.empty())
+    {
+      std::size_t missing = sizeof(frame::Header) > pendingMessage_.size() ?
+                            sizeof(frame::Header) - pendingMessage_.size() : 0;
+      if (missing == 0)
+      {
+        missing = getFrameSize(pendingMessage_.data()) - pendingMessage_.size();
+      }
+      std::size_t taken = std::min(missing, available);
+      pendingMessage_.append(data, taken);
+      util::AllocationAccounting::recordCopy(taken);
+      data += taken;
+      if (pendingMessage_.size() >= sizeof(frame::Header) &&
+          pendingMessage_.size() == getFrameSize(pendingMessage_.data()))
+      {
+        if (!notifyFrame(&pendingMessage_[0], pendingMessage_.size()))
+        {
+          return;
+        }
+        std::string().swap(pendingMessage_);
+      }
+      continue;
+    }
+
+    if (available < sizeof(frame::Header) || available < getFrameSize(frameStart))
+    {
+      pendingMessage_.assign(data, available);
+      util::AllocationAccounting::recordCopy(available);
+      break;
+    }
+    std::size_t frameSize = getFrameSize(frameStart);
+    if (!notifyFrame(data, frameSize))
+    {
+      return;
+    }
+    data += frameSize;
+  }
+}
+
+bool Connection::notifyFrame(char *data, size_t size)
+{
+  if (static_cast<uint8_t>(data[0]) != frame::MAGIC)
+  {
+    pendingMessage_.clear();
+    notifyError("invalid frame");
+    return false;
+  }
+  notifyMessage(data, size);
+  return true;
+}
+
+std::size_t Connection::getFrameSize(const char *header)
+{
+  frame::Header frameHeader;
+  std::memcpy(&frameHeader, header, sizeof(frameHeader));
+  return sizeof(frameHeader) + frameHeader.payloadSize;
+}
+
+void Connection::notifyMessage(char *data, size_t size)
+{
+  if (size == 0 || (size == 1 && data[0] == '\r'))
+  {
+    return;
+  }
+  if (!admitMessage())
+  {
+    return;
+  }
+  if (Capture::isActive())
+  {
+    if (captureId_ == 0)
+    {
+      captureId_ = Capture::createConnectionId();
+      captureSide_ = getCaptureSide();
+    }
+    Capture::record(captureId_, captureSide_, Capture::EVENT_MESSAGE, data, size);
+  }
+
+  // everything allocated from the thread's arena while handling the message is released at once
+  util::ArenaScope arenaScope;
+  util::AllocationAccounting::MessageScope accountingScope;
   ConnectionHandler::Ptr handler = handler_.lock();
   if (handler)
   {
@@ -20,11 +20,14 @@
 #define __SES_NET_CONNECTION_H__
 
 #include <cstdint>
+#include <functional>
 #include <memory>
 #include <string>
+#include <string_view>
 
 #include <boost/noncopyable.hpp>
 
+#include "net/capture.hpp"
 #include "net/connectiontype.hpp"
 
 namespace ses {
@@ -59,13 +62,20 @@ protected:
 
   Connection(const ConnectionHandler::Ptr& listener);
 
-  virtual ~Connection()
-  {};
+  virtual ~Connection();
 
+  // splits the received data into newline delimited messages or, if the peer's first byte was
+  // frame::MAGIC, into binary frames
   void notifyRead(char* data, size_t size);
 
   void notifyError(const std::string& error);
 
+  // checked for each message before it is handed to the handler, a message not admitted is dropped
+  virtual bool admitMessage() {return true;}
+
+  // the side captured messages of this connection are recorded for
+  virtual Capture::Side getCaptureSide() const {return Capture::SIDE_CLIENT;}
+
 public:
   void setHandler(const ConnectionHandler::Ptr& handler);
 
@@ -73,11 +83,48 @@ public:
 
   virtual std::string connectedIp() const = 0;
 
+  virtual int nativeHandle() const = 0;
+
+  // stops reading without closing the socket, e.g. before handing it over to another process
+  virtual void stopReading() = 0;
+
+  virtual void disconnect() = 0;
+
   virtual bool send(const char* data, std::size_t size) = 0;
-  bool send(const std::string& data) {return send(data.data(), data.size());}
+  bool send(std::string_view data) {return send(data.data(), data.size());}
+
+  // sends a message that is superseded by the next one sent this way, e.g. a job notification,
+  // so it may be dropped while the peer is not keeping up
+  virtual bool sendLatest(const char* data, std::size_t size) {return send(data, size);}
+  bool sendLatest(std::string_view data) {return sendLatest(data.data(), data.size());}
+
+  // calls flushedHandler on the connection's thread once what was sent before is written or writing
+  // failed, e.g. before the socket is handed over to another process
+  virtual void flush(const std::function<void()>& flushedHandler) {flushedHandler();}
 
 private:
+  enum Framing
+  {
+    FRAMING_UNKNOWN,
+    FRAMING_LINES,
+    FRAMING_BINARY
+  };
+
+  void notifyLines(char* data, size_t size);
+  void notifyFrames(char* data, size_t size);
+  bool notifyFrame(char* data, size_t size);
+  void notifyMessage(char* data, size_t size);
+  static std::size_t getFrameSize(const char* header);
+
+  static const std::size_t MAX_MESSAGE_SIZE = 64 * 1024;
+
   ConnectionHandler::WeakPtr handler_;
+  Framing framing_;
+  // the start of a message whose newline or remaining frame bytes have not been received yet
+  std::string pendingMessage_;
+  // zero until the first message is captured, the side is kept for the close event recorded on destruction
+  uint64_t captureId_;
+  Capture::Side captureSide_;
 };
 
 } //namespace net
@@ -12,7 +12,11 @@ enum ConnectionType
 {
   CONNECTION_TYPE_AUTO,
   CONNECTION_TYPE_TCP,
-  CONNECTION_TYPE_TLS
+  CONNECTION_TYPE_TLS,
+  // TLS with the records encrypted by the kernel after the handshake, where it supports that
+  CONNECTION_TYPE_TLS_KERNEL,
+  // a UNIX stream socket to a peer on the same host, the address is its path, see makeUnixEndpoint()
+  CONNECTION_TYPE_UNIX
 };
 
 } //namespace net
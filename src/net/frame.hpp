@@ -0,0 +1,32 @@
+#ifndef SES_NET_FRAME_HPP
+#define SES_NET_FRAME_HPP
+
+#include <cstddef>
+#include <cstdint>
+
+namespace ses {
+namespace net {
+namespace frame {
+
+/**
+ * Length prefixed binary frames as alternative to newline delimited JSON. A connection's framing is
+ * told by its first byte, MAGIC is no valid start of JSON text.
+ */
+const uint8_t MAGIC = 0xB5;
+const std::size_t PAYLOAD_SIZE_MAX = 0xFFFF;
+
+struct Header
+{
+  uint8_t magic;
+  uint8_t type;
+  // little endian size of the payload following the header
+  uint16_t payloadSize;
+};
+
+static_assert(sizeof(Header) == 4, "frame header must be 4 bytes");
+
+} // namespace frame
+} // namespace net
+} // namespace ses
+
+#endif //SES_NET_FRAME_HPP
@@ -0,0 +1,199 @@
+/* XMRig
+ * Copyright 2018      Sebastian Stolzenberg <https://github.com/sebastianstolzenberg>
+ *
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <cstring>
+#include <iostream>
+#include <thread>
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "net/handover.hpp"
+
+namespace ses {
+namespace net {
+namespace handover {
+
+namespace {
+const std::size_t STATE_SIZE_MAX = 4096;
+
+struct MessageHeader
+{
+  uint32_t type;
+  uint32_t stateSize;
+};
+
+bool makeAddress(const std::string& path, sockaddr_un& address)
+{
+  std::memset(&address, 0, sizeof(address));
+  address.sun_family = AF_UNIX;
+  if (path.size() >= sizeof(address.sun_path))
+  {
+    return false;
+  }
+  std::memcpy(address.sun_path, path.data(), path.size());
+  return true;
+}
+}
+
+Listener::Listener(const std::string& path, const SuccessorHandler& handler)
+  : path_(path)
+  , socket_(::socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0))
+{
+  sockaddr_un address;
+  if (socket_ < 0 || !makeAddress(path, address))
+  {
+    std::cout << "net::handover::Listener invalid path " << path << std::endl;
+    return;
+  }
+
+  // a predecessor's socket file is stale once its sockets are taken over
+  ::unlink(path.c_str());
+  if (::bind(socket_, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0 ||
+      ::listen(socket_, 1) != 0)
+  {
+    std::cout << "net::handover::Listener failed to listen on " << path << ": " << std::strerror(errno)
+              << std::endl;
+    return;
+  }
+
+  int listenSocket = socket_;
+  std::thread(
+    [listenSocket, handler]()
+    {
+      int channel = ::accept4(listenSocket, nullptr, nullptr, SOCK_CLOEXEC);
+      if (channel >= 0)
+      {
+        handler(channel);
+      }
+    }).detach();
+}
+
+Listener::~Listener()
+{
+  if (socket_ >= 0)
+  {
+    ::shutdown(socket_, SHUT_RDWR);
+    ::close(socket_);
+  }
+}
+
+Listener::Ptr listen(const std::string& path, const SuccessorHandler& handler)
+{
+  return std::make_shared<Listener>(path, handler);
+}
+
+int connect(const std::string& path)
+{
+  sockaddr_un address;
+  if (!makeAddress(path, address))
+  {
+    return -1;
+  }
+
+  int channel = ::socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+  if (channel >= 0 && ::connect(channel, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0)
+  {
+    ::close(channel);
+    channel = -1;
+  }
+  return channel;
+}
+
+bool send(int channel, SocketType type, int nativeHandle, const std::string& state)
+{
+  if (state.size() > STATE_SIZE_MAX)
+  {
+    std::cout << "net::handover::send, state too large, " << state.size() << ", limit, " << STATE_SIZE_MAX
+              << std::endl;
+    return false;
+  }
+
+  MessageHeader header = {static_cast<uint32_t>(type), static_cast<uint32_t>(state.size())};
+  iovec iov[2];
+  iov[0].iov_base = &header;
+  iov[0].iov_len = sizeof(header);
+  iov[1].iov_base = const_cast<char*>(state.data());
+  iov[1].iov_len = state.size();
+
+  char control[CMSG_SPACE(sizeof(int))];
+  std::memset(control, 0, sizeof(control));
+
+  msghdr message;
+  std::memset(&message, 0, sizeof(message));
+  message.msg_iov = iov;
+  message.msg_iovlen = 2;
+  message.msg_control = control;
+  message.msg_controllen = sizeof(control);
+
+  cmsghdr* controlMessage = CMSG_FIRSTHDR(&message);
+  controlMessage->cmsg_level = SOL_SOCKET;
+  controlMessage->cmsg_type = SCM_RIGHTS;
+  controlMessage->cmsg_len = CMSG_LEN(sizeof(int));
+  std::memcpy(CMSG_DATA(controlMessage), &nativeHandle, sizeof(int));
+
+  return ::sendmsg(channel, &message, MSG_NOSIGNAL) == static_cast<ssize_t>(sizeof(header) + state.size());
+}
+
+bool receive(int channel, SocketType& type, int& nativeHandle, std::string& state)
+{
+  MessageHeader header;
+  char stateBuffer[STATE_SIZE_MAX];
+  iovec iov[2];
+  iov[0].iov_base = &header;
+  iov[0].iov_len = sizeof(header);
+  iov[1].iov_base = stateBuffer;
+  iov[1].iov_len = sizeof(stateBuffer);
+
+  char control[CMSG_SPACE(sizeof(int))];
+  msghdr message;
+  std::memset(&message, 0, sizeof(message));
+  message.msg_iov = iov;
+  message.msg_iovlen = 2;
+  message.msg_control = control;
+  message.msg_controllen = sizeof(control);
+
+  ssize_t received = ::recvmsg(channel, &message, MSG_CMSG_CLOEXEC);
+  cmsghdr* controlMessage = received > 0 ? CMSG_FIRSTHDR(&message) : nullptr;
+  if (!controlMessage || controlMessage->cmsg_level != SOL_SOCKET || controlMessage->cmsg_type != SCM_RIGHTS)
+  {
+    return false;
+  }
+
+  std::memcpy(&nativeHandle, CMSG_DATA(controlMessage), sizeof(int));
+  if (received < static_cast<ssize_t>(sizeof(header)) || header.stateSize != received - sizeof(header))
+  {
+    // a socket arriving with a broken message would stay open in this process
+    ::close(nativeHandle);
+    return false;
+  }
+
+  type = static_cast<SocketType>(header.type);
+  state.assign(stateBuffer, header.stateSize);
+  return true;
+}
+
+void close(int channel)
+{
+  ::close(channel);
+}
+
+} //namespace handover
+} //namespace net
+} //namespace ses
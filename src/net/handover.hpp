@@ -0,0 +1,81 @@
+/* XMRig
+ * Copyright 2018      Sebastian Stolzenberg <https://github.com/sebastianstolzenberg>
+ *
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __SES_NET_HANDOVER_H__
+#define __SES_NET_HANDOVER_H__
+
+#include <functional>
+#include <memory>
+#include <string>
+
+#include <boost/noncopyable.hpp>
+
+namespace ses {
+namespace net {
+namespace handover {
+
+/**
+ * Passing of open sockets to a successor process for binary upgrades without disconnects.
+ *
+ * The running process listens on a unix socket. A freshly started process connects to it and
+ * receives every socket as SCM_RIGHTS message, together with opaque state describing the
+ * session on top of it. The channel is closed by the sender after the last socket.
+ */
+
+enum SocketType
+{
+  SOCKET_TYPE_LISTENER,
+  SOCKET_TYPE_CONNECTION
+};
+
+typedef std::function<void(int channel)> SuccessorHandler;
+
+class Listener : private boost::noncopyable
+{
+public:
+  typedef std::shared_ptr<Listener> Ptr;
+
+public:
+  Listener(const std::string& path, const SuccessorHandler& handler);
+  ~Listener();
+
+private:
+  std::string path_;
+  int socket_;
+};
+
+// waits in a background thread for a successor to connect on path
+Listener::Ptr listen(const std::string& path, const SuccessorHandler& handler);
+
+// connects to a predecessor listening on path, returns -1 if there is none
+int connect(const std::string& path);
+
+// false if the successor did not get the socket, e.g. for state above 4096 bytes
+bool send(int channel, SocketType type, int nativeHandle, const std::string& state);
+
+// returns false once the predecessor has sent all sockets
+bool receive(int channel, SocketType& type, int& nativeHandle, std::string& state);
+
+// closes a channel, or a received socket that is not taken over
+void close(int channel);
+
+} //namespace handover
+} //namespace net
+} //namespace ses
+
+#endif /* __SES_NET_HANDOVER_H__ */
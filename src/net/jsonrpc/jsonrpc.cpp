@@ -2,7 +2,9 @@
 #include <boost/property_tree/ptree.hpp>
 #include <boost/property_tree/json_parser.hpp>
 
+#include "util/allocationaccounting.hpp"
 #include "util/boostpropertytree.hpp"
+#include "util/sharetrace.hpp"
 #include "net/jsonrpc/jsonrpc.hpp"
 
 namespace ses {
@@ -11,87 +13,98 @@ namespace jsonrpc {
 
 namespace pt = boost::property_tree;
 
-std::string request(const std::string& id, const std::string& method, const std::string& params)
-{
-  pt::ptree requestTree;
-  requestTree.put("id", id);
-  requestTree.put("jsonrpc", "2.0");
-  requestTree.put("method", method);
-
-  if (!params.empty())
-  {
-    requestTree.put_child("params", util::boostpropertytree::stringToPtree(params));
-  }
-
-  return util::boostpropertytree::ptreeToString(requestTree, false);
+namespace {
+typedef writer::Object<writer::Field<"status", writer::String>> StatusResult;
+typedef writer::Object<writer::Field<"code", writer::Integer>, writer::Field<"message", writer::String>> Error;
+typedef writer::Line<writer::Object<writer::Field<"id", writer::Id>, schema::Version,
+                                    writer::Field<"method", writer::String>>> RequestWithoutParams;
+typedef writer::Line<writer::Object<schema::Version, writer::Field<"method", writer::String>>> NotificationWithoutParams;
 }
 
-std::string notification(const std::string& method, const std::string& params)
+util::ArenaString request(const std::string& id, const std::string& method, const std::string& params)
 {
-  pt::ptree notificationTree;
-  notificationTree.put("method", method);
-  notificationTree.put("jsonrpc", "2.0");
+  return params.empty() ? create<RequestWithoutParams>(id, method)
+                        : create<schema::Request<writer::Raw>>(id, method, params);
+}
 
-  if (!params.empty())
-  {
-    notificationTree.put_child("params", util::boostpropertytree::stringToPtree(params));
-  }
+util::ArenaString notification(const std::string& method, const std::string& params)
+{
+  return params.empty() ? create<NotificationWithoutParams>(method)
+                        : create<schema::Notification<writer::Raw>>(method, params);
+}
 
-  return util::boostpropertytree::ptreeToString(notificationTree, false);
+util::ArenaString response(const std::string& id, const std::string& result, const std::string& error)
+{
+  // JSON-RPC 2.0 has either of them
+  return error.empty() ? create<schema::Response<writer::Raw>>(id, result)
+                       : create<schema::ErrorResponse<writer::Raw>>(id, error);
 }
 
-std::string response(const std::string& id, const std::string& result, const std::string& error)
+util::ArenaString statusResponse(const std::string& id, const std::string& status)
 {
-  pt::ptree responseTree;
-  responseTree.put("id", id);
-  responseTree.put("jsonrpc", "2.0");
+  return create<schema::Response<StatusResult>>(id, status);
+}
 
-  if (!result.empty())
-  {
-    responseTree.put_child("result", util::boostpropertytree::stringToPtree(result));
-  }
+util::ArenaString errorResponse(const std::string& id, int code, const std::string& message)
+{
+  return create<schema::ErrorResponse<Error>>(id, code, message);
+}
 
-  if (!error.empty())
-  {
-    responseTree.put_child("error", util::boostpropertytree::stringToPtree(error));
-  }
+util::ArenaString requestV1(const std::string& id, const std::string& method, const std::string& params)
+{
+  return create<schema::RequestV1<writer::Raw>>(id, method, params.empty() ? std::string_view("[]") : params);
+}
 
-  return util::boostpropertytree::ptreeToString(responseTree, false);
+util::ArenaString notificationV1(const std::string& method, const std::string& params)
+{
+  return requestV1("null", method, params);
 }
 
-std::string statusResponse(const std::string& id, const std::string& status)
+util::ArenaString responseV1(const std::string& id, const std::string& result, const std::string& error)
 {
-  pt::ptree responseTree;
-  responseTree.put("id", id);
-  responseTree.put("jsonrpc", "2.0");
-  responseTree.put("result.status", status);
-  return util::boostpropertytree::ptreeToString(responseTree, false);
+  return create<schema::ResponseV1<writer::Raw, writer::Raw>>(id, result, error);
 }
 
-std::string errorResponse(const std::string& id, int code, const std::string& message)
+std::string quote(std::string_view string)
 {
-  pt::ptree responseTree;
-  responseTree.put("id", id);
-  responseTree.put("jsonrpc", "2.0");
-  responseTree.put("error.code", code);
-  responseTree.put("error.message", message);
-  return util::boostpropertytree::ptreeToString(responseTree, false);
+  std::string result;
+  result.reserve(string.size() + 2);
+  writer::String::write(result, string);
+  return result;
 }
 
-bool parse(const std::string& jsonrpc,
+bool parse(const char* data, std::size_t size,
            std::function<void (const std::string& id, const std::string& method, const std::string& params)> requestHandler,
            std::function<void (const std::string& id, const std::string& result, const std::string& error)> responseHandler,
            std::function<void (const std::string& method, const std::string& params)> notificatonHandler)
 {
-  pt::ptree jsonrpcTree = util::boostpropertytree::stringToPtree(jsonrpc);
+  std::string id;
+  std::string method;
+  std::string params;
+  std::string result;
+  std::string error;
+  {
+    // the handlers account for themselves
+    util::AllocationAccounting::Scope accountingScope(util::AllocationAccounting::SUBSYSTEM_JSONRPC);
+    pt::ptree jsonrpcTree = util::boostpropertytree::stringToPtree(data, size);
 
-  std::string id = jsonrpcTree.get<std::string>("id", "null");
-//  std::string jsonrpcVersion = jsonrpcTree.get<std::string>("jsonrpc", "");
-  std::string method = jsonrpcTree.get<std::string>("method", "");
+    id = jsonrpcTree.get<std::string>("id", "null");
+//    std::string jsonrpcVersion = jsonrpcTree.get<std::string>("jsonrpc", "");
+    method = jsonrpcTree.get<std::string>("method", "");
 
-  std::string params = util::boostpropertytree::ptreeToString(jsonrpcTree.get_child_optional("params"));
-  std::string result = util::boostpropertytree::ptreeToString(jsonrpcTree.get_child_optional("result"));
-  std::string error = util::boostpropertytree::ptreeToString(jsonrpcTree.get_child_optional("error"));
+    params = util::boostpropertytree::ptreeToString(jsonrpcTree.get_child_optional("params"));
+    result = util::boostpropertytree::ptreeToString(jsonrpcTree.get_child_optional("result"));
+    error = util::boostpropertytree::ptreeToString(jsonrpcTree.get_child_optional("error"));
+  }
+  if (result == "null")
+  {
+    result.clear();
+  }
+  if (error == "null")
+  {
+    error.clear();
+  }
+  util::ShareTrace::stamp(util::ShareTrace::STAGE_PARSE);
 
   bool success = false;
   if (id == "null")
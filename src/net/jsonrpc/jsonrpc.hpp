@@ -2,22 +2,78 @@
 #define SES_NET_JSONRPC_JSONRPC_HPP
 
 #include <string>
+#include <string_view>
 #include <functional>
 
+#include "net/jsonrpc/writer.hpp"
+#include "util/allocationaccounting.hpp"
+#include "util/arena.hpp"
+
 namespace ses {
 namespace net {
 namespace jsonrpc {
 
-std::string request(const std::string& id, const std::string& method, const std::string& parameters);
+// JSON-RPC 2.0 envelopes around the schemas of params, results and errors, see writer::Writer
+namespace schema {
+typedef writer::Field<"jsonrpc", writer::Constant<"\"2.0\"">> Version;
+
+template<typename PARAMS>
+using Request = writer::Line<writer::Object<writer::Field<"id", writer::Id>, Version,
+                                            writer::Field<"method", writer::String>,
+                                            writer::Field<"params", PARAMS>>>;
+template<typename PARAMS>
+using Notification = writer::Line<writer::Object<Version, writer::Field<"method", writer::String>,
+                                                 writer::Field<"params", PARAMS>>>;
+template<typename RESULT>
+using Response = writer::Line<writer::Object<writer::Field<"id", writer::Id>, Version,
+                                             writer::Field<"result", RESULT>>>;
+template<typename ERROR>
+using ErrorResponse = writer::Line<writer::Object<writer::Field<"id", writer::Id>, Version,
+                                                  writer::Field<"error", ERROR>>>;
+
+// JSON-RPC 1.0 of stratum v1, without version and with result and error always present
+template<typename PARAMS>
+using RequestV1 = writer::Line<writer::Object<writer::Field<"id", writer::Id>, writer::Field<"method", writer::String>,
+                                              writer::Field<"params", PARAMS>>>;
+template<typename RESULT, typename ERROR>
+using ResponseV1 = writer::Line<writer::Object<writer::Field<"id", writer::Id>, writer::Field<"result", RESULT>,
+                                               writer::Field<"error", ERROR>>>;
+} // namespace schema
+
+// writes a message of the schema into the arena of the calling thread
+template<typename SCHEMA, typename... VALUES>
+util::ArenaString create(const VALUES&... values)
+{
+  util::AllocationAccounting::Scope accountingScope(util::AllocationAccounting::SUBSYSTEM_JSONRPC);
+  util::ArenaString message = util::makeArenaString();
+  // the values rarely take more than that
+  message.reserve(writer::Writer<SCHEMA>::constantSize() + 256);
+  writer::Writer<SCHEMA>::write(message, values...);
+  return message;
+}
+
+// created messages live in the arena of the calling thread and are valid until its util::ArenaScope ends
+util::ArenaString request(const std::string& id, const std::string& method, const std::string& parameters);
+
+util::ArenaString notification(const std::string& method, const std::string& parameters);
+
+util::ArenaString response(const std::string& id, const std::string& result, const std::string& error);
+
+util::ArenaString statusResponse(const std::string& id, const std::string& status);
+util::ArenaString errorResponse(const std::string& id, int code, const std::string& message);
 
-std::string notification(const std::string& method, const std::string& parameters);
+// JSON-RPC 1.0 framing as spoken by stratum v1 miners, one message per line: params, result and error are
+// inserted verbatim and must be valid JSON, numeric ids stay numbers
+util::ArenaString requestV1(const std::string& id, const std::string& method, const std::string& params);
+util::ArenaString notificationV1(const std::string& method, const std::string& params);
+util::ArenaString responseV1(const std::string& id, const std::string& result, const std::string& error);
 
-std::string response(const std::string& id, const std::string& result, const std::string& error);
+// the string as JSON string literal including quotes
+std::string quote(std::string_view string);
 
-std::string statusResponse(const std::string& id, const std::string& status);
-std::string errorResponse(const std::string& id, int code, const std::string& message);
+// result, error and params which are no object or array are passed on as their bare value, null as empty
 
-bool parse(const std::string& jsonrpc,
+bool parse(const char* data, std::size_t size,
            std::function<void (const std::string& id, const std::string& method, const std::string& params)> requestHandler,
            std::function<void (const std::string& id, const std::string& result, const std::string& error)> responseHandler,
            std::function<void (const std::string& method, const std::string& params)> notificatonHandler);
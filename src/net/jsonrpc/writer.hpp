@@ -0,0 +1,352 @@
+#ifndef SES_NET_JSONRPC_WRITER_HPP
+#define SES_NET_JSONRPC_WRITER_HPP
+
+#include <algorithm>
+#include <array>
+#include <charconv>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+#include "util/hex.hpp"
+
+namespace ses {
+namespace net {
+namespace jsonrpc {
+namespace writer {
+
+/**
+ * JSON writer driven by schemas known at compile time.
+ *
+ * A schema is a type built from Object, Array, Field and Constant around the value kinds below,
+ * e.g. Object<Field<"id", Id>, Field<"result", Object<Field<"status", String>>>>. Names, brackets
+ * and constants are laid out once at compile time, writing a message appends the constant
+ * fragments and the values in between to the output, typed as their kind demands. Any string type
+ * with append() and push_back() serves as output, so messages go straight to their final buffer.
+ */
+
+// a string literal as template argument
+template<std::size_t SIZE>
+struct Literal
+{
+  constexpr Literal(const char (&text)[SIZE])
+  {
+    std::copy_n(text, SIZE, text_);
+  }
+
+  constexpr std::string_view view() const
+  {
+    return std::string_view(text_, SIZE - 1);
+  }
+
+  char text_[SIZE];
+};
+
+// the constant text of a schema and the offsets the values are inserted at
+struct Layout
+{
+  static const std::size_t TEXT_CAPACITY = 512;
+  static const std::size_t SLOT_CAPACITY = 32;
+
+  constexpr void append(std::string_view text)
+  {
+    for (char c : text)
+    {
+      text_[size_++] = c;
+    }
+  }
+
+  constexpr void slot()
+  {
+    slots_[slotCount_++] = size_;
+  }
+
+  char text_[TEXT_CAPACITY] = {};
+  std::size_t size_ = 0;
+  std::size_t slots_[SLOT_CAPACITY] = {};
+  std::size_t slotCount_ = 0;
+};
+
+// a kind taking one value when written
+template<typename KIND>
+struct Value
+{
+  typedef std::tuple<KIND> Slots;
+
+  static constexpr void describe(Layout& layout)
+  {
+    layout.slot();
+  }
+};
+
+// a JSON string, escaped
+struct String : Value<String>
+{
+  template<typename OUTPUT>
+  static void write(OUTPUT& output, std::string_view value)
+  {
+    static const char HEX[] = "0123456789abcdef";
+    output.push_back('"');
+    // runs without characters to escape are appended at once
+    std::size_t start = 0;
+    for (std::size_t i = 0; i < value.size(); ++i)
+    {
+      unsigned char c = static_cast<unsigned char>(value[i]);
+      if (c == '"' || c == '\\' || c < 0x20)
+      {
+        output.append(value.data() + start, i - start);
+        if (c < 0x20)
+        {
+          const char escaped[] = {'\\', 'u', '0', '0', HEX[c >> 4], HEX[c & 0xf]};
+          output.append(escaped, sizeof(escaped));
+        }
+        else
+        {
+          output.push_back('\\');
+          output.push_back(static_cast<char>(c));
+        }
+        start = i + 1;
+      }
+    }
+    output.append(value.data() + start, value.size() - start);
+    output.push_back('"');
+  }
+};
+
+// a JSON-RPC id as received, numeric ids stay numbers, an empty one is null
+struct Id : Value<Id>
+{
+  template<typename OUTPUT>
+  static void write(OUTPUT& output, std::string_view value)
+  {
+    if (value.empty() || value == "null")
+    {
+      output.append("null", 4);
+    }
+    else if (std::all_of(value.begin(), value.end(), [](char c) { return c >= '0' && c <= '9'; }))
+    {
+      output.append(value.data(), value.size());
+    }
+    else
+    {
+      String::write(output, value);
+    }
+  }
+};
+
+struct Integer : Value<Integer>
+{
+  template<typename OUTPUT>
+  static void write(OUTPUT& output, int64_t value)
+  {
+    char text[24];
+    output.append(text, std::to_chars(text, text + sizeof(text), value).ptr - text);
+  }
+};
+
+// the shortest text reading back as the same double
+struct Number : Value<Number>
+{
+  template<typename OUTPUT>
+  static void write(OUTPUT& output, double value)
+  {
+    char text[32];
+    output.append(text, std::to_chars(text, text + sizeof(text), value).ptr - text);
+  }
+};
+
+struct Boolean : Value<Boolean>
+{
+  template<typename OUTPUT>
+  static void write(OUTPUT& output, bool value)
+  {
+    value ? output.append("true", 4) : output.append("false", 5);
+  }
+};
+
+// bytes as JSON string of lower case hex digits
+struct Hex : Value<Hex>
+{
+  template<typename OUTPUT>
+  static void write(OUTPUT& output, std::span<const uint8_t> value)
+  {
+    output.push_back('"');
+    std::size_t offset = output.size();
+    output.resize(offset + 2 * value.size());
+    util::hex::encode(value.data(), value.size(), &output[offset]);
+    output.push_back('"');
+  }
+};
+
+// strings as JSON array
+struct Strings : Value<Strings>
+{
+  template<typename OUTPUT>
+  static void write(OUTPUT& output, const std::vector<std::string>& values)
+  {
+    output.push_back('[');
+    for (std::size_t i = 0; i < values.size(); ++i)
+    {
+      if (i > 0)
+      {
+        output.push_back(',');
+      }
+      String::write(output, values[i]);
+    }
+    output.push_back(']');
+  }
+};
+
+// JSON text inserted verbatim, e.g. params serialized before, an empty one is null
+struct Raw : Value<Raw>
+{
+  template<typename OUTPUT>
+  static void write(OUTPUT& output, std::string_view value)
+  {
+    value.empty() ? output.append("null", 4) : output.append(value.data(), value.size());
+  }
+};
+
+// JSON text known at compile time, takes no value
+template<Literal TEXT>
+struct Constant
+{
+  typedef std::tuple<> Slots;
+
+  static constexpr void describe(Layout& layout)
+  {
+    layout.append(TEXT.view());
+  }
+};
+
+template<Literal NAME, typename KIND>
+struct Field
+{
+  typedef typename KIND::Slots Slots;
+
+  static constexpr void describe(Layout& layout)
+  {
+    layout.append("\"");
+    layout.append(NAME.view());
+    layout.append("\":");
+    KIND::describe(layout);
+  }
+};
+
+template<typename... FIELDS>
+struct Object
+{
+  typedef decltype(std::tuple_cat(std::declval<typename FIELDS::Slots>()...)) Slots;
+
+  static constexpr void describe(Layout& layout)
+  {
+    layout.append("{");
+    bool first = true;
+    ((layout.append(first ? "" : ","), first = false, FIELDS::describe(layout)), ...);
+    layout.append("}");
+  }
+};
+
+template<typename... ELEMENTS>
+struct Array
+{
+  typedef decltype(std::tuple_cat(std::declval<typename ELEMENTS::Slots>()...)) Slots;
+
+  static constexpr void describe(Layout& layout)
+  {
+    layout.append("[");
+    bool first = true;
+    ((layout.append(first ? "" : ","), first = false, ELEMENTS::describe(layout)), ...);
+    layout.append("]");
+  }
+};
+
+// the schema followed by the newline ending a message on the wire
+template<typename SCHEMA>
+struct Line
+{
+  typedef typename SCHEMA::Slots Slots;
+
+  static constexpr void describe(Layout& layout)
+  {
+    SCHEMA::describe(layout);
+    layout.append("\n");
+  }
+};
+
+template<typename SCHEMA>
+class Writer
+{
+public:
+  typedef typename SCHEMA::Slots Slots;
+
+  // one value per slot of the schema, in order
+  template<typename OUTPUT, typename... VALUES>
+  static void write(OUTPUT& output, const VALUES&... values)
+  {
+    static_assert(sizeof...(VALUES) == std::tuple_size<Slots>::value, "one value per value kind of the schema");
+    writeSlots(output, std::index_sequence_for<VALUES...>(), values...);
+  }
+
+  // size of the constant text, a lower bound for the message
+  static constexpr std::size_t constantSize()
+  {
+    return LAYOUT.size_;
+  }
+
+private:
+  static constexpr Layout layout()
+  {
+    Layout layout;
+    SCHEMA::describe(layout);
+    return layout;
+  }
+
+  static constexpr Layout LAYOUT = layout();
+  // only the constant text is kept in the binary, not the whole layout
+  static constexpr std::array<char, LAYOUT.size_> TEXT =
+    []()
+    {
+      std::array<char, LAYOUT.size_> text{};
+      std::copy_n(LAYOUT.text_, LAYOUT.size_, text.begin());
+      return text;
+    }();
+
+  // the constant text before slot INDEX, or after the last one
+  template<std::size_t INDEX>
+  static constexpr std::string_view fragment()
+  {
+    constexpr std::size_t begin = INDEX == 0 ? 0 : LAYOUT.slots_[INDEX - 1];
+    constexpr std::size_t end = INDEX < LAYOUT.slotCount_ ? LAYOUT.slots_[INDEX] : LAYOUT.size_;
+    return std::string_view(TEXT.data() + begin, end - begin);
+  }
+
+  template<typename OUTPUT, std::size_t... INDEX, typename... VALUES>
+  static void writeSlots(OUTPUT& output, std::index_sequence<INDEX...>, const VALUES&... values)
+  {
+    ((appendFragment<INDEX>(output), std::tuple_element_t<INDEX, Slots>::write(output, values)), ...);
+    appendFragment<sizeof...(INDEX)>(output);
+  }
+
+  template<std::size_t INDEX, typename OUTPUT>
+  static void appendFragment(OUTPUT& output)
+  {
+    constexpr std::string_view text = fragment<INDEX>();
+    if constexpr (!text.empty())
+    {
+      output.append(text.data(), text.size());
+    }
+  }
+};
+
+} // namespace writer
+} // namespace jsonrpc
+} // namespace net
+} // namespace ses
+
+#endif //SES_NET_JSONRPC_WRITER_HPP
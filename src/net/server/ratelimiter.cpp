@@ -0,0 +1,228 @@
+#include <algorithm>
+#include <cstring>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+
+#include "net/server/ratelimiter.hpp"
+
+namespace ses {
+namespace net {
+namespace server {
+
+RateLimiter::RateLimiter(const RateLimits& rateLimits)
+  : rateLimits_(rateLimits)
+  , start_(std::chrono::steady_clock::now())
+  , entries_(CAPACITY)
+  , size_(0)
+  , counters_{0, 0, 0}
+{
+}
+
+void RateLimiter::setRateLimits(const RateLimits& rateLimits)
+{
+  rateLimits_ = rateLimits;
+}
+
+RateLimiter::Address RateLimiter::toAddress(const sockaddr* address)
+{
+  Address result = {};
+  if (address->sa_family == AF_INET6)
+  {
+    std::memcpy(result.data(), &reinterpret_cast<const sockaddr_in6*>(address)->sin6_addr, result.size());
+  }
+  else if (address->sa_family == AF_INET)
+  {
+    result[10] = 0xff;
+    result[11] = 0xff;
+    std::memcpy(result.data() + 12, &reinterpret_cast<const sockaddr_in*>(address)->sin_addr, 4);
+  }
+  return result;
+}
+
+RateLimiter::Address RateLimiter::peerAddress(int fd)
+{
+  sockaddr_storage address;
+  socklen_t addressLength = sizeof(address);
+  std::memset(&address, 0, sizeof(address));
+  ::getpeername(fd, reinterpret_cast<sockaddr*>(&address), &addressLength);
+  return toAddress(reinterpret_cast<const sockaddr*>(&address));
+}
+
+std::string RateLimiter::toString(const Address& address)
+{
+  static const uint8_t V4_MAPPED[12] = {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0xff, 0xff};
+  char text[INET6_ADDRSTRLEN] = "";
+  if (std::memcmp(address.data(), V4_MAPPED, sizeof(V4_MAPPED)) == 0)
+  {
+    ::inet_ntop(AF_INET, address.data() + 12, text, sizeof(text));
+  }
+  else
+  {
+    ::inet_ntop(AF_INET6, address.data(), text, sizeof(text));
+  }
+  return text;
+}
+
+bool RateLimiter::admitConnection(const Address& address)
+{
+  Entry* entry = find(address, true);
+  if (entry)
+  {
+    refill(*entry, now());
+    if (entry->connections_ < rateLimits_.maxConnections_ && entry->connectTokens_ >= 1)
+    {
+      entry->connectTokens_ -= 1;
+      ++entry->connections_;
+      return true;
+    }
+  }
+  ++counters_.rejectedConnections_;
+  return false;
+}
+
+void RateLimiter::releaseConnection(const Address& address)
+{
+  Entry* entry = find(address, false);
+  if (entry && entry->connections_ > 0)
+  {
+    --entry->connections_;
+  }
+}
+
+RateLimiter::Verdict RateLimiter::admitMessage(const Address& address)
+{
+  Entry* entry = find(address, false);
+  if (!entry)
+  {
+    return VERDICT_ADMIT;
+  }
+
+  refill(*entry, now());
+  if (entry->messageTokens_ >= 1)
+  {
+    entry->messageTokens_ -= 1;
+    return VERDICT_ADMIT;
+  }
+
+  // the debt is capped, so an IP is back to normal at most a burst's refill time after it stopped
+  ++counters_.throttledMessages_;
+  entry->messageTokens_ = std::max(entry->messageTokens_ - 1, -rateLimits_.messageBurst_);
+  if (entry->messageTokens_ <= -rateLimits_.messageBurst_)
+  {
+    ++counters_.droppedConnections_;
+    return VERDICT_DISCONNECT;
+  }
+  return VERDICT_THROTTLE;
+}
+
+const RateLimitCounters& RateLimiter::getCounters() const
+{
+  return counters_;
+}
+
+RateLimiter::Entry* RateLimiter::find(const Address& address, bool create)
+{
+  for (std::size_t index = hash(address) & (CAPACITY - 1);; index = (index + 1) & (CAPACITY - 1))
+  {
+    Entry& entry = entries_[index];
+    if (entry.used_ && entry.address_ == address)
+    {
+      return &entry;
+    }
+    if (!entry.used_)
+    {
+      if (!create)
+      {
+        return nullptr;
+      }
+      // keeps probe sequences short, new IPs are refused if active ones fill the table
+      if (size_ >= CAPACITY * 3 / 4)
+      {
+        sweep(now());
+        return size_ >= CAPACITY * 3 / 4 ? nullptr : find(address, true);
+      }
+
+      entry.address_ = address;
+      entry.refilled_ = now();
+      entry.connections_ = 0;
+      entry.used_ = true;
+      entry.connectTokens_ = rateLimits_.connectBurst_;
+      entry.messageTokens_ = rateLimits_.messageBurst_;
+      ++size_;
+      return &entry;
+    }
+  }
+}
+
+void RateLimiter::refill(Entry& entry, uint32_t now) const
+{
+  float seconds = static_cast<float>(now - entry.refilled_) / 1000;
+  entry.refilled_ = now;
+  entry.connectTokens_ = std::min(entry.connectTokens_ + seconds * rateLimits_.connectRate_,
+                                  rateLimits_.connectBurst_);
+  entry.messageTokens_ = std::min(entry.messageTokens_ + seconds * rateLimits_.messageRate_,
+                                  rateLimits_.messageBurst_);
+}
+
+bool RateLimiter::isIdle(const Entry& entry, uint32_t now) const
+{
+  Entry refilled = entry;
+  refill(refilled, now);
+  return refilled.connections_ == 0 && refilled.connectTokens_ >= rateLimits_.connectBurst_ &&
+         refilled.messageTokens_ >= rateLimits_.messageBurst_;
+}
+
+void RateLimiter::sweep(uint32_t now)
+{
+  for (std::size_t index = 0; index < CAPACITY;)
+  {
+    if (entries_[index].used_ && isIdle(entries_[index], now))
+    {
+      // erasing may move a later entry here, so the index is checked again
+      erase(index);
+    }
+    else
+    {
+      ++index;
+    }
+  }
+}
+
+void RateLimiter::erase(std::size_t index)
+{
+  // backward shift deletion, entries behind the gap move up unless that would put them before their home
+  std::size_t gap = index;
+  for (std::size_t next = (gap + 1) & (CAPACITY - 1); entries_[next].used_; next = (next + 1) & (CAPACITY - 1))
+  {
+    std::size_t home = hash(entries_[next].address_) & (CAPACITY - 1);
+    if (((next - home) & (CAPACITY - 1)) >= ((next - gap) & (CAPACITY - 1)))
+    {
+      entries_[gap] = entries_[next];
+      gap = next;
+    }
+  }
+  entries_[gap].used_ = false;
+  --size_;
+}
+
+uint32_t RateLimiter::now() const
+{
+  return static_cast<uint32_t>(
+    std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start_).count());
+}
+
+std::size_t RateLimiter::hash(const Address& address)
+{
+  // FNV-1a
+  uint64_t hash = 14695981039346656037ULL;
+  for (uint8_t byte : address)
+  {
+    hash = (hash ^ byte) * 1099511628211ULL;
+  }
+  return static_cast<std::size_t>(hash ^ (hash >> 32));
+}
+
+} //namespace server
+} //namespace net
+} //namespace ses
@@ -0,0 +1,90 @@
+#ifndef SES_NET_SERVER_RATELIMITER_HPP
+#define SES_NET_SERVER_RATELIMITER_HPP
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <sys/socket.h>
+
+#include "net/server/server.hpp"
+
+namespace ses {
+namespace net {
+namespace server {
+
+/**
+ * Enforces RateLimits in an open addressing table keyed by source IP. Buckets are refilled lazily
+ * when an IP is looked up, entries of IPs without connections are dropped once their buckets would
+ * be full again. If the table is full of active IPs, new IPs are refused. Only to be used from the
+ * server's event loop.
+ */
+class RateLimiter
+{
+public:
+  typedef std::shared_ptr<RateLimiter> Ptr;
+  // IPv6 address, IPv4 addresses are mapped
+  typedef std::array<uint8_t, 16> Address;
+
+  enum Verdict
+  {
+    VERDICT_ADMIT,
+    VERDICT_THROTTLE,
+    VERDICT_DISCONNECT
+  };
+
+  static const std::size_t CAPACITY = 1 << 16;
+
+public:
+  explicit RateLimiter(const RateLimits& rateLimits = DEFAULT_RATE_LIMITS);
+
+  void setRateLimits(const RateLimits& rateLimits);
+
+  static Address toAddress(const sockaddr* address);
+  static Address peerAddress(int fd);
+  static std::string toString(const Address& address);
+
+  // on success the connection counts until releaseConnection()
+  bool admitConnection(const Address& address);
+  void releaseConnection(const Address& address);
+
+  Verdict admitMessage(const Address& address);
+
+  const RateLimitCounters& getCounters() const;
+
+private:
+  struct Entry
+  {
+    Address address_;
+    // milliseconds since the limiter was created, wraps after 49 days
+    uint32_t refilled_;
+    uint16_t connections_;
+    bool used_;
+    float connectTokens_;
+    float messageTokens_;
+  };
+
+  Entry* find(const Address& address, bool create);
+  void refill(Entry& entry, uint32_t now) const;
+  bool isIdle(const Entry& entry, uint32_t now) const;
+  void sweep(uint32_t now);
+  void erase(std::size_t index);
+  uint32_t now() const;
+  static std::size_t hash(const Address& address);
+
+private:
+  RateLimits rateLimits_;
+  std::chrono::steady_clock::time_point start_;
+  std::vector<Entry> entries_;
+  std::size_t size_;
+  RateLimitCounters counters_;
+};
+
+} //namespace server
+} //namespace net
+} //namespace ses
+
+#endif //SES_NET_SERVER_RATELIMITER_HPP
@@ -0,0 +1,136 @@
+#include "net/server/sendqueue.hpp"
+#include "util/allocationaccounting.hpp"
+
+namespace ses {
+namespace net {
+namespace server {
+
+SendQueue::SendQueue(const SendLimits& sendLimits)
+  : sendLimits_(sendLimits)
+  , queuedBytes_(0)
+  , writing_(false)
+  , overHighWatermark_(false)
+  , evicted_(false)
+{
+}
+
+SendQueue::EnqueueResult SendQueue::enqueue(const char* data, std::size_t size, bool latest)
+{
+  util::AllocationAccounting::Scope accountingScope(util::AllocationAccounting::SUBSYSTEM_NET);
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (evicted_)
+  {
+    return ENQUEUE_RESULT_REJECTED;
+  }
+
+  std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+  if (overHighWatermark_)
+  {
+    if (now - overHighWatermarkSince_ > sendLimits_.evictionTimeout_)
+    {
+      evict();
+      return ENQUEUE_RESULT_EVICT;
+    }
+    if (latest)
+    {
+      dropSuperseded();
+    }
+  }
+  // above the high watermark at most one superseded message is left, the rest is kept regardless
+  if (queuedBytes_ + size > sendLimits_.maximum_)
+  {
+    evict();
+    return ENQUEUE_RESULT_EVICT;
+  }
+
+  queue_.push_back(OutgoingMessage{std::string(data, size), latest});
+  util::AllocationAccounting::recordCopy(size);
+  queuedBytes_ += size;
+  if (!overHighWatermark_ && queuedBytes_ > sendLimits_.highWatermark_)
+  {
+    overHighWatermark_ = true;
+    overHighWatermarkSince_ = now;
+  }
+
+  if (!writing_)
+  {
+    writing_ = true;
+    return ENQUEUE_RESULT_START_WRITING;
+  }
+  return ENQUEUE_RESULT_QUEUED;
+}
+
+bool SendQueue::takePending(std::string& buffer)
+{
+  util::AllocationAccounting::Scope accountingScope(util::AllocationAccounting::SUBSYSTEM_NET);
+  std::lock_guard<std::mutex> lock(mutex_);
+  buffer.clear();
+  for (const auto& message : queue_)
+  {
+    buffer += message.data_;
+    util::AllocationAccounting::recordCopy(message.data_.size());
+  }
+  queue_.clear();
+
+  writing_ = !buffer.empty() && !evicted_;
+  return writing_;
+}
+
+bool SendQueue::completeWrite(std::size_t bytesWritten)
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+  queuedBytes_ = bytesWritten < queuedBytes_ ? queuedBytes_ - bytesWritten : 0;
+  if (overHighWatermark_ && queuedBytes_ <= sendLimits_.lowWatermark_)
+  {
+    overHighWatermark_ = false;
+  }
+  // a peer reading too slowly is caught even while nothing new is sent to it
+  if (overHighWatermark_ && !evicted_ &&
+      std::chrono::steady_clock::now() - overHighWatermarkSince_ > sendLimits_.evictionTimeout_)
+  {
+    evict();
+    return true;
+  }
+  return false;
+}
+
+void SendQueue::failWrite()
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+  writing_ = false;
+}
+
+bool SendQueue::idle()
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+  return !writing_ && queue_.empty();
+}
+
+void SendQueue::evict()
+{
+  evicted_ = true;
+  queue_.clear();
+  queuedBytes_ = 0;
+}
+
+// keeps only the newest of the queued messages superseding each other, those taken for writing are gone already
+void SendQueue::dropSuperseded()
+{
+  auto message = queue_.begin();
+  while (message != queue_.end())
+  {
+    if (message->latest_)
+    {
+      queuedBytes_ -= message->data_.size();
+      message = queue_.erase(message);
+    }
+    else
+    {
+      ++message;
+    }
+  }
+}
+
+} //namespace server
+} //namespace net
+} //namespace ses
@@ -0,0 +1,76 @@
+#ifndef SES_NET_SERVER_SENDQUEUE_HPP
+#define SES_NET_SERVER_SENDQUEUE_HPP
+
+#include <chrono>
+#include <list>
+#include <mutex>
+#include <string>
+
+#include "net/server/server.hpp"
+
+namespace ses {
+namespace net {
+namespace server {
+
+/**
+ * Outgoing data of one server connection, bounded by SendLimits. Messages may be enqueued from any
+ * thread, writing is done by the connection's event loop which takes all pending messages at once.
+ */
+class SendQueue
+{
+public:
+  enum EnqueueResult
+  {
+    ENQUEUE_RESULT_QUEUED,
+    // nothing was being written, the caller has to trigger writing on the event loop
+    ENQUEUE_RESULT_START_WRITING,
+    // the peer stayed above the high watermark for too long and has to be disconnected
+    ENQUEUE_RESULT_EVICT,
+    ENQUEUE_RESULT_REJECTED
+  };
+
+public:
+  explicit SendQueue(const SendLimits& sendLimits);
+
+  EnqueueResult enqueue(const char* data, std::size_t size, bool latest);
+
+  // moves all pending messages into buffer, returns false and stops writing if there are none
+  bool takePending(std::string& buffer);
+
+  // true if the peer stayed above the high watermark for too long and has to be disconnected
+  bool completeWrite(std::size_t bytesWritten);
+
+  // stops writing after a failed write
+  void failWrite();
+
+  // nothing is queued or being written
+  bool idle();
+
+private:
+  struct OutgoingMessage
+  {
+    std::string data_;
+    bool latest_;
+  };
+
+  void dropSuperseded();
+  // discards everything, nothing is written anymore
+  void evict();
+
+private:
+  const SendLimits sendLimits_;
+  std::mutex mutex_;
+  std::list<OutgoingMessage> queue_;
+  // queued and not yet written bytes, including those already taken for writing
+  std::size_t queuedBytes_;
+  bool writing_;
+  bool overHighWatermark_;
+  std::chrono::steady_clock::time_point overHighWatermarkSince_;
+  bool evicted_;
+};
+
+} //namespace server
+} //namespace net
+} //namespace ses
+
+#endif //SES_NET_SERVER_SENDQUEUE_HPP
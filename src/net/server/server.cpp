@@ -2,23 +2,67 @@
 // Created by ses on 16.02.18.
 //
 
+#include <chrono>
 #include <iostream>
 #include <thread>
+#include <type_traits>
+#include <utility>
+#include <sys/stat.h>
 #include <boost/asio.hpp>
 
 #include "net/server/server.hpp"
+#include "net/unixendpoint.hpp"
+#include "net/server/ratelimiter.hpp"
+#include "net/server/sendqueue.hpp"
+#include "util/objectpool.hpp"
+#include "util/sharetrace.hpp"
+#ifdef SES_PROXY_IO_URING
+#include "net/server/uringserver.hpp"
+#endif
 
 namespace ses {
 namespace net {
 namespace server {
 
-class BoostConnection : public Connection
+// SOCKET is a TCP or a UNIX stream socket
+template<typename SOCKET>
+class BoostConnection : public Connection,
+                        public std::enable_shared_from_this<BoostConnection<SOCKET>>
 {
 public:
-  explicit BoostConnection(boost::asio::ip::tcp::socket socket)
+  typedef std::shared_ptr<BoostConnection> Ptr;
+
+public:
+  BoostConnection(SOCKET socket, const SendLimits& sendLimits,
+                  const RateLimiter::Ptr& rateLimiter, const RateLimiter::Address& address)
     : socket_(std::move(socket))
+    , sendQueue_(sendLimits)
+    , rateLimiter_(rateLimiter)
+    , address_(address)
+  {
+    // reads only follow readiness, a spurious one must not block the event loop
+    boost::system::error_code error;
+    socket_.non_blocking(true, error);
+  }
+
+  ~BoostConnection()
   {
-    triggerRead();
+    if (rateLimiter_)
+    {
+      RateLimiter::Ptr rateLimiter = rateLimiter_;
+      RateLimiter::Address address = address_;
+      boost::asio::post(socket_.get_executor(), [rateLimiter, address]() { rateLimiter->releaseConnection(address); });
+    }
+  }
+
+  // a connection admitted by the rate limiter, which is released again with the connection
+  static Ptr create(SOCKET socket, const SendLimits& sendLimits,
+                    const RateLimiter::Ptr& rateLimiter = RateLimiter::Ptr(),
+                    const RateLimiter::Address& address = RateLimiter::Address())
+  {
+    Ptr connection = std::make_shared<BoostConnection>(std::move(socket), sendLimits, rateLimiter, address);
+    connection->triggerRead();
+    return connection;
   }
 
 public:
@@ -29,68 +73,320 @@ public:
 
   virtual std::string connectedIp() const
   {
-    return connected() ?
-           socket_.lowest_layer().remote_endpoint().address().to_string() :
-           "";
+    if constexpr (std::is_same_v<SOCKET, boost::asio::local::stream_protocol::socket>)
+    {
+      // peers of UNIX sockets are on this host and mostly unnamed
+      return connected() ? "localhost" : "";
+    }
+    else
+    {
+      return connected() ?
+             socket_.lowest_layer().remote_endpoint().address().to_string() :
+             "";
+    }
+  }
+
+  virtual int nativeHandle() const
+  {
+    return const_cast<SOCKET&>(socket_).native_handle();
+  }
+
+  virtual void stopReading()
+  {
+    // cancelling would abort pending writes too, those are flushed before the socket is handed over
+    Ptr self = this->shared_from_this();
+    boost::asio::dispatch(socket_.get_executor(), [self]() { self->readingStopped_ = true; });
+  }
+
+  virtual void flush(const std::function<void()>& flushedHandler)
+  {
+    Ptr self = this->shared_from_this();
+    boost::asio::dispatch(socket_.get_executor(),
+                          [self, flushedHandler]()
+                          {
+                            if (self->sendQueue_.idle())
+                            {
+                              flushedHandler();
+                            }
+                            else
+                            {
+                              self->flushedHandler_ = flushedHandler;
+                            }
+                          });
+  }
+
+  virtual void disconnect()
+  {
+    // pending operations keep the connection alive until they are aborted
+    Ptr self = this->shared_from_this();
+    boost::asio::post(socket_.get_executor(),
+                      [self]()
+                      {
+                        boost::system::error_code error;
+                        self->socket_.close(error);
+                      });
   }
 
   virtual bool send(const char* data, std::size_t size)
+  {
+    return enqueue(data, size, false);
+  }
+
+  virtual bool sendLatest(const char* data, std::size_t size)
+  {
+    return enqueue(data, size, true);
+  }
+
+protected:
+  bool admitMessage() override
+  {
+    if (!rateLimiter_)
+    {
+      return true;
+    }
+    if (dropped_)
+    {
+      return false;
+    }
+
+    switch (rateLimiter_->admitMessage(address_))
+    {
+      case RateLimiter::VERDICT_ADMIT:
+        return true;
+
+      case RateLimiter::VERDICT_DISCONNECT:
+      {
+        dropped_ = true;
+        Ptr self = this->shared_from_this();
+        boost::asio::post(socket_.get_executor(),
+                          [self]()
+                          {
+                            std::cout << "net::server::BoostConnection dropping flooding peer "
+                                      << RateLimiter::toString(self->address_) << std::endl;
+                            boost::system::error_code error;
+                            self->socket_.close(error);
+                            self->notifyError("message rate limit exceeded");
+                          });
+        return false;
+      }
+
+      default:
+        return false;
+    }
+  }
+
+private:
+  bool enqueue(const char* data, std::size_t size, bool latest)
   {
     std::cout << "net::server::BoostConnection::send:" << std::endl << "  ";
     std::cout.write(data, size);
     std::cout << "\n";
 
-    socket_.send(boost::asio::buffer(data, size));
+    Ptr self = this->shared_from_this();
+    switch (sendQueue_.enqueue(data, size, latest))
+    {
+      case SendQueue::ENQUEUE_RESULT_START_WRITING:
+        boost::asio::post(socket_.get_executor(), [self]() { self->writeNext(); });
+        return true;
+
+      case SendQueue::ENQUEUE_RESULT_QUEUED:
+        return true;
+
+      case SendQueue::ENQUEUE_RESULT_EVICT:
+        boost::asio::post(socket_.get_executor(), [self]() { self->evict(); });
+        return false;
+
+      default:
+        return false;
+    }
   }
 
-private:
+  // runs on the socket's thread
+  void writeNext()
+  {
+    if (!sendQueue_.takePending(writeBuffer_))
+    {
+      // an idle connection keeps no capacity of what it wrote
+      std::string().swap(writeBuffer_);
+      notifyFlushed();
+      return;
+    }
+
+    Ptr self = this->shared_from_this();
+    boost::asio::async_write(socket_,
+                             boost::asio::buffer(writeBuffer_),
+                             [self](boost::system::error_code error, size_t bytes_transferred)
+                             {
+                               self->handleWrite(error, bytes_transferred);
+                             });
+  }
+
+  void handleWrite(const boost::system::error_code& error, size_t bytes_transferred)
+  {
+    if (sendQueue_.completeWrite(bytes_transferred))
+    {
+      evict();
+    }
+    else if (!error)
+    {
+      writeNext();
+    }
+    else
+    {
+      sendQueue_.failWrite();
+      notifyFlushed();
+      if (error != boost::asio::error::operation_aborted)
+      {
+        std::cout << "net::server::BoostConnection Write failed: " << error.message() << "\n";
+        notifyError(error.message());
+      }
+    }
+  }
+
+  // closes the connection of a peer that does not keep up with reading
+  void evict()
+  {
+    std::cout << "net::server::BoostConnection evicting slow peer" << std::endl;
+    boost::system::error_code error;
+    socket_.close(error);
+    notifyFlushed();
+    notifyError("send queue limit exceeded");
+  }
+
+  void notifyFlushed()
+  {
+    if (flushedHandler_)
+    {
+      std::function<void()> flushedHandler;
+      flushedHandler.swap(flushedHandler_);
+      flushedHandler();
+    }
+  }
+
+  // waits for data without a buffer, one is borrowed from the thread's pool only for reading it
   void triggerRead()
   {
-    boost::asio::async_read(socket_,
-                            boost::asio::buffer(receiveBuffer_, sizeof(receiveBuffer_)),
-                            boost::asio::transfer_at_least(1),
-                            [this](boost::system::error_code error, size_t bytes_transferred)
-                            {
-                              std::cout << "net::server::BoostConnection::handleRead:" << std::endl << "  ";
-                              std::cout.write(receiveBuffer_, bytes_transferred);
-                              std::cout << "\n";
-
-                              if (!error)
-                              {
-                                std::cout << "net::server::BoostConnection received :";
-                                std::cout.write(receiveBuffer_, bytes_transferred);
-                                std::cout << "\n";
-                                notifyRead(receiveBuffer_, bytes_transferred);
-                                triggerRead();
-                              }
-                              else
-                              {
-                                std::cout << "net::server::BoostConnection Read failed: " << error.message() << "\n";
-                                notifyError(error.message());
-                              }
-                            });
+    Ptr self = this->shared_from_this();
+    socket_.async_wait(boost::asio::socket_base::wait_read,
+                       [this, self](boost::system::error_code error)
+                       {
+                         if (readingStopped_)
+                         {
+                           // the data is left to the process the socket is handed over to
+                           return;
+                         }
+                         if (!error)
+                         {
+                           error = read();
+                         }
+
+                         if (!error)
+                         {
+                           triggerRead();
+                         }
+                         else if (error != boost::asio::error::operation_aborted)
+                         {
+                           std::cout << "net::server::BoostConnection Read failed: " << error.message() << "\n";
+                           notifyError(error.message());
+                         }
+                       });
+  }
+
+  boost::system::error_code read()
+  {
+    std::unique_ptr<char, void(*)(void*)> receiveBuffer(static_cast<char*>(ReceiveBufferPool::allocate()),
+                                                        &ReceiveBufferPool::deallocate);
+    boost::system::error_code error;
+    std::size_t bytes_transferred = socket_.read_some(boost::asio::buffer(receiveBuffer.get(), RECEIVE_BUFFER_SIZE),
+                                                      error);
+    if (error == boost::asio::error::would_block)
+    {
+      return boost::system::error_code();
+    }
+
+    util::ShareTrace::begin();
+    std::cout << "net::server::BoostConnection::handleRead:" << std::endl << "  ";
+    std::cout.write(receiveBuffer.get(), bytes_transferred);
+    std::cout << "\n";
+
+    if (!error)
+    {
+      std::cout << "net::server::BoostConnection received :";
+      std::cout.write(receiveBuffer.get(), bytes_transferred);
+      std::cout << "\n";
+      notifyRead(receiveBuffer.get(), bytes_transferred);
+    }
+    return error;
   }
 
 private:
-  boost::asio::ip::tcp::socket socket_;
-  char receiveBuffer_[2048];
+  static const std::size_t RECEIVE_BUFFER_SIZE = 2048;
+  typedef util::BlockPool<RECEIVE_BUFFER_SIZE, alignof(std::max_align_t)> ReceiveBufferPool;
+
+  SOCKET socket_;
+
+  SendQueue sendQueue_;
+  std::string writeBuffer_;
+  std::function<void()> flushedHandler_;
+  bool readingStopped_ = false;
+
+  RateLimiter::Ptr rateLimiter_;
+  const RateLimiter::Address address_;
+  bool dropped_ = false;
 };
 
+// PROTOCOL is boost::asio::ip::tcp or boost::asio::local::stream_protocol, peers of the latter are on
+// this host and not rate limited
+template<typename PROTOCOL>
 class BoostServer : public Server
 {
 public:
+  typedef typename PROTOCOL::socket Socket;
+
+  static constexpr bool IS_UNIX = std::is_same_v<PROTOCOL, boost::asio::local::stream_protocol>;
+
+public:
+  // for UNIX sockets the address is the path and the port is ignored
   BoostServer(const ServerHandler::Ptr& handler, const std::string& address, uint16_t port)
     : handler_(handler)
     , acceptor_(ioService_)
     , nextSocket_(ioService_)
+    , tickTimer_(ioService_)
+    , rateLimiter_(std::make_shared<RateLimiter>())
   {
     //TODO signal handling
 
-    boost::asio::ip::tcp::resolver resolver(ioService_);
-    boost::asio::ip::tcp::endpoint endpoint = *resolver.resolve({address, std::to_string(port)});
-    acceptor_.open(endpoint.protocol());
-    acceptor_.set_option(boost::asio::ip::tcp::acceptor::reuse_address(true));
-    acceptor_.bind(endpoint);
+    if constexpr (IS_UNIX)
+    {
+      boost::asio::local::stream_protocol::endpoint endpoint = makeUnixEndpoint(address);
+      // a socket file left behind by a previous run blocks the bind, one a running process still
+      // listens on is left to it and the bind fails
+      struct stat status;
+      if (!address.empty() && address[0] != '@' && ::stat(address.c_str(), &status) == 0 && S_ISSOCK(status.st_mode))
+      {
+        Socket probe(ioService_);
+        boost::system::error_code error;
+        probe.connect(endpoint, error);
+        if (error == boost::asio::error::connection_refused)
+        {
+          ::unlink(address.c_str());
+        }
+        else
+        {
+          std::cout << "net::server::BoostServer, socket file in use, " << address << std::endl;
+        }
+      }
+      acceptor_.open(endpoint.protocol());
+      acceptor_.bind(endpoint);
+    }
+    else
+    {
+      boost::asio::ip::tcp::resolver resolver(ioService_);
+      boost::asio::ip::tcp::endpoint endpoint = *resolver.resolve({address, std::to_string(port)});
+      acceptor_.open(endpoint.protocol());
+      acceptor_.set_option(boost::asio::ip::tcp::acceptor::reuse_address(true));
+      acceptor_.bind(endpoint);
+    }
     acceptor_.listen();
 
     accept();
@@ -98,7 +394,101 @@ public:
     std::thread([this]() { ioService_.run(); }).detach();
   }
 
+  BoostServer(const ServerHandler::Ptr& handler, int nativeHandle)
+    : handler_(handler)
+    , acceptor_(ioService_)
+    , nextSocket_(ioService_)
+    , tickTimer_(ioService_)
+    , rateLimiter_(std::make_shared<RateLimiter>())
+  {
+    acceptor_.assign(getProtocol(nativeHandle), nativeHandle);
+
+    accept();
+
+    std::thread([this]() { ioService_.run(); }).detach();
+  }
+
+public:
+  void dispatch(const std::function<void()>& function) override
+  {
+    ioService_.dispatch(function);
+  }
+
+  int nativeHandle() const override
+  {
+    return const_cast<typename PROTOCOL::acceptor&>(acceptor_).native_handle();
+  }
+
+  void startTicking(std::chrono::milliseconds interval, const std::function<void()>& tickHandler) override
+  {
+    tickInterval_ = interval;
+    tickHandler_ = tickHandler;
+    ioService_.dispatch([this]() { scheduleTick(); });
+  }
+
+  void setSendLimits(const SendLimits& sendLimits) override
+  {
+    // read by the event loop when it accepts
+    ioService_.dispatch([this, sendLimits]() { sendLimits_ = sendLimits; });
+  }
+
+  void setRateLimits(const RateLimits& rateLimits) override
+  {
+    RateLimiter::Ptr rateLimiter = rateLimiter_;
+    ioService_.dispatch([rateLimiter, rateLimits]() { rateLimiter->setRateLimits(rateLimits); });
+  }
+
+  RateLimitCounters getRateLimitCounters() const override
+  {
+    return rateLimiter_->getCounters();
+  }
+
+  void stopAccepting() override
+  {
+    acceptingStopped_ = true;
+    boost::system::error_code error;
+    acceptor_.cancel(error);
+  }
+
+  Connection::Ptr adoptConnection(int nativeHandle) override
+  {
+    Socket socket(ioService_);
+    socket.assign(getProtocol(nativeHandle), nativeHandle);
+    // handed over connections were admitted by the predecessor and are not rate limited
+    return BoostConnection<Socket>::create(std::move(socket), sendLimits_);
+  }
+
 private:
+  static PROTOCOL getProtocol(int nativeHandle)
+  {
+    if constexpr (IS_UNIX)
+    {
+      return PROTOCOL();
+    }
+    else
+    {
+      sockaddr_storage address;
+      socklen_t addressLength = sizeof(address);
+      ::getsockname(nativeHandle, reinterpret_cast<sockaddr*>(&address), &addressLength);
+      return address.ss_family == AF_INET6 ? PROTOCOL::v6() : PROTOCOL::v4();
+    }
+  }
+
+
+  void scheduleTick()
+  {
+    tickTimer_.expires_after(tickInterval_);
+    tickTimer_.async_wait(
+      [this](boost::system::error_code ec)
+      {
+        if (!ec)
+        {
+          tickHandler_();
+          scheduleTick();
+        }
+      });
+  }
+
   void accept()
   {
     acceptor_.async_accept(
@@ -107,18 +497,39 @@ private:
       {
         // Check whether the server was stopped by a signal before this
         // completion handler had a chance to run.
-        if (!acceptor_.is_open())
+        if (!acceptor_.is_open() || acceptingStopped_)
         {
           return;
         }
 
-        if (!ec)
+        if (!ec && IS_UNIX)
         {
           ServerHandler::Ptr handler = handler_.lock();
           if (handler)
+          {
+            handler->handleNewConnection(BoostConnection<Socket>::create(std::move(nextSocket_), sendLimits_));
+          }
+          else
+          {
+            nextSocket_.close();
+          }
+        }
+        else if (!ec)
+        {
+          boost::system::error_code endpointError;
+          typename PROTOCOL::endpoint endpoint = nextSocket_.remote_endpoint(endpointError);
+          RateLimiter::Address address = RateLimiter::toAddress(endpoint.data());
+          ServerHandler::Ptr handler = handler_.lock();
+          if (handler && (endpointError || !rateLimiter_->admitConnection(address)))
+          {
+            // refused before any data is read, the peer connects too often or too many times at once
+            boost::system::error_code closeError;
+            nextSocket_.close(closeError);
+          }
+          else if (handler)
           {
             handler->handleNewConnection(
-              std::make_shared<BoostConnection>(std::move(nextSocket_)));
+              BoostConnection<Socket>::create(std::move(nextSocket_), sendLimits_, rateLimiter_, address));
           }
           else
           {
@@ -135,15 +546,61 @@ private:
   ServerHandler::WeakPtr handler_;
 
   boost::asio::io_service ioService_;
-  boost::asio::ip::tcp::acceptor acceptor_;
-  boost::asio::ip::tcp::socket nextSocket_;
+  typename PROTOCOL::acceptor acceptor_;
+  Socket nextSocket_;
+  bool acceptingStopped_ = false;
+  SendLimits sendLimits_ = DEFAULT_SEND_LIMITS;
+
+  boost::asio::steady_timer tickTimer_;
+  std::chrono::milliseconds tickInterval_;
+  std::function<void()> tickHandler_;
+
+  // only used on the io service's thread
+  RateLimiter::Ptr rateLimiter_;
 };
 
 Server::Ptr createServer(const ServerHandler::Ptr& handler,
                          const std::string& address, uint16_t port,
                          ConnectionType type)
 {
-  return std::make_shared<BoostServer>(handler, address, port);
+  if (type == CONNECTION_TYPE_UNIX)
+  {
+    return std::make_shared<BoostServer<boost::asio::local::stream_protocol>>(handler, address, port);
+  }
+#ifdef SES_PROXY_IO_URING
+  if (type == CONNECTION_TYPE_TCP || type == CONNECTION_TYPE_AUTO)
+  {
+    Server::Ptr server = createUringServer(handler, address, port);
+    if (server)
+    {
+      return server;
+    }
+  }
+#endif
+  return std::make_shared<BoostServer<boost::asio::ip::tcp>>(handler, address, port);
+}
+
+Server::Ptr createServer(const ServerHandler::Ptr& handler, int nativeHandle, ConnectionType type)
+{
+  // a handed over listener keeps its family, whatever the successor was asked for
+  sockaddr_storage address;
+  socklen_t addressLength = sizeof(address);
+  if (::getsockname(nativeHandle, reinterpret_cast<sockaddr*>(&address), &addressLength) == 0 &&
+      address.ss_family == AF_UNIX)
+  {
+    return std::make_shared<BoostServer<boost::asio::local::stream_protocol>>(handler, nativeHandle);
+  }
+#ifdef SES_PROXY_IO_URING
+  if (type == CONNECTION_TYPE_TCP || type == CONNECTION_TYPE_AUTO)
+  {
+    Server::Ptr server = createUringServer(handler, nativeHandle);
+    if (server)
+    {
+      return server;
+    }
+  }
+#endif
+  return std::make_shared<BoostServer<boost::asio::ip::tcp>>(handler, nativeHandle);
 }
 
 } //namespace server
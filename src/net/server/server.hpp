@@ -5,8 +5,10 @@
 #ifndef SES_NET_SERVER_SERVER_HPP
 #define SES_NET_SERVER_SERVER_HPP
 
+#include <chrono>
 #include <string>
 #include <memory>
+#include <functional>
 #include <boost/core/noncopyable.hpp>
 
 #include "net/connectiontype.hpp"
@@ -16,6 +18,48 @@ namespace ses {
 namespace net {
 namespace server {
 
+/**
+ * Bounds the data queued for a slow peer. Above the high watermark only the latest of the messages sent
+ * with Connection::sendLatest is kept. A peer staying above it for longer than the eviction timeout is
+ * disconnected, it counts as below again once its queue drained to the low watermark. The timeout is
+ * checked whenever data is queued or written. The messages that are kept regardless are capped at the
+ * maximum, a peer exceeding it is disconnected right away.
+ */
+struct SendLimits
+{
+  std::size_t highWatermark_;
+  std::size_t lowWatermark_;
+  std::chrono::milliseconds evictionTimeout_;
+  std::size_t maximum_;
+};
+
+const SendLimits DEFAULT_SEND_LIMITS = {64 * 1024, 16 * 1024, std::chrono::seconds(30), 1024 * 1024};
+
+/**
+ * Limits per source IP, shared by all its connections. Connects and received messages take a token
+ * from the IP's bucket, which refills at the given rate up to the burst. Connects without a token or
+ * beyond the concurrent connections are closed right away. Messages without a token are dropped
+ * before they are parsed, and the connection is closed once the IP owes another burst of tokens.
+ * Generous defaults, as whole mining farms may share one address.
+ */
+struct RateLimits
+{
+  uint32_t maxConnections_;
+  float connectRate_;
+  float connectBurst_;
+  float messageRate_;
+  float messageBurst_;
+};
+
+const RateLimits DEFAULT_RATE_LIMITS = {1024, 20, 200, 1000, 5000};
+
+struct RateLimitCounters
+{
+  uint64_t rejectedConnections_;
+  uint64_t throttledMessages_;
+  uint64_t droppedConnections_;
+};
+
 class ServerHandler
 {
 public:
@@ -36,6 +80,25 @@ public:
 
 public:
   virtual ~Server() {};
+
+  // runs the function on the server's thread, which also runs all callbacks of its connections
+  virtual void dispatch(const std::function<void()>& function) = 0;
+
+  // calls tickHandler on the server's thread in the given interval
+  virtual void startTicking(std::chrono::milliseconds interval, const std::function<void()>& tickHandler) = 0;
+
+  // applies to connections accepted afterwards
+  virtual void setSendLimits(const SendLimits& sendLimits) = 0;
+
+  virtual void setRateLimits(const RateLimits& rateLimits) = 0;
+  // only to be called on the server's thread
+  virtual RateLimitCounters getRateLimitCounters() const = 0;
+
+  virtual int nativeHandle() const = 0;
+  virtual void stopAccepting() = 0;
+
+  // takes over a connected socket, e.g. one handed over by a predecessor process
+  virtual Connection::Ptr adoptConnection(int nativeHandle) = 0;
 };
 
 Server::Ptr createServer(const ServerHandler::Ptr& handler,
@@ -43,6 +106,11 @@ Server::Ptr createServer(const ServerHandler::Ptr& handler,
                          uint16_t port,
                          ConnectionType type = CONNECTION_TYPE_AUTO);
 
+// creates the server on top of an already listening socket
+Server::Ptr createServer(const ServerHandler::Ptr& handler,
+                         int nativeHandle,
+                         ConnectionType type = CONNECTION_TYPE_AUTO);
+
 
 } //namespace server
 } //namespace net
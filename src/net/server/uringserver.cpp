@@ -0,0 +1,989 @@
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include <arpa/inet.h>
+#include <linux/io_uring.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <sys/utsname.h>
+#include <unistd.h>
+
+#include <boost/noncopyable.hpp>
+
+#include "net/server/ratelimiter.hpp"
+#include "net/server/sendqueue.hpp"
+#include "net/server/uringserver.hpp"
+#include "util/sharetrace.hpp"
+
+namespace ses {
+namespace net {
+namespace server {
+
+namespace {
+const unsigned RING_ENTRIES = 4096;
+const unsigned RECEIVE_BUFFER_COUNT = 4096;
+const std::size_t RECEIVE_BUFFER_SIZE = 2048;
+const uint16_t RECEIVE_BUFFER_GROUP = 0;
+
+enum Operation : uint64_t
+{
+  OPERATION_ACCEPT = 1,
+  OPERATION_RECEIVE,
+  OPERATION_SEND,
+  OPERATION_WAKEUP,
+  OPERATION_TICK,
+  OPERATION_CANCEL,
+  OPERATION_PROVIDE_BUFFERS
+};
+
+uint64_t userData(Operation operation, uint64_t connectionId)
+{
+  return (static_cast<uint64_t>(operation) << 56) | connectionId;
+}
+
+Operation operationOf(uint64_t userData)
+{
+  return static_cast<Operation>(userData >> 56);
+}
+
+uint64_t connectionIdOf(uint64_t userData)
+{
+  return userData & ((uint64_t(1) << 56) - 1);
+}
+
+// multishot receive needs Linux 6.0, multishot accept 5.19
+bool kernelSupportsMultishot()
+{
+  utsname name;
+  int major = 0;
+  int minor = 0;
+  return ::uname(&name) == 0 && std::sscanf(name.release, "%d.%d", &major, &minor) == 2 && major >= 6;
+}
+
+class Ring : private boost::noncopyable
+{
+public:
+  ~Ring()
+  {
+    if (sqes_)
+    {
+      ::munmap(sqes_, sqesSize_);
+    }
+    if (cqRing_ && cqRing_ != sqRing_)
+    {
+      ::munmap(cqRing_, cqRingSize_);
+    }
+    if (sqRing_)
+    {
+      ::munmap(sqRing_, sqRingSize_);
+    }
+    if (fd_ >= 0)
+    {
+      ::close(fd_);
+    }
+  }
+
+  bool init(unsigned entries)
+  {
+    io_uring_params params;
+    std::memset(&params, 0, sizeof(params));
+    params.flags = IORING_SETUP_CLAMP;
+    fd_ = static_cast<int>(::syscall(__NR_io_uring_setup, entries, &params));
+    if (fd_ < 0 || !(params.features & IORING_FEAT_SINGLE_MMAP) || !(params.features & IORING_FEAT_NODROP))
+    {
+      return false;
+    }
+
+    sqRingSize_ = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    cqRingSize_ = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+    sqRingSize_ = cqRingSize_ = std::max(sqRingSize_, cqRingSize_);
+    sqRing_ = ::mmap(nullptr, sqRingSize_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd_,
+                     IORING_OFF_SQ_RING);
+    if (sqRing_ == MAP_FAILED)
+    {
+      sqRing_ = nullptr;
+      return false;
+    }
+    cqRing_ = sqRing_;
+
+    sqesSize_ = params.sq_entries * sizeof(io_uring_sqe);
+    void* sqes = ::mmap(nullptr, sqesSize_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd_,
+                        IORING_OFF_SQES);
+    if (sqes == MAP_FAILED)
+    {
+      return false;
+    }
+    sqes_ = static_cast<io_uring_sqe*>(sqes);
+
+    char* sq = static_cast<char*>(sqRing_);
+    sqHead_ = reinterpret_cast<unsigned*>(sq + params.sq_off.head);
+    sqTail_ = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+    sqMask_ = *reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+    sqEntries_ = params.sq_entries;
+    sqArray_ = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+    localSqTail_ = *sqTail_;
+
+    char* cq = static_cast<char*>(cqRing_);
+    cqHead_ = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+    cqTail_ = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+    cqMask_ = *reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+    cqes_ = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+    return true;
+  }
+
+  int fd() const
+  {
+    return fd_;
+  }
+
+  // the returned entry is cleared, submission is deferred to the next submit()
+  io_uring_sqe* getSqe()
+  {
+    if (localSqTail_ - __atomic_load_n(sqHead_, __ATOMIC_ACQUIRE) >= sqEntries_)
+    {
+      submit(0);
+    }
+    unsigned index = localSqTail_ & sqMask_;
+    io_uring_sqe* sqe = &sqes_[index];
+    std::memset(sqe, 0, sizeof(*sqe));
+    sqArray_[index] = index;
+    ++localSqTail_;
+    return sqe;
+  }
+
+  // submits all prepared entries with a single system call and optionally waits for completions
+  void submit(unsigned waitFor)
+  {
+    unsigned toSubmit = localSqTail_ - *sqTail_;
+    __atomic_store_n(sqTail_, localSqTail_, __ATOMIC_RELEASE);
+    if (toSubmit > 0 || waitFor > 0)
+    {
+      int result;
+      do
+      {
+        result = static_cast<int>(::syscall(__NR_io_uring_enter, fd_, toSubmit, waitFor,
+                                            waitFor > 0 ? IORING_ENTER_GETEVENTS : 0, nullptr, 0));
+      } while (result < 0 && errno == EINTR);
+    }
+  }
+
+  template<class HANDLER>
+  void forEachCqe(HANDLER handler)
+  {
+    unsigned head = *cqHead_;
+    while (head != __atomic_load_n(cqTail_, __ATOMIC_ACQUIRE))
+    {
+      io_uring_cqe cqe = cqes_[head & cqMask_];
+      ++head;
+      __atomic_store_n(cqHead_, head, __ATOMIC_RELEASE);
+      handler(cqe);
+    }
+  }
+
+private:
+  int fd_ = -1;
+  void* sqRing_ = nullptr;
+  std::size_t sqRingSize_ = 0;
+  void* cqRing_ = nullptr;
+  std::size_t cqRingSize_ = 0;
+  io_uring_sqe* sqes_ = nullptr;
+  std::size_t sqesSize_ = 0;
+
+  unsigned* sqHead_ = nullptr;
+  unsigned* sqTail_ = nullptr;
+  unsigned sqMask_ = 0;
+  unsigned sqEntries_ = 0;
+  unsigned* sqArray_ = nullptr;
+  unsigned localSqTail_ = 0;
+
+  unsigned* cqHead_ = nullptr;
+  unsigned* cqTail_ = nullptr;
+  unsigned cqMask_ = 0;
+  io_uring_cqe* cqes_ = nullptr;
+};
+
+// receive buffers the kernel picks from for multishot receives, handed back once the data was consumed
+class ProvidedBuffers : private boost::noncopyable
+{
+public:
+  bool init(Ring& ring, uint16_t groupId, unsigned count, std::size_t bufferSize)
+  {
+    groupId_ = groupId;
+    bufferSize_ = bufferSize;
+    buffers_.resize(count * bufferSize);
+
+    provide(ring, 0, count);
+    ring.submit(1);
+    bool provided = false;
+    ring.forEachCqe([&provided](const io_uring_cqe& cqe) { provided = cqe.res >= 0; });
+    return provided;
+  }
+
+  char* buffer(uint16_t bufferId)
+  {
+    return &buffers_[bufferId * bufferSize_];
+  }
+
+  // queued with the other submissions of the current event loop iteration
+  void recycle(Ring& ring, uint16_t bufferId)
+  {
+    provide(ring, bufferId, 1);
+  }
+
+private:
+  void provide(Ring& ring, uint16_t firstBufferId, unsigned count)
+  {
+    io_uring_sqe* sqe = ring.getSqe();
+    sqe->opcode = IORING_OP_PROVIDE_BUFFERS;
+    sqe->fd = static_cast<int>(count);
+    sqe->addr = reinterpret_cast<uint64_t>(buffer(firstBufferId));
+    sqe->len = static_cast<uint32_t>(bufferSize_);
+    sqe->buf_group = groupId_;
+    sqe->off = firstBufferId;
+    sqe->user_data = userData(OPERATION_PROVIDE_BUFFERS, 0);
+  }
+
+private:
+  uint16_t groupId_ = 0;
+  std::size_t bufferSize_ = 0;
+  std::vector<char> buffers_;
+};
+
+class UringServer;
+
+class UringConnection : public Connection,
+                        public std::enable_shared_from_this<UringConnection>
+{
+public:
+  typedef std::shared_ptr<UringConnection> Ptr;
+
+public:
+  UringConnection(UringServer& server, int fd, uint64_t id, const SendLimits& sendLimits,
+                  RateLimiter* rateLimiter = nullptr, const RateLimiter::Address& address = RateLimiter::Address())
+    : server_(server)
+    , fd_(fd)
+    , id_(id)
+    , sendQueue_(sendLimits)
+    , rateLimiter_(rateLimiter)
+    , address_(address)
+  {
+  }
+
+  bool connected() const override
+  {
+    return !closed_;
+  }
+
+  std::string connectedIp() const override
+  {
+    sockaddr_storage address;
+    socklen_t addressLength = sizeof(address);
+    char ip[INET6_ADDRSTRLEN] = "";
+    if (::getpeername(fd_, reinterpret_cast<sockaddr*>(&address), &addressLength) == 0)
+    {
+      if (address.ss_family == AF_INET6)
+      {
+        ::inet_ntop(AF_INET6, &reinterpret_cast<sockaddr_in6&>(address).sin6_addr, ip, sizeof(ip));
+      }
+      else
+      {
+        ::inet_ntop(AF_INET, &reinterpret_cast<sockaddr_in&>(address).sin_addr, ip, sizeof(ip));
+      }
+    }
+    return ip;
+  }
+
+  int nativeHandle() const override
+  {
+    return fd_;
+  }
+
+  void stopReading() override;
+  void disconnect() override;
+  void flush(const std::function<void()>& flushedHandler) override;
+
+  bool send(const char* data, std::size_t size) override
+  {
+    return enqueue(data, size, false);
+  }
+
+  bool sendLatest(const char* data, std::size_t size) override
+  {
+    return enqueue(data, size, true);
+  }
+
+public: // event loop
+  uint64_t id() const
+  {
+    return id_;
+  }
+
+  void startReceiving();
+  void handleReceived(const io_uring_cqe& cqe);
+  void writeNext();
+  void handleSent(const io_uring_cqe& cqe);
+  void close();
+
+protected:
+  bool admitMessage() override;
+
+private:
+  bool enqueue(const char* data, std::size_t size, bool latest);
+  void fail(const std::string& error);
+  void evict();
+  void notifyFlushed();
+
+private:
+  UringServer& server_;
+  const int fd_;
+  const uint64_t id_;
+
+  SendQueue sendQueue_;
+  std::string writeBuffer_;
+  std::size_t writeOffset_ = 0;
+  std::function<void()> flushedHandler_;
+
+  bool receiving_ = false;
+  bool sending_ = false;
+  bool readingStopped_ = false;
+  bool closing_ = false;
+  std::atomic<bool> closed_{false};
+
+  // set if the connection was admitted by the server's rate limiter, released when closed
+  RateLimiter* rateLimiter_;
+  const RateLimiter::Address address_;
+};
+
+class UringServer : public Server,
+                    public std::enable_shared_from_this<UringServer>
+{
+public:
+  UringServer(const ServerHandler::Ptr& handler)
+    : handler_(handler)
+  {
+  }
+
+  ~UringServer()
+  {
+    if (eventFd_ >= 0)
+    {
+      ::close(eventFd_);
+    }
+  }
+
+  bool init(int listenFd)
+  {
+    listenFd_ = listenFd;
+    eventFd_ = ::eventfd(0, EFD_CLOEXEC);
+    if (listenFd_ < 0 || eventFd_ < 0 || !kernelSupportsMultishot() || !ring_.init(RING_ENTRIES) ||
+        !receiveBuffers_.init(ring_, RECEIVE_BUFFER_GROUP, RECEIVE_BUFFER_COUNT, RECEIVE_BUFFER_SIZE))
+    {
+      return false;
+    }
+
+    armAccept();
+    armWakeup();
+    // the event loop runs for the rest of the process' lifetime and keeps its server alive
+    std::shared_ptr<UringServer> self = shared_from_this();
+    std::thread(
+      [self]()
+      {
+        self->loopThread_ = std::this_thread::get_id();
+        self->run();
+      }).detach();
+    return true;
+  }
+
+public: // Server
+  void dispatch(const std::function<void()>& function) override
+  {
+    if (std::this_thread::get_id() == loopThread_)
+    {
+      function();
+    }
+    else
+    {
+      post(function);
+    }
+  }
+
+  void startTicking(std::chrono::milliseconds interval, const std::function<void()>& tickHandler) override
+  {
+    post(
+      [this, interval, tickHandler]()
+      {
+        tickInterval_.tv_sec = interval.count() / 1000;
+        tickInterval_.tv_nsec = (interval.count() % 1000) * 1000000;
+        tickHandler_ = tickHandler;
+        armTick();
+      });
+  }
+
+  void setSendLimits(const SendLimits& sendLimits) override
+  {
+    // read by the event loop when it accepts
+    dispatch([this, sendLimits]() { sendLimits_ = sendLimits; });
+  }
+
+  void setRateLimits(const RateLimits& rateLimits) override
+  {
+    dispatch([this, rateLimits]() { rateLimiter_.setRateLimits(rateLimits); });
+  }
+
+  RateLimitCounters getRateLimitCounters() const override
+  {
+    return rateLimiter_.getCounters();
+  }
+
+  int nativeHandle() const override
+  {
+    return listenFd_;
+  }
+
+  void stopAccepting() override
+  {
+    dispatch(
+      [this]()
+      {
+        acceptingStopped_ = true;
+        cancel(userData(OPERATION_ACCEPT, 0));
+      });
+  }
+
+  Connection::Ptr adoptConnection(int nativeHandle) override
+  {
+    // handed over connections were admitted by the predecessor and are not rate limited
+    UringConnection::Ptr connection =
+      std::make_shared<UringConnection>(*this, nativeHandle, nextConnectionId_++, sendLimits_);
+    dispatch([this, connection]() { addConnection(connection); });
+    return connection;
+  }
+
+public: // event loop
+  void post(const std::function<void()>& function)
+  {
+    {
+      std::lock_guard<std::mutex> lock(postedMutex_);
+      posted_.push_back(function);
+    }
+    if (std::this_thread::get_id() != loopThread_ && !wakeupPending_.exchange(true))
+    {
+      uint64_t one = 1;
+      ssize_t written = ::write(eventFd_, &one, sizeof(one));
+      (void) written;
+    }
+  }
+
+  io_uring_sqe* getSqe()
+  {
+    return ring_.getSqe();
+  }
+
+  void cancel(uint64_t targetUserData)
+  {
+    io_uring_sqe* sqe = ring_.getSqe();
+    sqe->opcode = IORING_OP_ASYNC_CANCEL;
+    sqe->fd = -1;
+    sqe->addr = targetUserData;
+    sqe->user_data = userData(OPERATION_CANCEL, 0);
+  }
+
+  void recycleReceiveBuffer(uint16_t bufferId)
+  {
+    receiveBuffers_.recycle(ring_, bufferId);
+  }
+
+  char* receiveBuffer(uint16_t bufferId)
+  {
+    return receiveBuffers_.buffer(bufferId);
+  }
+
+  void removeConnection(uint64_t id)
+  {
+    connections_.erase(id);
+  }
+
+private:
+  void addConnection(const UringConnection::Ptr& connection)
+  {
+    connections_[connection->id()] = connection;
+    connection->startReceiving();
+  }
+
+  void run()
+  {
+    for (;;)
+    {
+      // one system call submits everything queued during the last iteration, e.g. the sends of all connections
+      ring_.submit(1);
+      ring_.forEachCqe([this](const io_uring_cqe& cqe) { handleCompletion(cqe); });
+
+      wakeupPending_.store(false);
+      for (;;)
+      {
+        std::vector<std::function<void()> > posted;
+        {
+          std::lock_guard<std::mutex> lock(postedMutex_);
+          posted.swap(posted_);
+        }
+        if (posted.empty())
+        {
+          break;
+        }
+        for (auto& function : posted)
+        {
+          function();
+        }
+      }
+    }
+  }
+
+  void handleCompletion(const io_uring_cqe& cqe)
+  {
+    switch (operationOf(cqe.user_data))
+    {
+      case OPERATION_ACCEPT:
+        handleAccept(cqe);
+        break;
+
+      case OPERATION_RECEIVE:
+      {
+        auto connection = connections_.find(connectionIdOf(cqe.user_data));
+        if (connection != connections_.end())
+        {
+          UringConnection::Ptr self = connection->second;
+          self->handleReceived(cqe);
+        }
+        else if (cqe.flags & IORING_CQE_F_BUFFER)
+        {
+          receiveBuffers_.recycle(ring_, static_cast<uint16_t>(cqe.flags >> IORING_CQE_BUFFER_SHIFT));
+        }
+        break;
+      }
+
+      case OPERATION_SEND:
+      {
+        auto connection = connections_.find(connectionIdOf(cqe.user_data));
+        if (connection != connections_.end())
+        {
+          UringConnection::Ptr self = connection->second;
+          self->handleSent(cqe);
+        }
+        break;
+      }
+
+      case OPERATION_WAKEUP:
+        armWakeup();
+        break;
+
+      case OPERATION_TICK:
+        if (tickHandler_)
+        {
+          tickHandler_();
+        }
+        armTick();
+        break;
+
+      default:
+        break;
+    }
+  }
+
+  void handleAccept(const io_uring_cqe& cqe)
+  {
+    if (cqe.res >= 0)
+    {
+      int nodelay = 1;
+      ::setsockopt(cqe.res, IPPROTO_TCP, TCP_NODELAY, &nodelay, sizeof(nodelay));
+
+      ServerHandler::Ptr handler = handler_.lock();
+      RateLimiter::Address address = RateLimiter::peerAddress(cqe.res);
+      if (handler && !rateLimiter_.admitConnection(address))
+      {
+        // refused before any data is read, the peer connects too often or too many times at once
+        ::close(cqe.res);
+      }
+      else if (handler)
+      {
+        UringConnection::Ptr connection =
+          std::make_shared<UringConnection>(*this, cqe.res, nextConnectionId_++, sendLimits_,
+                                            &rateLimiter_, address);
+        addConnection(connection);
+        handler->handleNewConnection(connection);
+      }
+      else
+      {
+        // noone there to handle a new socket ... just closes it
+        ::close(cqe.res);
+      }
+    }
+
+    if (!(cqe.flags & IORING_CQE_F_MORE) && !acceptingStopped_)
+    {
+      armAccept();
+    }
+  }
+
+  void armAccept()
+  {
+    io_uring_sqe* sqe = ring_.getSqe();
+    sqe->opcode = IORING_OP_ACCEPT;
+    sqe->fd = listenFd_;
+    sqe->ioprio = IORING_ACCEPT_MULTISHOT;
+    sqe->accept_flags = SOCK_CLOEXEC;
+    sqe->user_data = userData(OPERATION_ACCEPT, 0);
+  }
+
+  void armWakeup()
+  {
+    io_uring_sqe* sqe = ring_.getSqe();
+    sqe->opcode = IORING_OP_READ;
+    sqe->fd = eventFd_;
+    sqe->addr = reinterpret_cast<uint64_t>(&wakeupValue_);
+    sqe->len = sizeof(wakeupValue_);
+    sqe->user_data = userData(OPERATION_WAKEUP, 0);
+  }
+
+  void armTick()
+  {
+    io_uring_sqe* sqe = ring_.getSqe();
+    sqe->opcode = IORING_OP_TIMEOUT;
+    sqe->fd = -1;
+    sqe->addr = reinterpret_cast<uint64_t>(&tickInterval_);
+    sqe->len = 1;
+    sqe->user_data = userData(OPERATION_TICK, 0);
+  }
+
+private:
+  ServerHandler::WeakPtr handler_;
+  Ring ring_;
+  ProvidedBuffers receiveBuffers_;
+  int listenFd_ = -1;
+  int eventFd_ = -1;
+  uint64_t wakeupValue_ = 0;
+
+  std::atomic<std::thread::id> loopThread_;
+  std::mutex postedMutex_;
+  std::vector<std::function<void()> > posted_;
+  std::atomic<bool> wakeupPending_{false};
+
+  std::unordered_map<uint64_t, UringConnection::Ptr> connections_;
+  std::atomic<uint64_t> nextConnectionId_{1};
+  SendLimits sendLimits_ = DEFAULT_SEND_LIMITS;
+  RateLimiter rateLimiter_;
+  bool acceptingStopped_ = false;
+
+  __kernel_timespec tickInterval_ = {0, 0};
+  std::function<void()> tickHandler_;
+};
+
+void UringConnection::stopReading()
+{
+  Ptr self = shared_from_this();
+  server_.dispatch(
+    [self]()
+    {
+      self->readingStopped_ = true;
+      if (self->receiving_)
+      {
+        self->server_.cancel(userData(OPERATION_RECEIVE, self->id_));
+      }
+    });
+}
+
+void UringConnection::disconnect()
+{
+  Ptr self = shared_from_this();
+  server_.dispatch([self]() { self->close(); });
+}
+
+void UringConnection::flush(const std::function<void()>& flushedHandler)
+{
+  Ptr self = shared_from_this();
+  server_.dispatch(
+    [self, flushedHandler]()
+    {
+      // a closing socket writes nothing anymore
+      if (self->closing_ || self->sendQueue_.idle())
+      {
+        flushedHandler();
+      }
+      else
+      {
+        self->flushedHandler_ = flushedHandler;
+      }
+    });
+}
+
+void UringConnection::notifyFlushed()
+{
+  if (flushedHandler_)
+  {
+    std::function<void()> flushedHandler;
+    flushedHandler.swap(flushedHandler_);
+    flushedHandler();
+  }
+}
+
+bool UringConnection::enqueue(const char* data, std::size_t size, bool latest)
+{
+  Ptr self = shared_from_this();
+  switch (sendQueue_.enqueue(data, size, latest))
+  {
+    case SendQueue::ENQUEUE_RESULT_START_WRITING:
+      server_.dispatch([self]() { self->writeNext(); });
+      return true;
+
+    case SendQueue::ENQUEUE_RESULT_QUEUED:
+      return true;
+
+    case SendQueue::ENQUEUE_RESULT_EVICT:
+      server_.dispatch([self]() { self->evict(); });
+      return false;
+
+    default:
+      return false;
+  }
+}
+
+void UringConnection::startReceiving()
+{
+  io_uring_sqe* sqe = server_.getSqe();
+  sqe->opcode = IORING_OP_RECV;
+  sqe->fd = fd_;
+  sqe->flags = IOSQE_BUFFER_SELECT;
+  sqe->buf_group = RECEIVE_BUFFER_GROUP;
+  sqe->ioprio = IORING_RECV_MULTISHOT;
+  sqe->user_data = userData(OPERATION_RECEIVE, id_);
+  receiving_ = true;
+}
+
+void UringConnection::handleReceived(const io_uring_cqe& cqe)
+{
+  bool more = (cqe.flags & IORING_CQE_F_MORE) != 0;
+  if (cqe.res > 0)
+  {
+    uint16_t bufferId = static_cast<uint16_t>(cqe.flags >> IORING_CQE_BUFFER_SHIFT);
+    util::ShareTrace::begin();
+    notifyRead(server_.receiveBuffer(bufferId), static_cast<std::size_t>(cqe.res));
+    server_.recycleReceiveBuffer(bufferId);
+    if (!more)
+    {
+      receiving_ = false;
+      if (closing_)
+      {
+        close();
+      }
+      else if (!readingStopped_)
+      {
+        startReceiving();
+      }
+    }
+    return;
+  }
+
+  if (more)
+  {
+    return;
+  }
+  receiving_ = false;
+
+  if (cqe.res == -ENOBUFS && !readingStopped_ && !closing_)
+  {
+    // all receive buffers were in use at once, they are back by now
+    startReceiving();
+  }
+  else if (cqe.res == -ECANCELED && readingStopped_ && !closing_)
+  {
+    // the socket is being handed over and must stay open
+  }
+  else
+  {
+    if (!closing_)
+    {
+      fail(cqe.res == 0 ? "End of file" : std::strerror(-cqe.res));
+    }
+    close();
+  }
+}
+
+void UringConnection::writeNext()
+{
+  if (sending_ || closing_)
+  {
+    return;
+  }
+  if (writeOffset_ >= writeBuffer_.size())
+  {
+    if (!sendQueue_.takePending(writeBuffer_))
+    {
+      notifyFlushed();
+      return;
+    }
+    writeOffset_ = 0;
+  }
+
+  io_uring_sqe* sqe = server_.getSqe();
+  sqe->opcode = IORING_OP_SEND;
+  sqe->fd = fd_;
+  sqe->addr = reinterpret_cast<uint64_t>(writeBuffer_.data() + writeOffset_);
+  sqe->len = static_cast<uint32_t>(writeBuffer_.size() - writeOffset_);
+  sqe->msg_flags = MSG_NOSIGNAL;
+  sqe->user_data = userData(OPERATION_SEND, id_);
+  sending_ = true;
+}
+
+void UringConnection::handleSent(const io_uring_cqe& cqe)
+{
+  sending_ = false;
+  if (cqe.res >= 0)
+  {
+    // partial sends continue from where the kernel stopped
+    bool evicted = sendQueue_.completeWrite(static_cast<std::size_t>(cqe.res));
+    writeOffset_ += static_cast<std::size_t>(cqe.res);
+    if (closing_)
+    {
+      close();
+    }
+    else if (evicted)
+    {
+      evict();
+    }
+    else
+    {
+      writeNext();
+    }
+  }
+  else
+  {
+    sendQueue_.failWrite();
+    if (!closing_)
+    {
+      fail(std::strerror(-cqe.res));
+    }
+    close();
+  }
+}
+
+void UringConnection::close()
+{
+  if (!closing_)
+  {
+    closing_ = true;
+    // terminates the outstanding receive and send, the socket is closed once both completed
+    ::shutdown(fd_, SHUT_RDWR);
+  }
+  // nothing is written anymore
+  notifyFlushed();
+  if (!receiving_ && !sending_ && !closed_)
+  {
+    closed_ = true;
+    ::close(fd_);
+    if (rateLimiter_)
+    {
+      rateLimiter_->releaseConnection(address_);
+    }
+    server_.removeConnection(id_);
+  }
+}
+
+bool UringConnection::admitMessage()
+{
+  if (!rateLimiter_)
+  {
+    return true;
+  }
+  if (closing_)
+  {
+    return false;
+  }
+
+  switch (rateLimiter_->admitMessage(address_))
+  {
+    case RateLimiter::VERDICT_ADMIT:
+      return true;
+
+    case RateLimiter::VERDICT_DISCONNECT:
+      std::cout << "net::server::UringConnection dropping flooding peer " << RateLimiter::toString(address_)
+                << std::endl;
+      close();
+      notifyError("message rate limit exceeded");
+      return false;
+
+    default:
+      return false;
+  }
+}
+
+// closes the connection of a peer that does not keep up with reading
+void UringConnection::evict()
+{
+  if (!closing_)
+  {
+    std::cout << "net::server::UringConnection evicting slow peer" << std::endl;
+    close();
+    notifyError("send queue limit exceeded");
+  }
+}
+
+void UringConnection::fail(const std::string& error)
+{
+  std::cout << "net::server::UringConnection failed: " << error << "\n";
+  notifyError(error);
+}
+}
+
+Server::Ptr createUringServer(const ServerHandler::Ptr& handler, const std::string& address, uint16_t port)
+{
+  addrinfo hints;
+  std::memset(&hints, 0, sizeof(hints));
+  hints.ai_socktype = SOCK_STREAM;
+  hints.ai_flags = AI_PASSIVE;
+  addrinfo* addresses = nullptr;
+  if (::getaddrinfo(address.c_str(), std::to_string(port).c_str(), &hints, &addresses) != 0)
+  {
+    return nullptr;
+  }
+
+  int fd = ::socket(addresses->ai_family, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  int reuseAddress = 1;
+  bool listening = fd >= 0 &&
+                   ::setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &reuseAddress, sizeof(reuseAddress)) == 0 &&
+                   ::bind(fd, addresses->ai_addr, addresses->ai_addrlen) == 0 &&
+                   ::listen(fd, SOMAXCONN) == 0;
+  ::freeaddrinfo(addresses);
+
+  Server::Ptr server = listening ? createUringServer(handler, fd) : nullptr;
+  if (!server && fd >= 0)
+  {
+    ::close(fd);
+  }
+  return server;
+}
+
+Server::Ptr createUringServer(const ServerHandler::Ptr& handler, int nativeHandle)
+{
+  std::shared_ptr<UringServer> server = std::make_shared<UringServer>(handler);
+  if (!server->init(nativeHandle))
+  {
+    return nullptr;
+  }
+  return server;
+}
+
+} //namespace server
+} //namespace net
+} //namespace ses
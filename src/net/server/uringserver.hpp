@@ -0,0 +1,25 @@
+#ifndef SES_NET_SERVER_URINGSERVER_HPP
+#define SES_NET_SERVER_URINGSERVER_HPP
+
+#include "net/server/server.hpp"
+
+namespace ses {
+namespace net {
+namespace server {
+
+/**
+ * Server backend on top of io_uring: multishot accept, multishot receive into kernel provided
+ * buffers, and sends of all connections submitted together once per event loop iteration.
+ *
+ * Both factories return an empty pointer if the running kernel lacks the necessary io_uring
+ * features (Linux 6.0 or later), so callers can fall back to the Boost.Asio backend.
+ */
+Server::Ptr createUringServer(const ServerHandler::Ptr& handler, const std::string& address, uint16_t port);
+
+Server::Ptr createUringServer(const ServerHandler::Ptr& handler, int nativeHandle);
+
+} //namespace server
+} //namespace net
+} //namespace ses
+
+#endif //SES_NET_SERVER_URINGSERVER_HPP
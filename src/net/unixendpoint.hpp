@@ -0,0 +1,24 @@
+#ifndef SES_NET_UNIXENDPOINT_HPP
+#define SES_NET_UNIXENDPOINT_HPP
+
+#include <string>
+#include <boost/asio/local/stream_protocol.hpp>
+
+namespace ses {
+namespace net {
+
+// a filesystem path, or an abstract name if it starts with '@', which is left out of the file
+// system and goes away with the last socket bound to it
+inline boost::asio::local::stream_protocol::endpoint makeUnixEndpoint(const std::string& path)
+{
+  if (!path.empty() && path[0] == '@')
+  {
+    return boost::asio::local::stream_protocol::endpoint(std::string(1, '\0') + path.substr(1));
+  }
+  return boost::asio::local::stream_protocol::endpoint(path);
+}
+
+} //namespace net
+} //namespace ses
+
+#endif //SES_NET_UNIXENDPOINT_HPP
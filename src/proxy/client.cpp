@@ -1,18 +1,133 @@
 
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
 #include <iostream>
+#include <type_traits>
 #include <boost/uuid/uuid_io.hpp>
 #include <boost/lexical_cast.hpp>
 
 #include "net/jsonrpc/jsonrpc.hpp"
+#include "util/allocationaccounting.hpp"
+#include "util/hex.hpp"
+#include "util/sharetrace.hpp"
+#include "stratum/bitcoin.hpp"
 #include "stratum/stratum.hpp"
 #include "proxy/client.hpp"
 
 namespace ses {
 namespace proxy {
 
+namespace {
+// tells a successor built with another layout of HandOverState from one it can restore from
+struct HandOverHeader
+{
+  uint32_t magic;
+  uint16_t version;
+  uint16_t stateSize;
+};
+
+const uint32_t HAND_OVER_MAGIC = 0x53455348;
+const uint16_t HAND_OVER_VERSION = 2;
+
+struct HandOverState
+{
+  boost::uuids::uuid identifier;
+  stratum::Job job;
+  uint16_t useragentSize;
+  uint16_t usernameSize;
+  uint16_t extranonce1Size;
+  uint16_t addressSize;
+  uint16_t slotCount;
+  uint8_t protocol;
+  bool extranonceSubscribed;
+};
+// sent as their bytes to the successor
+static_assert(std::is_trivially_copyable_v<HandOverHeader>, "hand over header is copied bytewise");
+static_assert(std::is_trivially_copyable_v<HandOverState>, "hand over state is copied bytewise");
+
+// the nonce as the miner sent it, zero if malformed
+uint32_t parseNonce(const std::string& nonceHexString)
+{
+  uint32_t nonce = 0;
+  if (nonceHexString.size() != 2 * sizeof(nonce) ||
+      !util::hex::decode(nonceHexString, reinterpret_cast<uint8_t*>(&nonce)))
+  {
+    return 0;
+  }
+  return nonce;
+}
+}
+
+constexpr std::chrono::seconds Client::LOGIN_TIMEOUT;
+constexpr std::chrono::seconds Client::IDLE_TIMEOUT;
+constexpr std::chrono::seconds Client::KEEPALIVE_TIMEOUT;
+const uint16_t Client::BINARY_SLOT_COUNT_MAX;
+
 Client::Client(const boost::uuids::uuid& id)
-  : rpcIdentifier_(id)
+  : timingWheel_(nullptr)
+  , timeoutTimer_(std::bind(&Client::handleTimeout, this))
+  , connectedTime_(std::chrono::steady_clock::now())
+  , lastActivityTime_(connectedTime_)
+  , rpcIdentifier_(id)
+  , sentDifficulty_(0)
+  , currentJobSequence_(0)
+  , slotCount_(1)
+  , extranonce2Size_(0)
+  , protocol_(stratum::PROTOCOL_CRYPTONOTE)
+  , loggedIn_(false)
+  , usesKeepAlive_(false)
+  , extranonceSubscribed_(false)
+{
+}
+
+Client::Ptr Client::restore(const std::string& handOverState)
 {
+  HandOverHeader header;
+  if (handOverState.size() < sizeof(header))
+  {
+    std::cout << "proxy::Client::restore, state too short, " << handOverState.size() << std::endl;
+    return Client::Ptr();
+  }
+  std::memcpy(&header, handOverState.data(), sizeof(header));
+  if (header.magic != HAND_OVER_MAGIC || header.version != HAND_OVER_VERSION ||
+      header.stateSize != sizeof(HandOverState))
+  {
+    std::cout << "proxy::Client::restore, incompatible predecessor, magic, " << std::hex << header.magic << std::dec
+              << ", version, " << header.version << ", state size, " << header.stateSize << ", expected version, "
+              << HAND_OVER_VERSION << ", state size, " << sizeof(HandOverState) << std::endl;
+    return Client::Ptr();
+  }
+
+  HandOverState state;
+  std::size_t offset = sizeof(header) + sizeof(state);
+  if (handOverState.size() < offset)
+  {
+    std::cout << "proxy::Client::restore, state too short, " << handOverState.size() << std::endl;
+    return Client::Ptr();
+  }
+  std::memcpy(&state, handOverState.data() + sizeof(header), sizeof(state));
+  if (handOverState.size() !=
+      offset + state.useragentSize + state.usernameSize + state.extranonce1Size + state.addressSize)
+  {
+    std::cout << "proxy::Client::restore, state size mismatch, " << handOverState.size() << std::endl;
+    return Client::Ptr();
+  }
+
+  Client::Ptr client = std::make_shared<Client>(state.identifier);
+  client->currentJob_ = state.job;
+  client->useragent_ = handOverState.substr(offset, state.useragentSize);
+  client->username_ = handOverState.substr(offset + state.useragentSize, state.usernameSize);
+  client->subscribedExtraNone1_ =
+    handOverState.substr(offset + state.useragentSize + state.usernameSize, state.extranonce1Size);
+  // parked sessions are found by login and address, the address is only looked up at login
+  client->address_ = handOverState.substr(
+    offset + state.useragentSize + state.usernameSize + state.extranonce1Size, state.addressSize);
+  client->protocol_ = static_cast<stratum::Protocol>(state.protocol);
+  client->extranonceSubscribed_ = state.extranonceSubscribed;
+  client->slotCount_ = state.slotCount;
+  client->loggedIn_ = !client->username_.empty();
+  return client;
 }
 
 void Client::setConnection(const net::Connection::Ptr& connection)
@@ -21,18 +136,272 @@ void Client::setConnection(const net::Connection::Ptr& connection)
   connection_->setHandler(shared_from_this());
 }
 
+const net::Connection::Ptr& Client::getConnection() const
+{
+  return connection_;
+}
+
+void Client::setDisconnectHandler(const DisconnectHandler& disconnectHandler)
+{
+  disconnectHandler_ = disconnectHandler;
+}
+
+void Client::setLoginHandler(const LoginHandler& loginHandler)
+{
+  loginHandler_ = loginHandler;
+}
+
+void Client::setResumeHandler(const ResumeHandler& resumeHandler)
+{
+  resumeHandler_ = resumeHandler;
+}
+
+void Client::setShareHandler(const ShareHandler& shareHandler)
+{
+  shareHandler_ = shareHandler;
+}
+
+void Client::setBitcoinShareHandler(const BitcoinShareHandler& bitcoinShareHandler)
+{
+  bitcoinShareHandler_ = bitcoinShareHandler;
+}
+
+void Client::setShareJournal(const ShareJournal::Ptr& shareJournal)
+{
+  shareJournal_ = shareJournal;
+}
+
+void Client::setWorkerStatistics(const WorkerStatistics::Ptr& workerStatistics)
+{
+  workerStatistics_ = workerStatistics;
+}
+
+void Client::setShareVerifier(const ShareVerifier::Ptr& shareVerifier)
+{
+  shareVerifier_ = shareVerifier;
+}
+
+void Client::setJob(const stratum::Job& job)
+{
+  if (protocol_ == stratum::PROTOCOL_BITCOIN)
+  {
+    std::cout << "proxy::Client::setJob, CryptoNote job for a stratum v1 miner" << std::endl;
+    return;
+  }
+
+  if (protocol_ == stratum::PROTOCOL_BINARY)
+  {
+    previousJob_ = currentJob_;
+    currentJob_ = job;
+    ++currentJobSequence_;
+    if (loggedIn_ && connection_)
+    {
+      util::ArenaScope arenaScope;
+      connection_->sendLatest(stratum::binary::server::createJob(currentJob_, currentJobSequence_,
+                                                                 static_cast<uint8_t>(currentJob_.getNonce() >> 24),
+                                                                 slotCount_));
+    }
+    return;
+  }
+
+  currentJob_ = job;
+  if (loggedIn_ && connection_)
+  {
+    util::ArenaScope arenaScope;
+    connection_->sendLatest(stratum::server::createJobNotification(currentJob_, boost::uuids::to_string(rpcIdentifier_)));
+  }
+}
+
+bool Client::setBitcoinJob(const stratum::BitcoinJob::Ptr& job, uint8_t slot)
+{
+  if (protocol_ != stratum::PROTOCOL_BITCOIN)
+  {
+    std::cout << "proxy::Client::setBitcoinJob, stratum v1 job for a CryptoNote miner" << std::endl;
+    return false;
+  }
+
+  std::string extranonce1 = job->getExtranonce1() + util::hex::encode(&slot, 1);
+  bool extranonceChanged = !subscribedExtraNone1_.empty() && extranonce1 != subscribedExtraNone1_;
+  if (job->isClean() || extranonceChanged)
+  {
+    bitcoinJobs_.fill(nullptr);
+  }
+  std::move_backward(bitcoinJobs_.begin(), bitcoinJobs_.end() - 1, bitcoinJobs_.end());
+  bitcoinJobs_.front() = job;
+  subscribedExtraNone1_ = extranonce1;
+  extranonce2Size_ = static_cast<uint8_t>(job->getExtranonce2Size() - 1);
+
+  if (!connection_)
+  {
+    return true;
+  }
+
+  util::ArenaScope arenaScope;
+  if (!pendingSubscribeId_.empty())
+  {
+    sendBitcoinResult(pendingSubscribeId_,
+                      stratum::bitcoin::server::createSubscribeResult(boost::uuids::to_string(rpcIdentifier_),
+                                                                      subscribedExtraNone1_, extranonce2Size_));
+    pendingSubscribeId_.clear();
+  }
+  else if (extranonceChanged)
+  {
+    if (!extranonceSubscribed_)
+    {
+      // the miner would go on hashing with the old extranonce1
+      std::cout << "proxy::Client::setBitcoinJob, extranonce changed without subscription" << std::endl;
+      return false;
+    }
+    connection_->send(
+      net::jsonrpc::notificationV1("mining.set_extranonce",
+                                   stratum::bitcoin::server::createSetExtranonceParams(subscribedExtraNone1_,
+                                                                                       extranonce2Size_)));
+  }
+
+  if (loggedIn_)
+  {
+    sendBitcoinJob(job->isClean() || extranonceChanged || !bitcoinJobs_[1]);
+  }
+  return true;
+}
+
+bool Client::canSwitchSession() const
+{
+  return protocol_ != stratum::PROTOCOL_BITCOIN || extranonceSubscribed_ || subscribedExtraNone1_.empty();
+}
+
+uint16_t Client::getSlotCount() const
+{
+  return slotCount_;
+}
+
+void Client::startTimeouts(util::TimingWheel& timingWheel)
+{
+  timingWheel_ = &timingWheel;
+  timingWheel_->arm(timeoutTimer_, LOGIN_TIMEOUT);
+}
+
+void Client::disconnect()
+{
+  // the disconnect handler might release the last reference to this client
+  Client::Ptr self = shared_from_this();
+  timeoutTimer_.cancel();
+  if (connection_)
+  {
+    connection_->disconnect();
+  }
+  if (disconnectHandler_)
+  {
+    DisconnectHandler disconnectHandler;
+    disconnectHandler.swap(disconnectHandler_);
+    disconnectHandler(self);
+  }
+}
+
+bool Client::canResume() const
+{
+  return loggedIn_ && protocol_ == stratum::PROTOCOL_CRYPTONOTE;
+}
+
+void Client::park()
+{
+  timeoutTimer_.cancel();
+  connection_.reset();
+}
+
+void Client::resume(const Client& parked)
+{
+  rpcIdentifier_ = parked.rpcIdentifier_;
+  currentJob_ = parked.currentJob_;
+  usesKeepAlive_ = parked.usesKeepAlive_;
+}
+
+const boost::uuids::uuid& Client::getIdentifier() const
+{
+  return rpcIdentifier_;
+}
+
+const std::string& Client::getUsername() const
+{
+  return username_;
+}
+
+const std::string& Client::getAddress() const
+{
+  return address_;
+}
+
+bool Client::isLoggedIn() const
+{
+  return loggedIn_;
+}
+
+std::string Client::getHandOverState() const
+{
+  HandOverHeader header;
+  std::memset(static_cast<void*>(&header), 0, sizeof(header));
+  header.magic = HAND_OVER_MAGIC;
+  header.version = HAND_OVER_VERSION;
+  header.stateSize = static_cast<uint16_t>(sizeof(HandOverState));
+
+  HandOverState state;
+  // padding included, the state goes out as bytes
+  std::memset(static_cast<void*>(&state), 0, sizeof(state));
+  state.identifier = rpcIdentifier_;
+  state.job = currentJob_;
+  state.useragentSize = static_cast<uint16_t>(useragent_.size());
+  state.usernameSize = static_cast<uint16_t>(username_.size());
+  state.extranonce1Size = static_cast<uint16_t>(subscribedExtraNone1_.size());
+  state.addressSize = static_cast<uint16_t>(address_.size());
+  state.protocol = static_cast<uint8_t>(protocol_);
+  state.extranonceSubscribed = extranonceSubscribed_;
+  state.slotCount = slotCount_;
+
+  std::string result(reinterpret_cast<const char*>(&header), sizeof(header));
+  result.append(reinterpret_cast<const char*>(&state), sizeof(state));
+  result += useragent_;
+  result += username_;
+  result += subscribedExtraNone1_;
+  result += address_;
+  return result;
+}
+
 void Client::handleReceived(char* data, std::size_t size)
 {
   using namespace std::placeholders;
 
+  // the timeout is evaluated lazily when the timer fires instead of re-arming it for every message
+  lastActivityTime_ = std::chrono::steady_clock::now();
+  util::AllocationAccounting::Scope accountingScope(util::AllocationAccounting::SUBSYSTEM_PROXY);
+
+  if (stratum::binary::isFrame(data, size))
+  {
+    stratum::binary::server::parseFrame(data, size,
+                                        std::bind(&Client::handleBinaryLogin, this, _1),
+                                        std::bind(&Client::handleBinaryShares, this, _1, _2),
+                                        std::bind(&Client::handleBinaryInvalidFrame, this));
+    return;
+  }
+
   net::jsonrpc::parse(
-    std::string(data, size),
+    data, size,
     [this](const std::string& id, const std::string& method, const std::string& params)
     {
+      util::AllocationAccounting::setMessageType(method);
 //      std::cout << "proxy::Client::handleReceived request, id, " << id << ", method, " << method
 //                << ", params, " << params << std::endl;
+      if (stratum::bitcoin::server::isBitcoinMethod(method))
+      {
+        stratum::bitcoin::server::parseRequest(id, method, params,
+                                               std::bind(&Client::handleSubscribe, this, _1, _2),
+                                               std::bind(&Client::handleAuthorize, this, _1, _2, _3),
+                                               std::bind(&Client::handleBitcoinSubmit, this, _1, _2, _3, _4, _5, _6),
+                                               std::bind(&Client::handleExtranonceSubscribe, this, _1),
+                                               std::bind(&Client::handleBitcoinUnknownMethod, this, _1));
+        return;
+      }
       stratum::server::parseRequest(id, method, params,
-                                    std::bind(&Client::handleLogin, this, _1, _2, _3, _4),
+                                    std::bind(&Client::handleLogin, this, _1, _2, _3, _4, _5),
                                     std::bind(&Client::handleGetJob, this, _1),
                                     std::bind(&Client::handleSubmit, this, _1, _2, _3, _4, _5),
                                     std::bind(&Client::handleKeepAliveD, this, _1, _2),
@@ -52,15 +421,42 @@ void Client::handleReceived(char* data, std::size_t size)
 
 void Client::handleError(const std::string& error)
 {
-  std::cout << __PRETTY_FUNCTION__ << std::endl;
+  std::cout << __PRETTY_FUNCTION__ << ", error, " << error << std::endl;
+  disconnect();
 }
 
-void Client::handleLogin(const std::string& jsonRequestId, const std::string& login, const std::string& pass, const std::string& agent)
+void Client::handleTimeout()
+{
+  std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+  std::chrono::steady_clock::time_point deadline = getDeadline();
+  if (now >= deadline)
+  {
+    std::cout << "proxy::Client::handleTimeout, " << (loggedIn_ ? "idle" : "login") << " timeout" << std::endl;
+    disconnect();
+  }
+  else if (timingWheel_)
+  {
+    timingWheel_->arm(timeoutTimer_, std::chrono::duration_cast<std::chrono::milliseconds>(deadline - now));
+  }
+}
+
+std::chrono::steady_clock::time_point Client::getDeadline() const
+{
+  if (!loggedIn_)
+  {
+    return connectedTime_ + LOGIN_TIMEOUT;
+  }
+  return lastActivityTime_ + (usesKeepAlive_ ? KEEPALIVE_TIMEOUT : IDLE_TIMEOUT);
+}
+
+void Client::handleLogin(const std::string& jsonRequestId, const std::string& login, const std::string& pass,
+                         const std::string& agent, const std::string& sessionId)
 {
   std::cout << __PRETTY_FUNCTION__ << std::endl
             << " login = " << login << std::endl
             << " pass = " << pass << std::endl
-            << " agent = " << agent << std::endl;
+            << " agent = " << agent << std::endl
+            << " session = " << sessionId << std::endl;
 
   if (login.empty())
   {
@@ -69,23 +465,32 @@ void Client::handleLogin(const std::string& jsonRequestId, const std::string& lo
   else
   {
     // TODO 'invalid address used for login'
+    username_ = login;
+    useragent_ = agent;
 
-    stratum::Job
-      job =
-      {"0100fce3a2d4053f5d3b6d35992eca02a91c0e9789633dbc97e82074d26ee7816323fb313c795f00000000ec114de588d63bce2dcfd18f04ea3664942350ad63a752387212adc57ade160805",
-       "9Zl7oF0WaLk1IRz577c2vhY5ebs5",
-       "26310800",
-       boost::uuids::to_string(rpcIdentifier_)};
-
-    std::string responseResult =
-      stratum::server::createLoginResponse(boost::uuids::to_string(rpcIdentifier_));
+    // a job assigned right away, or kept by a resumed session, goes out with the response, a later
+    // one as notification
+    if (!loggedIn_)
+    {
+      address_ = connection_->connectedIp();
+      bool resumed = resumeHandler_ && resumeHandler_(shared_from_this(), sessionId);
+      if (!resumed && loginHandler_)
+      {
+        loginHandler_(shared_from_this());
+      }
+    }
+    loggedIn_ = true;
 
-    std::string response = net::jsonrpc::response(jsonRequestId, responseResult, "");
+    std::optional<stratum::Job> job;
+    if (currentJob_.isValid())
+    {
+      job = currentJob_;
+    }
+    util::ArenaString response =
+      stratum::server::createLoginResponse(jsonRequestId, boost::uuids::to_string(rpcIdentifier_), job);
     std::cout << " response = " << response << std::endl;
 
     connection_->send(response);
-
-    connection_->send(net::jsonrpc::notification("job", stratum::server::createJobNotification(job)));
   }
 }
 
@@ -104,9 +509,18 @@ void Client::handleSubmit(const std::string& jsonRequestId,
             << " nonce = " << nonce << std::endl
             << " result = " << result << std::endl;
 
+  util::ShareTrace::stamp(util::ShareTrace::STAGE_SUBMIT);
+  ShareJournal::Record share = createShareRecord(jobIdentifier, parseNonce(nonce), currentJob_.getDifficulty());
   if (!identifier.empty() && rpcIdentifier_ != boost::lexical_cast<boost::uuids::uuid>(identifier))
   {
     sendErrorResponse(jsonRequestId, "Unauthenticated");
+    recordShare(share, ShareJournal::OUTCOME_INVALID);
+  }
+  else if (nonce.size() != 2 * sizeof(uint32_t) || !util::hex::isValid(nonce) ||
+           result.size() != 2 * 32 || !util::hex::isValid(result))
+  {
+    sendErrorResponse(jsonRequestId, "Malformed share");
+    recordShare(share, ShareJournal::OUTCOME_INVALID);
   }
   else
   {
@@ -130,7 +544,15 @@ void Client::handleSubmit(const std::string& jsonRequestId,
       //TODO block expired -> sendErrorResponse(jsonRequestId, "Block expired");
       //TODO low difficulty share -> sendErrorResponse(jsonRequestId, "Low difficulty share");
 
-      sendSuccessResponse(jsonRequestId, "OK");
+      if (shareVerifier_ && currentJob_.isValid() && currentJob_.getJobId() == jobIdentifier &&
+          shareVerifier_->sample(username_))
+      {
+        verifyShare(jsonRequestId, jobIdentifier, nonce, result, share);
+      }
+      else
+      {
+        acceptShare(jsonRequestId, jobIdentifier, nonce, result, share);
+      }
     }
   }
 }
@@ -138,6 +560,7 @@ void Client::handleSubmit(const std::string& jsonRequestId,
 void Client::handleKeepAliveD(const std::string& jsonRequestId, const std::string& identifier)
 {
   std::cout << __PRETTY_FUNCTION__ << ", identifier, " << identifier << std::endl;
+  usesKeepAlive_ = true;
   sendSuccessResponse(jsonRequestId, "KEEPALIVED");
 }
 
@@ -147,6 +570,275 @@ void Client::handleUnknownMethod(const std::string& jsonRequestId)
   sendErrorResponse(jsonRequestId, "invalid method");
 }
 
+void Client::handleSubscribe(const std::string& jsonRequestId, const std::string& agent)
+{
+  std::cout << __PRETTY_FUNCTION__ << ", agent, " << agent << std::endl;
+  protocol_ = stratum::PROTOCOL_BITCOIN;
+  useragent_ = agent;
+
+  if (bitcoinJobs_.front())
+  {
+    sendBitcoinResult(jsonRequestId,
+                      stratum::bitcoin::server::createSubscribeResult(boost::uuids::to_string(rpcIdentifier_),
+                                                                      subscribedExtraNone1_, extranonce2Size_));
+  }
+  else
+  {
+    // the extranonce1 is known once the pool manager assigned a slot with work
+    pendingSubscribeId_ = jsonRequestId;
+    if (loginHandler_)
+    {
+      loginHandler_(shared_from_this());
+    }
+  }
+}
+
+void Client::handleAuthorize(const std::string& jsonRequestId, const std::string& user, const std::string& pass)
+{
+  std::cout << __PRETTY_FUNCTION__ << ", user, " << user << std::endl;
+  if (user.empty())
+  {
+    sendBitcoinError(jsonRequestId, stratum::bitcoin::ERROR_UNAUTHORIZED_WORKER, "Unauthorized worker");
+    return;
+  }
+
+  protocol_ = stratum::PROTOCOL_BITCOIN;
+  username_ = user;
+  bool firstAuthorize = !loggedIn_;
+  loggedIn_ = true;
+  sendBitcoinResult(jsonRequestId, "true");
+
+  if (firstAuthorize && pendingSubscribeId_.empty() && bitcoinJobs_.front())
+  {
+    sendBitcoinJob(true);
+  }
+}
+
+void Client::handleBitcoinSubmit(const std::string& jsonRequestId, const std::string& worker,
+                                 const std::string& jobId, const std::string& extranonce2,
+                                 const std::string& time, const std::string& nonce)
+{
+  util::ShareTrace::stamp(util::ShareTrace::STAGE_SUBMIT);
+  // stratum v1 nonces are big endian hex
+  ShareJournal::Record share = createShareRecord(
+    jobId, static_cast<uint32_t>(std::strtoul(nonce.c_str(), nullptr, 16)),
+    bitcoinJobs_.front() ? bitcoinJobs_.front()->getDifficulty() : 0.0);
+  if (subscribedExtraNone1_.empty())
+  {
+    sendBitcoinError(jsonRequestId, stratum::bitcoin::ERROR_NOT_SUBSCRIBED, "Not subscribed");
+    recordShare(share, ShareJournal::OUTCOME_INVALID);
+    return;
+  }
+  if (!loggedIn_)
+  {
+    sendBitcoinError(jsonRequestId, stratum::bitcoin::ERROR_UNAUTHORIZED_WORKER, "Unauthorized worker");
+    recordShare(share, ShareJournal::OUTCOME_INVALID);
+    return;
+  }
+
+  auto job = std::find_if(bitcoinJobs_.begin(), bitcoinJobs_.end(),
+                          [&jobId](const stratum::BitcoinJob::Ptr& job) { return job && job->getJobId() == jobId; });
+  if (job == bitcoinJobs_.end())
+  {
+    sendBitcoinError(jsonRequestId, stratum::bitcoin::ERROR_JOB_NOT_FOUND, "Job not found");
+    recordShare(share, ShareJournal::OUTCOME_STALE);
+    return;
+  }
+
+  share.difficulty = (*job)->getDifficulty();
+  util::Sha256::Hash hash;
+  if (extranonce2.size() != 2 * extranonce2Size_ ||
+      !(*job)->hashHeader(subscribedExtraNone1_, extranonce2, time, nonce, hash))
+  {
+    sendBitcoinError(jsonRequestId, stratum::bitcoin::ERROR_OTHER, "Malformed share");
+    recordShare(share, ShareJournal::OUTCOME_INVALID);
+  }
+  else if (stratum::BitcoinJob::getHashDifficulty(hash) < (*job)->getDifficulty())
+  {
+    sendBitcoinError(jsonRequestId, stratum::bitcoin::ERROR_LOW_DIFFICULTY_SHARE, "Low difficulty share");
+    recordShare(share, ShareJournal::OUTCOME_LOW_DIFFICULTY);
+  }
+  else
+  {
+    sendBitcoinResult(jsonRequestId, "true");
+    util::ShareTrace::stamp(util::ShareTrace::STAGE_REPLY);
+    if (bitcoinShareHandler_)
+    {
+      // the pool session's extranonce2 starts with the slot byte that ends the miner's extranonce1
+      bitcoinShareHandler_(shared_from_this(), jobId,
+                           subscribedExtraNone1_.substr((*job)->getExtranonce1().size()) + extranonce2, time,
+                           nonce, share);
+    }
+  }
+}
+
+void Client::handleExtranonceSubscribe(const std::string& jsonRequestId)
+{
+  std::cout << __PRETTY_FUNCTION__ << std::endl;
+  extranonceSubscribed_ = true;
+  sendBitcoinResult(jsonRequestId, "true");
+}
+
+void Client::handleBitcoinUnknownMethod(const std::string& jsonRequestId)
+{
+  std::cout << __PRETTY_FUNCTION__ << std::endl;
+  sendBitcoinError(jsonRequestId, stratum::bitcoin::ERROR_OTHER, "Unsupported method");
+}
+
+void Client::handleBinaryLogin(const stratum::binary::LoginRecord& login)
+{
+  util::AllocationAccounting::setMessageType("binary.login");
+  std::cout << __PRETTY_FUNCTION__ << ", user, " << login.user << ", slots, " << login.slotCount << std::endl;
+  if (login.user[0] == 0 || login.slotCount == 0)
+  {
+    connection_->send(stratum::binary::server::createLoginResult(false, "missing login"));
+    return;
+  }
+
+  protocol_ = stratum::PROTOCOL_BINARY;
+  username_ = login.user;
+  useragent_ = login.agent;
+  // an aligned power of two of slots, leaving room for others in the session
+  slotCount_ = 1;
+  while (slotCount_ * 2 <= std::min<uint16_t>(login.slotCount, BINARY_SLOT_COUNT_MAX))
+  {
+    slotCount_ *= 2;
+  }
+  connection_->send(stratum::binary::server::createLoginResult(true, "OK"));
+
+  if (!loggedIn_)
+  {
+    loggedIn_ = true;
+    if (loginHandler_)
+    {
+      loginHandler_(shared_from_this());
+    }
+  }
+}
+
+void Client::handleBinaryShares(const stratum::binary::ShareRecord* shares, std::size_t count)
+{
+  util::AllocationAccounting::setMessageType("binary.shares");
+  // the results are replied to after all shares were passed on
+  util::ShareTrace::stamp(util::ShareTrace::STAGE_SUBMIT);
+  std::vector<stratum::binary::ShareResultRecord> results(count);
+  for (std::size_t i = 0; i < count; ++i)
+  {
+    const stratum::binary::ShareRecord& share = shares[i];
+    results[i].sequence = share.sequence;
+    results[i].accepted = 0;
+    std::memset(results[i].reserved, 0, sizeof(results[i].reserved));
+
+    const stratum::Job* job = nullptr;
+    if (share.jobSequence == currentJobSequence_ && currentJob_.isValid())
+    {
+      job = &currentJob_;
+    }
+    else if (share.jobSequence + 1 == currentJobSequence_ && previousJob_.isValid())
+    {
+      job = &previousJob_;
+    }
+    if (!loggedIn_ || !job)
+    {
+      recordShare(createShareRecord(std::to_string(share.jobSequence), share.nonce, 0.0),
+                   ShareJournal::OUTCOME_STALE);
+      continue;
+    }
+
+    // the nonce has to be within the slots handed to the proxy
+    ShareJournal::Record record = createShareRecord(std::string(job->getJobId()), share.nonce, job->getDifficulty());
+    uint32_t slot = share.nonce >> 24;
+    uint32_t firstSlot = job->getNonce() >> 24;
+    if (slot < firstSlot || slot >= firstSlot + slotCount_)
+    {
+      recordShare(record, ShareJournal::OUTCOME_INVALID);
+      continue;
+    }
+
+    results[i].accepted = 1;
+    if (shareHandler_)
+    {
+      shareHandler_(shared_from_this(), std::string(job->getJobId()),
+                    util::hex::encode(reinterpret_cast<const uint8_t*>(&share.nonce), sizeof(share.nonce)),
+                    util::hex::encode(share.result, sizeof(share.result)), record);
+    }
+  }
+  connection_->send(stratum::binary::server::createShareResults(results));
+}
+
+void Client::handleBinaryInvalidFrame()
+{
+  std::cout << __PRETTY_FUNCTION__ << std::endl;
+  disconnect();
+}
+
+ShareJournal::Record Client::createShareRecord(const std::string& jobId, uint32_t nonce, double difficulty) const
+{
+  return ShareJournal::createRecord(rpcIdentifier_.data, username_, jobId, nonce, difficulty);
+}
+
+void Client::recordShare(const ShareJournal::Record& share, ShareJournal::Outcome outcome)
+{
+  if (shareJournal_)
+  {
+    shareJournal_->append(share, outcome);
+  }
+  if (workerStatistics_)
+  {
+    workerStatistics_->record(share, outcome);
+  }
+}
+
+void Client::acceptShare(const std::string& jsonRequestId, const std::string& jobIdentifier, const std::string& nonce,
+                         const std::string& result, const ShareJournal::Record& share)
+{
+  sendSuccessResponse(jsonRequestId, "OK");
+  util::ShareTrace::stamp(util::ShareTrace::STAGE_REPLY);
+  if (!currentJob_.isValid())
+  {
+    recordShare(share, ShareJournal::OUTCOME_STALE);
+  }
+  else if (shareHandler_)
+  {
+    shareHandler_(shared_from_this(), jobIdentifier, nonce, result, share);
+  }
+}
+
+void Client::verifyShare(const std::string& jsonRequestId, const std::string& jobIdentifier, const std::string& nonce,
+                         const std::string& result, const ShareJournal::Record& share)
+{
+  // the miner waits for the reply until the verdict is in, a share the verifier has no room for
+  // is accepted unverified
+  uint8_t resultHash[32];
+  util::hex::decode(result, resultHash);
+  std::weak_ptr<Client> weakSelf = shared_from_this();
+  util::ShareTrace::Record trace = util::ShareTrace::current();
+  bool verifying = shareVerifier_->verify(
+    username_, currentJob_, parseNonce(nonce), resultHash,
+    [weakSelf, jsonRequestId, jobIdentifier, nonce, result, share, trace](bool valid)
+    {
+      Client::Ptr self = weakSelf.lock();
+      if (!self || !self->connection_)
+      {
+        return;
+      }
+      util::ShareTrace::resume(trace);
+      if (valid)
+      {
+        self->acceptShare(jsonRequestId, jobIdentifier, nonce, result, share);
+      }
+      else
+      {
+        self->sendErrorResponse(jsonRequestId, "Invalid result");
+        self->recordShare(share, ShareJournal::OUTCOME_INVALID);
+      }
+    });
+  if (!verifying)
+  {
+    acceptShare(jsonRequestId, jobIdentifier, nonce, result, share);
+  }
+}
+
 void Client::sendSuccessResponse(const std::string& jsonRequestId, const std::string& status)
 {
   connection_->send(net::jsonrpc::statusResponse(jsonRequestId, status));
@@ -157,5 +849,29 @@ void Client::sendErrorResponse(const std::string& jsonRequestId, const std::stri
   connection_->send(net::jsonrpc::errorResponse(jsonRequestId, -1, message));
 }
 
+void Client::sendBitcoinResult(const std::string& jsonRequestId, const std::string& result)
+{
+  connection_->send(net::jsonrpc::responseV1(jsonRequestId, result, ""));
+}
+
+void Client::sendBitcoinError(const std::string& jsonRequestId, int code, const std::string& message)
+{
+  connection_->send(net::jsonrpc::responseV1(jsonRequestId, "", stratum::bitcoin::server::createError(code, message)));
+}
+
+void Client::sendBitcoinJob(bool cleanJobs)
+{
+  const stratum::BitcoinJob::Ptr& job = bitcoinJobs_.front();
+  if (job->getDifficulty() != sentDifficulty_)
+  {
+    sentDifficulty_ = job->getDifficulty();
+    connection_->send(
+      net::jsonrpc::notificationV1("mining.set_difficulty",
+                                   stratum::bitcoin::server::createSetDifficultyParams(sentDifficulty_)));
+  }
+  connection_->sendLatest(
+    net::jsonrpc::notificationV1("mining.notify", stratum::bitcoin::server::createNotifyParams(*job, cleanJobs)));
+}
+
 } // namespace proxy
 } // namespace ses
\ No newline at end of file
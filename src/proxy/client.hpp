@@ -5,37 +5,117 @@
 #ifndef SES_PROXY_CLIENT_HPP
 #define SES_PROXY_CLIENT_HPP
 
+#include <array>
+#include <chrono>
+#include <functional>
 #include <memory>
-#include <list>
-#include <map>
 #include <boost/uuid/uuid.hpp>
 
 #include "net/connection.hpp"
-#include "difficulty.hpp"
+#include "proxy/sharejournal.hpp"
+#include "proxy/shareverifier.hpp"
+#include "proxy/workerstatistics.hpp"
+#include "stratum/binary.hpp"
+#include "stratum/bitcoinjob.hpp"
+#include "stratum/job.hpp"
+#include "stratum/protocol.hpp"
+#include "util/timingwheel.hpp"
 
 namespace ses {
 namespace proxy {
 
-class MerkleBranches {};
-
 class Client : public net::ConnectionHandler,
                public std::enable_shared_from_this<Client>
 {
 public:
   typedef std::shared_ptr<Client> Ptr;
+  typedef std::function<void(const Client::Ptr& client)> DisconnectHandler;
+  typedef std::function<void(const Client::Ptr& client)> LoginHandler;
+  // true if the client was given back the session of a miner that lost its connection
+  typedef std::function<bool(const Client::Ptr& client, const std::string& sessionId)> ResumeHandler;
+  // share is the journal record of the share, to be completed with the pool's verdict
+  typedef std::function<void(const Client::Ptr& client, const std::string& jobId, const std::string& nonce,
+                             const std::string& result, const ShareJournal::Record& share)> ShareHandler;
+  // a verified stratum v1 share, extranonce2 already in the size of the pool session
+  typedef std::function<void(const Client::Ptr& client, const std::string& jobId, const std::string& extranonce2,
+                             const std::string& time, const std::string& nonce,
+                             const ShareJournal::Record& share)> BitcoinShareHandler;
+
+  // time to send the login, time to send anything while logged in, and once it has sent keepalived
+  static constexpr std::chrono::seconds LOGIN_TIMEOUT{30};
+  static constexpr std::chrono::seconds IDLE_TIMEOUT{600};
+  static constexpr std::chrono::seconds KEEPALIVE_TIMEOUT{180};
+  // stratum v1 jobs still accepted for shares until a clean job or another extranonce arrives
+  static const std::size_t BITCOIN_JOB_HISTORY = 4;
+  // nonce slots a proxy gets at most, half of a pool session
+  static const uint16_t BINARY_SLOT_COUNT_MAX = 128;
 
 public:
   Client(const boost::uuids::uuid& id);
 
+  // recreates a client from the state handed over by a predecessor process
+  static Ptr restore(const std::string& handOverState);
+
   void setConnection(const net::Connection::Ptr& connection);
+  const net::Connection::Ptr& getConnection() const;
+
+  // called once the client lost its connection or timed out
+  void setDisconnectHandler(const DisconnectHandler& disconnectHandler);
+
+  // called when the miner logged in and needs a job, stratum v1 miners already on subscribe
+  void setLoginHandler(const LoginHandler& loginHandler);
+
+  // asked before the login handler when a CryptoNote miner logs in
+  void setResumeHandler(const ResumeHandler& resumeHandler);
+
+  void setShareHandler(const ShareHandler& shareHandler);
+  void setBitcoinShareHandler(const BitcoinShareHandler& bitcoinShareHandler);
+  // journals the shares the client rejects itself
+  void setShareJournal(const ShareJournal::Ptr& shareJournal);
+  void setWorkerStatistics(const WorkerStatistics::Ptr& workerStatistics);
+  // recomputes the results of the CryptoNote shares it samples before they are replied to
+  void setShareVerifier(const ShareVerifier::Ptr& shareVerifier);
+
+  // sends the job to a logged in miner right away, otherwise along with the login response,
+  // proxies logged in with the binary protocol get slots getSlotCount() from the job's nonce on
+  void setJob(const stratum::Job& job);
+
+  // stratum v1 work, the miner's extranonce1 is the session's one followed by the slot byte,
+  // false when the miner cannot follow the job, the caller disconnects it once done with the session
+  bool setBitcoinJob(const stratum::BitcoinJob::Ptr& job, uint8_t slot);
+
+  // false for stratum v1 miners bound to their extranonce1 because they did not subscribe to changes
+  bool canSwitchSession() const;
+
+  // nonce slots the client needs, more than one for proxies
+  uint16_t getSlotCount() const;
+
+  // arms login, idle and keepalive timeouts on the timing wheel of the client's event loop
+  void startTimeouts(util::TimingWheel& timingWheel);
+
+  void disconnect();
+
+  // logged in CryptoNote miners can be parked once disconnected and resumed on a new connection
+  bool canResume() const;
+  // lets go of the lost connection, jobs keep being taken for the miner's return
+  void park();
+  // takes over identifier and jobs of the parked client, before the login is answered
+  void resume(const Client& parked);
+
+  const boost::uuids::uuid& getIdentifier() const;
+  const std::string& getUsername() const;
+  // the miner's IP as it logged in
+  const std::string& getAddress() const;
+  bool isLoggedIn() const;
+  std::string getHandOverState() const;
 
 private: // net::ConnectionHandler
   void handleReceived(char* data, std::size_t size) override;
   void handleError(const std::string& error) override;
 
 public:
-  void handleLogin(const std::string& jsonRequestId,
-                   const std::string& login, const std::string& pass, const std::string& agent);
+  void handleLogin(const std::string& jsonRequestId, const std::string& login, const std::string& pass,
+                   const std::string& agent, const std::string& sessionId);
   void handleGetJob(const std::string& jsonRequestId);
   void handleSubmit(const std::string& jsonRequestId,
                     const std::string& identifier, const std::string& jobIdentifier,
@@ -43,23 +123,73 @@ public:
   void handleKeepAliveD(const std::string& jsonRequestId, const std::string& identifier);
   void handleUnknownMethod(const std::string& jsonRequestId);
 
+  void handleSubscribe(const std::string& jsonRequestId, const std::string& agent);
+  void handleAuthorize(const std::string& jsonRequestId, const std::string& user, const std::string& pass);
+  void handleBitcoinSubmit(const std::string& jsonRequestId, const std::string& worker, const std::string& jobId,
+                           const std::string& extranonce2, const std::string& time, const std::string& nonce);
+  void handleExtranonceSubscribe(const std::string& jsonRequestId);
+  void handleBitcoinUnknownMethod(const std::string& jsonRequestId);
+
+  void handleBinaryLogin(const stratum::binary::LoginRecord& login);
+  void handleBinaryShares(const stratum::binary::ShareRecord* shares, std::size_t count);
+  void handleBinaryInvalidFrame();
+
 private:
+  void handleTimeout();
+  std::chrono::steady_clock::time_point getDeadline() const;
+
+  ShareJournal::Record createShareRecord(const std::string& jobId, uint32_t nonce, double difficulty) const;
+  void recordShare(const ShareJournal::Record& share, ShareJournal::Outcome outcome);
+  void acceptShare(const std::string& jsonRequestId, const std::string& jobIdentifier, const std::string& nonce,
+                   const std::string& result, const ShareJournal::Record& share);
+  void verifyShare(const std::string& jsonRequestId, const std::string& jobIdentifier, const std::string& nonce,
+                   const std::string& result, const ShareJournal::Record& share);
+
   void sendSuccessResponse(const std::string& jsonRequestId, const std::string& status);
   void sendErrorResponse(const std::string& jsonRequestId, const std::string& message);
+  void sendBitcoinResult(const std::string& jsonRequestId, const std::string& result);
+  void sendBitcoinError(const std::string& jsonRequestId, int code, const std::string& message);
+  void sendBitcoinJob(bool cleanJobs);
 
 private:
   net::Connection::Ptr connection_;
-  std::map<std::string, std::string> outstandingRequests_;
+  DisconnectHandler disconnectHandler_;
+  LoginHandler loginHandler_;
+  ResumeHandler resumeHandler_;
+  ShareHandler shareHandler_;
+  BitcoinShareHandler bitcoinShareHandler_;
+  ShareJournal::Ptr shareJournal_;
+  WorkerStatistics::Ptr workerStatistics_;
+  ShareVerifier::Ptr shareVerifier_;
+
+  util::TimingWheel* timingWheel_;
+  util::TimingWheel::Timer timeoutTimer_;
+  std::chrono::steady_clock::time_point connectedTime_;
+  std::chrono::steady_clock::time_point lastActivityTime_;
 
   boost::uuids::uuid rpcIdentifier_;
+  stratum::Job currentJob_;
+  // binary clients refer to jobs by sequence number, shares for the previous job are still accepted
+  stratum::Job previousJob_;
+
+  // stratum v1 work, newest first, unused entries are empty
+  std::array<stratum::BitcoinJob::Ptr, BITCOIN_JOB_HISTORY> bitcoinJobs_;
+  double sentDifficulty_;
 
+  // strings stay empty, and so without allocation, until the miner sends them
   std::string useragent_;
   std::string username_;
-  std::string password_;
-
+  std::string address_;
+  std::string pendingSubscribeId_;
   std::string subscribedExtraNone1_;
-  Difficulty suggestedDifficulty_;
-  std::string suggestedTarget_;
+
+  uint32_t currentJobSequence_;
+  uint16_t slotCount_;
+  uint8_t extranonce2Size_;
+  stratum::Protocol protocol_;
+  bool loggedIn_;
+  bool usesKeepAlive_;
+  bool extranonceSubscribed_;
 };
 
 } // namespace proxy
@@ -2,162 +2,742 @@
 // Created by ses on 18.02.18.
 //
 
+#include <algorithm>
+#include <cstdlib>
 #include <functional>
 #include <iostream>
+#include <utility>
+#include <boost/asio/co_spawn.hpp>
+#include <boost/asio/detached.hpp>
+#include <boost/asio/redirect_error.hpp>
+#include <boost/asio/use_awaitable.hpp>
 #include <boost/lexical_cast.hpp>
 
-#include "net/client/connection.hpp"
 #include "net/jsonrpc/jsonrpc.hpp"
+#include "util/allocationaccounting.hpp"
+#include "util/arena.hpp"
+#include "util/hex.hpp"
 #include "proxy/pool.hpp"
 
 namespace ses {
 namespace proxy {
 
+using boost::asio::use_awaitable;
+
+constexpr std::chrono::seconds Pool::CONNECT_TIMEOUT;
+constexpr std::chrono::seconds Pool::LOGIN_TIMEOUT;
+constexpr std::chrono::seconds Pool::GETJOB_TIMEOUT;
+constexpr std::chrono::seconds Pool::SUBMIT_TIMEOUT;
+constexpr std::chrono::seconds Pool::RECONNECT_DELAY;
+
+Pool::Pool()
+  : reconnectTimer_(net::client::getIoContext())
+{
+}
+
+void Pool::setJobHandler(const JobHandler& jobHandler)
+{
+  jobHandler_ = jobHandler;
+}
+
+void Pool::setErrorHandler(const ErrorHandler& errorHandler)
+{
+  errorHandler_ = errorHandler;
+}
+
+void Pool::setShareJournal(const ShareJournal::Ptr& shareJournal)
+{
+  shareJournal_ = shareJournal;
+}
+
+void Pool::setWorkerStatistics(const WorkerStatistics::Ptr& workerStatistics)
+{
+  workerStatistics_ = workerStatistics;
+}
+
 void Pool::connect(const std::string& host, uint16_t port, const std::string& user, const std::string& pass,
-             net::ConnectionType connectionType)
+             net::ConnectionType connectionType, stratum::Protocol protocol)
 {
   std::cout << __PRETTY_FUNCTION__ << std::endl;
-  connection_ = net::client::establishConnection(shared_from_this(), host, port, connectionType);
+  protocol_ = protocol;
+  user_ = user;
+  boost::asio::co_spawn(net::client::getIoContext(),
+                        run(shared_from_this(), host, port, pass, connectionType),
+                        boost::asio::detached);
+}
 
-  sendRequest(REQUEST_TYPE_LOGIN, stratum::client::createLoginRequest(user, pass, "ses-proxy"));
+void Pool::disconnect()
+{
+  Ptr self = shared_from_this();
+  boost::asio::post(net::client::getIoContext(),
+                    [self]()
+                    {
+                      self->stopped_ = true;
+                      self->reconnectTimer_.cancel();
+                      if (self->connection_)
+                      {
+                        self->connection_->disconnect();
+                      }
+                    });
 }
 
 void Pool::getJob()
 {
   std::cout << __PRETTY_FUNCTION__ << std::endl;
-  sendRequest(REQUEST_TYPE_GETJOB);
+  boost::asio::co_spawn(net::client::getIoContext(), requestJob(shared_from_this()), boost::asio::detached);
 }
 
-void Pool::submit(const std::string& nonce, const std::string& result)
+bool Pool::getCurrentJob(CurrentJob& currentJob) const
 {
-  std::cout << __PRETTY_FUNCTION__ << std::endl;
-  if (currentJob_)
-  {
-    sendRequest(REQUEST_TYPE_SUBMIT,
-                stratum::client::createSubmitRequest(clientIdentifier_, currentJob_->getJobId(), nonce, result));
-  }
+  return currentJob_.read(currentJob);
+}
+
+const RequestStatistics& Pool::getRequestStatistics() const
+{
+  return requestStatistics_;
+}
+
+bool Pool::isDegraded() const
+{
+  return degraded_.load(std::memory_order_relaxed);
+}
+
+void Pool::submit(const std::string& jobId, const std::string& nonce, const std::string& result,
+                  const ShareJournal::Record& share)
+{
+  boost::asio::co_spawn(net::client::getIoContext(),
+                        submitShare(shared_from_this(), jobId, nonce, result, share, util::ShareTrace::current()),
+                        boost::asio::detached);
+}
+
+void Pool::submit(const std::string& jobId, const std::string& extranonce2, const std::string& time,
+                  const std::string& nonce, const ShareJournal::Record& share)
+{
+  boost::asio::co_spawn(net::client::getIoContext(),
+                        submitBitcoinShare(shared_from_this(), jobId, extranonce2, time, nonce, share,
+                                           util::ShareTrace::current()),
+                        boost::asio::detached);
 }
 
 void Pool::handleReceived(char* data, std::size_t size)
 {
   std::cout << __PRETTY_FUNCTION__ << std::endl;
   using namespace std::placeholders;
+  util::AllocationAccounting::Scope accountingScope(util::AllocationAccounting::SUBSYSTEM_PROXY);
+
+  if (stratum::binary::isFrame(data, size))
+  {
+    stratum::binary::client::parseFrame(data, size,
+                                        std::bind(&Pool::handleBinaryLoginResult, this, _1, _2),
+                                        std::bind(&Pool::handleBinaryJob, this, _1, _2, _3),
+                                        std::bind(&Pool::handleBinaryShareResults, this, _1, _2));
+    return;
+  }
 
   net::jsonrpc::parse(
-    std::string(data, size),
+    data, size,
     [this](const std::string& id, const std::string& method, const std::string& params)
     {
+      util::AllocationAccounting::setMessageType(method);
       std::cout << "proxy::Pool::handleReceived request, id, " << id << ", method, " << method
                 << ", params, " << params << std::endl;
     },
     [this](const std::string& id, const std::string& result, const std::string& error)
     {
-      RequestIdentifier requestId = boost::lexical_cast<RequestIdentifier>(id);
-      if (outstandingRequests_.count(requestId) > 0)
+      util::AllocationAccounting::setMessageType("response");
+      try
       {
-        switch (outstandingRequests_[requestId])
-        {
-          case REQUEST_TYPE_LOGIN:
-            stratum::client::parseLoginResponse(result, error,
-                                                std::bind(&Pool::handleLoginSuccess, this, _1, _2),
-                                                std::bind(&Pool::handleLoginError, this, _1, _2));
-            break;
-
-          case REQUEST_TYPE_GETJOB:
-            stratum::client::parseGetJobResponse(result, error,
-                                                std::bind(&Pool::handleGetJobSuccess, this, _1),
-                                                std::bind(&Pool::handleGetJobError, this, _1, _2));
-            break;
-
-          case REQUEST_TYPE_SUBMIT:
-            stratum::client::parseSubmitResponse(result, error,
-                                                 std::bind(&Pool::handleSubmitSuccess, this, _1),
-                                                 std::bind(&Pool::handleSubmitError, this, _1, _2));
-            break;
-        }
-        outstandingRequests_.erase(requestId);
+        answer(boost::lexical_cast<RequestIdentifier>(id), result, error);
+      }
+      catch (const boost::bad_lexical_cast&)
+      {
+        std::cout << "proxy::Pool::handleReceived, unknown response id, " << id << std::endl;
       }
     },
     [this](const std::string& method, const std::string& params)
     {
-      stratum::client::parseNotification(method, params, std::bind(&Pool::handleNewJob, this, _1));
+      util::AllocationAccounting::setMessageType(method);
+      if (protocol_ == stratum::PROTOCOL_BITCOIN)
+      {
+        stratum::bitcoin::client::parseNotification(method, params,
+                                                    std::bind(&Pool::handleNotify, this, _1),
+                                                    std::bind(&Pool::handleSetDifficulty, this, _1),
+                                                    std::bind(&Pool::handleSubscribeSuccess, this, _1, _2));
+      }
+      else
+      {
+        stratum::client::parseNotification(method, params, std::bind(&Pool::handleNewJob, this, _1));
+      }
     });
 }
 
 void Pool::handleError(const std::string& error)
 {
-  std::cout << __PRETTY_FUNCTION__ << std::endl;
+  // the upstream connection reports errors by ending receive(), which serve() awaits
+  std::cout << __PRETTY_FUNCTION__ << ", error, " << error << std::endl;
 }
 
-void Pool::handleLoginSuccess(const std::string& id, const stratum::Job::Ptr& job)
+boost::asio::awaitable<void> Pool::run(Ptr self, std::string host, uint16_t port, std::string pass,
+                                       net::ConnectionType connectionType)
 {
-  std::cout << "proxy::Pool::handleLoginSuccess, id, " << id << std::endl;
+  while (!stopped_)
+  {
+    std::string error = co_await serve(host, port, pass, connectionType);
+    std::cout << "proxy::Pool::run, session ended, " << error << std::endl;
+
+    loggedIn_ = false;
+    abandonCalls();
+    std::unordered_map<uint32_t, ShareJournal::Record> unansweredShares;
+    unansweredShares.swap(journaledShares_);
+    for (auto& share : unansweredShares)
+    {
+      recordShare(share.second, ShareJournal::OUTCOME_UNANSWERED);
+    }
+    for (auto& trace : tracedShares_)
+    {
+      util::ShareTrace::finish(trace.second);
+    }
+    tracedShares_.clear();
+    pendingShares_.clear();
+    clientIdentifier_.clear();
+    extranonce1_.clear();
+    firstSlot_ = 0;
+    slotCount_ = NONCE_SLOTS;
+    notifyError(error);
+
+    if (!stopped_)
+    {
+      boost::system::error_code timerError;
+      reconnectTimer_.expires_after(RECONNECT_DELAY);
+      co_await reconnectTimer_.async_wait(boost::asio::redirect_error(use_awaitable, timerError));
+    }
+  }
+}
 
-  clientIdentifier_ = id;
-  if (job)
+boost::asio::awaitable<std::string> Pool::serve(std::string host, uint16_t port, std::string pass,
+                                                net::ConnectionType connectionType)
+{
+  net::client::UpstreamConnection::Ptr connection =
+    std::make_shared<net::client::UpstreamConnection>(shared_from_this(), connectionType);
+  connection_ = connection;
+  try
+  {
+    boost::asio::steady_timer deadline(net::client::getIoContext(), CONNECT_TIMEOUT);
+    deadline.async_wait(
+      [connection](const boost::system::error_code& error)
+      {
+        if (!error)
+        {
+          connection->disconnect();
+        }
+      });
+    co_await connection->connect(host, port);
+  }
+  catch (const boost::system::system_error& error)
+  {
+    co_return "Connecting to " + host + ":" + std::to_string(port) + " failed, " + error.code().message();
+  }
+  if (stopped_)
   {
-    currentJob_ = job;
-    currentJob_->setNonce(0x88000099);
+    connection->disconnect();
   }
+
+  // receiving runs alongside the login, which waits for the responses
+  std::shared_ptr<std::string> reason = std::make_shared<std::string>();
+  std::shared_ptr<boost::asio::steady_timer> ended =
+    std::make_shared<boost::asio::steady_timer>(net::client::getIoContext(),
+                                                boost::asio::steady_timer::time_point::max());
+  Ptr self = shared_from_this();
+  boost::asio::co_spawn(net::client::getIoContext(),
+                        [self, connection, reason, ended]() -> boost::asio::awaitable<void>
+                        {
+                          *reason = co_await connection->receive();
+                          // a login still waiting for its response would only wait for its deadline
+                          self->abandonCalls();
+                          ended->cancel();
+                        },
+                        boost::asio::detached);
+
+  loggedIn_ = co_await login(pass);
+  if (!loggedIn_)
+  {
+    connection->disconnect();
+  }
+
+  boost::system::error_code error;
+  co_await ended->async_wait(boost::asio::redirect_error(use_awaitable, error));
+  co_return loggedIn_ ? *reason : "Login failed, " + *reason;
 }
 
-void Pool::handleLoginError(int code, const std::string& message)
+boost::asio::awaitable<bool> Pool::login(std::string pass)
 {
-  std::cout << "proxy::Pool::handleLoginError, code, " << code << ", message, " << message<< std::endl;
+  if (protocol_ == stratum::PROTOCOL_BITCOIN)
+  {
+    bool subscribed = false;
+    CallPtr subscribe = co_await call("mining.subscribe", stratum::bitcoin::client::createSubscribeParams("ses-proxy"),
+                                      RequestStatistics::METHOD_LOGIN, LOGIN_TIMEOUT);
+    stratum::bitcoin::client::parseSubscribeResponse(
+      subscribe->result_, subscribe->error_,
+      [this, &subscribed](const std::string& extranonce1, std::size_t extranonce2Size)
+      {
+        handleSubscribeSuccess(extranonce1, extranonce2Size);
+        subscribed = true;
+      },
+      [](int code, const std::string& message)
+      {
+        std::cout << "proxy::Pool::login, subscribe failed, code, " << code << ", message, " << message << std::endl;
+      });
+    if (!subscribed)
+    {
+      co_return false;
+    }
+
+    bool authorized = false;
+    CallPtr authorize = co_await call("mining.authorize",
+                                      stratum::bitcoin::client::createAuthorizeParams(user_, pass),
+                                      RequestStatistics::METHOD_LOGIN, LOGIN_TIMEOUT);
+    stratum::bitcoin::client::parseAuthorizeResponse(
+      authorize->result_, authorize->error_,
+      [&authorized]()
+      {
+        authorized = true;
+      },
+      [](int code, const std::string& message)
+      {
+        std::cout << "proxy::Pool::login, authorize failed, code, " << code << ", message, " << message << std::endl;
+      });
+    co_return authorized;
+  }
+
+  if (protocol_ == stratum::PROTOCOL_BINARY)
+  {
+    RequestIdentifier id;
+    CallPtr call = createCall(id, RequestStatistics::METHOD_LOGIN);
+    binaryLoginCall_ = id;
+    {
+      util::ArenaScope arenaScope;
+      call->abandoned_ =
+        !connection_->send(stratum::binary::client::createLogin(user_, pass, "ses-proxy", BINARY_SLOT_COUNT));
+    }
+    CallPtr login = co_await await(id, LOGIN_TIMEOUT);
+    binaryLoginCall_ = 0;
+    if (!login->answered_ || !login->error_.empty())
+    {
+      std::cout << "proxy::Pool::login, failed, " << login->error_ << std::endl;
+      co_return false;
+    }
+    co_return true;
+  }
+
+  bool loggedIn = false;
+  CallPtr login = co_await call("login", stratum::client::createLoginRequest(user_, pass, "ses-proxy"),
+                                RequestStatistics::METHOD_LOGIN, LOGIN_TIMEOUT);
+  stratum::client::parseLoginResponse(
+    login->result_, login->error_,
+    [this, &loggedIn](const std::string& id, const stratum::Job::Ptr& job)
+    {
+      std::cout << "proxy::Pool::login, id, " << id << std::endl;
+      clientIdentifier_ = id;
+      loggedIn = true;
+      if (job)
+      {
+        notifyJob(job);
+      }
+    },
+    [](int code, const std::string& message)
+    {
+      std::cout << "proxy::Pool::login, failed, code, " << code << ", message, " << message << std::endl;
+    });
+  co_return loggedIn;
 }
 
-void Pool::handleGetJobSuccess(const stratum::Job::Ptr& job)
+boost::asio::awaitable<void> Pool::requestJob(Ptr self)
 {
-  std::cout << "proxy::Pool::handleGetJobSuccess" << std::endl;
+  if (!loggedIn_)
+  {
+    co_return;
+  }
+
+  net::client::UpstreamConnection::Ptr connection = connection_;
+  CallPtr getJob = co_await call("getjob", "", RequestStatistics::METHOD_GETJOB, GETJOB_TIMEOUT);
+  if (!getJob->answered_)
+  {
+    // a pool not answering in time is considered lost
+    std::cout << "proxy::Pool::requestJob, no response" << std::endl;
+    connection->disconnect();
+    co_return;
+  }
+  stratum::client::parseGetJobResponse(
+    getJob->result_, getJob->error_,
+    [this](const stratum::Job::Ptr& job)
+    {
+      notifyJob(job);
+    },
+    [](int code, const std::string& message)
+    {
+      std::cout << "proxy::Pool::requestJob, code, " << code << ", message, " << message << std::endl;
+    });
 }
 
-void Pool::handleGetJobError(int code, const std::string& message)
+boost::asio::awaitable<void> Pool::submitShare(Ptr self, std::string jobId, std::string nonce, std::string result,
+                                               ShareJournal::Record share, util::ShareTrace::Record trace)
 {
-  std::cout << "proxy::Pool::handleGetJobError, code, " << code << ", message, " << message << std::endl;
+  if (!loggedIn_)
+  {
+    recordShare(share, ShareJournal::OUTCOME_UNANSWERED);
+    util::ShareTrace::finish(trace);
+    co_return;
+  }
+  if (protocol_ != stratum::PROTOCOL_BINARY)
+  {
+    co_await awaitSubmit("submit", stratum::client::createSubmitRequest(clientIdentifier_, jobId, nonce, result),
+                         share, trace);
+    co_return;
+  }
+
+  // binary job ids are the upstream's job sequence numbers
+  stratum::binary::ShareRecord record;
+  record.jobSequence = static_cast<uint32_t>(std::strtoul(jobId.c_str(), nullptr, 10));
+  if (nonce.size() != 2 * sizeof(record.nonce) || result.size() != 2 * sizeof(record.result) ||
+      !util::hex::decode(nonce, reinterpret_cast<uint8_t*>(&record.nonce)) ||
+      !util::hex::decode(result, record.result))
+  {
+    recordShare(share, ShareJournal::OUTCOME_INVALID);
+    util::ShareTrace::finish(trace);
+    co_return;
+  }
+
+  record.sequence = nextShareSequence_++;
+  journaledShares_[record.sequence] = share;
+  if (trace.stamps[util::ShareTrace::STAGE_READ] != 0)
+  {
+    tracedShares_[record.sequence] = trace;
+  }
+  pendingShares_.push_back(record);
+  if (!sendingShares_)
+  {
+    co_await sendShares(self);
+  }
+}
+
+boost::asio::awaitable<void> Pool::submitBitcoinShare(Ptr self, std::string jobId, std::string extranonce2,
+                                                      std::string time, std::string nonce,
+                                                      ShareJournal::Record share, util::ShareTrace::Record trace)
+{
+  if (!loggedIn_)
+  {
+    recordShare(share, ShareJournal::OUTCOME_UNANSWERED);
+    util::ShareTrace::finish(trace);
+    co_return;
+  }
+  co_await awaitSubmit("mining.submit",
+                       stratum::bitcoin::client::createSubmitParams(user_, jobId, extranonce2, time, nonce), share,
+                       trace);
+}
+
+boost::asio::awaitable<void> Pool::awaitSubmit(std::string method, std::string params, ShareJournal::Record share,
+                                               util::ShareTrace::Record trace)
+{
+  util::ShareTrace::stamp(trace, util::ShareTrace::STAGE_UPSTREAM_SEND);
+  CallPtr submit = co_await call(method, params, RequestStatistics::METHOD_SUBMIT, SUBMIT_TIMEOUT);
+  if (!submit->answered_)
+  {
+    std::cout << "proxy::Pool::awaitSubmit, no response" << std::endl;
+    recordShare(share, ShareJournal::OUTCOME_UNANSWERED);
+    util::ShareTrace::finish(trace);
+    co_return;
+  }
+  util::ShareTrace::stamp(trace, util::ShareTrace::STAGE_POOL_RESPONSE);
+  util::ShareTrace::finish(trace);
+
+  bool accepted = false;
+  auto rejected = [](int code, const std::string& message)
+  {
+    std::cout << "proxy::Pool::awaitSubmit, rejected, code, " << code << ", message, " << message << std::endl;
+  };
+  if (protocol_ == stratum::PROTOCOL_BITCOIN)
+  {
+    stratum::bitcoin::client::parseSubmitResponse(submit->result_, submit->error_,
+                                                  [&accepted]() { accepted = true; }, rejected);
+  }
+  else
+  {
+    stratum::client::parseSubmitResponse(submit->result_, submit->error_,
+                                         [&accepted](const std::string& status) { accepted = true; }, rejected);
+  }
+  recordShare(share, accepted ? ShareJournal::OUTCOME_ACCEPTED : ShareJournal::OUTCOME_REJECTED);
+}
+
+boost::asio::awaitable<void> Pool::sendShares(Ptr self)
+{
+  // a batch at a time, so shares submitted while waiting for results are sent in one frame
+  sendingShares_ = true;
+  while (!pendingShares_.empty() && loggedIn_)
+  {
+    std::size_t count = std::min(pendingShares_.size(), stratum::binary::SHARES_PER_FRAME_MAX);
+    std::vector<stratum::binary::ShareRecord> batch(pendingShares_.begin(), pendingShares_.begin() + count);
+    pendingShares_.erase(pendingShares_.begin(), pendingShares_.begin() + count);
+
+    RequestIdentifier id;
+    for (const stratum::binary::ShareRecord& share : batch)
+    {
+      auto trace = tracedShares_.find(share.sequence);
+      if (trace != tracedShares_.end())
+      {
+        util::ShareTrace::stamp(trace->second, util::ShareTrace::STAGE_UPSTREAM_SEND);
+      }
+    }
+    CallPtr call = createCall(id, RequestStatistics::METHOD_SUBMIT);
+    shareBatchCall_ = id;
+    {
+      util::ArenaScope arenaScope;
+      call->abandoned_ = !connection_->send(stratum::binary::client::createShares(batch));
+    }
+    CallPtr results = co_await await(id, SUBMIT_TIMEOUT);
+    shareBatchCall_ = 0;
+    if (!results->answered_)
+    {
+      std::cout << "proxy::Pool::sendShares, no results" << std::endl;
+      for (const stratum::binary::ShareRecord& share : batch)
+      {
+        auto journaledShare = journaledShares_.find(share.sequence);
+        if (journaledShare != journaledShares_.end())
+        {
+          recordShare(journaledShare->second, ShareJournal::OUTCOME_UNANSWERED);
+          journaledShares_.erase(journaledShare);
+        }
+        auto trace = tracedShares_.find(share.sequence);
+        if (trace != tracedShares_.end())
+        {
+          util::ShareTrace::finish(trace->second);
+          tracedShares_.erase(trace);
+        }
+      }
+    }
+  }
+  sendingShares_ = false;
+}
+
+boost::asio::awaitable<Pool::CallPtr> Pool::call(std::string method, std::string params,
+                                                 RequestStatistics::Method statisticsMethod,
+                                                 std::chrono::seconds timeout)
+{
+  RequestIdentifier id;
+  CallPtr call = createCall(id, statisticsMethod);
+  {
+    util::ArenaScope arenaScope;
+    // a call that could not be sent is abandoned right away instead of running into its deadline
+    if (protocol_ == stratum::PROTOCOL_BITCOIN)
+    {
+      call->abandoned_ = !connection_->send(net::jsonrpc::requestV1(std::to_string(id), method, params));
+    }
+    else
+    {
+      call->abandoned_ = !connection_->send(net::jsonrpc::request(std::to_string(id), method, params));
+    }
+  }
+  co_return co_await await(id, timeout);
+}
+
+boost::asio::awaitable<Pool::CallPtr> Pool::await(RequestIdentifier id, std::chrono::seconds timeout)
+{
+  CallPtr call = calls_[id];
+  if (!call->answered_ && !call->abandoned_)
+  {
+    boost::system::error_code error;
+    call->timer_.expires_after(timeout);
+    co_await call->timer_.async_wait(boost::asio::redirect_error(use_awaitable, error));
+  }
+  calls_.erase(id);
+
+  if (call->answered_)
+  {
+    requestStatistics_.recordAnswered(call->method_, std::chrono::steady_clock::now() - call->sent_);
+    consecutiveTimeouts_ = 0;
+    if (degraded_.exchange(false, std::memory_order_relaxed))
+    {
+      std::cout << "proxy::Pool::await, pool recovered" << std::endl;
+    }
+  }
+  else if (!call->abandoned_)
+  {
+    requestStatistics_.recordTimeout(call->method_);
+    if (++consecutiveTimeouts_ == DEGRADED_TIMEOUTS)
+    {
+      std::cout << "proxy::Pool::await, pool degraded, timeouts in a row, " << consecutiveTimeouts_ << std::endl;
+      degraded_.store(true, std::memory_order_relaxed);
+      if (connection_)
+      {
+        connection_->disconnect();
+      }
+    }
+  }
+  co_return call;
 }
 
-void Pool::handleSubmitSuccess(const std::string& status)
+Pool::CallPtr Pool::createCall(RequestIdentifier& id, RequestStatistics::Method method)
 {
-  std::cout << "proxy::Pool::handleSubmitSuccess, status, " << status << std::endl;
+  id = nextRequestIdentifier_++;
+  CallPtr call = std::make_shared<Call>(net::client::getIoContext());
+  call->method_ = method;
+  call->sent_ = std::chrono::steady_clock::now();
+  calls_[id] = call;
+  return call;
+}
+
+void Pool::answer(RequestIdentifier id, const std::string& result, const std::string& error)
+{
+  auto call = calls_.find(id);
+  if (call == calls_.end())
+  {
+    // the deadline passed already
+    std::cout << "proxy::Pool::answer, late response, id, " << id << std::endl;
+    return;
+  }
+  call->second->answered_ = true;
+  call->second->result_ = result;
+  call->second->error_ = error;
+  call->second->timer_.cancel();
 }
 
-void Pool::handleSubmitError(int code, const std::string& message)
+void Pool::abandonCalls()
 {
-  std::cout << "proxy::Pool::handleSubmitError, code, " << code << ", message, " << message << std::endl;
+  for (auto& call : calls_)
+  {
+    call.second->abandoned_ = true;
+    call.second->timer_.cancel();
+  }
 }
 
 void Pool::handleNewJob(const stratum::Job::Ptr& job)
 {
   std::cout << "proxy::Pool::handleNewJob, job.jobId_, " << job->getJobId() << std::endl;
+  notifyJob(job);
 }
 
-void Pool::sendRequest(Pool::RequestType type, const std::string& params)
+void Pool::handleSubscribeSuccess(const std::string& extranonce1, std::size_t extranonce2Size)
 {
-  std::string method;
-  switch (type)
+  std::cout << "proxy::Pool::handleSubscribeSuccess, extranonce1, " << extranonce1 << ", extranonce2Size, "
+            << extranonce2Size << std::endl;
+  // a changed extranonce applies from the next notify on
+  extranonce1_ = extranonce1;
+  extranonce2Size_ = extranonce2Size;
+}
+
+void Pool::handleSetDifficulty(double difficulty)
+{
+  std::cout << "proxy::Pool::handleSetDifficulty, difficulty, " << difficulty << std::endl;
+  difficulty_ = difficulty;
+}
+
+void Pool::handleNotify(const stratum::BitcoinJob::Ptr& job)
+{
+  std::cout << "proxy::Pool::handleNotify, jobId, " << job->getJobId() << std::endl;
+  if (extranonce1_.empty())
   {
-    case REQUEST_TYPE_LOGIN:
-      method = "login";
-      break;
+    // work without subscription cannot be split among miners
+    return;
+  }
+  job->setExtranonce(extranonce1_, extranonce2Size_);
+  job->setDifficulty(difficulty_);
+  publishJob(CurrentJob{stratum::Job::Ptr(), job, 0, NONCE_SLOTS});
+}
 
-    case REQUEST_TYPE_GETJOB:
-      method = "getjob";
-      break;
+void Pool::handleBinaryLoginResult(bool accepted, const std::string& message)
+{
+  util::AllocationAccounting::setMessageType("binary.loginresult");
+  std::cout << "proxy::Pool::handleBinaryLoginResult, accepted, " << accepted << ", message, " << message
+            << std::endl;
+  if (binaryLoginCall_ != 0)
+  {
+    answer(binaryLoginCall_, "", accepted ? "" : message.empty() ? "rejected" : message);
+  }
+}
 
-    case REQUEST_TYPE_SUBMIT:
-      method = "submit";
-      break;
+void Pool::handleBinaryJob(const stratum::Job::Ptr& job, uint8_t firstSlot, uint16_t slotCount)
+{
+  util::AllocationAccounting::setMessageType("binary.job");
+  std::cout << "proxy::Pool::handleBinaryJob, sequence, " << job->getJobId() << ", slots, "
+            << static_cast<int>(firstSlot) << "+" << slotCount << std::endl;
+  firstSlot_ = firstSlot;
+  slotCount_ = slotCount;
+  notifyJob(job);
+}
 
-    default:
-      // unknown request type
-      return;
+void Pool::handleBinaryShareResults(const stratum::binary::ShareResultRecord* results, std::size_t count)
+{
+  util::AllocationAccounting::setMessageType("binary.results");
+  std::size_t accepted = 0;
+  for (std::size_t i = 0; i < count; ++i)
+  {
+    accepted += results[i].accepted;
   }
+  std::cout << "proxy::Pool::handleBinaryShareResults, accepted, " << accepted << ", rejected, "
+            << count - accepted << std::endl;
 
-  RequestIdentifier id = nextRequestIdentifier_;
-  ++nextRequestIdentifier_;
-  outstandingRequests_[id] = type;
-  connection_->send(net::jsonrpc::request(std::to_string(id), method, params));
+  for (std::size_t i = 0; i < count; ++i)
+  {
+    auto share = journaledShares_.find(results[i].sequence);
+    if (share != journaledShares_.end())
+    {
+      recordShare(share->second,
+                   results[i].accepted ? ShareJournal::OUTCOME_ACCEPTED : ShareJournal::OUTCOME_REJECTED);
+      journaledShares_.erase(share);
+    }
+    auto trace = tracedShares_.find(results[i].sequence);
+    if (trace != tracedShares_.end())
+    {
+      util::ShareTrace::stamp(trace->second, util::ShareTrace::STAGE_POOL_RESPONSE);
+      util::ShareTrace::finish(trace->second);
+      tracedShares_.erase(trace);
+    }
+  }
+  if (shareBatchCall_ != 0)
+  {
+    answer(shareBatchCall_, "", "");
+  }
+}
+
+void Pool::recordShare(const ShareJournal::Record& share, ShareJournal::Outcome outcome)
+{
+  if (shareJournal_)
+  {
+    shareJournal_->append(share, outcome);
+  }
+  if (workerStatistics_)
+  {
+    workerStatistics_->record(share, outcome);
+  }
+}
+
+void Pool::notifyJob(const stratum::Job::Ptr& job)
+{
+  if (!job->isValid())
+  {
+    // miners have no work until the pool sends a job that fits, see stratum::Job for the limits, an
+    // empty job id was missing or too long
+    std::cout << "proxy::Pool::notifyJob, invalid job, blob size, " << job->getBlobSize() << ", job id, "
+              << job->getJobId() << ", target, " << job->getTarget() << std::endl;
+  }
+  publishJob(CurrentJob{job, stratum::BitcoinJob::Ptr(), firstSlot_, slotCount_});
+}
+
+void Pool::publishJob(const CurrentJob& currentJob)
+{
+  currentJob_.publish(currentJob);
+  if (jobHandler_)
+  {
+    jobHandler_();
+  }
+}
+
+void Pool::notifyError(const std::string& error)
+{
+  if (errorHandler_)
+  {
+    errorHandler_(error);
+  }
 }
 
 } // namespace proxy
-} // namespace ses
\ No newline at end of file
+} // namespace ses
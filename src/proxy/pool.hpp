@@ -5,62 +5,212 @@
 #ifndef SES_PROXY_POOL_HPP
 #define SES_PROXY_POOL_HPP
 
+#include <atomic>
+#include <chrono>
+#include <functional>
 #include <memory>
 #include <unordered_map>
-#include "net/connection.hpp"
+#include <vector>
+#include <boost/asio/steady_timer.hpp>
+
+#include "net/client/connection.hpp"
+#include "proxy/requeststatistics.hpp"
+#include "proxy/sharejournal.hpp"
+#include "proxy/workerstatistics.hpp"
+#include "stratum/binary.hpp"
+#include "stratum/bitcoin.hpp"
+#include "stratum/protocol.hpp"
 #include "stratum/stratum.hpp"
+#include "util/epoch.hpp"
+#include "util/sharetrace.hpp"
 
 namespace ses {
 namespace proxy {
 
+/**
+ * A session with the upstream pool, run as a coroutine on the upstream thread shared by all pools.
+ *
+ * The session connects, logs in and then serves the connection until it is lost, and starts over
+ * after RECONNECT_DELAY until disconnect(). Every call to the pool awaits its response until a
+ * deadline; a missed login or job request ends the session, a share without response counts as
+ * unanswered. DEGRADED_TIMEOUTS missed deadlines in a row mark the pool degraded and end the
+ * session as well, so a stalled pool loses its miners within seconds. All state is only touched on
+ * the upstream thread, the public methods post to it.
+ */
 class Pool : public net::ConnectionHandler,
              public std::enable_shared_from_this<Pool>
 {
 public:
   typedef std::shared_ptr<Pool> Ptr;
+  // called once a new job was published, getCurrentJob() returns it or an even newer one
+  typedef std::function<void()> JobHandler;
+  typedef std::function<void(const std::string& error)> ErrorHandler;
+
+  // the session's latest job, never modified once published
+  struct CurrentJob
+  {
+    // one of them is set, depending on the protocol
+    stratum::Job::Ptr job_;
+    stratum::BitcoinJob::Ptr bitcoinJob_;
+    // the session may hand out the highest nonce bytes firstSlot_ to firstSlot_ + slotCount_ - 1
+    uint8_t firstSlot_;
+    uint16_t slotCount_;
+  };
+
+  static const uint16_t NONCE_SLOTS = 256;
+  // nonce slots a leaf proxy asks an upstream proxy for per session
+  static const uint16_t BINARY_SLOT_COUNT = 64;
+
+  static constexpr std::chrono::seconds CONNECT_TIMEOUT{10};
+  static constexpr std::chrono::seconds LOGIN_TIMEOUT{10};
+  static constexpr std::chrono::seconds GETJOB_TIMEOUT{10};
+  static constexpr std::chrono::seconds SUBMIT_TIMEOUT{10};
+  static constexpr std::chrono::seconds RECONNECT_DELAY{5};
+  static const unsigned DEGRADED_TIMEOUTS = 3;
 
 public:
+  Pool();
+
+  // all handlers are called on the upstream thread
+  void setJobHandler(const JobHandler& jobHandler);
+  // called whenever the session was lost, it reconnects on its own
+  void setErrorHandler(const ErrorHandler& errorHandler);
+  // journals forwarded shares once the pool answered them or the deadline passed
+  void setShareJournal(const ShareJournal::Ptr& shareJournal);
+  void setWorkerStatistics(const WorkerStatistics::Ptr& workerStatistics);
+
+  // starts the session, returns right away
   void connect(const std::string& host, uint16_t port, const std::string& user, const std::string& pass,
-               net::ConnectionType connectionType = net::CONNECTION_TYPE_AUTO);
+               net::ConnectionType connectionType = net::CONNECTION_TYPE_AUTO,
+               stratum::Protocol protocol = stratum::PROTOCOL_CRYPTONOTE);
+
+  // ends the session for good
+  void disconnect();
 
   void getJob();
 
-  void submit(const std::string& nonce, const std::string& result);
+  // wait-free and safe to call from any thread, false before the first job
+  bool getCurrentJob(CurrentJob& currentJob) const;
+
+  void submit(const std::string& jobId, const std::string& nonce, const std::string& result,
+              const ShareJournal::Record& share);
+  // stratum v1 share, extranonce2 in the size of this session
+  void submit(const std::string& jobId, const std::string& extranonce2, const std::string& time,
+              const std::string& nonce, const ShareJournal::Record& share);
+
+  // both safe to call from any thread
+  const RequestStatistics& getRequestStatistics() const;
+  // set from the last of DEGRADED_TIMEOUTS missed deadlines in a row until the next response
+  bool isDegraded() const;
 
 private: // net::ConnectionHandler
   void handleReceived(char* data, std::size_t size) override;
   void handleError(const std::string& error) override;
 
-public:
-  void handleLoginSuccess(const std::string& id, const stratum::Job::Ptr& job);
-  void handleLoginError(int code, const std::string& message);
-
-  void handleGetJobSuccess(const stratum::Job::Ptr& job);
-  void handleGetJobError(int code, const std::string& message);
-
-  void handleSubmitSuccess(const std::string& status);
-  void handleSubmitError(int code, const std::string& message);
-
-  void handleNewJob(const stratum::Job::Ptr& job);
-
 private:
   typedef uint32_t RequestIdentifier;
-  enum RequestType
+
+  // a request waiting for its response, the timer expires at the deadline unless the response cancels it
+  struct Call
   {
-    REQUEST_TYPE_LOGIN,
-    REQUEST_TYPE_GETJOB,
-    REQUEST_TYPE_SUBMIT
+    explicit Call(boost::asio::io_context& ioContext)
+      : timer_(ioContext)
+    {
+    }
+
+    boost::asio::steady_timer timer_;
+    RequestStatistics::Method method_ = RequestStatistics::METHOD_LOGIN;
+    std::chrono::steady_clock::time_point sent_;
+    bool answered_ = false;
+    // woken without response because the connection was lost, which is no timeout
+    bool abandoned_ = false;
+    std::string result_;
+    std::string error_;
   };
+  typedef std::shared_ptr<Call> CallPtr;
+
+  // the coroutines keep their pool alive through self
+  boost::asio::awaitable<void> run(Ptr self, std::string host, uint16_t port, std::string pass,
+                                   net::ConnectionType connectionType);
+  boost::asio::awaitable<std::string> serve(std::string host, uint16_t port, std::string pass,
+                                            net::ConnectionType connectionType);
+  boost::asio::awaitable<bool> login(std::string pass);
+  boost::asio::awaitable<void> requestJob(Ptr self);
+  // the trace is the one of the submitting thread, it is finished with the pool's response
+  boost::asio::awaitable<void> submitShare(Ptr self, std::string jobId, std::string nonce, std::string result,
+                                           ShareJournal::Record share, util::ShareTrace::Record trace);
+  boost::asio::awaitable<void> submitBitcoinShare(Ptr self, std::string jobId, std::string extranonce2,
+                                                  std::string time, std::string nonce, ShareJournal::Record share,
+                                                  util::ShareTrace::Record trace);
+  boost::asio::awaitable<void> awaitSubmit(std::string method, std::string params, ShareJournal::Record share,
+                                           util::ShareTrace::Record trace);
+  boost::asio::awaitable<void> sendShares(Ptr self);
+
+  // sends a JSON-RPC request and waits for its response until the deadline
+  boost::asio::awaitable<CallPtr> call(std::string method, std::string params,
+                                       RequestStatistics::Method statisticsMethod, std::chrono::seconds timeout);
+  // records the round trip or the timeout of the call
+  boost::asio::awaitable<CallPtr> await(RequestIdentifier id, std::chrono::seconds timeout);
+  // the call's round trip starts now
+  CallPtr createCall(RequestIdentifier& id, RequestStatistics::Method method);
+  void answer(RequestIdentifier id, const std::string& result, const std::string& error);
+  // wakes all waiting calls unanswered and abandoned
+  void abandonCalls();
 
-  void sendRequest(RequestType type, const std::string& params = "");
+  void handleNewJob(const stratum::Job::Ptr& job);
+  void handleSubscribeSuccess(const std::string& extranonce1, std::size_t extranonce2Size);
+  void handleSetDifficulty(double difficulty);
+  void handleNotify(const stratum::BitcoinJob::Ptr& job);
+  void handleBinaryLoginResult(bool accepted, const std::string& message);
+  void handleBinaryJob(const stratum::Job::Ptr& job, uint8_t firstSlot, uint16_t slotCount);
+  void handleBinaryShareResults(const stratum::binary::ShareResultRecord* results, std::size_t count);
+
+  void notifyJob(const stratum::Job::Ptr& job);
+  void publishJob(const CurrentJob& currentJob);
+  void notifyError(const std::string& error);
+  void recordShare(const ShareJournal::Record& share, ShareJournal::Outcome outcome);
 
 private:
-  net::Connection::Ptr connection_;
+  JobHandler jobHandler_;
+  ErrorHandler errorHandler_;
+  ShareJournal::Ptr shareJournal_;
+  WorkerStatistics::Ptr workerStatistics_;
+
+  net::client::UpstreamConnection::Ptr connection_;
+  stratum::Protocol protocol_ = stratum::PROTOCOL_CRYPTONOTE;
+  bool loggedIn_ = false;
+  bool stopped_ = false;
+  // the reconnect delay, cancelled by disconnect()
+  boost::asio::steady_timer reconnectTimer_;
+
   RequestIdentifier nextRequestIdentifier_ = 1;
-  std::unordered_map<RequestIdentifier, RequestType> outstandingRequests_;
+  std::unordered_map<RequestIdentifier, CallPtr> calls_;
+  RequestStatistics requestStatistics_;
+  unsigned consecutiveTimeouts_ = 0;
+  std::atomic<bool> degraded_{false};
+  // the binary protocol's login and share batch are awaited like the JSON-RPC calls
+  RequestIdentifier binaryLoginCall_ = 0;
+  RequestIdentifier shareBatchCall_ = 0;
 
   std::string clientIdentifier_;
-  stratum::Job::Ptr currentJob_;
+  // written on the upstream thread only
+  util::Published<CurrentJob> currentJob_;
+  uint8_t firstSlot_ = 0;
+  uint16_t slotCount_ = NONCE_SLOTS;
+
+  // binary shares wait while a batch is unacknowledged and go out together with its results
+  uint32_t nextShareSequence_ = 1;
+  bool sendingShares_ = false;
+  std::vector<stratum::binary::ShareRecord> pendingShares_;
+  // forwarded binary shares by share sequence
+  std::unordered_map<uint32_t, ShareJournal::Record> journaledShares_;
+  // the sampled ones among them
+  std::unordered_map<uint32_t, util::ShareTrace::Record> tracedShares_;
+
+  std::string user_;
+  std::string extranonce1_;
+  std::size_t extranonce2Size_ = 0;
+  double difficulty_ = 1.0;
 };
 
 } // namespace proxy
@@ -0,0 +1,612 @@
+#include <algorithm>
+#include <atomic>
+#include <iostream>
+
+#include "proxy/poolmanager.hpp"
+
+namespace ses {
+namespace proxy {
+
+namespace {
+// the highest nonce byte is fixed per miner, miners iterate the lower three bytes
+stratum::Job createSlotJob(const stratum::Job& job, uint8_t slot)
+{
+  stratum::Job slotJob = job;
+  slotJob.setNonce(static_cast<uint32_t>(slot) << 24);
+  return slotJob;
+}
+}
+
+constexpr double PoolManager::SCALE_UP_THRESHOLD;
+constexpr double PoolManager::SCALE_DOWN_THRESHOLD;
+
+PoolManager::PoolManager(const PoolConfiguration& configuration, const Dispatcher& dispatcher,
+                         util::TimingWheel& timingWheel)
+  : configuration_(configuration)
+  , dispatcher_(dispatcher)
+  , timingWheel_(timingWheel)
+  , nextSessionId_(1)
+{
+}
+
+PoolManager::~PoolManager()
+{
+  for (auto& session : sessions_)
+  {
+    session.pool_->disconnect();
+  }
+}
+
+void PoolManager::start()
+{
+  openSession();
+}
+
+void PoolManager::addClient(const Client::Ptr& client)
+{
+  if (assignments_.count(client) > 0 ||
+      std::find(waitingClients_.begin(), waitingClients_.end(), client) != waitingClients_.end())
+  {
+    return;
+  }
+
+  SessionIterator session = findFreeSession();
+  if (session != sessions_.end())
+  {
+    assign(client, session);
+  }
+  else
+  {
+    waitingClients_.push_back(client);
+  }
+  rebalance();
+}
+
+void PoolManager::removeClient(const Client::Ptr& client)
+{
+  auto assignment = assignments_.find(client);
+  if (assignment != assignments_.end())
+  {
+    unassign(client, assignment->second);
+  }
+  else
+  {
+    waitingClients_.remove(client);
+  }
+  rebalance();
+}
+
+void PoolManager::resumeClient(const Client::Ptr& parked, const Client::Ptr& client)
+{
+  auto assignment = assignments_.find(parked);
+  if (assignment != assignments_.end())
+  {
+    SessionIterator session = assignment->second;
+    uint8_t slot = session->clients_[parked];
+    session->clients_.erase(parked);
+    session->clients_[client] = slot;
+    assignments_.erase(assignment);
+    assignments_[client] = session;
+    return;
+  }
+
+  auto waiting = std::find(waitingClients_.begin(), waitingClients_.end(), parked);
+  if (waiting != waitingClients_.end())
+  {
+    *waiting = client;
+  }
+  else
+  {
+    addClient(client);
+  }
+}
+
+void PoolManager::setShareJournal(const ShareJournal::Ptr& shareJournal)
+{
+  shareJournal_ = shareJournal;
+}
+
+void PoolManager::setWorkerStatistics(const WorkerStatistics::Ptr& workerStatistics)
+{
+  workerStatistics_ = workerStatistics;
+}
+
+void PoolManager::submit(const Client::Ptr& client, const std::string& jobId, const std::string& nonce,
+                         const std::string& result, const ShareJournal::Record& share)
+{
+  auto assignment = assignments_.find(client);
+  if (assignment != assignments_.end())
+  {
+    ShareJournal::Record sessionShare = share;
+    sessionShare.sessionId = assignment->second->id_;
+    assignment->second->pool_->submit(jobId, nonce, result, sessionShare);
+  }
+  else
+  {
+    recordShare(share, ShareJournal::OUTCOME_UNANSWERED);
+  }
+}
+
+void PoolManager::submit(const Client::Ptr& client, const std::string& jobId, const std::string& extranonce2,
+                         const std::string& time, const std::string& nonce, const ShareJournal::Record& share)
+{
+  auto assignment = assignments_.find(client);
+  if (assignment != assignments_.end())
+  {
+    ShareJournal::Record sessionShare = share;
+    sessionShare.sessionId = assignment->second->id_;
+    assignment->second->pool_->submit(jobId, extranonce2, time, nonce, sessionShare);
+  }
+  else
+  {
+    recordShare(share, ShareJournal::OUTCOME_UNANSWERED);
+  }
+}
+
+std::size_t PoolManager::getSessionCount() const
+{
+  return sessions_.size();
+}
+
+void PoolManager::logStatistics() const
+{
+  for (const Session& session : sessions_)
+  {
+    const RequestStatistics& statistics = session.pool_->getRequestStatistics();
+    for (int method = 0; method < RequestStatistics::METHOD_COUNT; ++method)
+    {
+      RequestStatistics::Summary summary = statistics.collect(static_cast<RequestStatistics::Method>(method));
+      std::cout << "proxy::PoolManager::logStatistics, session, " << session.id_ << ", degraded, "
+                << session.pool_->isDegraded() << ", method, "
+                << RequestStatistics::toString(static_cast<RequestStatistics::Method>(method))
+                << ", answered, " << summary.answered << ", timeouts, " << summary.timeouts
+                << ", rtt us p50, " << summary.p50.count() << ", p90, " << summary.p90.count()
+                << ", p99, " << summary.p99.count() << std::endl;
+    }
+  }
+}
+
+void PoolManager::openSession()
+{
+  uint64_t sessionId = nextSessionId_++;
+  Pool::Ptr pool = std::make_shared<Pool>();
+  pool->setShareJournal(shareJournal_);
+  pool->setWorkerStatistics(workerStatistics_);
+  uint16_t slotCount =
+    configuration_.protocol_ == stratum::PROTOCOL_BINARY ? Pool::BINARY_SLOT_COUNT : NONCE_SLOTS;
+  sessions_.push_back(
+    Session{sessionId, pool, stratum::Job::Ptr(), stratum::BitcoinJob::Ptr(), {}, {}, false, 0, slotCount});
+  std::cout << "proxy::PoolManager::openSession, sessions, " << sessions_.size() << std::endl;
+
+  std::weak_ptr<PoolManager> weakSelf = shared_from_this();
+  Dispatcher dispatcher = dispatcher_;
+  // jobs published while a notification is pending are picked up by it, so a burst of jobs does
+  // not queue up on the event loop
+  std::shared_ptr<std::atomic<bool>> jobPending = std::make_shared<std::atomic<bool>>(false);
+  pool->setJobHandler(
+    [weakSelf, dispatcher, sessionId, jobPending]()
+    {
+      if (jobPending->exchange(true))
+      {
+        return;
+      }
+      dispatcher(
+        [weakSelf, sessionId, jobPending]()
+        {
+          jobPending->store(false);
+          PoolManager::Ptr self = weakSelf.lock();
+          if (self)
+          {
+            self->handleJob(sessionId);
+          }
+        });
+    });
+  pool->setErrorHandler(
+    [weakSelf, dispatcher, sessionId](const std::string& error)
+    {
+      dispatcher(
+        [weakSelf, sessionId, error]()
+        {
+          PoolManager::Ptr self = weakSelf.lock();
+          if (self)
+          {
+            self->handleError(sessionId, error);
+          }
+        });
+    });
+
+  pool->connect(configuration_.host_, configuration_.port_, configuration_.user_, configuration_.pass_,
+                configuration_.connectionType_, configuration_.protocol_);
+}
+
+void PoolManager::closeSession(SessionIterator session)
+{
+  session->pool_->disconnect();
+  sessions_.erase(session);
+  std::cout << "proxy::PoolManager::closeSession, sessions, " << sessions_.size() << std::endl;
+}
+
+PoolManager::SessionIterator PoolManager::findSession(uint64_t sessionId)
+{
+  return std::find_if(sessions_.begin(), sessions_.end(),
+                      [sessionId](const Session& session) { return session.id_ == sessionId; });
+}
+
+PoolManager::SessionIterator PoolManager::findFreeSession(uint16_t slotCount)
+{
+  // fills the fullest session first, so surplus sessions empty out
+  SessionIterator result = sessions_.end();
+  for (SessionIterator session = sessions_.begin(); session != sessions_.end(); ++session)
+  {
+    if (!session->draining_ && hasJob(*session) && findFreeSlots(*session, slotCount) < NONCE_SLOTS &&
+        (result == sessions_.end() || session->usedSlots_.count() > result->usedSlots_.count()))
+    {
+      result = session;
+    }
+  }
+  return result;
+}
+
+std::size_t PoolManager::findFreeSlots(const Session& session, uint16_t slotCount)
+{
+  for (std::size_t first = 0; first + slotCount <= NONCE_SLOTS; first += slotCount)
+  {
+    std::size_t slot = first;
+    while (slot < first + slotCount && !session.usedSlots_.test(slot))
+    {
+      ++slot;
+    }
+    if (slot == first + slotCount)
+    {
+      return first;
+    }
+  }
+  return NONCE_SLOTS;
+}
+
+void PoolManager::setSlotRange(SessionIterator session, uint8_t firstSlot, uint16_t slotCount)
+{
+  // the upstream proxy moved the session to other slots, its miners start over on the new ones
+  for (auto& client : session->clients_)
+  {
+    assignments_.erase(client.first);
+    waitingClients_.push_front(client.first);
+  }
+  session->clients_.clear();
+
+  session->firstSlot_ = firstSlot;
+  session->slotCount_ = slotCount;
+  session->usedSlots_.set();
+  for (std::size_t slot = firstSlot; slot < firstSlot + slotCount && slot < NONCE_SLOTS; ++slot)
+  {
+    session->usedSlots_.reset(slot);
+  }
+}
+
+std::size_t PoolManager::getUsedSlots() const
+{
+  std::size_t used = 0;
+  for (auto& assignment : assignments_)
+  {
+    used += assignment.first->getSlotCount();
+  }
+  for (auto& client : waitingClients_)
+  {
+    used += client->getSlotCount();
+  }
+  return used;
+}
+
+void PoolManager::handleJob(uint64_t sessionId)
+{
+  SessionIterator session = findSession(sessionId);
+  Pool::CurrentJob currentJob;
+  if (session == sessions_.end() || !session->pool_->getCurrentJob(currentJob))
+  {
+    return;
+  }
+
+  if (currentJob.bitcoinJob_)
+  {
+    handleBitcoinJob(session, currentJob.bitcoinJob_);
+  }
+  else if (currentJob.job_ != session->job_)
+  {
+    if (!session->job_ || session->firstSlot_ != currentJob.firstSlot_ ||
+        session->slotCount_ != currentJob.slotCount_)
+    {
+      setSlotRange(session, currentJob.firstSlot_, currentJob.slotCount_);
+    }
+    session->job_ = currentJob.job_;
+    startJob(session);
+  }
+}
+
+void PoolManager::handleBitcoinJob(SessionIterator session, const stratum::BitcoinJob::Ptr& job)
+{
+  if (job == session->bitcoinJob_)
+  {
+    return;
+  }
+  if (job->getExtranonce2Size() < 2)
+  {
+    // one extranonce2 byte goes to the slot, the miners need at least one of their own
+    std::cout << "proxy::PoolManager::handleBitcoinJob, extranonce2 too small to be shared" << std::endl;
+    std::list<Client::Ptr> boundClients = resetSession(session);
+    assignWaitingClients();
+    disconnectClients(boundClients);
+    return;
+  }
+  session->bitcoinJob_ = job;
+  startJob(session);
+}
+
+void PoolManager::startJob(SessionIterator session)
+{
+  // a new job is where miners can switch sessions without losing work, those staying get the job
+  std::list<Client::Ptr> unusableClients;
+  if (session->draining_)
+  {
+    moveClients(session);
+    unusableClients = sendJob(session);
+  }
+  else
+  {
+    unusableClients = sendJob(session);
+    moveClients(session);
+  }
+  assignWaitingClients();
+  rebalance();
+  disconnectClients(unusableClients);
+}
+
+void PoolManager::handleError(uint64_t sessionId, const std::string& error)
+{
+  SessionIterator session = findSession(sessionId);
+  if (session == sessions_.end())
+  {
+    return;
+  }
+
+  std::cout << "proxy::PoolManager::handleError, error, " << error << std::endl;
+  std::list<Client::Ptr> boundClients = resetSession(session);
+  if (session->draining_)
+  {
+    closeSession(session);
+  }
+  assignWaitingClients();
+  rebalance();
+  disconnectClients(boundClients);
+}
+
+std::list<Client::Ptr> PoolManager::resetSession(SessionIterator session)
+{
+  std::list<Client::Ptr> boundClients;
+  for (auto& client : session->clients_)
+  {
+    assignments_.erase(client.first);
+    if (client.first->canSwitchSession())
+    {
+      waitingClients_.push_front(client.first);
+    }
+    else
+    {
+      boundClients.push_back(client.first);
+    }
+  }
+  session->clients_.clear();
+  session->usedSlots_.reset();
+  session->job_.reset();
+  session->bitcoinJob_.reset();
+
+  // miners bound to the extranonce of the session cannot continue elsewhere
+  return boundClients;
+}
+
+void PoolManager::disconnectClients(const std::list<Client::Ptr>& clients)
+{
+  // each disconnect comes back through removeClient, which may close sessions
+  for (const Client::Ptr& client : clients)
+  {
+    client->disconnect();
+  }
+}
+
+void PoolManager::recordShare(const ShareJournal::Record& share, ShareJournal::Outcome outcome)
+{
+  if (shareJournal_)
+  {
+    shareJournal_->append(share, outcome);
+  }
+  if (workerStatistics_)
+  {
+    workerStatistics_->record(share, outcome);
+  }
+}
+
+std::list<Client::Ptr> PoolManager::sendJob(SessionIterator session)
+{
+  std::list<Client::Ptr> unusableClients;
+  for (auto& client : session->clients_)
+  {
+    if (!sendJob(client.first, session, client.second))
+    {
+      unusableClients.push_back(client.first);
+    }
+  }
+  return unusableClients;
+}
+
+bool PoolManager::sendJob(const Client::Ptr& client, SessionIterator session, uint8_t slot)
+{
+  if (session->bitcoinJob_)
+  {
+    return client->setBitcoinJob(session->bitcoinJob_, slot);
+  }
+  client->setJob(createSlotJob(*session->job_, slot));
+  return true;
+}
+
+bool PoolManager::hasJob(const Session& session)
+{
+  return session.job_ || session.bitcoinJob_;
+}
+
+Client::Ptr PoolManager::findMovableClient(const Session& session)
+{
+  for (auto& client : session.clients_)
+  {
+    if (client.first->canSwitchSession())
+    {
+      return client.first;
+    }
+  }
+  return Client::Ptr();
+}
+
+void PoolManager::assign(const Client::Ptr& client, SessionIterator session)
+{
+  std::size_t slot = findFreeSlots(*session, client->getSlotCount());
+  for (std::size_t used = slot; used < slot + client->getSlotCount(); ++used)
+  {
+    session->usedSlots_.set(used);
+  }
+  session->clients_[client] = static_cast<uint8_t>(slot);
+  assignments_[client] = session;
+
+  // a client that cannot follow the job is disconnected with the session's next one, not in the middle of a move
+  sendJob(client, session, static_cast<uint8_t>(slot));
+}
+
+void PoolManager::unassign(const Client::Ptr& client, SessionIterator session)
+{
+  auto assignment = session->clients_.find(client);
+  if (assignment != session->clients_.end())
+  {
+    for (std::size_t slot = assignment->second; slot < assignment->second + client->getSlotCount(); ++slot)
+    {
+      session->usedSlots_.reset(slot);
+    }
+    session->clients_.erase(assignment);
+  }
+  assignments_.erase(client);
+}
+
+void PoolManager::assignWaitingClients()
+{
+  for (auto client = waitingClients_.begin(); client != waitingClients_.end();)
+  {
+    SessionIterator session = findFreeSession((*client)->getSlotCount());
+    if (session == sessions_.end())
+    {
+      ++client;
+      continue;
+    }
+    assign(*client, session);
+    client = waitingClients_.erase(client);
+  }
+}
+
+void PoolManager::moveClients(SessionIterator session)
+{
+  if (session->draining_)
+  {
+    // the draining session's miners move on instead of starting its new job
+    for (Client::Ptr client = findMovableClient(*session); client; client = findMovableClient(*session))
+    {
+      SessionIterator target = findFreeSession(client->getSlotCount());
+      if (target == sessions_.end())
+      {
+        break;
+      }
+      unassign(client, session);
+      assign(client, target);
+    }
+  }
+  else
+  {
+    // miners of draining sessions start the new job of this one
+    for (SessionIterator draining = sessions_.begin(); draining != sessions_.end(); ++draining)
+    {
+      if (!draining->draining_)
+      {
+        continue;
+      }
+      for (Client::Ptr client = findMovableClient(*draining);
+           client && findFreeSlots(*session, client->getSlotCount()) < NONCE_SLOTS;
+           client = findMovableClient(*draining))
+      {
+        unassign(client, draining);
+        assign(client, session);
+      }
+    }
+  }
+}
+
+void PoolManager::rebalance()
+{
+  std::size_t used = getUsedSlots();
+  std::size_t capacity = 0;
+  std::size_t activeSessions = 0;
+  bool draining = false;
+  for (auto& session : sessions_)
+  {
+    if (session.draining_)
+    {
+      draining = true;
+    }
+    else
+    {
+      capacity += session.slotCount_;
+      ++activeSessions;
+    }
+  }
+
+  if (used > capacity * SCALE_UP_THRESHOLD)
+  {
+    // a draining session is still logged in and quicker to reuse than a new one
+    auto session = std::find_if(sessions_.begin(), sessions_.end(),
+                                [](const Session& session) { return session.draining_; });
+    if (session != sessions_.end())
+    {
+      session->draining_ = false;
+      assignWaitingClients();
+    }
+    else
+    {
+      openSession();
+    }
+  }
+  else if (!draining && activeSessions > 1 &&
+           used <= (capacity - capacity / activeSessions) * SCALE_DOWN_THRESHOLD)
+  {
+    // sessions still logging in are left alone, they are about to become usable
+    SessionIterator leastUsed = sessions_.end();
+    for (SessionIterator session = sessions_.begin(); session != sessions_.end(); ++session)
+    {
+      if (hasJob(*session) &&
+          (leastUsed == sessions_.end() || session->usedSlots_.count() < leastUsed->usedSlots_.count()))
+      {
+        leastUsed = session;
+      }
+    }
+    if (leastUsed != sessions_.end())
+    {
+      std::cout << "proxy::PoolManager::rebalance, draining session with clients, "
+                << leastUsed->clients_.size() << std::endl;
+      leastUsed->draining_ = true;
+    }
+  }
+
+  for (SessionIterator session = sessions_.begin(); session != sessions_.end();)
+  {
+    SessionIterator current = session++;
+    if (current->draining_ && current->clients_.empty())
+    {
+      closeSession(current);
+    }
+  }
+}
+
+} // namespace proxy
+} // namespace ses
@@ -0,0 +1,148 @@
+#ifndef SES_PROXY_POOLMANAGER_HPP
+#define SES_PROXY_POOLMANAGER_HPP
+
+#include <bitset>
+#include <chrono>
+#include <functional>
+#include <list>
+#include <map>
+#include <memory>
+
+#include "net/connectiontype.hpp"
+#include "proxy/client.hpp"
+#include "proxy/pool.hpp"
+#include "stratum/protocol.hpp"
+#include "util/timingwheel.hpp"
+
+namespace ses {
+namespace proxy {
+
+struct PoolConfiguration
+{
+  std::string host_;
+  uint16_t port_;
+  std::string user_;
+  std::string pass_;
+  net::ConnectionType connectionType_;
+  stratum::Protocol protocol_;
+};
+
+/**
+ * Serves miners with as few logged in pool sessions as possible. Each session has NONCE_SLOTS
+ * values of the highest nonce byte to hand out, one per miner and an aligned block of them per proxy
+ * logged in with the binary protocol. Sessions to such an upstream proxy only have the slots it
+ * granted. For stratum v1 pools the slot is the first byte of the session's extranonce2, which the
+ * miner gets appended to its extranonce1. Another session is opened in advance once the used slots
+ * of all sessions pass SCALE_UP_THRESHOLD. Surplus sessions are drained by moving their miners to
+ * other sessions at job boundaries and closed once empty. Stratum v1 miners only move if they
+ * subscribed to extranonce changes.
+ *
+ * A session whose pool connection is lost stays open and reconnects on its own, its miners wait
+ * for the next job of any session meanwhile.
+ *
+ * All state lives on the event loop of the dispatcher, pool events are dispatched to it. Jobs are
+ * not carried by these events, they are read from the snapshot the pool published.
+ */
+class PoolManager : public std::enable_shared_from_this<PoolManager>
+{
+public:
+  typedef std::shared_ptr<PoolManager> Ptr;
+  typedef std::function<void(const std::function<void()>&)> Dispatcher;
+
+  static const std::size_t NONCE_SLOTS = Pool::NONCE_SLOTS;
+  static constexpr double SCALE_UP_THRESHOLD = 0.75;
+  // a session is drained if the others would be used at most this much without it
+  static constexpr double SCALE_DOWN_THRESHOLD = 0.5;
+
+public:
+  PoolManager(const PoolConfiguration& configuration, const Dispatcher& dispatcher,
+              util::TimingWheel& timingWheel);
+  ~PoolManager();
+
+  void start();
+
+  // pools of later sessions journal the shares they forward
+  void setShareJournal(const ShareJournal::Ptr& shareJournal);
+  void setWorkerStatistics(const WorkerStatistics::Ptr& workerStatistics);
+
+  void addClient(const Client::Ptr& client);
+  void removeClient(const Client::Ptr& client);
+  // the client takes the place of the parked one, keeping its session and slot
+  void resumeClient(const Client::Ptr& parked, const Client::Ptr& client);
+
+  // forwards a share to the client's session
+  void submit(const Client::Ptr& client, const std::string& jobId, const std::string& nonce,
+              const std::string& result, const ShareJournal::Record& share);
+  // forwards a verified stratum v1 share to the client's session
+  void submit(const Client::Ptr& client, const std::string& jobId, const std::string& extranonce2,
+              const std::string& time, const std::string& nonce, const ShareJournal::Record& share);
+
+  std::size_t getSessionCount() const;
+  // round trips and timeouts of each session's upstream requests
+  void logStatistics() const;
+
+private:
+  struct Session
+  {
+    uint64_t id_;
+    Pool::Ptr pool_;
+    stratum::Job::Ptr job_;
+    stratum::BitcoinJob::Ptr bitcoinJob_;
+    std::bitset<NONCE_SLOTS> usedSlots_;
+    std::map<Client::Ptr, uint8_t> clients_;
+    bool draining_;
+    // the slots the session may hand out, the others are marked used
+    uint8_t firstSlot_;
+    uint16_t slotCount_;
+  };
+  typedef std::list<Session>::iterator SessionIterator;
+
+  void openSession();
+  void closeSession(SessionIterator session);
+  SessionIterator findSession(uint64_t sessionId);
+  SessionIterator findFreeSession(uint16_t slotCount = 1);
+  // the first of slotCount aligned free slots, NONCE_SLOTS if there are none
+  static std::size_t findFreeSlots(const Session& session, uint16_t slotCount);
+  void setSlotRange(SessionIterator session, uint8_t firstSlot, uint16_t slotCount);
+  std::size_t getUsedSlots() const;
+
+  // picks up the job the session's pool published last
+  void handleJob(uint64_t sessionId);
+  void handleBitcoinJob(SessionIterator session, const stratum::BitcoinJob::Ptr& job);
+  void startJob(SessionIterator session);
+  void handleError(uint64_t sessionId, const std::string& error);
+  // the session has no usable job until the next one, returns the clients bound to it, which the
+  // caller disconnects once done with the session, as that may close it
+  std::list<Client::Ptr> resetSession(SessionIterator session);
+  static void disconnectClients(const std::list<Client::Ptr>& clients);
+  void recordShare(const ShareJournal::Record& share, ShareJournal::Outcome outcome);
+
+  // both report the clients that cannot follow the job, to be disconnected once done with the session
+  std::list<Client::Ptr> sendJob(SessionIterator session);
+  bool sendJob(const Client::Ptr& client, SessionIterator session, uint8_t slot);
+  static bool hasJob(const Session& session);
+  static Client::Ptr findMovableClient(const Session& session);
+  void assign(const Client::Ptr& client, SessionIterator session);
+  void unassign(const Client::Ptr& client, SessionIterator session);
+  void assignWaitingClients();
+  void moveClients(SessionIterator session);
+  void rebalance();
+
+private:
+  PoolConfiguration configuration_;
+  Dispatcher dispatcher_;
+  util::TimingWheel& timingWheel_;
+  ShareJournal::Ptr shareJournal_;
+  WorkerStatistics::Ptr workerStatistics_;
+
+  uint64_t nextSessionId_;
+  std::list<Session> sessions_;
+  std::map<Client::Ptr, SessionIterator> assignments_;
+  // logged in miners without a slot, because no session had one left or none received a job yet
+  std::list<Client::Ptr> waitingClients_;
+};
+
+} // namespace proxy
+} // namespace ses
+
+#endif //SES_PROXY_POOLMANAGER_HPP
@@ -0,0 +1,97 @@
+#include <cmath>
+
+#include "proxy/requeststatistics.hpp"
+
+namespace ses {
+namespace proxy {
+
+namespace {
+// increments a counter only its owner thread writes, so no locked instruction is needed
+inline void increment(std::atomic<uint64_t>& counter)
+{
+  counter.store(counter.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+}
+}
+
+RequestStatistics::RequestStatistics()
+{
+  for (Counters& counters : counters_)
+  {
+    counters.timeouts.store(0, std::memory_order_relaxed);
+    for (auto& bucket : counters.buckets)
+    {
+      bucket.store(0, std::memory_order_relaxed);
+    }
+  }
+}
+
+void RequestStatistics::recordAnswered(Method method, std::chrono::steady_clock::duration roundTrip)
+{
+  increment(counters_[method].buckets[toBucket(roundTrip)]);
+}
+
+void RequestStatistics::recordTimeout(Method method)
+{
+  increment(counters_[method].timeouts);
+}
+
+RequestStatistics::Summary RequestStatistics::collect(Method method) const
+{
+  const Counters& counters = counters_[method];
+  uint64_t buckets[BUCKETS];
+  Summary summary{0, counters.timeouts.load(std::memory_order_relaxed), {}, {}, {}};
+  for (std::size_t bucket = 0; bucket < BUCKETS; ++bucket)
+  {
+    buckets[bucket] = counters.buckets[bucket].load(std::memory_order_relaxed);
+    summary.answered += buckets[bucket];
+  }
+
+  // the smallest bucket whose requests and those of all faster buckets reach the percentile's share
+  std::chrono::microseconds* percentiles[] = {&summary.p50, &summary.p90, &summary.p99};
+  const uint64_t shares[] = {50, 90, 99};
+  uint64_t counted = 0;
+  std::size_t percentile = 0;
+  for (std::size_t bucket = 0; bucket < BUCKETS && percentile < 3; ++bucket)
+  {
+    counted += buckets[bucket];
+    while (percentile < 3 && buckets[bucket] > 0 && counted * 100 >= summary.answered * shares[percentile])
+    {
+      *percentiles[percentile++] = toUpperBound(bucket);
+    }
+  }
+  return summary;
+}
+
+const char* RequestStatistics::toString(Method method)
+{
+  switch (method)
+  {
+    case METHOD_LOGIN:
+      return "login";
+    case METHOD_GETJOB:
+      return "getjob";
+    case METHOD_SUBMIT:
+      return "submit";
+    default:
+      return "unknown";
+  }
+}
+
+std::size_t RequestStatistics::toBucket(std::chrono::steady_clock::duration roundTrip)
+{
+  int64_t microseconds = std::chrono::duration_cast<std::chrono::microseconds>(roundTrip).count();
+  if (microseconds <= 1)
+  {
+    return 0;
+  }
+  std::size_t bucket = static_cast<std::size_t>(std::log2(static_cast<double>(microseconds)) * 4);
+  return bucket < BUCKETS ? bucket : BUCKETS - 1;
+}
+
+std::chrono::microseconds RequestStatistics::toUpperBound(std::size_t bucket)
+{
+  return std::chrono::microseconds(static_cast<int64_t>(std::ceil(std::exp2((bucket + 1) / 4.0))));
+}
+
+} // namespace proxy
+} // namespace ses
@@ -0,0 +1,71 @@
+#ifndef SES_PROXY_REQUESTSTATISTICS_HPP
+#define SES_PROXY_REQUESTSTATISTICS_HPP
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+
+namespace ses {
+namespace proxy {
+
+/**
+ * Round trip times and timeouts of the requests a pool session sends upstream, per method.
+ *
+ * Round trip times are counted in buckets growing by a quarter octave from one microsecond, so a
+ * percentile is known to within 19% of its value. Only the session's thread records, any thread
+ * may collect.
+ */
+class RequestStatistics
+{
+public:
+  typedef std::shared_ptr<RequestStatistics> Ptr;
+
+  enum Method
+  {
+    METHOD_LOGIN,
+    METHOD_GETJOB,
+    METHOD_SUBMIT,
+    METHOD_COUNT
+  };
+
+  struct Summary
+  {
+    uint64_t answered;
+    uint64_t timeouts;
+    // upper bounds of the buckets holding the percentiles, zero without answered requests
+    std::chrono::microseconds p50;
+    std::chrono::microseconds p90;
+    std::chrono::microseconds p99;
+  };
+
+  // 2^28 microseconds are about four and a half minutes, longer round trips go to the last bucket
+  static const std::size_t BUCKETS = 4 * 28;
+
+public:
+  RequestStatistics();
+
+  void recordAnswered(Method method, std::chrono::steady_clock::duration roundTrip);
+  void recordTimeout(Method method);
+
+  Summary collect(Method method) const;
+
+  static const char* toString(Method method);
+
+private:
+  static std::size_t toBucket(std::chrono::steady_clock::duration roundTrip);
+  static std::chrono::microseconds toUpperBound(std::size_t bucket);
+
+  struct Counters
+  {
+    std::atomic<uint64_t> timeouts;
+    std::atomic<uint64_t> buckets[BUCKETS];
+  };
+
+  Counters counters_[METHOD_COUNT];
+};
+
+} // namespace proxy
+} // namespace ses
+
+#endif //SES_PROXY_REQUESTSTATISTICS_HPP
@@ -1,14 +1,184 @@
+#include <future>
+#include <iostream>
+#include <boost/lexical_cast.hpp>
 #include <boost/uuid/random_generator.hpp>
+#include <boost/uuid/uuid_io.hpp>
 
+#include "net/handover.hpp"
 #include "proxy/server.hpp"
+#include "util/allocationaccounting.hpp"
 
 namespace ses {
 namespace proxy {
 
+namespace {
+const std::chrono::milliseconds TIMING_WHEEL_TICK(250);
+}
+
+constexpr std::chrono::seconds Server::STATISTICS_INTERVAL;
+constexpr std::chrono::seconds Server::SESSION_GRACE_PERIOD;
+constexpr std::chrono::seconds Server::HAND_OVER_FLUSH_TIMEOUT;
+
+Server::Server()
+  : timingWheel_(TIMING_WHEEL_TICK)
+  , statisticsTimer_(std::bind(&Server::logStatistics, this))
+  , workerStatistics_(std::make_shared<WorkerStatistics>())
+  , sessionGracePeriod_(SESSION_GRACE_PERIOD)
+  , resumedSessions_(0)
+{
+}
+
+void Server::setPool(const PoolConfiguration& poolConfiguration)
+{
+  poolConfiguration_ = poolConfiguration;
+}
+
+void Server::setShareJournal(const ShareJournal::Ptr& shareJournal)
+{
+  shareJournal_ = shareJournal;
+}
+
+void Server::setShareVerification(const ShareVerification& shareVerification)
+{
+  shareVerification_ = shareVerification;
+}
+
+void Server::setSessionGracePeriod(std::chrono::seconds sessionGracePeriod)
+{
+  sessionGracePeriod_ = sessionGracePeriod;
+}
+
+const WorkerStatistics::Ptr& Server::getWorkerStatistics() const
+{
+  return workerStatistics_;
+}
+
 void Server::start(const std::string& address, uint16_t port, net::ConnectionType type)
 {
-  Server::Ptr server = shared_from_this();
-  server_ = net::server::createServer(server, address, port, type);
+  startServer(net::server::createServer(shared_from_this(), address, port, type));
+}
+
+bool Server::takeOver(const std::string& handOverPath)
+{
+  int channel = net::handover::connect(handOverPath);
+  if (channel < 0)
+  {
+    return false;
+  }
+
+  net::handover::SocketType type;
+  int nativeHandle;
+  std::string state;
+  while (net::handover::receive(channel, type, nativeHandle, state))
+  {
+    Client::Ptr client = type == net::handover::SOCKET_TYPE_CONNECTION ? Client::restore(state) : Client::Ptr();
+    if (type == net::handover::SOCKET_TYPE_LISTENER && !server_)
+    {
+      startServer(net::server::createServer(shared_from_this(), nativeHandle, net::CONNECTION_TYPE_TCP));
+    }
+    else if (client && server_)
+    {
+      // connections start reading right away, so their client needs to be attached on the server thread
+      std::promise<void> adopted;
+      server_->dispatch(
+        [&]()
+        {
+          client->setConnection(server_->adoptConnection(nativeHandle));
+          addClient(client);
+          adopted.set_value();
+        });
+      adopted.get_future().wait();
+    }
+    else
+    {
+      // the miner reconnects instead of waiting on a socket nobody reads
+      std::cout << "proxy::Server::takeOver, closing socket not taken over, type, " << type
+                << ", state size, " << state.size() << std::endl;
+      net::handover::close(nativeHandle);
+    }
+  }
+  net::handover::close(channel);
+
+  std::cout << "proxy::Server::takeOver, clients, " << clients_.size() << std::endl;
+  return static_cast<bool>(server_);
+}
+
+void Server::handOver(int channel)
+{
+  if (server_)
+  {
+    // replies and jobs already sent are written before the socket goes, the successor knows nothing of them
+    std::shared_ptr<HandOver> handOver = std::make_shared<HandOver>();
+    handOver->channel_ = channel;
+    std::future<void> handedOver = handOver->handedOver_.get_future();
+    server_->dispatch(
+      [this, handOver]()
+      {
+        server_->stopAccepting();
+        if (!net::handover::send(handOver->channel_, net::handover::SOCKET_TYPE_LISTENER, server_->nativeHandle(),
+                                 ""))
+        {
+          std::cout << "proxy::Server::handOver, listener not handed over" << std::endl;
+        }
+        handOver->pendingClients_ = clients_;
+        if (handOver->pendingClients_.empty())
+        {
+          handOver->handedOver_.set_value();
+        }
+        for (auto& client : clients_)
+        {
+          const net::Connection::Ptr& connection = client.second->getConnection();
+          connection->stopReading();
+          boost::uuids::uuid id = client.first;
+          connection->flush([this, handOver, id]() { handOverClient(handOver, id); });
+        }
+      });
+
+    if (handedOver.wait_for(HAND_OVER_FLUSH_TIMEOUT) == std::future_status::timeout)
+    {
+      // miners not reading would hold up the hand over, their sockets go unflushed
+      std::promise<void> forced;
+      server_->dispatch(
+        [&]()
+        {
+          std::cout << "proxy::Server::handOver, flush timed out, clients, " << handOver->pendingClients_.size()
+                    << std::endl;
+          while (!handOver->pendingClients_.empty())
+          {
+            handOverClient(handOver, handOver->pendingClients_.begin()->first);
+          }
+          forced.set_value();
+        });
+      forced.get_future().wait();
+    }
+
+    std::cout << "proxy::Server::handOver, clients, " << clients_.size() << std::endl;
+  }
+  net::handover::close(channel);
+}
+
+void Server::handOverClient(const std::shared_ptr<HandOver>& handOver, const boost::uuids::uuid& id)
+{
+  auto client = handOver->pendingClients_.find(id);
+  if (client == handOver->pendingClients_.end())
+  {
+    // handed over unflushed after the timeout already
+    return;
+  }
+
+  const net::Connection::Ptr& connection = client->second->getConnection();
+  if (!net::handover::send(handOver->channel_, net::handover::SOCKET_TYPE_CONNECTION, connection->nativeHandle(),
+                           client->second->getHandOverState()))
+  {
+    // this process ends with the hand over, the miner reconnects to the successor
+    std::cout << "proxy::Server::handOver, client not handed over, disconnecting, " << id << std::endl;
+    connection->disconnect();
+  }
+  handOver->pendingClients_.erase(client);
+  if (handOver->pendingClients_.empty())
+  {
+    handOver->handedOver_.set_value();
+  }
 }
 
 void Server::handleNewConnection(const net::Connection::Ptr& connection)
@@ -16,8 +186,263 @@ void Server::handleNewConnection(const net::Connection::Ptr& connection)
   boost::uuids::uuid clientId = boost::uuids::random_generator()();
   Client::Ptr client = std::make_shared<Client>(clientId);
   client->setConnection(connection);
-  clients_[clientId] = client;
+  addClient(client);
+}
+
+void Server::startServer(const net::server::Server::Ptr& server)
+{
+  server_ = server;
+  server_->startTicking(TIMING_WHEEL_TICK, [this]() { timingWheel_.advance(); });
+  server_->dispatch([this]() { timingWheel_.arm(statisticsTimer_, STATISTICS_INTERVAL); });
+
+  if (shareVerification_)
+  {
+    // verdicts are handled on the server thread like everything else of the clients
+    shareVerifier_ = std::make_shared<ShareVerifier>(
+      *shareVerification_,
+      [this](const std::function<void()>& function) { server_->dispatch(function); });
+  }
+
+  if (poolConfiguration_)
+  {
+    // the pool manager shares the server's event loop with the clients
+    server_->dispatch(
+      [this]()
+      {
+        poolManager_ = std::make_shared<PoolManager>(
+          *poolConfiguration_,
+          [this](const std::function<void()>& function) { server_->dispatch(function); },
+          timingWheel_);
+        poolManager_->setShareJournal(shareJournal_);
+        poolManager_->setWorkerStatistics(workerStatistics_);
+        poolManager_->start();
+      });
+  }
+}
+
+void Server::addClient(const Client::Ptr& client)
+{
+  // lambdas capturing only this fit into the handlers without allocating, binds of member functions do not
+  client->setDisconnectHandler([this](const Client::Ptr& client) { handleClientDisconnected(client); });
+  client->setLoginHandler([this](const Client::Ptr& client) { handleClientLogin(client); });
+  client->setResumeHandler(
+    [this](const Client::Ptr& client, const std::string& sessionId) { return handleClientResume(client, sessionId); });
+  client->setShareHandler(
+    [this](const Client::Ptr& client, const std::string& jobId, const std::string& nonce, const std::string& result,
+           const ShareJournal::Record& share)
+    {
+      handleClientShare(client, jobId, nonce, result, share);
+    });
+  client->setBitcoinShareHandler(
+    [this](const Client::Ptr& client, const std::string& jobId, const std::string& extranonce2,
+           const std::string& time, const std::string& nonce, const ShareJournal::Record& share)
+    {
+      handleClientBitcoinShare(client, jobId, extranonce2, time, nonce, share);
+    });
+  client->setShareJournal(shareJournal_);
+  client->setWorkerStatistics(workerStatistics_);
+  client->setShareVerifier(shareVerifier_);
+  client->startTimeouts(timingWheel_);
+  clients_[client->getIdentifier()] = client;
+
+  // clients taken over from a predecessor are logged in already
+  if (client->isLoggedIn())
+  {
+    handleClientLogin(client);
+  }
+}
+
+void Server::handleClientLogin(const Client::Ptr& client)
+{
+  if (poolManager_)
+  {
+    poolManager_->addClient(client);
+  }
+}
+
+bool Server::handleClientResume(const Client::Ptr& client, const std::string& sessionId)
+{
+  // the session id the miner was issued, otherwise the same login from the same address
+  ParkedSessionIterator session = parkedSessions_.end();
+  if (!sessionId.empty())
+  {
+    try
+    {
+      session = parkedSessions_.find(boost::lexical_cast<boost::uuids::uuid>(sessionId));
+    }
+    catch (const boost::bad_lexical_cast&)
+    {
+    }
+  }
+  if (session == parkedSessions_.end())
+  {
+    auto login = parkedLogins_.find(std::make_pair(client->getUsername(), client->getAddress()));
+    if (login != parkedLogins_.end())
+    {
+      session = parkedSessions_.find(login->second);
+    }
+  }
+  if (session == parkedSessions_.end() || !poolManager_)
+  {
+    return false;
+  }
+
+  Client::Ptr parked = session->second.client_;
+  unparkSession(session);
+  clients_.erase(client->getIdentifier());
+  client->resume(*parked);
+  clients_[client->getIdentifier()] = client;
+  poolManager_->resumeClient(parked, client);
+  ++resumedSessions_;
+  std::cout << "proxy::Server::handleClientResume, session, " << client->getIdentifier() << std::endl;
+  return true;
+}
+
+void Server::handleClientShare(const Client::Ptr& client, const std::string& jobId, const std::string& nonce,
+                               const std::string& result, const ShareJournal::Record& share)
+{
+  if (poolManager_)
+  {
+    poolManager_->submit(client, jobId, nonce, result, share);
+  }
+}
+
+void Server::handleClientBitcoinShare(const Client::Ptr& client, const std::string& jobId,
+                                      const std::string& extranonce2, const std::string& time,
+                                      const std::string& nonce, const ShareJournal::Record& share)
+{
+  if (poolManager_)
+  {
+    poolManager_->submit(client, jobId, extranonce2, time, nonce, share);
+  }
+}
+
+void Server::handleClientDisconnected(const Client::Ptr& client)
+{
+  clients_.erase(client->getIdentifier());
+  if (poolManager_ && client->canResume() && sessionGracePeriod_.count() > 0)
+  {
+    parkSession(client);
+  }
+  else if (poolManager_)
+  {
+    poolManager_->removeClient(client);
+  }
+}
+
+void Server::parkSession(const Client::Ptr& client)
+{
+  boost::uuids::uuid id = client->getIdentifier();
+  auto parked = parkedSessions_.emplace(std::piecewise_construct, std::forward_as_tuple(id),
+                                        std::forward_as_tuple([this, id]() { expireSession(id); }));
+  if (!parked.second)
+  {
+    poolManager_->removeClient(client);
+    return;
+  }
+
+  // the pool manager keeps the slot and sends the parked client its jobs as to any other
+  client->park();
+  parked.first->second.client_ = client;
+  parkedLogins_.emplace(std::make_pair(client->getUsername(), client->getAddress()), id);
+  timingWheel_.arm(parked.first->second.expiryTimer_, sessionGracePeriod_);
+}
+
+void Server::unparkSession(ParkedSessionIterator session)
+{
+  const Client::Ptr& client = session->second.client_;
+  auto logins = parkedLogins_.equal_range(std::make_pair(client->getUsername(), client->getAddress()));
+  for (auto login = logins.first; login != logins.second; ++login)
+  {
+    if (login->second == session->first)
+    {
+      parkedLogins_.erase(login);
+      break;
+    }
+  }
+  parkedSessions_.erase(session);
+}
+
+void Server::expireSession(const boost::uuids::uuid& id)
+{
+  ParkedSessionIterator session = parkedSessions_.find(id);
+  if (session != parkedSessions_.end())
+  {
+    Client::Ptr client = session->second.client_;
+    unparkSession(session);
+    if (poolManager_)
+    {
+      poolManager_->removeClient(client);
+    }
+  }
+}
+
+void Server::logStatistics()
+{
+  // stratum v1 difficulty 1 takes 2^32 hashes on average
+  double hashesPerDifficulty =
+    poolConfiguration_ && poolConfiguration_->protocol_ == stratum::PROTOCOL_BITCOIN ? 4294967296.0 : 1.0;
+  for (const WorkerStatistics::Summary& summary : workerStatistics_->collect())
+  {
+    std::cout << "proxy::Server::logStatistics, worker, " << summary.worker << ", accepted, " << summary.accepted
+              << ", rejected, " << summary.rejected << ", stale, " << summary.stale << ", hashrate";
+    for (int window = 0; window < WorkerStatistics::WINDOW_COUNT; ++window)
+    {
+      std::cout << ", " << WorkerStatistics::toString(static_cast<WorkerStatistics::Window>(window)) << " "
+                << summary.hashrate[window] * hashesPerDifficulty;
+    }
+    std::cout << std::endl;
+  }
+  if (poolManager_)
+  {
+    poolManager_->logStatistics();
+  }
+  logAllocations();
+  std::cout << "proxy::Server::logStatistics, parked sessions, " << parkedSessions_.size() << ", resumed, "
+            << resumedSessions_ << std::endl;
+  if (shareVerifier_)
+  {
+    ShareVerifier::Statistics statistics = shareVerifier_->getStatistics();
+    std::cout << "proxy::Server::logStatistics, verified shares, " << statistics.verified << ", invalid, "
+              << statistics.invalid << ", skipped, " << statistics.skipped << ", unsupported, "
+              << statistics.unsupported << std::endl;
+  }
+  if (server_)
+  {
+    net::server::RateLimitCounters counters = server_->getRateLimitCounters();
+    std::cout << "proxy::Server::logStatistics, rejected connections, " << counters.rejectedConnections_
+              << ", throttled messages, " << counters.throttledMessages_
+              << ", dropped connections, " << counters.droppedConnections_ << std::endl;
+  }
+  timingWheel_.arm(statisticsTimer_, STATISTICS_INTERVAL);
+}
+
+void Server::logAllocations()
+{
+  // in accounting builds only, per message type and subsystem since the start
+  for (const util::AllocationAccounting::Summary& summary : util::AllocationAccounting::collect())
+  {
+    for (int subsystem = 0; subsystem < util::AllocationAccounting::SUBSYSTEM_COUNT; ++subsystem)
+    {
+      const util::AllocationAccounting::Counters& counters = summary.counters[subsystem];
+      if (counters.allocations == 0 && counters.largeCopies == 0)
+      {
+        continue;
+      }
+      std::cout << "proxy::Server::logStatistics, allocations, "
+                << (summary.messageType.empty() ? "-" : summary.messageType) << ", "
+                << util::AllocationAccounting::toString(static_cast<util::AllocationAccounting::Subsystem>(subsystem))
+                << ", messages, " << summary.messages << ", allocations, " << counters.allocations
+                << ", bytes, " << counters.allocatedBytes << ", large copies, " << counters.largeCopies
+                << ", copied bytes, " << counters.copiedBytes;
+      if (summary.messages > 0)
+      {
+        std::cout << ", allocations per message, " << static_cast<double>(counters.allocations) / summary.messages;
+      }
+      std::cout << std::endl;
+    }
+  }
 }
 
 } // namespace proxy
-} // namespace ses
\ No newline at end of file
+} // namespace ses
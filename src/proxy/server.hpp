@@ -5,12 +5,18 @@
 #ifndef SES_PROXY_SERVER_HPP
 #define SES_PROXY_SERVER_HPP
 
+#include <future>
 #include <list>
+#include <map>
 #include <memory>
+#include <optional>
 #include <boost/uuid/uuid.hpp>
 
 #include "net/server/server.hpp"
 #include "proxy/client.hpp"
+#include "proxy/poolmanager.hpp"
+#include "proxy/shareverifier.hpp"
+#include "util/timingwheel.hpp"
 
 namespace ses {
 namespace proxy {
@@ -21,18 +27,104 @@ class Server : public ses::net::server::ServerHandler,
 public:
   typedef std::shared_ptr<ses::proxy::Server> Ptr;
 
+  // how often the per worker statistics are logged
+  static constexpr std::chrono::seconds STATISTICS_INTERVAL{60};
+  // how long a miner that lost its connection may come back to its slot and job by default
+  static constexpr std::chrono::seconds SESSION_GRACE_PERIOD{60};
+  // how long the hand over waits for what was sent to the miners to be written
+  static constexpr std::chrono::seconds HAND_OVER_FLUSH_TIMEOUT{5};
+
 public:
+  Server();
+
+  // the upstream pool miners are served from, sessions are opened as needed once started
+  void setPool(const PoolConfiguration& poolConfiguration);
+
+  // journals the shares of all miners, set before starting
+  void setShareJournal(const ShareJournal::Ptr& shareJournal);
+
+  // verifies sampled shares of CryptoNote miners, set before starting
+  void setShareVerification(const ShareVerification& shareVerification);
+
+  // sessions of disconnected CryptoNote miners are kept this long for them to resume, zero releases
+  // them right away
+  void setSessionGracePeriod(std::chrono::seconds sessionGracePeriod);
+
+  const WorkerStatistics::Ptr& getWorkerStatistics() const;
+
   void start(const std::string& address,
              uint16_t port,
              net::ConnectionType type = net::CONNECTION_TYPE_AUTO);
 
+  // takes over listening socket and clients from a predecessor process, false if there is none
+  bool takeOver(const std::string& handOverPath);
+
+  // hands listening socket and clients over to a successor process connected on channel
+  void handOver(int channel);
+
 public:
   void handleNewConnection(const net::Connection::Ptr& connection) override;
 
+private:
+  void startServer(const net::server::Server::Ptr& server);
+  void addClient(const Client::Ptr& client);
+  void handleClientLogin(const Client::Ptr& client);
+  bool handleClientResume(const Client::Ptr& client, const std::string& sessionId);
+  void handleClientShare(const Client::Ptr& client, const std::string& jobId, const std::string& nonce,
+                         const std::string& result, const ShareJournal::Record& share);
+  void handleClientBitcoinShare(const Client::Ptr& client, const std::string& jobId,
+                                const std::string& extranonce2, const std::string& time, const std::string& nonce,
+                                const ShareJournal::Record& share);
+  void handleClientDisconnected(const Client::Ptr& client);
+  void logStatistics();
+  void logAllocations();
+
+  struct ParkedSession
+  {
+    explicit ParkedSession(const util::TimingWheel::Timer::Callback& expire)
+      : expiryTimer_(expire)
+    {
+    }
+
+    Client::Ptr client_;
+    util::TimingWheel::Timer expiryTimer_;
+  };
+  typedef std::map<boost::uuids::uuid, ParkedSession>::iterator ParkedSessionIterator;
+
+  // clients whose sockets go to the successor once their pending writes are flushed
+  struct HandOver
+  {
+    int channel_;
+    std::map<boost::uuids::uuid, Client::Ptr> pendingClients_;
+    std::promise<void> handedOver_;
+  };
+
+  void handOverClient(const std::shared_ptr<HandOver>& handOver, const boost::uuids::uuid& id);
+
+  void parkSession(const Client::Ptr& client);
+  void unparkSession(ParkedSessionIterator session);
+  void expireSession(const boost::uuids::uuid& id);
+
 private:
   net::server::Server::Ptr server_;
+  util::TimingWheel timingWheel_;
+  util::TimingWheel::Timer statisticsTimer_;
+
+  std::optional<PoolConfiguration> poolConfiguration_;
+  PoolManager::Ptr poolManager_;
+  ShareJournal::Ptr shareJournal_;
+  WorkerStatistics::Ptr workerStatistics_;
+  std::optional<ShareVerification> shareVerification_;
+  ShareVerifier::Ptr shareVerifier_;
 
   std::map<boost::uuids::uuid, Client::Ptr> clients_;
+
+  // disconnected miners keeping their slot in the pool manager, by the session id they were issued
+  // and by login and address
+  std::chrono::seconds sessionGracePeriod_;
+  std::map<boost::uuids::uuid, ParkedSession> parkedSessions_;
+  std::multimap<std::pair<std::string, std::string>, boost::uuids::uuid> parkedLogins_;
+  uint64_t resumedSessions_;
 };
 
 } // namespace proxy
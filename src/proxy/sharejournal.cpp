@@ -0,0 +1,422 @@
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <ctime>
+#include <dirent.h>
+#include <fcntl.h>
+#include <iostream>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "proxy/sharejournal.hpp"
+
+namespace ses {
+namespace proxy {
+
+namespace {
+const char SEGMENT_MAGIC[8] = {'S', 'E', 'S', 'S', 'H', 'A', 'R', 'E'};
+const uint32_t SEGMENT_VERSION = 2;
+
+// records of version 1 segments, with names cut at 32 and 48 characters
+struct RecordV1
+{
+  uint64_t timestamp;
+  uint64_t sessionId;
+  uint8_t workerId[16];
+  double difficulty;
+  uint32_t nonce;
+  ShareJournal::Outcome outcome;
+  uint8_t reserved[3];
+  char jobId[32];
+  char worker[48];
+};
+static_assert(sizeof(RecordV1) == 128, "version 1 records have a fixed size");
+
+// the UTC day of a record timestamp as YYYYMMDD
+std::string getDay(uint64_t timestamp)
+{
+  std::time_t seconds = static_cast<std::time_t>(timestamp / 1000000000);
+  std::tm time;
+  gmtime_r(&seconds, &time);
+  char day[9];
+  std::strftime(day, sizeof(day), "%Y%m%d", &time);
+  return day;
+}
+
+void copyString(char* destination, std::size_t size, const std::string& source)
+{
+  std::size_t length = std::min(size, source.size());
+  std::memcpy(destination, source.data(), length);
+  std::memset(destination + length, 0, size - length);
+}
+
+uint64_t hashWorker(const char* worker, std::size_t size)
+{
+  // FNV-1a
+  uint64_t hash = 14695981039346656037ULL;
+  for (std::size_t i = 0; i < size; ++i)
+  {
+    hash = (hash ^ static_cast<uint8_t>(worker[i])) * 1099511628211ULL;
+  }
+  return hash;
+}
+
+ShareJournal::Record upgradeRecord(const RecordV1& recordV1)
+{
+  ShareJournal::Record record;
+  std::memset(&record, 0, sizeof(record));
+  record.timestamp = recordV1.timestamp;
+  record.sessionId = recordV1.sessionId;
+  std::memcpy(record.workerId, recordV1.workerId, sizeof(record.workerId));
+  record.difficulty = recordV1.difficulty;
+  record.nonce = recordV1.nonce;
+  record.outcome = recordV1.outcome;
+  std::size_t workerSize = strnlen(recordV1.worker, sizeof(recordV1.worker));
+  record.workerHash = hashWorker(recordV1.worker, workerSize);
+  std::memcpy(record.jobId, recordV1.jobId, strnlen(recordV1.jobId, sizeof(recordV1.jobId)));
+  std::memcpy(record.worker, recordV1.worker, workerSize);
+  return record;
+}
+}
+
+constexpr std::chrono::milliseconds ShareJournal::COMMIT_INTERVAL;
+
+ShareJournal::Ptr ShareJournal::open(const std::string& directory)
+{
+  if (::access(directory.c_str(), W_OK) != 0)
+  {
+    std::cout << "proxy::ShareJournal::open, not writable, " << directory << std::endl;
+    return nullptr;
+  }
+  return Ptr(new ShareJournal(directory));
+}
+
+ShareJournal::ShareJournal(const std::string& directory)
+  : directory_(directory), cells_(new Cell[QUEUE_CAPACITY]), enqueuePosition_(0), dequeuePosition_(0),
+    droppedRecords_(0), segmentFile_(-1), segment_(nullptr), segmentSize_(0), writtenRecords_(0),
+    committedRecords_(0), stopped_(false)
+{
+  for (std::size_t i = 0; i < QUEUE_CAPACITY; ++i)
+  {
+    cells_[i].sequence.store(i, std::memory_order_relaxed);
+  }
+  writer_ = std::thread(&ShareJournal::run, this);
+}
+
+ShareJournal::~ShareJournal()
+{
+  {
+    std::lock_guard<std::mutex> lock(stopMutex_);
+    stopped_ = true;
+  }
+  stopCondition_.notify_one();
+  writer_.join();
+}
+
+ShareJournal::Record ShareJournal::createRecord(const uint8_t* workerId, const std::string& worker,
+                                                const std::string& jobId, uint32_t nonce, double difficulty)
+{
+  Record record;
+  std::memset(&record, 0, sizeof(record));
+  // the vDSO serves the clock without entering the kernel
+  record.timestamp = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+    std::chrono::system_clock::now().time_since_epoch()).count());
+  std::memcpy(record.workerId, workerId, sizeof(record.workerId));
+  record.difficulty = difficulty;
+  record.nonce = nonce;
+  record.outcome = OUTCOME_ACCEPTED;
+  copyString(record.jobId, sizeof(record.jobId), jobId);
+  copyString(record.worker, sizeof(record.worker), worker);
+  record.workerHash = hashWorker(worker.data(), worker.size());
+  return record;
+}
+
+void ShareJournal::append(const Record& record)
+{
+  // bounded multi producer queue, each cell's sequence tells whose turn it is
+  uint64_t position = enqueuePosition_.load(std::memory_order_relaxed);
+  Cell* cell;
+  for (;;)
+  {
+    cell = &cells_[position & (QUEUE_CAPACITY - 1)];
+    int64_t difference =
+      static_cast<int64_t>(cell->sequence.load(std::memory_order_acquire)) - static_cast<int64_t>(position);
+    if (difference == 0)
+    {
+      if (enqueuePosition_.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+      {
+        break;
+      }
+    }
+    else if (difference < 0)
+    {
+      droppedRecords_.fetch_add(1, std::memory_order_relaxed);
+      return;
+    }
+    else
+    {
+      position = enqueuePosition_.load(std::memory_order_relaxed);
+    }
+  }
+  cell->record = record;
+  cell->sequence.store(position + 1, std::memory_order_release);
+}
+
+void ShareJournal::append(Record record, Outcome outcome)
+{
+  record.outcome = outcome;
+  append(record);
+}
+
+uint64_t ShareJournal::getDroppedRecords() const
+{
+  return droppedRecords_.load(std::memory_order_relaxed);
+}
+
+std::vector<std::string> ShareJournal::findSegments(const std::string& directory, const std::string& day)
+{
+  std::vector<std::pair<unsigned long, std::string>> segments;
+  DIR* dir = ::opendir(directory.c_str());
+  if (!dir)
+  {
+    return {};
+  }
+  std::string prefix = "shares-" + day + "-";
+  std::string suffix = ".journal";
+  for (struct dirent* entry = ::readdir(dir); entry; entry = ::readdir(dir))
+  {
+    std::string name = entry->d_name;
+    if (name.size() > prefix.size() + suffix.size() && name.compare(0, prefix.size(), prefix) == 0 &&
+        name.compare(name.size() - suffix.size(), suffix.size(), suffix) == 0)
+    {
+      unsigned long number = std::strtoul(name.c_str() + prefix.size(), nullptr, 10);
+      segments.emplace_back(number, directory + "/" + name);
+    }
+  }
+  ::closedir(dir);
+
+  std::sort(segments.begin(), segments.end());
+  std::vector<std::string> paths;
+  for (auto& segment : segments)
+  {
+    paths.push_back(segment.second);
+  }
+  return paths;
+}
+
+bool ShareJournal::read(const std::string& path, const std::function<void(const Record&)>& recordHandler)
+{
+  int file = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (file < 0)
+  {
+    return false;
+  }
+  struct stat status;
+  if (::fstat(file, &status) != 0 || static_cast<std::size_t>(status.st_size) < sizeof(SegmentHeader))
+  {
+    ::close(file);
+    return false;
+  }
+  std::size_t size = static_cast<std::size_t>(status.st_size);
+  void* mapping = ::mmap(nullptr, size, PROT_READ, MAP_SHARED, file, 0);
+  ::close(file);
+  if (mapping == MAP_FAILED)
+  {
+    return false;
+  }
+  ::madvise(mapping, size, MADV_SEQUENTIAL);
+
+  // the header fields read here are laid out alike in both versions, records start at the second record size
+  const SegmentHeader* header = static_cast<const SegmentHeader*>(mapping);
+  bool current = header->version == SEGMENT_VERSION && header->recordSize == sizeof(Record);
+  bool legacy = header->version == 1 && header->recordSize == sizeof(RecordV1);
+  bool valid = std::memcmp(header->magic, SEGMENT_MAGIC, sizeof(SEGMENT_MAGIC)) == 0 && (current || legacy) &&
+               size >= 2 * header->recordSize;
+  if (valid)
+  {
+    uint64_t count = std::min<uint64_t>(__atomic_load_n(&header->committedRecords, __ATOMIC_ACQUIRE),
+                                        size / header->recordSize - 1);
+    const uint8_t* records = static_cast<const uint8_t*>(mapping) + header->recordSize;
+    for (uint64_t i = 0; i < count; ++i)
+    {
+      if (current)
+      {
+        recordHandler(reinterpret_cast<const Record*>(records)[i]);
+      }
+      else
+      {
+        RecordV1 recordV1;
+        std::memcpy(&recordV1, records + i * sizeof(RecordV1), sizeof(recordV1));
+        recordHandler(upgradeRecord(recordV1));
+      }
+    }
+  }
+  ::munmap(mapping, size);
+  return valid;
+}
+
+const char* ShareJournal::toString(Outcome outcome)
+{
+  switch (outcome)
+  {
+    case OUTCOME_ACCEPTED:
+      return "accepted";
+    case OUTCOME_REJECTED:
+      return "rejected";
+    case OUTCOME_UNANSWERED:
+      return "unanswered";
+    case OUTCOME_INVALID:
+      return "invalid";
+    case OUTCOME_LOW_DIFFICULTY:
+      return "low difficulty";
+    case OUTCOME_STALE:
+      return "stale";
+  }
+  return "unknown";
+}
+
+void ShareJournal::run()
+{
+  std::unique_lock<std::mutex> lock(stopMutex_);
+  for (;;)
+  {
+    // producers never wake the writer, it polls once per commit interval
+    bool stopped = stopCondition_.wait_for(lock, COMMIT_INTERVAL, [this]() { return stopped_; });
+    lock.unlock();
+    bool more;
+    do
+    {
+      more = drain();
+      commit();
+    }
+    while (more);
+    lock.lock();
+    if (stopped)
+    {
+      break;
+    }
+  }
+  closeSegment();
+}
+
+bool ShareJournal::drain()
+{
+  // one queue capacity at most, so a backlog is committed in steps
+  std::size_t count = 0;
+  for (; count < QUEUE_CAPACITY; ++count)
+  {
+    Cell& cell = cells_[dequeuePosition_ & (QUEUE_CAPACITY - 1)];
+    if (cell.sequence.load(std::memory_order_acquire) != dequeuePosition_ + 1)
+    {
+      break;
+    }
+    write(cell.record);
+    cell.sequence.store(dequeuePosition_ + QUEUE_CAPACITY, std::memory_order_release);
+    ++dequeuePosition_;
+  }
+  return count == QUEUE_CAPACITY;
+}
+
+void ShareJournal::write(const Record& record)
+{
+  std::string day = getDay(record.timestamp);
+  if (segment_ && (writtenRecords_ == SEGMENT_RECORDS || day != segmentDay_))
+  {
+    commit();
+    closeSegment();
+  }
+  if (!segment_ && !openSegment(day))
+  {
+    droppedRecords_.fetch_add(1, std::memory_order_relaxed);
+    return;
+  }
+
+  Record* records = reinterpret_cast<Record*>(segment_ + sizeof(SegmentHeader));
+  records[writtenRecords_++] = record;
+}
+
+bool ShareJournal::openSegment(const std::string& day)
+{
+  // continues numbering after the segments of earlier runs on the same day
+  std::size_t number = findSegments(directory_, day).size();
+
+  std::string path;
+  int file = -1;
+  for (; file < 0; ++number)
+  {
+    path = directory_ + "/shares-" + day + "-" + std::to_string(number) + ".journal";
+    file = ::open(path.c_str(), O_RDWR | O_CREAT | O_EXCL | O_CLOEXEC, 0644);
+    if (file < 0 && errno != EEXIST)
+    {
+      std::cout << "proxy::ShareJournal::openSegment, " << path << ", " << std::strerror(errno) << std::endl;
+      return false;
+    }
+  }
+
+  std::size_t size = sizeof(SegmentHeader) + SEGMENT_RECORDS * sizeof(Record);
+  void* mapping = MAP_FAILED;
+  if (::ftruncate(file, static_cast<off_t>(size)) == 0)
+  {
+    mapping = ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, file, 0);
+  }
+  if (mapping == MAP_FAILED)
+  {
+    std::cout << "proxy::ShareJournal::openSegment, " << path << ", " << std::strerror(errno) << std::endl;
+    ::close(file);
+    ::unlink(path.c_str());
+    return false;
+  }
+
+  segmentDay_ = day;
+  segmentFile_ = file;
+  segment_ = static_cast<uint8_t*>(mapping);
+  segmentSize_ = size;
+  writtenRecords_ = 0;
+  committedRecords_ = 0;
+
+  SegmentHeader* header = reinterpret_cast<SegmentHeader*>(segment_);
+  std::memcpy(header->magic, SEGMENT_MAGIC, sizeof(SEGMENT_MAGIC));
+  header->version = SEGMENT_VERSION;
+  header->recordSize = sizeof(Record);
+  header->recordCapacity = SEGMENT_RECORDS;
+  header->committedRecords = 0;
+  std::cout << "proxy::ShareJournal::openSegment, " << path << std::endl;
+  return true;
+}
+
+void ShareJournal::commit()
+{
+  if (!segment_ || writtenRecords_ == committedRecords_)
+  {
+    return;
+  }
+
+  // records first, so the header never counts records that did not reach the disk
+  long pageSize = ::sysconf(_SC_PAGESIZE);
+  std::size_t begin = sizeof(SegmentHeader) + committedRecords_ * sizeof(Record);
+  std::size_t end = sizeof(SegmentHeader) + writtenRecords_ * sizeof(Record);
+  begin -= begin % pageSize;
+  ::msync(segment_ + begin, end - begin, MS_SYNC);
+
+  SegmentHeader* header = reinterpret_cast<SegmentHeader*>(segment_);
+  __atomic_store_n(&header->committedRecords, writtenRecords_, __ATOMIC_RELEASE);
+  ::msync(segment_, sizeof(SegmentHeader), MS_SYNC);
+  committedRecords_ = writtenRecords_;
+}
+
+void ShareJournal::closeSegment()
+{
+  if (!segment_)
+  {
+    return;
+  }
+  commit();
+  ::munmap(segment_, segmentSize_);
+  ::close(segmentFile_);
+  segment_ = nullptr;
+  segmentFile_ = -1;
+}
+
+} // namespace proxy
+} // namespace ses
@@ -0,0 +1,139 @@
+#ifndef SES_PROXY_SHAREJOURNAL_HPP
+#define SES_PROXY_SHAREJOURNAL_HPP
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace ses {
+namespace proxy {
+
+/**
+ * Durable record of every share a miner submitted, for payouts and disputes. Records have a fixed
+ * size and are appended to memory mapped segment files named shares-<YYYYMMDD>-<n>.journal after
+ * the UTC day of their timestamp. A segment is rotated when full or when the day changes.
+ *
+ * append() only copies the record into a lock-free queue, so journaling adds no syscall to the
+ * submit path. A writer thread drains the queue every COMMIT_INTERVAL, copies the records into the
+ * mapping and commits them as a group with a single msync before publishing the new record count
+ * in the segment header. Records arriving while the queue is full are dropped and counted.
+ */
+class ShareJournal
+{
+public:
+  typedef std::shared_ptr<ShareJournal> Ptr;
+
+  enum Outcome : uint8_t
+  {
+    OUTCOME_ACCEPTED,
+    OUTCOME_REJECTED,
+    // not answered by the pool, its connection was lost or the miner had no session
+    OUTCOME_UNANSWERED,
+    OUTCOME_INVALID,
+    OUTCOME_LOW_DIFFICULTY,
+    OUTCOME_STALE
+  };
+
+  struct Record
+  {
+    // nanoseconds since the epoch, when the miner submitted the share
+    uint64_t timestamp;
+    uint64_t sessionId;
+    uint8_t workerId[16];
+    double difficulty;
+    uint32_t nonce;
+    Outcome outcome;
+    uint8_t reserved[3];
+    // FNV-1a of the whole worker name, tells apart workers whose names were truncated alike
+    uint64_t workerHash;
+    // zero padded, truncated if longer, job ids of CryptoNote jobs always fit
+    char jobId[104];
+    char worker[224];
+  };
+  static_assert(sizeof(Record) == 384, "journal records have a fixed size");
+
+  struct SegmentHeader
+  {
+    char magic[8];
+    uint32_t version;
+    uint32_t recordSize;
+    uint64_t recordCapacity;
+    // records before this are committed, the writer only ever increases it
+    uint64_t committedRecords;
+    uint8_t reserved[352];
+  };
+  static_assert(sizeof(SegmentHeader) == sizeof(Record), "records start at the second record size");
+
+  static const std::size_t QUEUE_CAPACITY = 1 << 16;
+  static const std::size_t SEGMENT_RECORDS = 1 << 16;
+  static constexpr std::chrono::milliseconds COMMIT_INTERVAL{100};
+
+public:
+  // nullptr if the directory is not writable
+  static Ptr open(const std::string& directory);
+  ~ShareJournal();
+
+  static Record createRecord(const uint8_t* workerId, const std::string& worker, const std::string& jobId,
+                             uint32_t nonce, double difficulty);
+
+  // lock-free and safe to call from any thread
+  void append(const Record& record);
+  void append(Record record, Outcome outcome);
+  uint64_t getDroppedRecords() const;
+
+  // segment paths of a day given as YYYYMMDD, oldest first
+  static std::vector<std::string> findSegments(const std::string& directory, const std::string& day);
+  // passes the committed records of a segment, also of version 1 ones, false if it is no readable segment
+  static bool read(const std::string& path, const std::function<void(const Record&)>& recordHandler);
+
+  static const char* toString(Outcome outcome);
+
+private:
+  struct Cell
+  {
+    std::atomic<uint64_t> sequence;
+    Record record;
+  };
+
+  explicit ShareJournal(const std::string& directory);
+
+  void run();
+  bool drain();
+  void write(const Record& record);
+  bool openSegment(const std::string& day);
+  void commit();
+  void closeSegment();
+
+private:
+  std::string directory_;
+
+  std::unique_ptr<Cell[]> cells_;
+  alignas(64) std::atomic<uint64_t> enqueuePosition_;
+  alignas(64) uint64_t dequeuePosition_;
+  std::atomic<uint64_t> droppedRecords_;
+
+  // only touched by the writer thread
+  std::string segmentDay_;
+  int segmentFile_;
+  uint8_t* segment_;
+  std::size_t segmentSize_;
+  uint64_t writtenRecords_;
+  uint64_t committedRecords_;
+
+  std::mutex stopMutex_;
+  std::condition_variable stopCondition_;
+  bool stopped_;
+  std::thread writer_;
+};
+
+} // namespace proxy
+} // namespace ses
+
+#endif //SES_PROXY_SHAREJOURNAL_HPP
@@ -0,0 +1,168 @@
+#include <cstring>
+#include <iostream>
+
+#include "proxy/shareverifier.hpp"
+#include "util/cryptonight.hpp"
+
+namespace ses {
+namespace proxy {
+
+const std::size_t ShareVerifier::QUEUE_CAPACITY;
+const uint32_t ShareVerifier::PROBATION_SHARES;
+
+ShareVerifier::ShareVerifier(const ShareVerification& verification, const Dispatcher& dispatcher)
+  : verification_(verification)
+  , dispatcher_(dispatcher)
+  , random_(std::random_device()())
+  , statistics_{0, 0, 0, 0}
+  , stopped_(false)
+{
+  std::cout << "proxy::ShareVerifier, threads, " << verification_.threadCount_ << ", sample rate, "
+            << verification_.sampleRate_ << ", max major version, " << verification_.maxMajorVersion_
+            << ", implementation, " << util::CryptoNight::implementation() << std::endl;
+  for (std::size_t i = 0; i < verification_.threadCount_; ++i)
+  {
+    workers_.emplace_back(&ShareVerifier::run, this);
+  }
+}
+
+ShareVerifier::~ShareVerifier()
+{
+  {
+    std::lock_guard<std::mutex> lock(queueMutex_);
+    stopped_ = true;
+  }
+  queueCondition_.notify_all();
+  for (std::thread& worker : workers_)
+  {
+    worker.join();
+  }
+}
+
+bool ShareVerifier::sample(const std::string& login)
+{
+  double sampleRate = getHistory(login).sampleRate;
+  return sampleRate >= 1.0 || (sampleRate > 0.0 && std::uniform_real_distribution<double>()(random_) < sampleRate);
+}
+
+bool ShareVerifier::verify(const std::string& login, const stratum::Job& job, uint32_t nonce, const uint8_t* result,
+                           const VerdictHandler& verdictHandler)
+{
+  uint64_t majorVersion = 0;
+  if (!getMajorVersion(job, majorVersion) || majorVersion > verification_.maxMajorVersion_)
+  {
+    ++statistics_.unsupported;
+    return false;
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(queueMutex_);
+    if (queue_.size() < QUEUE_CAPACITY)
+    {
+      queue_.push_back(Task{login, job, {}, verdictHandler});
+      queue_.back().job.setNonce(nonce);
+      std::memcpy(queue_.back().result.data(), result, queue_.back().result.size());
+    }
+    else
+    {
+      ++statistics_.skipped;
+      return false;
+    }
+  }
+  queueCondition_.notify_one();
+  return true;
+}
+
+ShareVerifier::Statistics ShareVerifier::getStatistics() const
+{
+  return statistics_;
+}
+
+void ShareVerifier::run()
+{
+  // the scratchpad is allocated once per worker and reused for every share
+  util::CryptoNight cryptoNight;
+  if (!cryptoNight.usesHugePages())
+  {
+    std::cout << "proxy::ShareVerifier::run, no huge pages reserved, scratchpad in regular pages" << std::endl;
+  }
+
+  std::unique_lock<std::mutex> lock(queueMutex_);
+  for (;;)
+  {
+    queueCondition_.wait(lock, [this]() { return stopped_ || !queue_.empty(); });
+    if (stopped_)
+    {
+      return;
+    }
+    Task task = std::move(queue_.front());
+    queue_.pop_front();
+    lock.unlock();
+
+    util::CryptoNight::Hash hash = cryptoNight.hash(task.job.getBlob(), task.job.getBlobSize());
+    bool valid = std::memcmp(hash.data(), task.result.data(), hash.size()) == 0;
+    dispatcher_(
+      [this, login = std::move(task.login), valid, verdictHandler = std::move(task.verdictHandler)]()
+      {
+        handleVerdict(login, valid, verdictHandler);
+      });
+
+    lock.lock();
+  }
+}
+
+void ShareVerifier::handleVerdict(const std::string& login, bool valid, const VerdictHandler& verdictHandler)
+{
+  ++statistics_.verified;
+  MinerHistory& history = getHistory(login);
+  if (valid)
+  {
+    if (history.validShares < PROBATION_SHARES && ++history.validShares == PROBATION_SHARES)
+    {
+      history.sampleRate = getConfiguredSampleRate(login);
+    }
+  }
+  else
+  {
+    ++statistics_.invalid;
+    std::cout << "proxy::ShareVerifier::handleVerdict, invalid result, " << login << std::endl;
+    history.sampleRate = 1.0;
+    history.validShares = 0;
+  }
+  verdictHandler(valid);
+}
+
+ShareVerifier::MinerHistory& ShareVerifier::getHistory(const std::string& login)
+{
+  auto history = histories_.find(login);
+  if (history == histories_.end())
+  {
+    history = histories_.emplace(login, MinerHistory{getConfiguredSampleRate(login), PROBATION_SHARES}).first;
+  }
+  return history->second;
+}
+
+double ShareVerifier::getConfiguredSampleRate(const std::string& login) const
+{
+  auto minerSampleRate = verification_.minerSampleRates_.find(login);
+  return minerSampleRate != verification_.minerSampleRates_.end() ? minerSampleRate->second
+                                                                  : verification_.sampleRate_;
+}
+
+bool ShareVerifier::getMajorVersion(const stratum::Job& job, uint64_t& majorVersion)
+{
+  majorVersion = 0;
+  for (std::size_t i = 0; i < job.getBlobSize() && i < 10; ++i)
+  {
+    uint8_t byte = job.getBlob()[i];
+    majorVersion |= static_cast<uint64_t>(byte & 0x7f) << (7 * i);
+    if (!(byte & 0x80))
+    {
+      return true;
+    }
+  }
+  return false;
+}
+
+} // namespace proxy
+} // namespace ses
@@ -0,0 +1,122 @@
+#ifndef SES_PROXY_SHAREVERIFIER_HPP
+#define SES_PROXY_SHAREVERIFIER_HPP
+
+#include <array>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "stratum/job.hpp"
+
+namespace ses {
+namespace proxy {
+
+struct ShareVerification
+{
+  // share of the shares verified, miners with a bad history get all theirs verified regardless
+  double sampleRate_;
+  std::size_t threadCount_;
+  // sample rates by login, overriding sampleRate_
+  std::map<std::string, double> minerSampleRates_;
+  // blobs up to this major version are hashed with cn/0, later ones go unverified
+  uint64_t maxMajorVersion_;
+};
+
+/**
+ * Recomputes the CryptoNight hash of sampled shares from the job's blob with the nonce patched in,
+ * so a miner reporting results its nonce does not hash to is caught before the pool holds its
+ * shares against the proxy's account. Only cn/0 is implemented, shares of blobs whose major version
+ * is past maxMajorVersion_ are accepted unverified and counted as unsupported instead of being
+ * rejected for a hash of the wrong algorithm.
+ *
+ * Hashing runs on worker threads with a hasher, and so a scratchpad, each allocated once. The
+ * server thread only enqueues, a share arriving while QUEUE_CAPACITY shares wait goes unverified
+ * and is counted as skipped. Verdicts are dispatched back to the server thread, which keeps the
+ * history of the miners by login: a miner caught with an invalid result has all its shares
+ * verified until PROBATION_SHARES in a row were valid, also across reconnects.
+ */
+class ShareVerifier
+{
+public:
+  typedef std::shared_ptr<ShareVerifier> Ptr;
+  typedef std::function<void(const std::function<void()>&)> Dispatcher;
+  typedef std::function<void(bool valid)> VerdictHandler;
+
+  static const std::size_t QUEUE_CAPACITY = 256;
+  static const uint32_t PROBATION_SHARES = 64;
+
+  struct Statistics
+  {
+    uint64_t verified;
+    uint64_t invalid;
+    uint64_t skipped;
+    uint64_t unsupported;
+  };
+
+public:
+  // verdicts are passed to the dispatcher, which runs them on the server thread
+  ShareVerifier(const ShareVerification& verification, const Dispatcher& dispatcher);
+  ~ShareVerifier();
+
+  // whether the next share of the miner is to be verified, only to be called on the server thread
+  bool sample(const std::string& login);
+
+  // verifies that the job's blob with nonce hashes to result, false if the share is skipped or
+  // its blob is not known to be cn/0
+  bool verify(const std::string& login, const stratum::Job& job, uint32_t nonce, const uint8_t* result,
+              const VerdictHandler& verdictHandler);
+
+  // only to be called on the server thread
+  Statistics getStatistics() const;
+
+private:
+  struct Task
+  {
+    std::string login;
+    stratum::Job job;
+    std::array<uint8_t, 32> result;
+    VerdictHandler verdictHandler;
+  };
+
+  struct MinerHistory
+  {
+    double sampleRate;
+    // valid shares in a row since the last invalid one
+    uint32_t validShares;
+  };
+
+  void run();
+  void handleVerdict(const std::string& login, bool valid, const VerdictHandler& verdictHandler);
+  MinerHistory& getHistory(const std::string& login);
+  double getConfiguredSampleRate(const std::string& login) const;
+  // the varint the blob starts with, false if the blob ends before it does
+  static bool getMajorVersion(const stratum::Job& job, uint64_t& majorVersion);
+
+private:
+  ShareVerification verification_;
+  Dispatcher dispatcher_;
+
+  // only touched on the server thread
+  std::map<std::string, MinerHistory> histories_;
+  std::minstd_rand random_;
+  Statistics statistics_;
+
+  std::mutex queueMutex_;
+  std::condition_variable queueCondition_;
+  std::deque<Task> queue_;
+  bool stopped_;
+  std::vector<std::thread> workers_;
+};
+
+} // namespace proxy
+} // namespace ses
+
+#endif //SES_PROXY_SHAREVERIFIER_HPP
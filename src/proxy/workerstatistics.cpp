@@ -0,0 +1,257 @@
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <map>
+
+#include "proxy/workerstatistics.hpp"
+
+namespace ses {
+namespace proxy {
+
+namespace {
+const uint64_t INVALID_BUCKET = UINT64_MAX;
+
+std::atomic<uint64_t> nextIdentifier(1);
+
+// the shard a thread records into, handed back when the thread ends
+struct ThreadShard
+{
+  ~ThreadShard()
+  {
+    release();
+  }
+
+  void release()
+  {
+    if (shard)
+    {
+      shard->store(false, std::memory_order_release);
+    }
+  }
+
+  uint64_t statistics = 0;
+  std::shared_ptr<void> keepAlive;
+  std::atomic<bool>* shard = nullptr;
+  void* pointer = nullptr;
+};
+thread_local ThreadShard threadShard;
+
+// increments a counter only its owner thread writes, so no locked instruction is needed
+inline void increment(std::atomic<uint64_t>& counter)
+{
+  counter.store(counter.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+}
+}
+
+const WorkerStatistics::WindowLayout WorkerStatistics::WINDOWS[WINDOW_COUNT] = {
+  {5, 12, 0}, {60, 15, 12}, {300, 12, 27}, {3600, 24, 39}};
+
+WorkerStatistics::Shard::Shard()
+  : owned(true)
+{
+  for (auto& worker : workers)
+  {
+    worker.store(nullptr, std::memory_order_relaxed);
+  }
+}
+
+WorkerStatistics::Shard::~Shard()
+{
+  for (auto& worker : workers)
+  {
+    delete worker.load(std::memory_order_relaxed);
+  }
+}
+
+WorkerStatistics::Worker* WorkerStatistics::Shard::find(const char* name, uint64_t nameHash, bool create)
+{
+  const std::size_t nameSize = sizeof(Worker::name);
+  for (std::size_t probe = 0; probe < WORKERS_PER_SHARD; ++probe)
+  {
+    std::atomic<Worker*>& slot = workers[(nameHash + probe) & (WORKERS_PER_SHARD - 1)];
+    Worker* worker = slot.load(std::memory_order_acquire);
+    if (!worker)
+    {
+      if (!create)
+      {
+        return nullptr;
+      }
+      // only the owner inserts, readers see the worker once it is complete
+      worker = new Worker();
+      std::memcpy(worker->name, name, nameSize);
+      worker->nameHash = nameHash;
+      worker->accepted.store(0, std::memory_order_relaxed);
+      worker->rejected.store(0, std::memory_order_relaxed);
+      worker->stale.store(0, std::memory_order_relaxed);
+      for (Bucket& bucket : worker->buckets)
+      {
+        bucket.index.store(INVALID_BUCKET, std::memory_order_relaxed);
+        bucket.difficulty.store(0, std::memory_order_relaxed);
+      }
+      slot.store(worker, std::memory_order_release);
+      return worker;
+    }
+    if (worker->nameHash == nameHash && std::memcmp(worker->name, name, nameSize) == 0)
+    {
+      return worker;
+    }
+  }
+  return nullptr;
+}
+
+WorkerStatistics::WorkerStatistics()
+  : identifier_(nextIdentifier.fetch_add(1))
+{
+}
+
+void WorkerStatistics::record(const ShareJournal::Record& share, ShareJournal::Outcome outcome)
+{
+  Worker* worker = getShard().find(share.worker, share.workerHash, true);
+  if (!worker)
+  {
+    return;
+  }
+
+  if (outcome == ShareJournal::OUTCOME_STALE)
+  {
+    increment(worker->stale);
+    return;
+  }
+  if (outcome != ShareJournal::OUTCOME_ACCEPTED)
+  {
+    increment(worker->rejected);
+    return;
+  }
+
+  increment(worker->accepted);
+  uint64_t seconds = share.timestamp / 1000000000;
+  for (const WindowLayout& window : WINDOWS)
+  {
+    uint64_t index = seconds / window.bucketSeconds;
+    Bucket& bucket = worker->buckets[window.firstBucket + index % window.bucketCount];
+    if (bucket.index.load(std::memory_order_relaxed) == index)
+    {
+      bucket.difficulty.store(bucket.difficulty.load(std::memory_order_relaxed) + share.difficulty,
+                              std::memory_order_relaxed);
+    }
+    else
+    {
+      // invalidated while reused, so readers never add a stale sum to the new bucket
+      bucket.index.store(INVALID_BUCKET, std::memory_order_relaxed);
+      std::atomic_thread_fence(std::memory_order_release);
+      bucket.difficulty.store(share.difficulty, std::memory_order_relaxed);
+      bucket.index.store(index, std::memory_order_release);
+    }
+  }
+}
+
+std::vector<WorkerStatistics::Summary> WorkerStatistics::collect() const
+{
+  uint64_t now = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::seconds>(
+    std::chrono::system_clock::now().time_since_epoch()).count());
+
+  // the same worker has counters in each shard it was recorded into
+  std::map<std::pair<std::string, uint64_t>, Summary> summaries;
+  std::lock_guard<std::mutex> lock(shardsMutex_);
+  for (const auto& shard : shards_)
+  {
+    for (const auto& slot : shard->workers)
+    {
+      const Worker* worker = slot.load(std::memory_order_acquire);
+      if (!worker)
+      {
+        continue;
+      }
+
+      std::string name(worker->name, strnlen(worker->name, sizeof(worker->name)));
+      auto inserted = summaries.emplace(std::make_pair(name, worker->nameHash), Summary{name, 0, 0, 0, {}});
+      Summary& summary = inserted.first->second;
+      summary.accepted += worker->accepted.load(std::memory_order_relaxed);
+      summary.rejected += worker->rejected.load(std::memory_order_relaxed);
+      summary.stale += worker->stale.load(std::memory_order_relaxed);
+
+      for (int window = 0; window < WINDOW_COUNT; ++window)
+      {
+        const WindowLayout& layout = WINDOWS[window];
+        uint64_t current = now / layout.bucketSeconds;
+        double difficulty = 0;
+        for (uint32_t i = 0; i < layout.bucketCount; ++i)
+        {
+          const Bucket& bucket = worker->buckets[layout.firstBucket + i];
+          uint64_t index = bucket.index.load(std::memory_order_acquire);
+          double bucketDifficulty = bucket.difficulty.load(std::memory_order_relaxed);
+          std::atomic_thread_fence(std::memory_order_acquire);
+          if (index != INVALID_BUCKET && index == bucket.index.load(std::memory_order_relaxed) &&
+              index <= current && index + layout.bucketCount > current)
+          {
+            difficulty += bucketDifficulty;
+          }
+        }
+        double seconds = (layout.bucketCount - 1) * layout.bucketSeconds + now % layout.bucketSeconds + 1;
+        summary.hashrate[window] += difficulty / seconds;
+      }
+    }
+  }
+
+  std::vector<Summary> result;
+  result.reserve(summaries.size());
+  for (auto& summary : summaries)
+  {
+    result.push_back(summary.second);
+  }
+  return result;
+}
+
+const char* WorkerStatistics::toString(Window window)
+{
+  switch (window)
+  {
+    case WINDOW_1M:
+      return "1m";
+    case WINDOW_15M:
+      return "15m";
+    case WINDOW_1H:
+      return "1h";
+    case WINDOW_24H:
+      return "24h";
+    default:
+      return "unknown";
+  }
+}
+
+WorkerStatistics::Shard& WorkerStatistics::getShard()
+{
+  if (threadShard.statistics == identifier_)
+  {
+    return *static_cast<Shard*>(threadShard.pointer);
+  }
+
+  // first share of this thread, takes over the shard of an ended thread or adds one
+  threadShard.release();
+  std::shared_ptr<Shard> shard;
+  {
+    std::lock_guard<std::mutex> lock(shardsMutex_);
+    for (const auto& candidate : shards_)
+    {
+      bool owned = false;
+      if (candidate->owned.compare_exchange_strong(owned, true, std::memory_order_acquire))
+      {
+        shard = candidate;
+        break;
+      }
+    }
+    if (!shard)
+    {
+      shard = std::make_shared<Shard>();
+      shards_.push_back(shard);
+    }
+  }
+  threadShard.statistics = identifier_;
+  threadShard.keepAlive = shard;
+  threadShard.shard = &shard->owned;
+  threadShard.pointer = shard.get();
+  return *shard;
+}
+
+} // namespace proxy
+} // namespace ses
@@ -0,0 +1,114 @@
+#ifndef SES_PROXY_WORKERSTATISTICS_HPP
+#define SES_PROXY_WORKERSTATISTICS_HPP
+
+#include <atomic>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "proxy/sharejournal.hpp"
+
+namespace ses {
+namespace proxy {
+
+/**
+ * Share counts and difficulty weighted hashrates per worker login over sliding windows. Workers are
+ * told apart by the journal record's name together with the hash of the whole login, so logins
+ * longer than the record keeps still count separately.
+ *
+ * Each thread recording shares owns a shard with the counters of the workers it has seen, so
+ * recording is a lookup plus plain stores without locks or contended atomics. Readers merge all
+ * shards. A window is a ring of time buckets; the current bucket is only partly filled, so a window
+ * covers its full length minus the unfilled part of that bucket.
+ */
+class WorkerStatistics
+{
+public:
+  typedef std::shared_ptr<WorkerStatistics> Ptr;
+
+  enum Window
+  {
+    WINDOW_1M,
+    WINDOW_15M,
+    WINDOW_1H,
+    WINDOW_24H,
+    WINDOW_COUNT
+  };
+
+  struct Summary
+  {
+    std::string worker;
+    uint64_t accepted;
+    uint64_t rejected;
+    uint64_t stale;
+    // accepted difficulty per second
+    double hashrate[WINDOW_COUNT];
+  };
+
+  // workers a single thread can tell apart, shares of further workers are not counted
+  static const std::size_t WORKERS_PER_SHARD = 4096;
+
+public:
+  WorkerStatistics();
+
+  // safe to call from any thread
+  void record(const ShareJournal::Record& share, ShareJournal::Outcome outcome);
+
+  // sorted by worker
+  std::vector<Summary> collect() const;
+
+  static const char* toString(Window window);
+
+private:
+  struct Bucket
+  {
+    std::atomic<uint64_t> index;
+    std::atomic<double> difficulty;
+  };
+
+  struct WindowLayout
+  {
+    uint32_t bucketSeconds;
+    uint32_t bucketCount;
+    uint32_t firstBucket;
+  };
+  static const WindowLayout WINDOWS[WINDOW_COUNT];
+  static const std::size_t BUCKETS = 12 + 15 + 12 + 24;
+
+  // written only by the thread owning the shard
+  struct Worker
+  {
+    char name[sizeof(ShareJournal::Record::worker)];
+    uint64_t nameHash;
+    std::atomic<uint64_t> accepted;
+    std::atomic<uint64_t> rejected;
+    std::atomic<uint64_t> stale;
+    Bucket buckets[BUCKETS];
+  };
+
+  struct Shard
+  {
+    Shard();
+    ~Shard();
+
+    Worker* find(const char* name, uint64_t nameHash, bool create);
+
+    std::atomic<bool> owned;
+    std::atomic<Worker*> workers[WORKERS_PER_SHARD];
+  };
+
+  Shard& getShard();
+
+private:
+  const uint64_t identifier_;
+  mutable std::mutex shardsMutex_;
+  std::list<std::shared_ptr<Shard>> shards_;
+};
+
+} // namespace proxy
+} // namespace ses
+
+#endif //SES_PROXY_WORKERSTATISTICS_HPP
@@ -0,0 +1,165 @@
+#include <algorithm>
+#include <cstring>
+
+#include "stratum/binary.hpp"
+
+namespace ses {
+namespace stratum {
+namespace binary {
+
+namespace {
+util::ArenaString createFrame(RecordType type, const void* payload, std::size_t payloadSize)
+{
+  net::frame::Header header{net::frame::MAGIC, type, static_cast<uint16_t>(payloadSize)};
+  util::ArenaString frame = util::makeArenaString();
+  frame.reserve(sizeof(header) + payloadSize);
+  frame.append(reinterpret_cast<const char*>(&header), sizeof(header));
+  frame.append(static_cast<const char*>(payload), payloadSize);
+  return frame;
+}
+
+// record fields are not trusted to be terminated
+void copyString(char* out, std::size_t outSize, const std::string& string)
+{
+  std::memset(out, 0, outSize);
+  std::memcpy(out, string.data(), std::min(outSize - 1, string.size()));
+}
+
+template<typename RECORD>
+bool readRecord(const char* payload, std::size_t payloadSize, RECORD& record)
+{
+  if (payloadSize != sizeof(RECORD))
+  {
+    return false;
+  }
+  std::memcpy(&record, payload, sizeof(record));
+  return true;
+}
+
+// records in a batch are copied out of the receive buffer to align them
+template<typename RECORD>
+bool readRecords(const char* payload, std::size_t payloadSize, std::vector<RECORD>& records)
+{
+  if (payloadSize % sizeof(RECORD) != 0)
+  {
+    return false;
+  }
+  records.resize(payloadSize / sizeof(RECORD));
+  std::memcpy(records.data(), payload, payloadSize);
+  return true;
+}
+}
+
+bool isFrame(const char* data, std::size_t size)
+{
+  return size >= sizeof(net::frame::Header) && static_cast<uint8_t>(data[0]) == net::frame::MAGIC;
+}
+
+namespace server {
+
+void parseFrame(const char* data, std::size_t size, LoginHandler loginHandler, SharesHandler sharesHandler,
+                InvalidFrameHandler invalidFrameHandler)
+{
+  net::frame::Header header;
+  std::memcpy(&header, data, sizeof(header));
+  const char* payload = data + sizeof(header);
+  std::size_t payloadSize = size - sizeof(header);
+
+  LoginRecord login;
+  std::vector<ShareRecord> shares;
+  if (header.type == RECORD_TYPE_LOGIN && readRecord(payload, payloadSize, login))
+  {
+    login.user[sizeof(login.user) - 1] = 0;
+    login.pass[sizeof(login.pass) - 1] = 0;
+    login.agent[sizeof(login.agent) - 1] = 0;
+    loginHandler(login);
+  }
+  else if (header.type == RECORD_TYPE_SHARES && readRecords(payload, payloadSize, shares))
+  {
+    sharesHandler(shares.data(), shares.size());
+  }
+  else
+  {
+    invalidFrameHandler();
+  }
+}
+
+util::ArenaString createLoginResult(bool accepted, const std::string& message)
+{
+  LoginResultRecord record;
+  record.accepted = accepted ? 1 : 0;
+  copyString(record.message, sizeof(record.message), message);
+  return createFrame(RECORD_TYPE_LOGIN_RESULT, &record, sizeof(record));
+}
+
+util::ArenaString createJob(const Job& job, uint32_t sequence, uint8_t firstSlot, uint16_t slotCount)
+{
+  JobRecord record;
+  std::memset(&record, 0, sizeof(record));
+  record.target = job.getTarget();
+  record.sequence = sequence;
+  record.slotCount = slotCount;
+  record.firstSlot = firstSlot;
+  record.blobSize = static_cast<uint8_t>(job.getBlobSize());
+  std::memcpy(record.blob, job.getBlob(), job.getBlobSize());
+  return createFrame(RECORD_TYPE_JOB, &record, sizeof(record));
+}
+
+util::ArenaString createShareResults(const std::vector<ShareResultRecord>& results)
+{
+  return createFrame(RECORD_TYPE_SHARE_RESULTS, results.data(), results.size() * sizeof(ShareResultRecord));
+}
+
+} // namespace server
+
+namespace client {
+
+util::ArenaString createLogin(const std::string& user, const std::string& pass, const std::string& agent,
+                              uint16_t slotCount)
+{
+  LoginRecord record;
+  copyString(record.user, sizeof(record.user), user);
+  copyString(record.pass, sizeof(record.pass), pass);
+  copyString(record.agent, sizeof(record.agent), agent);
+  record.slotCount = slotCount;
+  return createFrame(RECORD_TYPE_LOGIN, &record, sizeof(record));
+}
+
+util::ArenaString createShares(const std::vector<ShareRecord>& shares)
+{
+  return createFrame(RECORD_TYPE_SHARES, shares.data(), shares.size() * sizeof(ShareRecord));
+}
+
+void parseFrame(const char* data, std::size_t size, LoginResultHandler loginResultHandler, JobHandler jobHandler,
+                ShareResultsHandler shareResultsHandler)
+{
+  net::frame::Header header;
+  std::memcpy(&header, data, sizeof(header));
+  const char* payload = data + sizeof(header);
+  std::size_t payloadSize = size - sizeof(header);
+
+  LoginResultRecord loginResult;
+  JobRecord job;
+  std::vector<ShareResultRecord> results;
+  if (header.type == RECORD_TYPE_LOGIN_RESULT && readRecord(payload, payloadSize, loginResult))
+  {
+    loginResult.message[sizeof(loginResult.message) - 1] = 0;
+    loginResultHandler(loginResult.accepted != 0, loginResult.message);
+  }
+  else if (header.type == RECORD_TYPE_JOB && readRecord(payload, payloadSize, job) &&
+           job.blobSize <= Job::BLOB_SIZE_MAX)
+  {
+    jobHandler(Job::create(job.blob, job.blobSize, std::to_string(job.sequence), job.target),
+               job.firstSlot, job.slotCount);
+  }
+  else if (header.type == RECORD_TYPE_SHARE_RESULTS && readRecords(payload, payloadSize, results))
+  {
+    shareResultsHandler(results.data(), results.size());
+  }
+}
+
+} // namespace client
+
+} // namespace binary
+} // namespace stratum
+} // namespace ses
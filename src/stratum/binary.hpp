@@ -0,0 +1,125 @@
+#ifndef SES_STRATUM_BINARY_HPP
+#define SES_STRATUM_BINARY_HPP
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "net/frame.hpp"
+#include "stratum/job.hpp"
+#include "util/arena.hpp"
+
+namespace ses {
+namespace stratum {
+namespace binary {
+
+/**
+ * Binary protocol between proxies for CryptoNote jobs. A leaf proxy logs in as one worker asking for a
+ * range of nonce slots, the highest nonce bytes it may hand out to its own miners. Jobs, shares and
+ * share results travel as fixed layout little endian records in net::frame frames, shares and results
+ * batched several records to a frame. Jobs are referred to by a sequence number instead of their id.
+ */
+
+static_assert(__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__, "records are sent in host byte order");
+
+enum RecordType : uint8_t
+{
+  RECORD_TYPE_LOGIN = 1,
+  RECORD_TYPE_LOGIN_RESULT,
+  RECORD_TYPE_JOB,
+  RECORD_TYPE_SHARES,
+  RECORD_TYPE_SHARE_RESULTS
+};
+
+struct LoginRecord
+{
+  char user[112];
+  char pass[32];
+  char agent[30];
+  // a power of two, the nonce slots the leaf asks for
+  uint16_t slotCount;
+};
+
+struct LoginResultRecord
+{
+  uint8_t accepted;
+  char message[63];
+};
+
+struct JobRecord
+{
+  uint64_t target;
+  uint32_t sequence;
+  // the nonce slots granted, the blob's nonce starts at firstSlot << 24
+  uint16_t slotCount;
+  uint8_t firstSlot;
+  uint8_t blobSize;
+  uint8_t blob[Job::BLOB_SIZE_MAX];
+  uint8_t reserved[4];
+};
+
+struct ShareRecord
+{
+  uint32_t sequence;
+  uint32_t jobSequence;
+  uint32_t nonce;
+  uint8_t result[32];
+};
+
+struct ShareResultRecord
+{
+  uint32_t sequence;
+  uint8_t accepted;
+  uint8_t reserved[3];
+};
+
+static_assert(sizeof(LoginRecord) == 176, "unexpected record layout");
+static_assert(sizeof(LoginResultRecord) == 64, "unexpected record layout");
+static_assert(sizeof(JobRecord) == 104, "unexpected record layout");
+static_assert(sizeof(ShareRecord) == 44, "unexpected record layout");
+static_assert(sizeof(ShareResultRecord) == 8, "unexpected record layout");
+
+// a batch is bounded by the frame's payload size
+const std::size_t SHARES_PER_FRAME_MAX = net::frame::PAYLOAD_SIZE_MAX / sizeof(ShareRecord);
+
+bool isFrame(const char* data, std::size_t size);
+
+// created frames live in the arena of the calling thread like net::jsonrpc messages
+
+namespace server {
+
+typedef std::function<void(const LoginRecord& login)> LoginHandler;
+typedef std::function<void(const ShareRecord* shares, std::size_t count)> SharesHandler;
+typedef std::function<void()> InvalidFrameHandler;
+
+void parseFrame(const char* data, std::size_t size, LoginHandler loginHandler, SharesHandler sharesHandler,
+                InvalidFrameHandler invalidFrameHandler);
+
+util::ArenaString createLoginResult(bool accepted, const std::string& message);
+util::ArenaString createJob(const Job& job, uint32_t sequence, uint8_t firstSlot, uint16_t slotCount);
+util::ArenaString createShareResults(const std::vector<ShareResultRecord>& results);
+
+} // namespace server
+
+namespace client {
+
+typedef std::function<void(bool accepted, const std::string& message)> LoginResultHandler;
+typedef std::function<void(const Job::Ptr& job, uint8_t firstSlot, uint16_t slotCount)> JobHandler;
+typedef std::function<void(const ShareResultRecord* results, std::size_t count)> ShareResultsHandler;
+
+util::ArenaString createLogin(const std::string& user, const std::string& pass, const std::string& agent,
+                              uint16_t slotCount);
+// at most SHARES_PER_FRAME_MAX shares
+util::ArenaString createShares(const std::vector<ShareRecord>& shares);
+
+void parseFrame(const char* data, std::size_t size, LoginResultHandler loginResultHandler, JobHandler jobHandler,
+                ShareResultsHandler shareResultsHandler);
+
+} // namespace client
+
+} // namespace binary
+} // namespace stratum
+} // namespace ses
+
+#endif //SES_STRATUM_BINARY_HPP
@@ -0,0 +1,267 @@
+#include <vector>
+#include <boost/lexical_cast.hpp>
+#include <boost/property_tree/ptree.hpp>
+#include <boost/property_tree/json_parser.hpp>
+
+#include "net/jsonrpc/jsonrpc.hpp"
+#include "util/allocationaccounting.hpp"
+#include "util/boostpropertytree.hpp"
+#include "stratum/bitcoin.hpp"
+
+namespace ses {
+namespace stratum {
+namespace bitcoin {
+namespace pt = boost::property_tree;
+
+namespace {
+// the values of a JSON array, nested arrays as empty strings
+std::vector<std::string> parseArray(const pt::ptree& tree)
+{
+  std::vector<std::string> values;
+  for (const auto& child : tree)
+  {
+    values.push_back(child.second.data());
+  }
+  return values;
+}
+
+std::vector<std::string> parseArray(const std::string& json)
+{
+  return parseArray(util::boostpropertytree::stringToPtree(json));
+}
+
+std::size_t parseSize(const std::string& value)
+{
+  try
+  {
+    return boost::lexical_cast<std::size_t>(value);
+  }
+  catch (...)
+  {
+    return 0;
+  }
+}
+
+namespace writer = net::jsonrpc::writer;
+
+template<typename SCHEMA, typename... VALUES>
+std::string create(const VALUES&... values)
+{
+  std::string json;
+  writer::Writer<SCHEMA>::write(json, values...);
+  return json;
+}
+}
+
+namespace server {
+
+bool isBitcoinMethod(const std::string& method)
+{
+  return method.compare(0, 7, "mining.") == 0;
+}
+
+void parseRequest(const std::string& jsonRequestId, const std::string& method, const std::string& params,
+                  SubscribeHandler subscribeHandler, AuthorizeHandler authorizeHandler, SubmitHandler submitHandler,
+                  ExtranonceSubscribeHandler extranonceSubscribeHandler, UnknownMethodHandler unknownMethodHandler)
+{
+  std::vector<std::string> values;
+  {
+    // the handlers account for themselves
+    util::AllocationAccounting::Scope accountingScope(util::AllocationAccounting::SUBSYSTEM_STRATUM);
+    values = parseArray(params);
+    values.resize(std::max<std::size_t>(values.size(), 5));
+  }
+  if (method == "mining.subscribe")
+  {
+    subscribeHandler(jsonRequestId, values[0]);
+  }
+  else if (method == "mining.authorize")
+  {
+    authorizeHandler(jsonRequestId, values[0], values[1]);
+  }
+  else if (method == "mining.submit")
+  {
+    submitHandler(jsonRequestId, values[0], values[1], values[2], values[3], values[4]);
+  }
+  else if (method == "mining.extranonce.subscribe")
+  {
+    extranonceSubscribeHandler(jsonRequestId);
+  }
+  else
+  {
+    unknownMethodHandler(jsonRequestId);
+  }
+}
+
+std::string createSubscribeResult(const std::string& subscriptionId, const std::string& extranonce1,
+                                  std::size_t extranonce2Size)
+{
+  typedef writer::Array<writer::Array<writer::Array<writer::Constant<"\"mining.set_difficulty\"">, writer::String>,
+                                      writer::Array<writer::Constant<"\"mining.notify\"">, writer::String>>,
+                        writer::String, writer::Integer> SubscribeResult;
+  return create<SubscribeResult>(subscriptionId, subscriptionId, extranonce1, extranonce2Size);
+}
+
+std::string createSetDifficultyParams(double difficulty)
+{
+  return create<writer::Array<writer::Number>>(difficulty);
+}
+
+std::string createNotifyParams(const BitcoinJob& job, bool cleanJobs)
+{
+  typedef writer::Array<writer::String, writer::String, writer::String, writer::String, writer::Strings,
+                        writer::String, writer::String, writer::String, writer::Boolean> NotifyParams;
+  return create<NotifyParams>(job.getJobId(), job.getPreviousHash(), job.getCoinbase1(), job.getCoinbase2(),
+                              job.getMerkleBranches(), job.getVersion(), job.getBits(), job.getTime(), cleanJobs);
+}
+
+std::string createSetExtranonceParams(const std::string& extranonce1, std::size_t extranonce2Size)
+{
+  return create<writer::Array<writer::String, writer::Integer>>(extranonce1, extranonce2Size);
+}
+
+std::string createError(int code, const std::string& message)
+{
+  return create<writer::Array<writer::Integer, writer::String, writer::Constant<"null">>>(code, message);
+}
+
+} // namespace server
+
+namespace client {
+
+namespace {
+// pools send [code, message, traceback], some an object with code and message
+void parseError(const std::string& error, ErrorHandler& handler)
+{
+  pt::ptree tree = util::boostpropertytree::stringToPtree(error);
+  if (tree.empty())
+  {
+    handler(ERROR_OTHER, error);
+  }
+  else if (tree.begin()->first.empty())
+  {
+    std::vector<std::string> values = parseArray(tree);
+    values.resize(std::max<std::size_t>(values.size(), 2));
+    handler(static_cast<int>(parseSize(values[0])), values[1]);
+  }
+  else
+  {
+    handler(tree.get<int>("code", ERROR_OTHER), tree.get<std::string>("message", ""));
+  }
+}
+
+void parseBooleanResponse(const std::string& result, const std::string& error,
+                          const std::function<void()>& successHandler, ErrorHandler& errorHandler,
+                          const std::string& rejection)
+{
+  if (!error.empty())
+  {
+    parseError(error, errorHandler);
+  }
+  else if (result == "true")
+  {
+    successHandler();
+  }
+  else
+  {
+    errorHandler(ERROR_OTHER, rejection);
+  }
+}
+}
+
+std::string createSubscribeParams(const std::string& agent)
+{
+  return create<writer::Array<writer::String>>(agent);
+}
+
+void parseSubscribeResponse(const std::string& result, const std::string& error,
+                            SubscribeSuccessHandler successHandler, ErrorHandler errorHandler)
+{
+  if (!error.empty())
+  {
+    parseError(error, errorHandler);
+    return;
+  }
+
+  // [[subscriptions], extranonce1, extranonce2 size]
+  std::vector<std::string> values = parseArray(result);
+  if (values.size() < 3 || parseSize(values[2]) == 0)
+  {
+    errorHandler(ERROR_OTHER, "Malformed subscribe response");
+  }
+  else
+  {
+    successHandler(values[1], parseSize(values[2]));
+  }
+}
+
+std::string createAuthorizeParams(const std::string& user, const std::string& pass)
+{
+  return create<writer::Array<writer::String, writer::String>>(user, pass);
+}
+
+void parseAuthorizeResponse(const std::string& result, const std::string& error,
+                            AuthorizeSuccessHandler successHandler, ErrorHandler errorHandler)
+{
+  parseBooleanResponse(result, error, successHandler, errorHandler, "Unauthorized worker");
+}
+
+std::string createSubmitParams(const std::string& user, const std::string& jobId, const std::string& extranonce2,
+                               const std::string& time, const std::string& nonce)
+{
+  return create<writer::Array<writer::String, writer::String, writer::String, writer::String, writer::String>>(
+    user, jobId, extranonce2, time, nonce);
+}
+
+void parseSubmitResponse(const std::string& result, const std::string& error,
+                         SubmitSuccessHandler successHandler, ErrorHandler errorHandler)
+{
+  parseBooleanResponse(result, error, successHandler, errorHandler, "Share rejected");
+}
+
+void parseNotification(const std::string& method, const std::string& params, NotifyHandler notifyHandler,
+                       SetDifficultyHandler setDifficultyHandler, SetExtranonceHandler setExtranonceHandler)
+{
+  std::vector<std::string> values;
+  BitcoinJob::Ptr job;
+  {
+    // the handlers account for themselves
+    util::AllocationAccounting::Scope accountingScope(util::AllocationAccounting::SUBSYSTEM_STRATUM);
+    pt::ptree tree = util::boostpropertytree::stringToPtree(params);
+    values = parseArray(tree);
+    if (method == "mining.notify" && values.size() >= 9)
+    {
+      // [job id, previous hash, coinbase 1, coinbase 2, [merkle branches], version, bits, time, clean jobs]
+      auto branches = std::next(tree.begin(), 4);
+      job = BitcoinJob::create(values[0], values[1], values[2], values[3], parseArray(branches->second),
+                               values[5], values[6], values[7], values[8] == "true");
+    }
+  }
+  if (method == "mining.notify" && values.size() >= 9)
+  {
+    if (job)
+    {
+      notifyHandler(job);
+    }
+  }
+  else if (method == "mining.set_difficulty" && !values.empty())
+  {
+    try
+    {
+      setDifficultyHandler(boost::lexical_cast<double>(values[0]));
+    }
+    catch (...)
+    {
+    }
+  }
+  else if (method == "mining.set_extranonce" && values.size() >= 2)
+  {
+    setExtranonceHandler(values[0], parseSize(values[1]));
+  }
+}
+
+} // namespace client
+
+} // namespace bitcoin
+} // namespace stratum
+} // namespace ses
@@ -0,0 +1,84 @@
+#ifndef SES_STRATUM_BITCOIN_HPP
+#define SES_STRATUM_BITCOIN_HPP
+
+#include <string>
+#include <functional>
+
+#include "stratum/bitcoinjob.hpp"
+
+namespace ses {
+namespace stratum {
+namespace bitcoin {
+
+/**
+ * Stratum v1 as spoken by bitcoin pools and miners. Unlike the CryptoNote dialect its params and results
+ * carry typed JSON values, so the created strings are meant for the net::jsonrpc *V1 framing.
+ */
+
+// stratum v1 error codes
+const int ERROR_OTHER = 20;
+const int ERROR_JOB_NOT_FOUND = 21;
+const int ERROR_DUPLICATE_SHARE = 22;
+const int ERROR_LOW_DIFFICULTY_SHARE = 23;
+const int ERROR_UNAUTHORIZED_WORKER = 24;
+const int ERROR_NOT_SUBSCRIBED = 25;
+
+namespace server {
+
+typedef std::function<void(const std::string& jsonRequestId, const std::string& agent)> SubscribeHandler;
+typedef std::function<void(const std::string& jsonRequestId, const std::string& user,
+                           const std::string& pass)> AuthorizeHandler;
+typedef std::function<void(const std::string& jsonRequestId, const std::string& worker, const std::string& jobId,
+                           const std::string& extranonce2, const std::string& time,
+                           const std::string& nonce)> SubmitHandler;
+typedef std::function<void(const std::string& jsonRequestId)> ExtranonceSubscribeHandler;
+typedef std::function<void(const std::string& jsonRequestId)> UnknownMethodHandler;
+
+// stratum v1 methods all live in the mining. namespace
+bool isBitcoinMethod(const std::string& method);
+
+void parseRequest(const std::string& jsonRequestId, const std::string& method, const std::string& params,
+                  SubscribeHandler subscribeHandler, AuthorizeHandler authorizeHandler, SubmitHandler submitHandler,
+                  ExtranonceSubscribeHandler extranonceSubscribeHandler, UnknownMethodHandler unknownMethodHandler);
+
+std::string createSubscribeResult(const std::string& subscriptionId, const std::string& extranonce1,
+                                  std::size_t extranonce2Size);
+std::string createSetDifficultyParams(double difficulty);
+std::string createNotifyParams(const BitcoinJob& job, bool cleanJobs);
+std::string createSetExtranonceParams(const std::string& extranonce1, std::size_t extranonce2Size);
+std::string createError(int code, const std::string& message);
+
+} // namespace server
+
+
+namespace client {
+typedef std::function<void(int code, const std::string& message)> ErrorHandler;
+
+std::string createSubscribeParams(const std::string& agent);
+typedef std::function<void(const std::string& extranonce1, std::size_t extranonce2Size)> SubscribeSuccessHandler;
+void parseSubscribeResponse(const std::string& result, const std::string& error,
+                            SubscribeSuccessHandler successHandler, ErrorHandler errorHandler);
+
+std::string createAuthorizeParams(const std::string& user, const std::string& pass);
+typedef std::function<void()> AuthorizeSuccessHandler;
+void parseAuthorizeResponse(const std::string& result, const std::string& error,
+                            AuthorizeSuccessHandler successHandler, ErrorHandler errorHandler);
+
+std::string createSubmitParams(const std::string& user, const std::string& jobId, const std::string& extranonce2,
+                               const std::string& time, const std::string& nonce);
+typedef std::function<void()> SubmitSuccessHandler;
+void parseSubmitResponse(const std::string& result, const std::string& error,
+                         SubmitSuccessHandler successHandler, ErrorHandler errorHandler);
+
+typedef std::function<void(const BitcoinJob::Ptr& job)> NotifyHandler;
+typedef std::function<void(double difficulty)> SetDifficultyHandler;
+typedef std::function<void(const std::string& extranonce1, std::size_t extranonce2Size)> SetExtranonceHandler;
+void parseNotification(const std::string& method, const std::string& params, NotifyHandler notifyHandler,
+                       SetDifficultyHandler setDifficultyHandler, SetExtranonceHandler setExtranonceHandler);
+} // namespace client
+
+} // namespace bitcoin
+} // namespace stratum
+} // namespace ses
+
+#endif //SES_STRATUM_BITCOIN_HPP
@@ -0,0 +1,199 @@
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+
+#include "util/hex.hpp"
+#include "stratum/bitcoinjob.hpp"
+
+namespace ses {
+namespace stratum {
+
+namespace {
+const std::size_t VERSION_OFFSET = 0;
+const std::size_t PREVIOUS_HASH_OFFSET = 4;
+const std::size_t MERKLE_ROOT_OFFSET = 36;
+const std::size_t TIME_OFFSET = 68;
+const std::size_t BITS_OFFSET = 72;
+const std::size_t NONCE_OFFSET = 76;
+
+// stratum sends header integers as big endian hex, the header stores them little endian
+bool decodeUint32(const std::string& hex, uint8_t* out)
+{
+  if (hex.size() != 8 || !util::hex::decode(hex, out))
+  {
+    return false;
+  }
+  std::reverse(out, out + 4);
+  return true;
+}
+
+// the previous hash comes as eight words in reversed byte order
+bool decodePreviousHash(const std::string& hex, uint8_t* out)
+{
+  if (hex.size() != 2 * util::Sha256::HASH_SIZE || !util::hex::decode(hex, out))
+  {
+    return false;
+  }
+  for (std::size_t word = 0; word < util::Sha256::HASH_SIZE; word += 4)
+  {
+    std::reverse(out + word, out + word + 4);
+  }
+  return true;
+}
+}
+
+BitcoinJob::Ptr BitcoinJob::create(const std::string& jobId, const std::string& previousHash,
+                                   const std::string& coinbase1, const std::string& coinbase2,
+                                   const std::vector<std::string>& merkleBranches,
+                                   const std::string& version, const std::string& bits, const std::string& time,
+                                   bool cleanJobs)
+{
+  Ptr job(new BitcoinJob());
+  std::vector<uint8_t> coinbase1Bytes(coinbase1.size() / 2);
+  job->coinbase2Bytes_.resize(coinbase2.size() / 2);
+  if (jobId.empty() ||
+      !decodeUint32(version, job->header_ + VERSION_OFFSET) ||
+      !decodePreviousHash(previousHash, job->header_ + PREVIOUS_HASH_OFFSET) ||
+      !decodeUint32(time, job->header_ + TIME_OFFSET) ||
+      !decodeUint32(bits, job->header_ + BITS_OFFSET) ||
+      !util::hex::decode(coinbase1, coinbase1Bytes.data()) ||
+      !util::hex::decode(coinbase2, job->coinbase2Bytes_.data()) ||
+      !job->merkleBranches_.parse(merkleBranches))
+  {
+    return Ptr();
+  }
+
+  job->coinbase1State_.update(coinbase1Bytes.data(), coinbase1Bytes.size());
+  job->jobId_ = jobId;
+  job->previousHash_ = previousHash;
+  job->coinbase1_ = coinbase1;
+  job->coinbase2_ = coinbase2;
+  job->merkleBranchHexStrings_ = merkleBranches;
+  job->version_ = version;
+  job->bits_ = bits;
+  job->time_ = time;
+  job->cleanJobs_ = cleanJobs;
+  return job;
+}
+
+const std::string& BitcoinJob::getJobId() const
+{
+  return jobId_;
+}
+
+const std::string& BitcoinJob::getPreviousHash() const
+{
+  return previousHash_;
+}
+
+const std::string& BitcoinJob::getCoinbase1() const
+{
+  return coinbase1_;
+}
+
+const std::string& BitcoinJob::getCoinbase2() const
+{
+  return coinbase2_;
+}
+
+const std::vector<std::string>& BitcoinJob::getMerkleBranches() const
+{
+  return merkleBranchHexStrings_;
+}
+
+const std::string& BitcoinJob::getVersion() const
+{
+  return version_;
+}
+
+const std::string& BitcoinJob::getBits() const
+{
+  return bits_;
+}
+
+const std::string& BitcoinJob::getTime() const
+{
+  return time_;
+}
+
+bool BitcoinJob::isClean() const
+{
+  return cleanJobs_;
+}
+
+void BitcoinJob::setExtranonce(const std::string& extranonce1, std::size_t extranonce2Size)
+{
+  extranonce1_ = extranonce1;
+  extranonce2Size_ = extranonce2Size;
+}
+
+const std::string& BitcoinJob::getExtranonce1() const
+{
+  return extranonce1_;
+}
+
+std::size_t BitcoinJob::getExtranonce2Size() const
+{
+  return extranonce2Size_;
+}
+
+void BitcoinJob::setDifficulty(double difficulty)
+{
+  difficulty_ = difficulty;
+}
+
+double BitcoinJob::getDifficulty() const
+{
+  return difficulty_;
+}
+
+bool BitcoinJob::hashHeader(const std::string& extranonce1, const std::string& extranonce2,
+                            const std::string& time, const std::string& nonce, util::Sha256::Hash& hash) const
+{
+  uint8_t extranonce[2 * EXTRANONCE_SIZE_MAX];
+  uint8_t header[HEADER_SIZE];
+  std::size_t extranonce1Size = extranonce1.size() / 2;
+  if (extranonce1Size + extranonce2.size() / 2 > sizeof(extranonce) ||
+      !util::hex::decode(extranonce1, extranonce) ||
+      !util::hex::decode(extranonce2, extranonce + extranonce1Size))
+  {
+    return false;
+  }
+
+  std::memcpy(header, header_, HEADER_SIZE);
+  if (!decodeUint32(time, header + TIME_OFFSET) || !decodeUint32(nonce, header + NONCE_OFFSET))
+  {
+    return false;
+  }
+
+  util::Sha256 coinbase = coinbase1State_;
+  coinbase.update(extranonce, extranonce1Size + extranonce2.size() / 2);
+  coinbase.update(coinbase2Bytes_.data(), coinbase2Bytes_.size());
+  util::Sha256::Hash coinbaseHash = coinbase.finalize();
+  coinbaseHash = util::Sha256::hash(coinbaseHash.data(), coinbaseHash.size());
+
+  util::Sha256::Hash merkleRoot = merkleBranches_.computeRoot(coinbaseHash);
+  std::memcpy(header + MERKLE_ROOT_OFFSET, merkleRoot.data(), merkleRoot.size());
+
+  hash = util::Sha256::doubleHash(header, HEADER_SIZE);
+  return true;
+}
+
+double BitcoinJob::getHashDifficulty(const util::Sha256::Hash& hash)
+{
+  double value = 0;
+  for (std::size_t i = hash.size(); i > 0; --i)
+  {
+    value = value * 256 + hash[i - 1];
+  }
+  if (value == 0)
+  {
+    return std::numeric_limits<double>::infinity();
+  }
+  // 0xffff * 2^208
+  return std::ldexp(65535.0, 208) / value;
+}
+
+} // namespace stratum
+} // namespace ses
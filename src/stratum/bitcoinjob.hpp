@@ -0,0 +1,87 @@
+#ifndef SES_STRATUM_BITCOINJOB_HPP
+#define SES_STRATUM_BITCOINJOB_HPP
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "stratum/merklebranches.hpp"
+#include "util/sha256.hpp"
+
+namespace ses {
+namespace stratum {
+
+/**
+ * The work of a mining.notify. Everything a share does not change is decoded once: the merkle branches,
+ * the header fields and the SHA-256 midstate of the coinbase up to the extranonces. Checking a share then
+ * hashes the coinbase tail, the merkle path and the header.
+ */
+class BitcoinJob
+{
+public:
+  typedef std::shared_ptr<BitcoinJob> Ptr;
+
+  static const std::size_t HEADER_SIZE = 80;
+  static const std::size_t EXTRANONCE_SIZE_MAX = 32;
+
+public:
+  // fields as hex strings of mining.notify, nullptr if one is malformed
+  static Ptr create(const std::string& jobId, const std::string& previousHash,
+                    const std::string& coinbase1, const std::string& coinbase2,
+                    const std::vector<std::string>& merkleBranches,
+                    const std::string& version, const std::string& bits, const std::string& time,
+                    bool cleanJobs);
+
+  const std::string& getJobId() const;
+  const std::string& getPreviousHash() const;
+  const std::string& getCoinbase1() const;
+  const std::string& getCoinbase2() const;
+  const std::vector<std::string>& getMerkleBranches() const;
+  const std::string& getVersion() const;
+  const std::string& getBits() const;
+  const std::string& getTime() const;
+  bool isClean() const;
+
+  // extranonce and share difficulty of the pool session the job belongs to
+  void setExtranonce(const std::string& extranonce1, std::size_t extranonce2Size);
+  const std::string& getExtranonce1() const;
+  std::size_t getExtranonce2Size() const;
+  void setDifficulty(double difficulty);
+  double getDifficulty() const;
+
+  // SHA-256d of the block header a share describes, false if a share field is malformed
+  bool hashHeader(const std::string& extranonce1, const std::string& extranonce2,
+                  const std::string& time, const std::string& nonce, util::Sha256::Hash& hash) const;
+
+  // the difficulty 1 target divided by the hash read as little endian number
+  static double getHashDifficulty(const util::Sha256::Hash& hash);
+
+private:
+  BitcoinJob() = default;
+
+  std::string jobId_;
+  std::string previousHash_;
+  std::string coinbase1_;
+  std::string coinbase2_;
+  std::vector<std::string> merkleBranchHexStrings_;
+  std::string version_;
+  std::string bits_;
+  std::string time_;
+  bool cleanJobs_ = false;
+
+  std::string extranonce1_;
+  std::size_t extranonce2Size_ = 0;
+  double difficulty_ = 1.0;
+
+  util::Sha256 coinbase1State_;
+  std::vector<uint8_t> coinbase2Bytes_;
+  MerkleBranches merkleBranches_;
+  // version, previous hash and bits in place, merkle root, time and nonce are filled per share
+  uint8_t header_[HEADER_SIZE] = {};
+};
+
+} // namespace stratum
+} // namespace ses
+
+#endif //SES_STRATUM_BITCOINJOB_HPP
@@ -1,5 +1,6 @@
-#include <boost/algorithm/hex.hpp>
+#include <cstring>
 
+#include "util/hex.hpp"
 #include "stratum/job.hpp"
 
 namespace ses {
@@ -8,19 +9,15 @@ namespace stratum {
 namespace {
 const size_t NONCE_OFFSET = 39;
 
-std::vector<uint8_t> parseBlob(const std::string& blobHexString)
-{
-  std::vector<uint8_t> blob;
-  boost::algorithm::unhex(blobHexString, std::back_inserter(blob));
-  return blob;
-}
-
-uint64_t parseTarget(std::string targetHexString)
+uint64_t parseTarget(const std::string& targetHexString)
 {
   uint64_t target = 0;
-  if (targetHexString.size() <= 2 * sizeof(uint64_t))
+  // decode writes what it read before it finds a bad character, so nothing but a good target is taken
+  uint64_t decoded = 0;
+  if (targetHexString.size() <= 2 * sizeof(uint64_t) &&
+      util::hex::decode(targetHexString, reinterpret_cast<uint8_t*>(&decoded)))
   {
-    boost::algorithm::unhex(targetHexString, reinterpret_cast<uint8_t*>(&target));
+    target = decoded;
     if (targetHexString.size() <= 2 * sizeof(uint32_t))
     {
       // multiplication necessary
@@ -31,37 +28,69 @@ uint64_t parseTarget(std::string targetHexString)
 }
 }
 
-Job::Job(const std::string& blobHexString, const std::string& jobId, const std::string& targetHexString,
-         const std::string& id)
-  : blob_(parseBlob(blobHexString))
-  , jobId_(jobId)
-  , target_(parseTarget(targetHexString))
-  , id_(id)
+Job::Job()
+  : target_(0)
+  , blob_()
+  , blobSize_(0)
+  , jobIdSize_(0)
+  , jobId_()
+{
+}
+
+Job::Job(const std::string& blobHexString, const std::string& jobId, const std::string& targetHexString)
+  : Job()
+{
+  if (blobHexString.size() <= 2 * BLOB_SIZE_MAX && util::hex::decode(blobHexString, blob_))
+  {
+    blobSize_ = static_cast<uint8_t>(blobHexString.size() / 2);
+  }
+  if (jobId.size() <= JOB_ID_SIZE_MAX)
+  {
+    std::memcpy(jobId_, jobId.data(), jobId.size());
+    jobIdSize_ = static_cast<uint8_t>(jobId.size());
+  }
+  target_ = parseTarget(targetHexString);
+}
+
+Job::Job(const uint8_t* blob, std::size_t blobSize, std::string_view jobId, uint64_t target)
+  : Job()
 {
+  if (blobSize <= BLOB_SIZE_MAX)
+  {
+    std::memcpy(blob_, blob, blobSize);
+    blobSize_ = static_cast<uint8_t>(blobSize);
+  }
+  if (jobId.size() <= JOB_ID_SIZE_MAX)
+  {
+    std::memcpy(jobId_, jobId.data(), jobId.size());
+    jobIdSize_ = static_cast<uint8_t>(jobId.size());
+  }
+  target_ = target;
 }
 
 bool Job::isValid() const
 {
-  const size_t BLOB_SIZE_MAX = 84;
-  const size_t BLOB_SIZE_MIN = 76;
-  return target_ != 0 && blob_.size() >= BLOB_SIZE_MIN && blob_.size() <= BLOB_SIZE_MAX;
+  return target_ != 0 && jobIdSize_ != 0 && blobSize_ >= BLOB_SIZE_MIN && blobSize_ <= BLOB_SIZE_MAX;
 }
 
-const std::vector<uint8_t>& Job::getBlob() const
+const uint8_t* Job::getBlob() const
 {
   return blob_;
 }
 
+std::size_t Job::getBlobSize() const
+{
+  return blobSize_;
+}
+
 std::string Job::getBlobHexString() const
 {
-  std::string result;
-  boost::algorithm::hex(blob_, std::back_inserter(result));
-  return result;
+  return util::hex::encode(blob_, blobSize_);
 }
 
-const std::string& Job::getJobId() const
+std::string_view Job::getJobId() const
 {
-  return jobId_;
+  return std::string_view(jobId_, jobIdSize_);
 }
 
 uint64_t Job::getTarget() const
@@ -71,27 +100,25 @@ uint64_t Job::getTarget() const
 
 std::string Job::getTargetHexString() const
 {
-  std::string result;
-  boost::algorithm::hex(reinterpret_cast<const uint8_t*>(&target_),
-                        reinterpret_cast<const uint8_t*>(&target_) + sizeof(target_),
-                        std::back_inserter(result));
-  return result;
+  return util::hex::encode(reinterpret_cast<const uint8_t*>(&target_), sizeof(target_));
 }
 
-const std::string& Job::getId() const
+double Job::getDifficulty() const
 {
-  return id_;
+  return target_ != 0 ? static_cast<double>(UINT64_MAX) / static_cast<double>(target_) : 0.0;
 }
 
 uint32_t Job::getNonce() const
 {
-  return *(reinterpret_cast<const uint32_t*>(blob_.data() + NONCE_OFFSET));
+  uint32_t nonce;
+  std::memcpy(&nonce, blob_ + NONCE_OFFSET, sizeof(nonce));
+  return nonce;
 }
 
 void Job::setNonce(uint32_t nonce)
 {
-  *(reinterpret_cast<uint32_t*>(blob_.data() + NONCE_OFFSET)) = nonce;
+  std::memcpy(blob_ + NONCE_OFFSET, &nonce, sizeof(nonce));
 }
 
 } // namespace stratum
-} // namespace ses
\ No newline at end of file
+} // namespace ses
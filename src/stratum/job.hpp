@@ -1,44 +1,73 @@
 #ifndef SES_STRATUM_JOB_HPP
 #define SES_STRATUM_JOB_HPP
 
+#include <cstdint>
 #include <string>
-#include <vector>
+#include <string_view>
 #include <memory>
+#include <type_traits>
+
+#include "util/objectpool.hpp"
 
 namespace ses {
 namespace stratum {
 
-class Job
+/**
+ * A mining job as a fixed size value type. Blob, target and job id are stored inline, so copying
+ * a job is a single memcpy of three cache lines.
+ *
+ * Blobs of BLOB_SIZE_MIN to BLOB_SIZE_MAX bytes and job ids of up to JOB_ID_SIZE_MAX characters fit,
+ * which covers UUIDs and hex encoded hashes as job ids. A job with a longer one, or with a malformed
+ * blob or target, is not valid.
+ */
+class alignas(64) Job
 {
 public:
   typedef std::shared_ptr<Job> Ptr;
 
+  static const std::size_t BLOB_SIZE_MIN = 76;
+  static const std::size_t BLOB_SIZE_MAX = 84;
+  static const std::size_t JOB_ID_SIZE_MAX = 98;
+
 public:
-  Job(const std::string& blobHexString, const std::string& jobId, const std::string& targetHexString,
-      const std::string& id);
+  // jobs are recycled through a per thread object pool instead of the global heap
+  template<typename... ARGS>
+  static Ptr create(ARGS&&... args)
+  {
+    return std::allocate_shared<Job>(util::PoolAllocator<Job>(), std::forward<ARGS>(args)...);
+  }
+
+  Job();
+  Job(const std::string& blobHexString, const std::string& jobId, const std::string& targetHexString);
+  Job(const uint8_t* blob, std::size_t blobSize, std::string_view jobId, uint64_t target);
 
   bool isValid() const;
 
-  const std::vector<uint8_t>& getBlob() const;
+  const uint8_t* getBlob() const;
+  std::size_t getBlobSize() const;
   std::string getBlobHexString() const;
 
-  const std::string& getJobId() const;
+  std::string_view getJobId() const;
 
   uint64_t getTarget() const;
   std::string getTargetHexString() const;
-
-  const std::string& getId() const;
+  // expected hashes per share for the target
+  double getDifficulty() const;
 
   uint32_t getNonce() const;
   void setNonce(uint32_t nonce);
 
 private:
-  std::vector<uint8_t> blob_;
-  std::string jobId_;
   uint64_t target_;
-  std::string id_;
+  uint8_t blob_[BLOB_SIZE_MAX];
+  uint8_t blobSize_;
+  uint8_t jobIdSize_;
+  char jobId_[JOB_ID_SIZE_MAX];
 };
 
+static_assert(std::is_trivially_copyable<Job>::value, "Job must be copyable by memcpy");
+static_assert(sizeof(Job) == 192, "Job must fit into three cache lines");
+
 } // namespace stratum
 } // namespace ses
 
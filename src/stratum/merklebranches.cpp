@@ -0,0 +1,44 @@
+#include <cstring>
+
+#include "util/hex.hpp"
+#include "stratum/merklebranches.hpp"
+
+namespace ses {
+namespace stratum {
+
+bool MerkleBranches::parse(const std::vector<std::string>& branchHexStrings)
+{
+  std::vector<util::Sha256::Hash> branches(branchHexStrings.size());
+  for (std::size_t i = 0; i < branchHexStrings.size(); ++i)
+  {
+    if (branchHexStrings[i].size() != 2 * util::Sha256::HASH_SIZE ||
+        !util::hex::decode(branchHexStrings[i], branches[i].data()))
+    {
+      return false;
+    }
+  }
+  branches_.swap(branches);
+  return true;
+}
+
+util::Sha256::Hash MerkleBranches::computeRoot(const util::Sha256::Hash& coinbaseHash) const
+{
+  // the coinbase is the leftmost leaf, so the running hash is always the left node
+  uint8_t node[2 * util::Sha256::HASH_SIZE];
+  util::Sha256::Hash root = coinbaseHash;
+  for (const auto& branch : branches_)
+  {
+    std::memcpy(node, root.data(), util::Sha256::HASH_SIZE);
+    std::memcpy(node + util::Sha256::HASH_SIZE, branch.data(), util::Sha256::HASH_SIZE);
+    root = util::Sha256::doubleHash(node, sizeof(node));
+  }
+  return root;
+}
+
+std::size_t MerkleBranches::size() const
+{
+  return branches_.size();
+}
+
+} // namespace stratum
+} // namespace ses
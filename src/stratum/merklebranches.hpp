@@ -0,0 +1,35 @@
+#ifndef SES_STRATUM_MERKLEBRANCHES_HPP
+#define SES_STRATUM_MERKLEBRANCHES_HPP
+
+#include <string>
+#include <vector>
+
+#include "util/sha256.hpp"
+
+namespace ses {
+namespace stratum {
+
+/**
+ * The merkle branch of a mining.notify, decoded once so that computing the merkle root of a share
+ * only hashes the coinbase and one 64 byte block per branch.
+ */
+class MerkleBranches
+{
+public:
+  MerkleBranches() = default;
+
+  // false if a branch is no 32 byte hex string
+  bool parse(const std::vector<std::string>& branchHexStrings);
+
+  util::Sha256::Hash computeRoot(const util::Sha256::Hash& coinbaseHash) const;
+
+  std::size_t size() const;
+
+private:
+  std::vector<util::Sha256::Hash> branches_;
+};
+
+} // namespace stratum
+} // namespace ses
+
+#endif //SES_STRATUM_MERKLEBRANCHES_HPP
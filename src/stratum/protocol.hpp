@@ -0,0 +1,20 @@
+#ifndef SES_STRATUM_PROTOCOL_HPP
+#define SES_STRATUM_PROTOCOL_HPP
+
+namespace ses {
+namespace stratum {
+
+enum Protocol
+{
+  // login/job/submit dialect of CryptoNote pools
+  PROTOCOL_CRYPTONOTE,
+  // stratum v1 of bitcoin pools, mining.subscribe/authorize/notify/submit
+  PROTOCOL_BITCOIN,
+  // binary records between proxies, see stratum/binary.hpp
+  PROTOCOL_BINARY
+};
+
+} // namespace stratum
+} // namespace ses
+
+#endif //SES_STRATUM_PROTOCOL_HPP
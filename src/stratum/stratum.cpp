@@ -1,6 +1,8 @@
 #include <boost/property_tree/ptree.hpp>
 #include <boost/property_tree/json_parser.hpp>
 
+#include "net/jsonrpc/jsonrpc.hpp"
+#include "util/allocationaccounting.hpp"
 #include "util/boostpropertytree.hpp"
 #include "stratum/stratum.hpp"
 
@@ -8,32 +10,62 @@ namespace ses {
 namespace stratum {
 namespace pt = boost::property_tree;
 
+namespace {
+namespace writer = net::jsonrpc::writer;
+
+typedef writer::Object<writer::Field<"blob", writer::Hex>, writer::Field<"job_id", writer::String>,
+                       writer::Field<"target", writer::Hex>, writer::Field<"id", writer::String>> JobParams;
+
+std::span<const uint8_t> blobBytes(const Job& job)
+{
+  return std::span<const uint8_t>(job.getBlob(), job.getBlobSize());
+}
+
+// the target's bytes in memory order, as pools send it
+std::span<const uint8_t> targetBytes(const uint64_t& target)
+{
+  return std::span<const uint8_t>(reinterpret_cast<const uint8_t*>(&target), sizeof(target));
+}
+}
+
 namespace server {
 namespace {
+typedef writer::Object<writer::Field<"id", writer::String>, writer::Field<"status", writer::Constant<"\"OK\"">>>
+  LoginResult;
+typedef writer::Object<writer::Field<"id", writer::String>, writer::Field<"job", JobParams>,
+                       writer::Field<"status", writer::Constant<"\"OK\"">>> LoginResultWithJob;
+
+// the parameters are accounted to stratum, what the handlers do to themselves
+pt::ptree parseParams(const std::string& params)
+{
+  util::AllocationAccounting::Scope accountingScope(util::AllocationAccounting::SUBSYSTEM_STRATUM);
+  return util::boostpropertytree::stringToPtree(params);
+}
+
+std::string getParam(const pt::ptree& tree, const char* name)
+{
+  util::AllocationAccounting::Scope accountingScope(util::AllocationAccounting::SUBSYSTEM_STRATUM);
+  return tree.get<std::string>(name, "");
+}
+
 void parseLogin(const std::string& jsonRequestId, const std::string& params, LoginHandler& handler)
 {
-  pt::ptree tree = util::boostpropertytree::stringToPtree(params);
-  std::string login = tree.get<std::string>("login", "");
-  std::string pass = tree.get<std::string>("pass", "");
-  std::string agent = tree.get<std::string>("agent", "");
-  handler(jsonRequestId, login, pass, agent);
+  pt::ptree tree = parseParams(params);
+  handler(jsonRequestId, getParam(tree, "login"), getParam(tree, "pass"), getParam(tree, "agent"),
+          getParam(tree, "id"));
 }
 
 void parseSubmit(const std::string& jsonRequestId, const std::string& params, SubmitHandler& handler)
 {
-  pt::ptree tree = util::boostpropertytree::stringToPtree(params);
-  std::string identifier = tree.get<std::string>("id", "");
-  std::string jobIdentifier = tree.get<std::string>("job_id", "");
-  std::string nonce = tree.get<std::string>("nonce", "");
-  std::string result = tree.get<std::string>("result", "");
-  handler(jsonRequestId, identifier, jobIdentifier, nonce, result);
+  pt::ptree tree = parseParams(params);
+  handler(jsonRequestId, getParam(tree, "id"), getParam(tree, "job_id"), getParam(tree, "nonce"),
+          getParam(tree, "result"));
 }
 
 void parseKeepaliveD(const std::string& jsonRequestId, const std::string& params, KeepAliveDHandler& handler)
 {
-  pt::ptree tree = util::boostpropertytree::stringToPtree(params);
-  std::string identifier = tree.get<std::string>("id", "");
-  handler(jsonRequestId, identifier);
+  pt::ptree tree = parseParams(params);
+  handler(jsonRequestId, getParam(tree, "id"));
 }
 }
 
@@ -63,29 +95,23 @@ void parseRequest(const std::string& jsonRequestId, const std::string& method, c
   }
 }
 
-std::string createLoginResponse(const std::string& id, const std::optional<Job>& job)
+util::ArenaString createLoginResponse(const std::string& jsonRequestId, const std::string& id,
+                                      const std::optional<Job>& job)
 {
-  pt::ptree tree;
-  tree.put("id", id);
-  if (job)
+  if (!job)
   {
-    tree.put("job.blob", job->getBlobHexString());
-    tree.put("job.job_id", job->getJobId());
-    tree.put("job.target", job->getTargetHexString());
-    tree.put("job.id", job->getId());
+    return net::jsonrpc::create<net::jsonrpc::schema::Response<LoginResult>>(jsonRequestId, id);
   }
-  tree.put("status", "OK");
-  return util::boostpropertytree::ptreeToString(tree);
+  uint64_t target = job->getTarget();
+  return net::jsonrpc::create<net::jsonrpc::schema::Response<LoginResultWithJob>>(
+    jsonRequestId, id, blobBytes(*job), std::string_view(job->getJobId()), targetBytes(target), id);
 }
 
-std::string createJobNotification(const Job& job)
+util::ArenaString createJobNotification(const Job& job, const std::string& id)
 {
-  pt::ptree tree;
-  tree.put("blob", job.getBlobHexString());
-  tree.put("job_id", job.getJobId());
-  tree.put("target", job.getTargetHexString());
-  tree.put("id", job.getId());
-  return util::boostpropertytree::ptreeToString(tree);
+  uint64_t target = job.getTarget();
+  return net::jsonrpc::create<net::jsonrpc::schema::Notification<JobParams>>(
+    "job", blobBytes(job), std::string_view(job.getJobId()), targetBytes(target), id);
 }
 
 } // namespace server
@@ -93,6 +119,11 @@ std::string createJobNotification(const Job& job)
 namespace client {
 
 namespace {
+typedef writer::Object<writer::Field<"login", writer::String>, writer::Field<"pass", writer::String>,
+                       writer::Field<"agent", writer::String>> LoginParams;
+typedef writer::Object<writer::Field<"id", writer::String>, writer::Field<"job_id", writer::String>,
+                       writer::Field<"nonce", writer::String>, writer::Field<"result", writer::String>> SubmitParams;
+
 void parseError(const std::string& error, ErrorHandler& handler)
 {
   pt::ptree tree = util::boostpropertytree::stringToPtree(error);
@@ -103,19 +134,17 @@ void parseError(const std::string& error, ErrorHandler& handler)
 
 Job::Ptr parseJob(const pt::ptree& tree)
 {
-  return std::make_shared<Job>(tree.get<std::string>("blob", ""), tree.get<std::string>("job_id", ""),
-                               tree.get<std::string>("target", ""), tree.get<std::string>("id", ""));
+  return Job::create(tree.get<std::string>("blob", ""), tree.get<std::string>("job_id", ""),
+                     tree.get<std::string>("target", ""));
 }
 
 }
 
 std::string createLoginRequest(const std::string& login, const std::string& pass, const std::string& agent)
 {
-  pt::ptree tree;
-  tree.put("login", login);
-  tree.put("pass", pass);
-  tree.put("agent", agent);
-  return util::boostpropertytree::ptreeToString(tree);
+  std::string params;
+  writer::Writer<LoginParams>::write(params, login, pass, agent);
+  return params;
 }
 
 void parseLoginResponse(const std::string& result, const std::string& error,
@@ -155,12 +184,9 @@ void parseGetJobResponse(const std::string& result, const std::string& error,
 std::string createSubmitRequest(const std::string& id, const std::string& jobId,
                                 const std::string& nonce, const std::string& result)
 {
-  pt::ptree tree;
-  tree.put("id", id);
-  tree.put("job_id", jobId);
-  tree.put("nonce", nonce);
-  tree.put("result", result);
-  return util::boostpropertytree::ptreeToString(tree);
+  std::string params;
+  writer::Writer<SubmitParams>::write(params, id, jobId, nonce, result);
+  return params;
 }
 
 void parseSubmitResponse(const std::string& result, const std::string& error,
@@ -182,8 +208,12 @@ void parseNotification(const std::string& method, const std::string& params, New
 {
   if (method == "job")
   {
-    pt::ptree tree = util::boostpropertytree::stringToPtree(params);
-    newJobHandler(parseJob(tree));
+    Job::Ptr job;
+    {
+      util::AllocationAccounting::Scope accountingScope(util::AllocationAccounting::SUBSYSTEM_STRATUM);
+      job = parseJob(util::boostpropertytree::stringToPtree(params));
+    }
+    newJobHandler(job);
   }
 }
 
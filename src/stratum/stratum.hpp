@@ -7,14 +7,17 @@
 #include <optional>
 
 #include "stratum/job.hpp"
+#include "util/arena.hpp"
 
 namespace ses {
 namespace stratum {
 
 namespace server {
 
+// sessionId is the id a reconnecting miner was issued before, empty for a new one
 typedef std::function<void(const std::string& jsonRequestId, const std::string& login,
-                           const std::string& pass, const std::string& agent)> LoginHandler;
+                           const std::string& pass, const std::string& agent,
+                           const std::string& sessionId)> LoginHandler;
 typedef std::function<void(const std::string& jsonRequestId)> GetJobHandler;
 typedef std::function<void(const std::string& jsonRequestId, const std::string& identifier, const std::string& jobIdentifier,
                            const std::string& nonce, const std::string& result)> SubmitHandler;
@@ -25,8 +28,10 @@ void parseRequest(const std::string& jsonRequestId, const std::string& method, c
                   LoginHandler loginHandler, GetJobHandler getJobHandler, SubmitHandler submitHandler,
                   KeepAliveDHandler keepAliveDHandler, UnknownMethodHandler unknownMethodHandler);
 
-std::string createLoginResponse(const std::string& id, const std::optional<Job>& job = std::optional<Job>());
-std::string createJobNotification(const Job& job);
+// complete messages, living in the arena of the calling thread like those of net::jsonrpc
+util::ArenaString createLoginResponse(const std::string& jsonRequestId, const std::string& id,
+                                      const std::optional<Job>& job = std::optional<Job>());
+util::ArenaString createJobNotification(const Job& job, const std::string& id);
 
 } // namespace server
 
@@ -0,0 +1,109 @@
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+#include <sys/resource.h>
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/ip/tcp.hpp>
+#include <boost/asio/write.hpp>
+
+using boost::asio::ip::tcp;
+
+namespace {
+// time for the proxy to handle the connections and logins before its memory is read
+const std::chrono::seconds SETTLE_TIME{3};
+// connections per source address on loopback, below the burst the rate limiter admits
+const std::size_t CONNECTIONS_PER_ADDRESS = 100;
+
+// anonymous resident memory of the process, what connections and their clients take
+long readRssAnonKb(const std::string& pid)
+{
+  std::ifstream status("/proc/" + pid + "/status");
+  std::string line;
+  while (std::getline(status, line))
+  {
+    if (line.compare(0, 8, "RssAnon:") == 0)
+    {
+      return std::strtol(line.c_str() + 8, nullptr, 10);
+    }
+  }
+  return -1;
+}
+
+void raiseFileLimit()
+{
+  rlimit limit;
+  if (getrlimit(RLIMIT_NOFILE, &limit) == 0)
+  {
+    limit.rlim_cur = limit.rlim_max;
+    setrlimit(RLIMIT_NOFILE, &limit);
+  }
+}
+}
+
+// Memory a running proxy spends per idle miner: opens the connections, logs each in unless the
+// login is empty, lets them sit and reports the growth of the proxy's anonymous resident memory
+// divided by the connections. On loopback the connections come from several source addresses to
+// stay within the proxy's per address limits, its file limit has to allow for them.
+//   ses_proxy_idlebench <proxy pid> <host> <port> [connections] [login]
+int main(int argc, char* argv[])
+{
+  if (argc < 4)
+  {
+    std::cerr << "usage: " << argv[0] << " <proxy pid> <host> <port> [connections] [login]" << std::endl;
+    return 1;
+  }
+  std::string pid = argv[1];
+  std::size_t count = argc > 4 ? std::strtoul(argv[4], nullptr, 10) : 10000;
+  std::string login = argc > 5 ? argv[5] : "idlebench";
+
+  long before = readRssAnonKb(pid);
+  if (before < 0)
+  {
+    std::cerr << "no process " << pid << std::endl;
+    return 1;
+  }
+
+  raiseFileLimit();
+  boost::asio::io_context ioContext;
+  tcp::resolver resolver(ioContext);
+  tcp::endpoint endpoint = *resolver.resolve(argv[2], argv[3]).begin();
+  std::vector<tcp::socket> sockets;
+  sockets.reserve(count);
+  try
+  {
+    for (std::size_t i = 0; i < count; ++i)
+    {
+      sockets.emplace_back(ioContext);
+      sockets.back().open(endpoint.protocol());
+      if (endpoint.address().is_loopback() && endpoint.address().is_v4())
+      {
+        // 127.1.0.1 on, the proxy limits connections per address
+        uint32_t source = 0x7f010001 + static_cast<uint32_t>(i / CONNECTIONS_PER_ADDRESS);
+        sockets.back().bind(tcp::endpoint(boost::asio::ip::address_v4(source), 0));
+      }
+      sockets.back().connect(endpoint);
+      if (!login.empty())
+      {
+        std::string request = "{\"id\":1,\"jsonrpc\":\"2.0\",\"method\":\"login\",\"params\":{\"login\":\"" + login +
+                              "\",\"pass\":\"x\",\"agent\":\"ses_proxy_idlebench\"}}\n";
+        boost::asio::write(sockets.back(), boost::asio::buffer(request));
+      }
+    }
+  }
+  catch (const boost::system::system_error& error)
+  {
+    std::cerr << "connection " << sockets.size() << ": " << error.what() << std::endl;
+    sockets.pop_back();
+  }
+
+  std::this_thread::sleep_for(SETTLE_TIME);
+  long after = readRssAnonKb(pid);
+  std::cout << "connections " << sockets.size() << ", rss anon before " << before << " kB, after " << after
+            << " kB, per connection " << (sockets.empty() ? 0 : (after - before) * 1024 / static_cast<long>(sockets.size()))
+            << " bytes" << std::endl;
+  return 0;
+}
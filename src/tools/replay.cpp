@@ -0,0 +1,437 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <deque>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <regex>
+#include <string>
+// Boost 1.74's awaitable.hpp uses std::exchange without including <utility>
+#include <utility>
+#include <vector>
+#include <boost/asio/co_spawn.hpp>
+#include <boost/asio/detached.hpp>
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/ip/tcp.hpp>
+#include <boost/asio/redirect_error.hpp>
+#include <boost/asio/steady_timer.hpp>
+#include <boost/asio/use_awaitable.hpp>
+#include <boost/asio/write.hpp>
+
+#include "net/capture.hpp"
+#include "net/frame.hpp"
+
+using boost::asio::awaitable;
+using boost::asio::ip::tcp;
+using boost::asio::use_awaitable;
+using ses::net::Capture;
+
+namespace {
+typedef std::chrono::steady_clock Clock;
+
+struct Message
+{
+  // capture nanoseconds
+  uint64_t timestamp;
+  std::string data;
+};
+
+struct Stream
+{
+  Capture::Side side;
+  std::vector<Message> messages;
+};
+
+// the replies a miner connection still waits for by request id, and what the proxy assigned to it
+// in this replay, which differs from the capture
+struct ClientState
+{
+  explicit ClientState(boost::asio::io_context& ioContext)
+    : socket(ioContext)
+  {
+  }
+
+  tcp::socket socket;
+  std::map<std::string, std::deque<Clock::time_point>> pendingRequests;
+  std::size_t pendingCount = 0;
+
+  std::string loginRequestId;
+  std::string subscribeRequestId;
+  // CryptoNote session id from the login response
+  std::string sessionId;
+  // stratum v1 extranonce from the subscribe response or mining.set_extranonce
+  std::string extranonce1;
+  std::size_t extranonce2Size = 0;
+  bool subscribed = false;
+};
+
+struct Replay
+{
+  boost::asio::io_context ioContext;
+  // 0 replays as fast as possible
+  double speed = 1;
+  uint64_t base = 0;
+  Clock::time_point start;
+  std::vector<Stream> clientStreams;
+  std::vector<Stream> poolStreams;
+  std::size_t nextPoolStream = 0;
+  std::size_t runningClients = 0;
+  uint64_t sentMessages = 0;
+  std::vector<double> latencies;
+};
+
+const std::chrono::seconds REPLY_GRACE{2};
+
+const std::regex METHOD(R"re("method"\s*:\s*"([^"]*)")re");
+// the first id in the result of a CryptoNote login response is the session id
+const std::regex LOGIN_SESSION_ID(R"re("result"\s*:\s*\{[^}]*?"id"\s*:\s*"([^"]*)")re");
+// extranonce1 and extranonce2 size ending a subscribe result or the params of mining.set_extranonce
+const std::regex EXTRANONCE(R"re("([0-9a-fA-F]*)"\s*,\s*([0-9]+)\s*\])re");
+const std::regex SUBMIT_SESSION_ID(R"re(("params"\s*:\s*\{[^}]*?"id"\s*:\s*")[^"]*("))re");
+// worker, job id and extranonce2 of mining.submit
+const std::regex SUBMIT_EXTRANONCE2(R"re(("params"\s*:\s*\[\s*"[^"]*"\s*,\s*"[^"]*"\s*,\s*")([0-9a-fA-F]*)("))re");
+
+// the id of a JSON-RPC message without quotes, empty if it has none
+std::string extractId(const std::string& message)
+{
+  std::size_t position = message.find("\"id\"");
+  if (position == std::string::npos)
+  {
+    return "";
+  }
+  position = message.find(':', position);
+  if (position == std::string::npos)
+  {
+    return "";
+  }
+  position = message.find_first_not_of(" \"", position + 1);
+  std::size_t end = message.find_first_of(",}\" ", position);
+  if (position == std::string::npos || end == std::string::npos)
+  {
+    return "";
+  }
+  std::string id = message.substr(position, end - position);
+  return id == "null" ? "" : id;
+}
+
+bool isFrame(const std::string& data)
+{
+  return !data.empty() && static_cast<uint8_t>(data[0]) == ses::net::frame::MAGIC;
+}
+
+// the first group of the first match, empty without one
+std::string search(const std::string& message, const std::regex& pattern)
+{
+  std::smatch match;
+  return std::regex_search(message, match, pattern) ? match[1].str() : "";
+}
+
+void takeExtranonce(ClientState& state, const std::string& message)
+{
+  std::smatch match;
+  if (std::regex_search(message, match, EXTRANONCE))
+  {
+    state.extranonce1 = match[1].str();
+    state.extranonce2Size = std::stoul(match[2].str());
+    state.subscribed = true;
+  }
+}
+
+// submits carry what the proxy assigned in the capture, they are rewritten to what it assigned now
+std::string rewriteSubmit(const ClientState& state, const std::string& method, const std::string& data)
+{
+  std::smatch match;
+  if (method == "submit" && !state.sessionId.empty() && std::regex_search(data, match, SUBMIT_SESSION_ID))
+  {
+    return match.prefix().str() + match[1].str() + state.sessionId + match[2].str() + match.suffix().str();
+  }
+
+  if (method == "mining.submit" && state.subscribed && std::regex_search(data, match, SUBMIT_EXTRANONCE2))
+  {
+    // the captured extranonce2 went with the captured extranonce1, it is fitted to the size that
+    // goes with the new one, keeping its low order digits
+    std::string extranonce2 = match[2].str();
+    std::size_t size = 2 * state.extranonce2Size;
+    extranonce2 = extranonce2.size() >= size ? extranonce2.substr(extranonce2.size() - size)
+                                             : std::string(size - extranonce2.size(), '0') + extranonce2;
+    return match.prefix().str() + match[1].str() + extranonce2 + match[3].str() + match.suffix().str();
+  }
+  return data;
+}
+
+awaitable<void> waitFor(Replay& replay, std::function<bool()> done, std::chrono::seconds timeout)
+{
+  Clock::time_point deadline = Clock::now() + timeout;
+  boost::asio::steady_timer timer(replay.ioContext);
+  while (!done() && Clock::now() < deadline)
+  {
+    timer.expires_after(std::chrono::milliseconds(10));
+    co_await timer.async_wait(use_awaitable);
+  }
+}
+
+awaitable<void> waitUntil(Replay& replay, uint64_t timestamp)
+{
+  if (replay.speed == 0 || timestamp <= replay.base)
+  {
+    co_return;
+  }
+  boost::asio::steady_timer timer(replay.ioContext);
+  timer.expires_at(replay.start + std::chrono::nanoseconds(
+    static_cast<int64_t>(static_cast<double>(timestamp - replay.base) / replay.speed)));
+  boost::system::error_code error;
+  co_await timer.async_wait(boost::asio::redirect_error(use_awaitable, error));
+}
+
+awaitable<void> send(tcp::socket& socket, const std::string& data)
+{
+  // lines were captured without their newline, binary frames as a whole
+  if (isFrame(data))
+  {
+    co_await boost::asio::async_write(socket, boost::asio::buffer(data), use_awaitable);
+  }
+  else
+  {
+    std::string line = data + "\n";
+    co_await boost::asio::async_write(socket, boost::asio::buffer(line), use_awaitable);
+  }
+}
+
+awaitable<void> readReplies(Replay& replay, std::shared_ptr<ClientState> state)
+{
+  char buffer[4096];
+  std::string pending;
+  try
+  {
+    for (;;)
+    {
+      std::size_t size = co_await state->socket.async_read_some(boost::asio::buffer(buffer), use_awaitable);
+      Clock::time_point now = Clock::now();
+      pending.append(buffer, size);
+      for (std::size_t newline = pending.find('\n'); newline != std::string::npos; newline = pending.find('\n'))
+      {
+        std::string line = pending.substr(0, newline);
+        std::string id = extractId(line);
+        if (!id.empty() && id == state->loginRequestId)
+        {
+          state->sessionId = search(line, LOGIN_SESSION_ID);
+        }
+        else if ((!id.empty() && id == state->subscribeRequestId) || search(line, METHOD) == "mining.set_extranonce")
+        {
+          takeExtranonce(*state, line);
+        }
+
+        auto request = state->pendingRequests.find(id);
+        if (request != state->pendingRequests.end() && !request->second.empty())
+        {
+          replay.latencies.push_back(
+            std::chrono::duration<double, std::micro>(now - request->second.front()).count());
+          request->second.pop_front();
+          --state->pendingCount;
+        }
+        pending.erase(0, newline + 1);
+      }
+    }
+  }
+  catch (const boost::system::system_error&)
+  {
+  }
+}
+
+awaitable<void> playClient(Replay& replay, const Stream& stream, tcp::endpoint proxy)
+{
+  std::shared_ptr<ClientState> state = std::make_shared<ClientState>(replay.ioContext);
+  try
+  {
+    co_await waitUntil(replay, stream.messages.front().timestamp);
+    co_await state->socket.async_connect(proxy, use_awaitable);
+    boost::asio::co_spawn(replay.ioContext, readReplies(replay, state), boost::asio::detached);
+
+    for (const Message& message : stream.messages)
+    {
+      co_await waitUntil(replay, message.timestamp);
+      std::string id = extractId(message.data);
+      std::string method = isFrame(message.data) ? "" : search(message.data, METHOD);
+      std::string data = message.data;
+      if (method == "login")
+      {
+        state->loginRequestId = id;
+      }
+      else if (method == "mining.subscribe")
+      {
+        state->subscribeRequestId = id;
+      }
+      else if (method == "submit" || method == "mining.submit")
+      {
+        // sent before the answer to the login or subscribe arrived, it would go out unchanged
+        co_await waitFor(replay,
+                         [&state, &method]()
+                         {
+                           return method == "submit" ? !state->sessionId.empty() : state->subscribed;
+                         },
+                         REPLY_GRACE);
+        data = rewriteSubmit(*state, method, data);
+      }
+      if (!id.empty())
+      {
+        state->pendingRequests[id].push_back(Clock::now());
+        ++state->pendingCount;
+      }
+      co_await send(state->socket, data);
+      ++replay.sentMessages;
+    }
+
+    // the last replies may still be on their way
+    co_await waitFor(replay, [&state]() { return state->pendingCount == 0; }, REPLY_GRACE);
+  }
+  catch (const boost::system::system_error& error)
+  {
+    std::cerr << "client connection failed, " << error.code().message() << std::endl;
+  }
+
+  boost::system::error_code error;
+  state->socket.close(error);
+  if (--replay.runningClients == 0)
+  {
+    replay.ioContext.stop();
+  }
+}
+
+awaitable<void> drain(std::shared_ptr<tcp::socket> socket)
+{
+  char buffer[4096];
+  boost::system::error_code error;
+  while (!error)
+  {
+    co_await socket->async_read_some(boost::asio::buffer(buffer), boost::asio::redirect_error(use_awaitable, error));
+  }
+}
+
+awaitable<void> playPool(Replay& replay, std::shared_ptr<tcp::socket> socket, const Stream& stream)
+{
+  boost::asio::co_spawn(replay.ioContext, drain(socket), boost::asio::detached);
+  try
+  {
+    for (const Message& message : stream.messages)
+    {
+      co_await waitUntil(replay, message.timestamp);
+      co_await send(*socket, message.data);
+    }
+  }
+  catch (const boost::system::system_error&)
+  {
+  }
+}
+
+void startClients(Replay& replay, tcp::endpoint proxy)
+{
+  replay.start = Clock::now();
+  replay.runningClients = replay.clientStreams.size();
+  for (const Stream& stream : replay.clientStreams)
+  {
+    boost::asio::co_spawn(replay.ioContext, playClient(replay, stream, proxy), boost::asio::detached);
+  }
+}
+
+awaitable<void> servePools(Replay& replay, tcp::acceptor& acceptor, tcp::endpoint proxy)
+{
+  for (;;)
+  {
+    std::shared_ptr<tcp::socket> socket = std::make_shared<tcp::socket>(co_await acceptor.async_accept(use_awaitable));
+    if (replay.nextPoolStream == 0)
+    {
+      // the traffic starts over with the proxy's first pool connection
+      startClients(replay, proxy);
+    }
+    if (replay.nextPoolStream < replay.poolStreams.size())
+    {
+      boost::asio::co_spawn(replay.ioContext, playPool(replay, socket, replay.poolStreams[replay.nextPoolStream++]),
+                            boost::asio::detached);
+    }
+  }
+}
+
+double percentile(const std::vector<double>& sorted, double share)
+{
+  return sorted.empty() ? 0 : sorted[std::min(sorted.size() - 1, static_cast<std::size_t>(share * sorted.size()))];
+}
+}
+
+// Replays a capture against a proxy: serves the captured pool messages to the proxy's pool
+// connections in the order they connect and sends the captured miner messages to the proxy, with
+// the captured timing scaled by speed, 0 for as fast as possible. The replay starts with the
+// proxy's first pool connection, so start this first and the proxy with its pool port second.
+// Submits get the session id or the extranonce the proxy assigned in the replay.
+//   ses_proxy_replay <capture file> <proxy port> <pool port> [speed]
+int main(int argc, char* argv[])
+{
+  if (argc != 4 && argc != 5)
+  {
+    std::cerr << "usage: " << argv[0] << " <capture file> <proxy port> <pool port> [speed]" << std::endl;
+    return 1;
+  }
+
+  Replay replay;
+  replay.speed = argc == 5 ? std::atof(argv[4]) : 1;
+  tcp::endpoint proxy(boost::asio::ip::address_v4::loopback(), static_cast<uint16_t>(std::atoi(argv[2])));
+
+  std::map<uint64_t, std::size_t> clientStreams;
+  std::map<uint64_t, std::size_t> poolStreams;
+  bool readable = Capture::read(
+    argv[1],
+    [&](const Capture::RecordHeader& header, const char* data)
+    {
+      if (header.event != Capture::EVENT_MESSAGE)
+      {
+        return;
+      }
+      bool pool = header.side == Capture::SIDE_POOL;
+      std::vector<Stream>& streams = pool ? replay.poolStreams : replay.clientStreams;
+      auto inserted = (pool ? poolStreams : clientStreams).emplace(header.connectionId, streams.size());
+      if (inserted.second)
+      {
+        streams.push_back(Stream{header.side, {}});
+      }
+      streams[inserted.first->second].messages.push_back(Message{header.timestamp, std::string(data, header.size)});
+    });
+  if (!readable)
+  {
+    std::cerr << "cannot read " << argv[1] << std::endl;
+    return 1;
+  }
+  if (replay.clientStreams.empty())
+  {
+    std::cerr << "no miner traffic in " << argv[1] << std::endl;
+    return 1;
+  }
+  std::cerr << replay.clientStreams.size() << " miner and " << replay.poolStreams.size()
+            << " pool connections captured" << std::endl;
+
+  tcp::acceptor acceptor(replay.ioContext,
+                         tcp::endpoint(boost::asio::ip::address_v4::loopback(),
+                                       static_cast<uint16_t>(std::atoi(argv[3]))));
+  if (replay.poolStreams.empty())
+  {
+    replay.base = replay.clientStreams.front().messages.front().timestamp;
+    startClients(replay, proxy);
+  }
+  else
+  {
+    replay.base = replay.poolStreams.front().messages.front().timestamp;
+    boost::asio::co_spawn(replay.ioContext, servePools(replay, acceptor, proxy), boost::asio::detached);
+  }
+  replay.ioContext.run();
+
+  double seconds = std::chrono::duration<double>(Clock::now() - replay.start).count();
+  std::sort(replay.latencies.begin(), replay.latencies.end());
+  std::cout << "messages, " << replay.sentMessages << ", replies, " << replay.latencies.size() << ", seconds, "
+            << std::fixed << std::setprecision(3) << seconds << ", messages per second, "
+            << std::setprecision(0) << replay.sentMessages / seconds << std::endl;
+  std::cout << std::setprecision(1) << "reply latency us, p50, " << percentile(replay.latencies, 0.5) << ", p90, "
+            << percentile(replay.latencies, 0.9) << ", p99, " << percentile(replay.latencies, 0.99) << ", max, "
+            << (replay.latencies.empty() ? 0 : replay.latencies.back()) << std::endl;
+  return 0;
+}
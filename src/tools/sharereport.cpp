@@ -0,0 +1,99 @@
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <ctime>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "proxy/sharejournal.hpp"
+
+using ses::proxy::ShareJournal;
+
+namespace {
+struct WorkerShares
+{
+  uint64_t shares[ShareJournal::OUTCOME_STALE + 1] = {};
+  double acceptedDifficulty = 0;
+  uint64_t firstTimestamp = UINT64_MAX;
+  uint64_t lastTimestamp = 0;
+};
+
+std::string formatTime(uint64_t timestamp)
+{
+  std::time_t seconds = static_cast<std::time_t>(timestamp / 1000000000);
+  std::tm time;
+  gmtime_r(&seconds, &time);
+  char text[9];
+  std::strftime(text, sizeof(text), "%H:%M:%S", &time);
+  return text;
+}
+}
+
+// Sums up the shares of each worker on a day from the share journal segments.
+//   ses_proxy_sharereport <journal directory> <YYYYMMDD>
+int main(int argc, char* argv[])
+{
+  if (argc != 3)
+  {
+    std::cerr << "usage: " << argv[0] << " <journal directory> <YYYYMMDD>" << std::endl;
+    return 1;
+  }
+
+  auto start = std::chrono::steady_clock::now();
+  // by name and hash of the whole name, names cut at the record's size may be alike
+  std::map<std::pair<std::string, uint64_t>, WorkerShares> workers;
+  uint64_t records = 0;
+  std::vector<std::string> segments = ShareJournal::findSegments(argv[1], argv[2]);
+  for (const std::string& segment : segments)
+  {
+    bool readable = ShareJournal::read(
+      segment,
+      [&workers, &records](const ShareJournal::Record& record)
+      {
+        WorkerShares& shares = workers[std::make_pair(
+          std::string(record.worker, strnlen(record.worker, sizeof(record.worker))), record.workerHash)];
+        if (record.outcome <= ShareJournal::OUTCOME_STALE)
+        {
+          ++shares.shares[record.outcome];
+        }
+        if (record.outcome == ShareJournal::OUTCOME_ACCEPTED)
+        {
+          shares.acceptedDifficulty += record.difficulty;
+        }
+        shares.firstTimestamp = std::min(shares.firstTimestamp, record.timestamp);
+        shares.lastTimestamp = std::max(shares.lastTimestamp, record.timestamp);
+        ++records;
+      });
+    if (!readable)
+    {
+      std::cerr << "skipping unreadable segment " << segment << std::endl;
+    }
+  }
+
+  std::cout << std::left << std::setw(48) << "worker";
+  for (int outcome = ShareJournal::OUTCOME_ACCEPTED; outcome <= ShareJournal::OUTCOME_STALE; ++outcome)
+  {
+    std::cout << std::right << std::setw(15) << ShareJournal::toString(static_cast<ShareJournal::Outcome>(outcome));
+  }
+  std::cout << std::setw(20) << "accepted difficulty" << std::setw(10) << "first" << std::setw(10) << "last"
+            << std::endl;
+  for (auto& worker : workers)
+  {
+    std::cout << std::left << std::setw(48) << worker.first.first << std::right;
+    for (uint64_t count : worker.second.shares)
+    {
+      std::cout << std::setw(15) << count;
+    }
+    std::cout << std::setw(20) << std::fixed << std::setprecision(0) << worker.second.acceptedDifficulty
+              << std::setw(10) << formatTime(worker.second.firstTimestamp)
+              << std::setw(10) << formatTime(worker.second.lastTimestamp) << std::endl;
+  }
+
+  auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start);
+  std::cerr << records << " shares in " << segments.size() << " segments, " << elapsed.count() << " ms"
+            << std::endl;
+  return 0;
+}
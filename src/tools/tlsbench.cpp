@@ -0,0 +1,254 @@
+#include <chrono>
+#include <cstdlib>
+#include <ctime>
+#include <future>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+// Boost 1.74's awaitable.hpp uses std::exchange without including <utility>
+#include <utility>
+#include <boost/asio/co_spawn.hpp>
+#include <boost/asio/detached.hpp>
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/ip/tcp.hpp>
+#include <boost/asio/ssl/context.hpp>
+#include <boost/asio/ssl/stream.hpp>
+#include <boost/asio/use_awaitable.hpp>
+#include <boost/asio/write.hpp>
+#include <openssl/evp.h>
+#include <openssl/x509.h>
+
+#include "net/client/connection.hpp"
+#include "util/allocationaccounting.hpp"
+
+using boost::asio::awaitable;
+using boost::asio::ip::tcp;
+using boost::asio::use_awaitable;
+using ses::net::client::UpstreamConnection;
+using ses::util::AllocationAccounting;
+
+namespace {
+typedef std::chrono::steady_clock Clock;
+
+const char START_RECEIVING[] = "go\n";
+
+class Counter : public ses::net::ConnectionHandler
+{
+public:
+  void handleReceived(char* data, std::size_t size) override
+  {
+    if (++received_ == expected_)
+    {
+      done_.set_value();
+    }
+  }
+
+  void handleError(const std::string& error) override
+  {
+  }
+
+  // set before the pool starts sending
+  std::size_t expected_ = 0;
+  std::size_t received_ = 0;
+  std::promise<void> done_;
+};
+
+// a throwaway key and self-signed certificate for the server side
+void useGeneratedCertificate(boost::asio::ssl::context& context)
+{
+  EVP_PKEY* key = EVP_EC_gen("P-256");
+  X509* certificate = X509_new();
+  X509_set_version(certificate, 2);
+  ASN1_INTEGER_set(X509_get_serialNumber(certificate), 1);
+  X509_gmtime_adj(X509_getm_notBefore(certificate), 0);
+  X509_gmtime_adj(X509_getm_notAfter(certificate), 3600);
+  X509_set_pubkey(certificate, key);
+  X509_NAME_add_entry_by_txt(X509_get_subject_name(certificate), "CN", MBSTRING_ASC,
+                             reinterpret_cast<const unsigned char*>("localhost"), -1, -1, 0);
+  X509_set_issuer_name(certificate, X509_get_subject_name(certificate));
+  X509_sign(certificate, key, EVP_sha256());
+  SSL_CTX_use_certificate(context.native_handle(), certificate);
+  SSL_CTX_use_PrivateKey(context.native_handle(), key);
+  X509_free(certificate);
+  EVP_PKEY_free(key);
+}
+
+// the pool: reads the messages and the start line, then sends the messages back in one go
+awaitable<void> serve(tcp::acceptor& acceptor, boost::asio::ssl::context& context, std::string messages,
+                      std::promise<void>& received)
+{
+  try
+  {
+    boost::asio::ssl::stream<tcp::socket> stream(co_await acceptor.async_accept(use_awaitable), context);
+    co_await stream.async_handshake(boost::asio::ssl::stream_base::server, use_awaitable);
+    char buffer[16384];
+    std::size_t total = 0;
+    bool signalled = false;
+    while (total < messages.size() + sizeof(START_RECEIVING) - 1)
+    {
+      total += co_await stream.async_read_some(boost::asio::buffer(buffer), use_awaitable);
+      if (!signalled && total >= messages.size())
+      {
+        signalled = true;
+        received.set_value();
+      }
+    }
+    co_await boost::asio::async_write(stream, boost::asio::buffer(messages), use_awaitable);
+    // stays open until the connection is done reading
+    co_await stream.async_read_some(boost::asio::buffer(buffer), use_awaitable);
+  }
+  catch (const boost::system::system_error&)
+  {
+  }
+}
+
+awaitable<void> connect(UpstreamConnection::Ptr connection, uint16_t port, std::promise<void>& connected)
+{
+  try
+  {
+    co_await connection->connect("127.0.0.1", port);
+  }
+  catch (const boost::system::system_error&)
+  {
+    connected.set_exception(std::current_exception());
+    co_return;
+  }
+  connected.set_value();
+  co_await connection->receive();
+}
+
+// CPU time of the upstream thread, taken on it
+double upstreamCpuSeconds()
+{
+  std::promise<double> seconds;
+  boost::asio::post(ses::net::client::getIoContext(),
+                    [&seconds]()
+                    {
+                      timespec time;
+                      clock_gettime(CLOCK_THREAD_CPUTIME_ID, &time);
+                      seconds.set_value(time.tv_sec + time.tv_nsec * 1e-9);
+                    });
+  return seconds.get_future().get();
+}
+
+AllocationAccounting::Counters operator-(const AllocationAccounting::Counters& after,
+                                         const AllocationAccounting::Counters& before)
+{
+  return AllocationAccounting::Counters{after.allocations - before.allocations,
+                                        after.allocatedBytes - before.allocatedBytes,
+                                        after.largeCopies - before.largeCopies,
+                                        after.copiedBytes - before.copiedBytes};
+}
+
+void report(const std::string& mode, const std::string& phase, std::size_t count, Clock::duration wall,
+            double cpuSeconds, const AllocationAccounting::Counters& allocations)
+{
+  double wallSeconds = std::chrono::duration<double>(wall).count();
+  std::cout << std::left << std::setw(10) << mode << std::setw(9) << phase << std::right << std::fixed
+            << std::setprecision(0) << std::setw(12) << count / wallSeconds << " messages/s"
+            << std::setprecision(3) << std::setw(10) << cpuSeconds * 1e6 / count << " us cpu/message";
+  // in builds with allocation accounting only, counted in all threads
+  if (AllocationAccounting::ENABLED)
+  {
+    std::cout << std::setprecision(2) << std::setw(8) << static_cast<double>(allocations.allocations) / count
+              << " allocations/message" << std::setprecision(0) << std::setw(8)
+              << static_cast<double>(allocations.allocatedBytes) / count << " bytes/message"
+              << std::setprecision(2) << std::setw(8) << static_cast<double>(allocations.largeCopies) / count
+              << " large copies/message";
+  }
+  std::cout << std::endl;
+}
+
+bool run(const std::string& mode, ses::net::ConnectionType type, std::size_t count, std::size_t size)
+{
+  boost::asio::io_context poolContext(1);
+  boost::asio::ssl::context poolTls(boost::asio::ssl::context::tls_server);
+  useGeneratedCertificate(poolTls);
+  tcp::acceptor acceptor(poolContext, tcp::endpoint(boost::asio::ip::make_address("127.0.0.1"), 0));
+  std::string message(size - 1, 'x');
+  message += '\n';
+  std::string messages;
+  for (std::size_t i = 0; i < count; ++i)
+  {
+    messages += message;
+  }
+  std::promise<void> received;
+  boost::asio::co_spawn(poolContext, serve(acceptor, poolTls, messages, received), boost::asio::detached);
+  std::thread pool([&poolContext]() { poolContext.run(); });
+
+  auto counter = std::make_shared<Counter>();
+  counter->expected_ = count;
+  auto connection = std::make_shared<UpstreamConnection>(counter, type);
+  std::promise<void> connected;
+  boost::asio::co_spawn(ses::net::client::getIoContext(), connect(connection, acceptor.local_endpoint().port(), connected),
+                        boost::asio::detached);
+  bool succeeded = true;
+  try
+  {
+    connected.get_future().get();
+    // the connection logs every message it sends, which would outweigh the encryption
+    std::streambuf* output = std::cout.rdbuf(nullptr);
+
+    // the shares the proxy submits, sent one by one as the proxy does
+    double cpu = upstreamCpuSeconds();
+    AllocationAccounting::Counters allocations = AllocationAccounting::total();
+    Clock::time_point start = Clock::now();
+    for (std::size_t i = 0; i < count; ++i)
+    {
+      boost::asio::post(ses::net::client::getIoContext(), [&connection, &message]() { connection->send(message); });
+    }
+    received.get_future().get();
+    Clock::duration sendWall = Clock::now() - start;
+    double sendCpu = upstreamCpuSeconds() - cpu;
+    AllocationAccounting::Counters sendAllocations = AllocationAccounting::total() - allocations;
+
+    // the jobs the pool sends
+    cpu = upstreamCpuSeconds();
+    allocations = AllocationAccounting::total();
+    start = Clock::now();
+    boost::asio::post(ses::net::client::getIoContext(),
+                      [&connection]() { connection->send(START_RECEIVING, sizeof(START_RECEIVING) - 1); });
+    counter->done_.get_future().get();
+    Clock::duration receiveWall = Clock::now() - start;
+    double receiveCpu = upstreamCpuSeconds() - cpu;
+    AllocationAccounting::Counters receiveAllocations = AllocationAccounting::total() - allocations;
+    std::cout.rdbuf(output);
+    std::cout.clear();
+
+    report(mode, "send", count, sendWall, sendCpu, sendAllocations);
+    report(mode, "receive", count, receiveWall, receiveCpu, receiveAllocations);
+  }
+  catch (const boost::system::system_error& error)
+  {
+    std::cerr << mode << ": " << error.what() << std::endl;
+    succeeded = false;
+  }
+  connection->disconnect();
+  poolContext.stop();
+  pool.join();
+  return succeeded;
+}
+}
+
+// Compares TLS encrypted by OpenSSL with TLS handed to the kernel on an upstream connection: a pool
+// on loopback with a throwaway certificate takes the messages the connection sends, then sends as
+// many back. For both directions it reports messages per second and the CPU time the upstream
+// thread spent per message. Which directions the kernel took over is printed on connecting. Built
+// with allocation accounting, heap allocations and large copies per message are reported as well.
+//   ses_proxy_tlsbench [messages] [message size]
+int main(int argc, char* argv[])
+{
+  std::size_t count = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 100000;
+  std::size_t size = argc > 2 ? std::strtoul(argv[2], nullptr, 10) : 200;
+  if (count == 0 || size < 2)
+  {
+    std::cerr << "usage: " << argv[0] << " [messages] [message size]" << std::endl;
+    return 1;
+  }
+
+  bool succeeded = run("userspace", ses::net::CONNECTION_TYPE_TLS, count, size);
+  succeeded = run("kernel", ses::net::CONNECTION_TYPE_TLS_KERNEL, count, size) && succeeded;
+  return succeeded ? 0 : 1;
+}
@@ -0,0 +1,76 @@
+#include <algorithm>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "util/sharetrace.hpp"
+
+using ses::util::ShareTrace;
+
+namespace {
+double percentile(const std::vector<double>& sorted, double share)
+{
+  return sorted[std::min(sorted.size() - 1, static_cast<std::size_t>(share * sorted.size()))];
+}
+
+void printLatencies(const std::string& name, std::vector<double>& latencies)
+{
+  std::cout << std::left << std::setw(32) << name << std::right << std::setw(10) << latencies.size();
+  if (latencies.empty())
+  {
+    std::cout << std::endl;
+    return;
+  }
+  std::sort(latencies.begin(), latencies.end());
+  std::cout << std::fixed << std::setprecision(1) << std::setw(12) << percentile(latencies, 0.5)
+            << std::setw(12) << percentile(latencies, 0.9) << std::setw(12) << percentile(latencies, 0.99)
+            << std::setw(12) << latencies.back() << std::endl;
+}
+}
+
+// Prints the latency of each stage of the traced shares, measured from the previous stage the share
+// passed, in microseconds.
+//   ses_proxy_tracereport <trace file>
+int main(int argc, char* argv[])
+{
+  if (argc != 2)
+  {
+    std::cerr << "usage: " << argv[0] << " <trace file>" << std::endl;
+    return 1;
+  }
+
+  std::vector<double> stages[ShareTrace::STAGE_COUNT];
+  std::vector<double> totals;
+  double ticksPerMicrosecond = 1;
+  bool readable = ShareTrace::read(
+    argv[1], ticksPerMicrosecond,
+    [&stages, &totals, &ticksPerMicrosecond](const ShareTrace::Record& record)
+    {
+      int previous = ShareTrace::STAGE_READ;
+      for (int stage = ShareTrace::STAGE_READ + 1; stage < ShareTrace::STAGE_COUNT; ++stage)
+      {
+        if (record.stamps[stage] != 0)
+        {
+          stages[stage].push_back((record.stamps[stage] - record.stamps[previous]) / ticksPerMicrosecond);
+          previous = stage;
+        }
+      }
+      totals.push_back((record.stamps[previous] - record.stamps[ShareTrace::STAGE_READ]) / ticksPerMicrosecond);
+    });
+  if (!readable)
+  {
+    std::cerr << "cannot read " << argv[1] << std::endl;
+    return 1;
+  }
+
+  std::cout << std::left << std::setw(32) << "stage" << std::right << std::setw(10) << "shares" << std::setw(12)
+            << "p50 us" << std::setw(12) << "p90 us" << std::setw(12) << "p99 us" << std::setw(12) << "max us"
+            << std::endl;
+  for (int stage = ShareTrace::STAGE_READ + 1; stage < ShareTrace::STAGE_COUNT; ++stage)
+  {
+    printLatencies(ShareTrace::toString(static_cast<ShareTrace::Stage>(stage)), stages[stage]);
+  }
+  printLatencies("total", totals);
+  return 0;
+}
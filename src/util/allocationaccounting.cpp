@@ -0,0 +1,235 @@
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <new>
+
+#include "util/allocationaccounting.hpp"
+
+namespace ses {
+namespace util {
+
+namespace {
+struct SharedCounters
+{
+  std::atomic<uint64_t> allocations;
+  std::atomic<uint64_t> allocatedBytes;
+  std::atomic<uint64_t> largeCopies;
+  std::atomic<uint64_t> copiedBytes;
+};
+
+// index zero is for no type, all of it constant initialized for operator new before main
+SharedCounters counters[AllocationAccounting::MESSAGE_TYPE_CAPACITY + 1][AllocationAccounting::SUBSYSTEM_COUNT];
+std::atomic<uint64_t> messages[AllocationAccounting::MESSAGE_TYPE_CAPACITY + 1];
+char messageTypes[AllocationAccounting::MESSAGE_TYPE_CAPACITY][AllocationAccounting::MESSAGE_TYPE_SIZE_MAX + 1];
+std::atomic<std::size_t> messageTypeCount(0);
+std::mutex messageTypeMutex;
+
+void add(SharedCounters& shared, const AllocationAccounting::Counters& counters)
+{
+  shared.allocations.fetch_add(counters.allocations, std::memory_order_relaxed);
+  shared.allocatedBytes.fetch_add(counters.allocatedBytes, std::memory_order_relaxed);
+  shared.largeCopies.fetch_add(counters.largeCopies, std::memory_order_relaxed);
+  shared.copiedBytes.fetch_add(counters.copiedBytes, std::memory_order_relaxed);
+}
+
+AllocationAccounting::Counters load(const SharedCounters& shared)
+{
+  return AllocationAccounting::Counters{shared.allocations.load(std::memory_order_relaxed),
+                                        shared.allocatedBytes.load(std::memory_order_relaxed),
+                                        shared.largeCopies.load(std::memory_order_relaxed),
+                                        shared.copiedBytes.load(std::memory_order_relaxed)};
+}
+
+bool isZero(const AllocationAccounting::Counters& counters)
+{
+  return counters.allocations == 0 && counters.largeCopies == 0;
+}
+}
+
+const std::size_t AllocationAccounting::LARGE_COPY_SIZE;
+const std::size_t AllocationAccounting::MESSAGE_TYPE_CAPACITY;
+const std::size_t AllocationAccounting::MESSAGE_TYPE_SIZE_MAX;
+
+thread_local AllocationAccounting::ThreadState AllocationAccounting::threadState_;
+
+std::vector<AllocationAccounting::Summary> AllocationAccounting::collect()
+{
+  std::vector<Summary> summaries;
+  if (!ENABLED)
+  {
+    return summaries;
+  }
+
+  std::size_t typeCount = messageTypeCount.load(std::memory_order_acquire);
+  for (std::size_t type = 0; type <= typeCount; ++type)
+  {
+    Summary summary;
+    summary.messages = messages[type].load(std::memory_order_relaxed);
+    bool counted = summary.messages > 0;
+    for (int subsystem = 0; subsystem < SUBSYSTEM_COUNT; ++subsystem)
+    {
+      summary.counters[subsystem] = load(counters[type][subsystem]);
+      counted = counted || !isZero(summary.counters[subsystem]);
+    }
+    if (counted)
+    {
+      summary.messageType = type == 0 ? "" : messageTypes[type - 1];
+      summaries.push_back(summary);
+    }
+  }
+  return summaries;
+}
+
+AllocationAccounting::Counters AllocationAccounting::total()
+{
+  Counters sum{0, 0, 0, 0};
+  for (const Summary& summary : collect())
+  {
+    for (const Counters& counters : summary.counters)
+    {
+      sum.allocations += counters.allocations;
+      sum.allocatedBytes += counters.allocatedBytes;
+      sum.largeCopies += counters.largeCopies;
+      sum.copiedBytes += counters.copiedBytes;
+    }
+  }
+  return sum;
+}
+
+const char* AllocationAccounting::toString(Subsystem subsystem)
+{
+  switch (subsystem)
+  {
+    case SUBSYSTEM_OTHER:
+      return "other";
+    case SUBSYSTEM_NET:
+      return "net";
+    case SUBSYSTEM_JSONRPC:
+      return "jsonrpc";
+    case SUBSYSTEM_STRATUM:
+      return "stratum";
+    case SUBSYSTEM_PROXY:
+      return "proxy";
+    default:
+      return "unknown";
+  }
+}
+
+void AllocationAccounting::beginMessage()
+{
+  if (threadState_.messageDepth++ == 0)
+  {
+    threadState_.messageType = 0;
+  }
+}
+
+void AllocationAccounting::endMessage()
+{
+  if (--threadState_.messageDepth == 0)
+  {
+    uint8_t type = threadState_.messageType;
+    for (int subsystem = 0; subsystem < SUBSYSTEM_COUNT; ++subsystem)
+    {
+      Counters& pending = threadState_.pending[subsystem];
+      if (!isZero(pending))
+      {
+        add(counters[type][subsystem], pending);
+        pending = Counters{0, 0, 0, 0};
+      }
+    }
+    messages[type].fetch_add(1, std::memory_order_relaxed);
+  }
+}
+
+void AllocationAccounting::charge(uint64_t allocations, uint64_t allocatedBytes, uint64_t largeCopies,
+                                  uint64_t copiedBytes)
+{
+  if (threadState_.messageDepth > 0)
+  {
+    Counters& pending = threadState_.pending[threadState_.subsystem];
+    pending.allocations += allocations;
+    pending.allocatedBytes += allocatedBytes;
+    pending.largeCopies += largeCopies;
+    pending.copiedBytes += copiedBytes;
+  }
+  else
+  {
+    add(counters[0][threadState_.subsystem], Counters{allocations, allocatedBytes, largeCopies, copiedBytes});
+  }
+}
+
+uint8_t AllocationAccounting::findMessageType(std::string_view messageType)
+{
+  // registered types are never changed, only looking them up takes no lock
+  messageType = messageType.substr(0, MESSAGE_TYPE_SIZE_MAX);
+  auto find = [messageType](std::size_t count) -> std::size_t
+  {
+    for (std::size_t type = 0; type < count; ++type)
+    {
+      if (messageType == messageTypes[type])
+      {
+        return type + 1;
+      }
+    }
+    return 0;
+  };
+
+  std::size_t found = find(messageTypeCount.load(std::memory_order_acquire));
+  if (found == 0)
+  {
+    std::lock_guard<std::mutex> lock(messageTypeMutex);
+    std::size_t count = messageTypeCount.load(std::memory_order_relaxed);
+    found = find(count);
+    if (found == 0 && count < MESSAGE_TYPE_CAPACITY)
+    {
+      std::copy(messageType.begin(), messageType.end(), messageTypes[count]);
+      messageTypes[count][messageType.size()] = 0;
+      messageTypeCount.store(count + 1, std::memory_order_release);
+      found = count + 1;
+    }
+  }
+  return static_cast<uint8_t>(found);
+}
+
+} // namespace util
+} // namespace ses
+
+#ifdef SES_PROXY_ALLOCATION_ACCOUNTING
+// the other forms of new and delete of the standard library end up in these
+void* operator new(std::size_t size)
+{
+  ses::util::AllocationAccounting::recordAllocation(size);
+  void* pointer = std::malloc(size == 0 ? 1 : size);
+  if (!pointer)
+  {
+    throw std::bad_alloc();
+  }
+  return pointer;
+}
+
+void* operator new(std::size_t size, std::align_val_t alignment)
+{
+  ses::util::AllocationAccounting::recordAllocation(size);
+  std::size_t alignmentSize = static_cast<std::size_t>(alignment);
+  // aligned_alloc takes multiples of the alignment only
+  std::size_t alignedSize = std::max(alignmentSize, (size + alignmentSize - 1) & ~(alignmentSize - 1));
+  void* pointer = std::aligned_alloc(alignmentSize, alignedSize);
+  if (!pointer)
+  {
+    throw std::bad_alloc();
+  }
+  return pointer;
+}
+
+void operator delete(void* pointer) noexcept
+{
+  std::free(pointer);
+}
+
+void operator delete(void* pointer, std::align_val_t) noexcept
+{
+  std::free(pointer);
+}
+#endif
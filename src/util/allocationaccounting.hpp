@@ -0,0 +1,178 @@
+#ifndef SES_UTIL_ALLOCATIONACCOUNTING_HPP
+#define SES_UTIL_ALLOCATIONACCOUNTING_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <boost/noncopyable.hpp>
+
+namespace ses {
+namespace util {
+
+/**
+ * Heap allocations and large copies per subsystem and message type, counted in builds configured
+ * with SES_PROXY_ALLOCATION_ACCOUNTING only. Otherwise scopes and records compile to nothing.
+ *
+ * The accounting build replaces the global operator new, each allocation is charged to the
+ * subsystem of the innermost Scope of its thread. A MessageScope around the handling of a received
+ * message holds back its charges until the message ends, by then whoever parsed it set its type,
+ * and adds them to that type. Charges outside of messages count for no type. Copies are recorded
+ * where the message path copies data, those of LARGE_COPY_SIZE bytes and more are counted.
+ */
+class AllocationAccounting
+{
+public:
+  enum Subsystem
+  {
+    SUBSYSTEM_OTHER,
+    SUBSYSTEM_NET,
+    SUBSYSTEM_JSONRPC,
+    SUBSYSTEM_STRATUM,
+    SUBSYSTEM_PROXY,
+    SUBSYSTEM_COUNT
+  };
+
+  struct Counters
+  {
+    uint64_t allocations;
+    uint64_t allocatedBytes;
+    uint64_t largeCopies;
+    uint64_t copiedBytes;
+  };
+
+  struct Summary
+  {
+    // empty for what happened outside of messages or before their type was known
+    std::string messageType;
+    uint64_t messages;
+    Counters counters[SUBSYSTEM_COUNT];
+  };
+
+#ifdef SES_PROXY_ALLOCATION_ACCOUNTING
+  static constexpr bool ENABLED = true;
+#else
+  static constexpr bool ENABLED = false;
+#endif
+
+  static const std::size_t LARGE_COPY_SIZE = 128;
+  // further message types are counted without type
+  static const std::size_t MESSAGE_TYPE_CAPACITY = 32;
+  static const std::size_t MESSAGE_TYPE_SIZE_MAX = 31;
+
+  class Scope : private boost::noncopyable
+  {
+  public:
+    explicit Scope(Subsystem subsystem)
+    {
+#ifdef SES_PROXY_ALLOCATION_ACCOUNTING
+      previous_ = threadState_.subsystem;
+      threadState_.subsystem = subsystem;
+#endif
+    }
+
+    ~Scope()
+    {
+#ifdef SES_PROXY_ALLOCATION_ACCOUNTING
+      threadState_.subsystem = previous_;
+#endif
+    }
+
+  private:
+#ifdef SES_PROXY_ALLOCATION_ACCOUNTING
+    Subsystem previous_;
+#endif
+  };
+
+  // the handling of one received message, charged to net until inner scopes say otherwise
+  class MessageScope : private boost::noncopyable
+  {
+  public:
+    MessageScope()
+#ifdef SES_PROXY_ALLOCATION_ACCOUNTING
+      : scope_(SUBSYSTEM_NET)
+    {
+      beginMessage();
+    }
+#else
+    {
+    }
+#endif
+
+    ~MessageScope()
+    {
+#ifdef SES_PROXY_ALLOCATION_ACCOUNTING
+      endMessage();
+#endif
+    }
+
+  private:
+#ifdef SES_PROXY_ALLOCATION_ACCOUNTING
+    Scope scope_;
+#endif
+  };
+
+public:
+  // the method of a request or notification, "response" for responses, names are truncated to
+  // MESSAGE_TYPE_SIZE_MAX characters
+  static void setMessageType(std::string_view messageType)
+  {
+#ifdef SES_PROXY_ALLOCATION_ACCOUNTING
+    if (threadState_.messageDepth > 0)
+    {
+      threadState_.messageType = findMessageType(messageType);
+    }
+#endif
+  }
+
+  static void recordCopy(std::size_t size)
+  {
+#ifdef SES_PROXY_ALLOCATION_ACCOUNTING
+    if (size >= LARGE_COPY_SIZE)
+    {
+      charge(0, 0, 1, size);
+    }
+#endif
+  }
+
+  // called by the replaced operator new
+  static void recordAllocation(std::size_t size)
+  {
+#ifdef SES_PROXY_ALLOCATION_ACCOUNTING
+    charge(1, size, 0, 0);
+#endif
+  }
+
+  // everything counted since the start, per message type that has counts, none without accounting
+  static std::vector<Summary> collect();
+
+  // the sum over all message types and subsystems
+  static Counters total();
+
+  static const char* toString(Subsystem subsystem);
+
+private:
+  // zero initialized, operator new may use it before any constructor ran
+  struct ThreadState
+  {
+    Subsystem subsystem;
+    uint32_t messageDepth;
+    uint8_t messageType;
+    Counters pending[SUBSYSTEM_COUNT];
+  };
+
+  static void beginMessage();
+  static void endMessage();
+  static void charge(uint64_t allocations, uint64_t allocatedBytes, uint64_t largeCopies, uint64_t copiedBytes);
+  // one based index of the message type, registered on first use, zero if there is no room left
+  static uint8_t findMessageType(std::string_view messageType);
+
+  static thread_local ThreadState threadState_;
+};
+
+} // namespace util
+} // namespace ses
+
+#endif //SES_UTIL_ALLOCATIONACCOUNTING_HPP
@@ -0,0 +1,92 @@
+#ifndef SES_UTIL_ARENA_HPP
+#define SES_UTIL_ARENA_HPP
+
+#include <cstddef>
+#include <memory>
+#include <memory_resource>
+#include <string>
+
+namespace ses {
+namespace util {
+
+/**
+ * Per thread monotonic arena for memory that lives no longer than the handling of one message.
+ *
+ * Allocations are served from a preallocated buffer and are released in bulk by reset(), so the
+ * message path does not touch the global heap as long as one iteration fits into the buffer.
+ */
+class Arena
+{
+public:
+  static const std::size_t BUFFER_SIZE = 64 * 1024;
+
+  static Arena& local()
+  {
+    static thread_local Arena arena;
+    return arena;
+  }
+
+  std::pmr::memory_resource* resource()
+  {
+    return &resource_;
+  }
+
+  void reset()
+  {
+    resource_.release();
+  }
+
+private:
+  Arena()
+    : buffer_(new char[BUFFER_SIZE])
+    , resource_(buffer_.get(), BUFFER_SIZE)
+  {
+  }
+
+private:
+  std::unique_ptr<char[]> buffer_;
+  std::pmr::monotonic_buffer_resource resource_;
+};
+
+/**
+ * Marks one iteration of message handling. The arena of the current thread is reset when the
+ * outermost scope ends, so everything allocated from it must not outlive that scope.
+ */
+class ArenaScope
+{
+public:
+  ArenaScope()
+  {
+    ++depth();
+  }
+
+  ~ArenaScope()
+  {
+    if (--depth() == 0)
+    {
+      Arena::local().reset();
+    }
+  }
+
+  ArenaScope(const ArenaScope&) = delete;
+  ArenaScope& operator=(const ArenaScope&) = delete;
+
+private:
+  static std::size_t& depth()
+  {
+    static thread_local std::size_t depth = 0;
+    return depth;
+  }
+};
+
+typedef std::pmr::string ArenaString;
+
+inline ArenaString makeArenaString()
+{
+  return ArenaString(Arena::local().resource());
+}
+
+} // namespace util
+} // namespace ses
+
+#endif //SES_UTIL_ARENA_HPP
@@ -2,6 +2,11 @@
 #define SES_UTIL_BOOSTPROPERTYTREE_HPP
 
 #include <boost/exception/diagnostic_information.hpp>
+#include <boost/iostreams/stream.hpp>
+#include <boost/iostreams/device/array.hpp>
+#include <boost/iostreams/device/back_inserter.hpp>
+
+#include "util/arena.hpp"
 
 namespace ses {
 namespace util {
@@ -21,6 +26,20 @@ inline boost::property_tree::ptree stringToPtree(const std::string& string)
   return tree;
 }
 
+inline boost::property_tree::ptree stringToPtree(const char* data, std::size_t size)
+{
+  boost::iostreams::stream<boost::iostreams::array_source> stream(data, size);
+  boost::property_tree::ptree tree;
+  try
+  {
+    boost::property_tree::read_json(stream, tree);
+  }
+  catch (...)
+  {
+  }
+  return tree;
+}
+
 inline std::string ptreeToString(const boost::property_tree::ptree& ptree, bool pretty = true)
 {
   std::ostringstream stream;
@@ -39,7 +58,22 @@ inline std::string ptreeToString(const boost::optional<boost::property_tree::ptr
   std::string result;
   if (ptree)
   {
-    result = ptreeToString(*ptree, pretty);
+    // a bare value like true, a number or null is no JSON document of its own, its text is returned
+    result = ptree->empty() ? ptree->data() : ptreeToString(*ptree, pretty);
+  }
+  return result;
+}
+
+inline util::ArenaString ptreeToArenaString(const boost::property_tree::ptree& ptree, bool pretty = true)
+{
+  util::ArenaString result = util::makeArenaString();
+  try
+  {
+    boost::iostreams::stream<boost::iostreams::back_insert_device<util::ArenaString> > stream(result);
+    boost::property_tree::write_json(stream, ptree, pretty);
+  }
+  catch (...)
+  {
   }
   return result;
 }
@@ -0,0 +1,891 @@
+#include <cstring>
+#include <cpuid.h>
+#include <immintrin.h>
+#include <new>
+#include <sys/mman.h>
+#include <utility>
+
+#include "util/cryptonight.hpp"
+
+namespace ses {
+namespace util {
+
+namespace {
+const std::size_t KECCAK_RATE = 136;
+const std::size_t AES_BLOCK_SIZE = 16;
+const std::size_t AES_ROUNDS = 10;
+// the scratchpad is filled and folded eight AES blocks at a time
+const std::size_t TEXT_SIZE = 8 * AES_BLOCK_SIZE;
+const std::size_t ITERATIONS = 1 << 20;
+const uint64_t ADDRESS_MASK = (CryptoNight::SCRATCHPAD_SIZE - 1) & ~uint64_t(AES_BLOCK_SIZE - 1);
+
+const uint64_t KECCAK_ROUND_CONSTANTS[24] = {
+  0x0000000000000001, 0x0000000000008082, 0x800000000000808a, 0x8000000080008000,
+  0x000000000000808b, 0x0000000080000001, 0x8000000080008081, 0x8000000000008009,
+  0x000000000000008a, 0x0000000000000088, 0x0000000080008009, 0x000000008000000a,
+  0x000000008000808b, 0x800000000000008b, 0x8000000000008089, 0x8000000000008003,
+  0x8000000000008002, 0x8000000000000080, 0x000000000000800a, 0x800000008000000a,
+  0x8000000080008081, 0x8000000000008080, 0x0000000080000001, 0x8000000080008008};
+const int KECCAK_ROTATIONS[24] = {1, 3, 6, 10, 15, 21, 28, 36, 45, 55, 2, 14, 27, 41, 56, 8, 25, 43, 62, 18, 39, 61,
+                                  20, 44};
+const int KECCAK_LANES[24] = {10, 7, 11, 17, 18, 3, 5, 16, 8, 21, 24, 4, 15, 23, 19, 13, 12, 2, 20, 14, 22, 9, 6, 1};
+
+const uint32_t BLAKE_INITIAL_STATE[8] = {
+  0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19};
+const uint32_t BLAKE_CONSTANTS[16] = {
+  0x243f6a88, 0x85a308d3, 0x13198a2e, 0x03707344, 0xa4093822, 0x299f31d0, 0x082efa98, 0xec4e6c89,
+  0x452821e6, 0x38d01377, 0xbe5466cf, 0x34e90c6c, 0xc0ac29b7, 0xc97c50dd, 0x3f84d5b5, 0xb5470917};
+const uint8_t BLAKE_PERMUTATIONS[10][16] = {
+  {0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15},
+  {14, 10, 4, 8, 9, 15, 13, 6, 1, 12, 0, 2, 11, 7, 5, 3},
+  {11, 8, 12, 0, 5, 2, 15, 13, 10, 14, 3, 6, 7, 1, 9, 4},
+  {7, 9, 3, 1, 13, 12, 11, 14, 2, 6, 5, 10, 4, 0, 15, 8},
+  {9, 0, 5, 7, 2, 4, 10, 15, 14, 1, 11, 12, 6, 8, 3, 13},
+  {2, 12, 6, 10, 0, 11, 8, 3, 4, 13, 7, 5, 15, 14, 1, 9},
+  {12, 5, 1, 15, 14, 13, 4, 10, 0, 7, 6, 3, 9, 2, 8, 11},
+  {13, 11, 7, 14, 12, 1, 3, 9, 5, 0, 15, 4, 8, 6, 2, 10},
+  {6, 15, 14, 9, 11, 3, 0, 8, 12, 2, 13, 7, 1, 4, 10, 5},
+  {10, 2, 8, 4, 7, 6, 1, 5, 15, 11, 9, 14, 3, 12, 13, 0}};
+
+const uint8_t GROESTL_MIX[8] = {2, 2, 3, 4, 5, 3, 5, 7};
+const int GROESTL_SHIFTS_P[8] = {0, 1, 2, 3, 4, 5, 6, 7};
+const int GROESTL_SHIFTS_Q[8] = {1, 3, 5, 7, 0, 2, 4, 6};
+
+const uint8_t JH_SBOXES[2][16] = {
+  {9, 0, 4, 11, 13, 12, 3, 15, 1, 10, 2, 6, 7, 5, 8, 14},
+  {3, 12, 6, 13, 5, 7, 1, 9, 15, 2, 0, 4, 11, 10, 14, 8}};
+// the fraction of the square root of 2, the round constants are derived from it
+const uint8_t JH_FIRST_ROUND_CONSTANT[32] = {
+  0x6a, 0x09, 0xe6, 0x67, 0xf3, 0xbc, 0xc9, 0x08, 0xb2, 0xfb, 0x13, 0x66, 0xea, 0x95, 0x7d, 0x3e,
+  0x3a, 0xde, 0xc1, 0x75, 0x12, 0x77, 0x50, 0x99, 0xda, 0x2f, 0x59, 0x0b, 0x06, 0x67, 0x32, 0x2a};
+const int JH_ROUNDS = 42;
+
+const uint64_t SKEIN_KEY_PARITY = 0x1bd11bdaa9fc1a22;
+const int SKEIN_ROTATIONS[8][4] = {
+  {46, 36, 19, 37}, {33, 27, 14, 42}, {17, 49, 36, 39}, {44, 9, 54, 56},
+  {39, 30, 34, 24}, {13, 50, 10, 17}, {25, 29, 39, 43}, {8, 35, 56, 22}};
+const int SKEIN_PERMUTATION[8] = {2, 1, 4, 7, 6, 5, 0, 3};
+const uint64_t SKEIN_FIRST = uint64_t(1) << 62;
+const uint64_t SKEIN_FINAL = uint64_t(1) << 63;
+const uint64_t SKEIN_CONFIGURATION = uint64_t(4) << 56;
+const uint64_t SKEIN_MESSAGE = uint64_t(48) << 56;
+const uint64_t SKEIN_OUTPUT = uint64_t(63) << 56;
+// "SHA3" and version 1
+const uint64_t SKEIN_SCHEMA = 0x0000000133414853;
+
+inline uint64_t rotateLeft(uint64_t value, int bits)
+{
+  return (value << bits) | (value >> (64 - bits));
+}
+
+inline uint32_t rotateRight(uint32_t value, int bits)
+{
+  return (value >> bits) | (value << (32 - bits));
+}
+
+inline uint32_t readBigEndian(const uint8_t* data)
+{
+  return (uint32_t(data[0]) << 24) | (uint32_t(data[1]) << 16) | (uint32_t(data[2]) << 8) | data[3];
+}
+
+inline uint8_t bit(const uint8_t* data, std::size_t index)
+{
+  return (data[index / 8] >> (7 - index % 8)) & 1;
+}
+
+uint8_t gfMultiply(uint8_t a, uint8_t b)
+{
+  uint8_t product = 0;
+  for (; b; b >>= 1)
+  {
+    if (b & 1)
+    {
+      product ^= a;
+    }
+    a = static_cast<uint8_t>((a << 1) ^ (a & 0x80 ? 0x1b : 0));
+  }
+  return product;
+}
+
+// tables derived once instead of spelled out
+struct Tables
+{
+  Tables()
+  {
+    // the AES S-box is the affine transform of the multiplicative inverse, walked through with
+    // 3 as generator and its inverse
+    uint8_t p = 1;
+    uint8_t q = 1;
+    do
+    {
+      p = static_cast<uint8_t>(p ^ (p << 1) ^ (p & 0x80 ? 0x1b : 0));
+      q = static_cast<uint8_t>(q ^ (q << 1));
+      q = static_cast<uint8_t>(q ^ (q << 2));
+      q = static_cast<uint8_t>(q ^ (q << 4));
+      if (q & 0x80)
+      {
+        q ^= 0x09;
+      }
+      uint8_t affine = q;
+      for (int shift = 1; shift < 5; ++shift)
+      {
+        affine ^= static_cast<uint8_t>((q << shift) | (q >> (8 - shift)));
+      }
+      sbox[p] = affine ^ 0x63;
+    }
+    while (p != 1);
+    sbox[0] = 0x63;
+
+    // JH's round constants are the previous one through a round of the 256 bit variant
+    std::memcpy(jhRoundConstants[0], JH_FIRST_ROUND_CONSTANT, sizeof(JH_FIRST_ROUND_CONSTANT));
+    const uint8_t zero[8] = {};
+    for (int round = 1; round < JH_ROUNDS; ++round)
+    {
+      uint8_t elements[64];
+      for (int i = 0; i < 64; ++i)
+      {
+        elements[i] = (jhRoundConstants[round - 1][i / 2] >> (i % 2 ? 0 : 4)) & 0xf;
+      }
+      jhRound(elements, 6, zero);
+      for (int i = 0; i < 32; ++i)
+      {
+        jhRoundConstants[round][i] = static_cast<uint8_t>((elements[2 * i] << 4) | elements[2 * i + 1]);
+      }
+    }
+  }
+
+  // a round on 2^dimension 4 bit elements, the constant's bits select the S-box of each
+  static void jhRound(uint8_t* elements, int dimension, const uint8_t* constant)
+  {
+    const std::size_t count = std::size_t(1) << dimension;
+    for (std::size_t i = 0; i < count; ++i)
+    {
+      elements[i] = JH_SBOXES[bit(constant, i)][elements[i]];
+    }
+    // the linear transform is a multiplication by 2 in GF(2^4)
+    auto times2 = [](uint8_t element)
+    {
+      return static_cast<uint8_t>(((element << 1) ^ (element & 8 ? 3 : 0)) & 0xf);
+    };
+    for (std::size_t i = 0; i < count; i += 2)
+    {
+      elements[i + 1] ^= times2(elements[i]);
+      elements[i] ^= times2(elements[i + 1]);
+    }
+
+    uint8_t swapped[256];
+    for (std::size_t i = 0; i < count; i += 4)
+    {
+      swapped[i] = elements[i];
+      swapped[i + 1] = elements[i + 1];
+      swapped[i + 2] = elements[i + 3];
+      swapped[i + 3] = elements[i + 2];
+    }
+    for (std::size_t i = 0; i < count / 2; ++i)
+    {
+      elements[i] = swapped[2 * i];
+      elements[i + count / 2] = swapped[2 * i + 1];
+    }
+    for (std::size_t i = count / 2; i < count; i += 2)
+    {
+      std::swap(elements[i], elements[i + 1]);
+    }
+  }
+
+  uint8_t sbox[256];
+  uint8_t jhRoundConstants[JH_ROUNDS][32];
+};
+
+const Tables& tables()
+{
+  static const Tables tables;
+  return tables;
+}
+
+void keccakPermutation(uint64_t* state)
+{
+  for (uint64_t roundConstant : KECCAK_ROUND_CONSTANTS)
+  {
+    uint64_t parity[5];
+    for (int i = 0; i < 5; ++i)
+    {
+      parity[i] = state[i] ^ state[i + 5] ^ state[i + 10] ^ state[i + 15] ^ state[i + 20];
+    }
+    for (int i = 0; i < 5; ++i)
+    {
+      uint64_t theta = parity[(i + 4) % 5] ^ rotateLeft(parity[(i + 1) % 5], 1);
+      for (int j = 0; j < 25; j += 5)
+      {
+        state[j + i] ^= theta;
+      }
+    }
+
+    uint64_t lane = state[1];
+    for (int i = 0; i < 24; ++i)
+    {
+      uint64_t next = state[KECCAK_LANES[i]];
+      state[KECCAK_LANES[i]] = rotateLeft(lane, KECCAK_ROTATIONS[i]);
+      lane = next;
+    }
+
+    for (int j = 0; j < 25; j += 5)
+    {
+      uint64_t row[5];
+      std::memcpy(row, state + j, sizeof(row));
+      for (int i = 0; i < 5; ++i)
+      {
+        state[j + i] = row[i] ^ (~row[(i + 1) % 5] & row[(i + 2) % 5]);
+      }
+    }
+
+    state[0] ^= roundConstant;
+  }
+}
+
+// Keccak as submitted to the SHA-3 competition, before the padding changed, keeping all 200 bytes
+void keccak1600(const uint8_t* data, std::size_t size, uint64_t* state)
+{
+  std::memset(state, 0, 25 * sizeof(uint64_t));
+  for (; size >= KECCAK_RATE; size -= KECCAK_RATE, data += KECCAK_RATE)
+  {
+    for (std::size_t i = 0; i < KECCAK_RATE / 8; ++i)
+    {
+      uint64_t word;
+      std::memcpy(&word, data + 8 * i, sizeof(word));
+      state[i] ^= word;
+    }
+    keccakPermutation(state);
+  }
+
+  uint8_t block[KECCAK_RATE] = {};
+  std::memcpy(block, data, size);
+  block[size] = 0x01;
+  block[KECCAK_RATE - 1] |= 0x80;
+  for (std::size_t i = 0; i < KECCAK_RATE / 8; ++i)
+  {
+    uint64_t word;
+    std::memcpy(&word, block + 8 * i, sizeof(word));
+    state[i] ^= word;
+  }
+  keccakPermutation(state);
+}
+
+// the first ten round keys of the AES-256 key schedule
+void expandKey(const uint8_t* key, uint8_t* roundKeys)
+{
+  const uint8_t* sbox = tables().sbox;
+  std::memcpy(roundKeys, key, 32);
+  uint8_t roundConstant = 1;
+  for (std::size_t i = 8; i < 4 * AES_ROUNDS; ++i)
+  {
+    uint8_t word[4];
+    std::memcpy(word, roundKeys + 4 * (i - 1), sizeof(word));
+    if (i % 8 == 0)
+    {
+      uint8_t first = word[0];
+      word[0] = sbox[word[1]] ^ roundConstant;
+      word[1] = sbox[word[2]];
+      word[2] = sbox[word[3]];
+      word[3] = sbox[first];
+      roundConstant = static_cast<uint8_t>((roundConstant << 1) ^ (roundConstant & 0x80 ? 0x1b : 0));
+    }
+    else if (i % 8 == 4)
+    {
+      for (uint8_t& byte : word)
+      {
+        byte = sbox[byte];
+      }
+    }
+    for (int j = 0; j < 4; ++j)
+    {
+      roundKeys[4 * i + j] = roundKeys[4 * (i - 8) + j] ^ word[j];
+    }
+  }
+}
+
+// one AES encryption round as the aesenc instruction does it
+void aesRound(uint8_t* block, const uint8_t* roundKey)
+{
+  const uint8_t* sbox = tables().sbox;
+  uint8_t shifted[AES_BLOCK_SIZE];
+  for (int column = 0; column < 4; ++column)
+  {
+    for (int row = 0; row < 4; ++row)
+    {
+      shifted[4 * column + row] = sbox[block[4 * ((column + row) % 4) + row]];
+    }
+  }
+  for (int column = 0; column < 4; ++column)
+  {
+    const uint8_t* in = shifted + 4 * column;
+    uint8_t all = in[0] ^ in[1] ^ in[2] ^ in[3];
+    for (int row = 0; row < 4; ++row)
+    {
+      uint8_t pair = in[row] ^ in[(row + 1) % 4];
+      pair = static_cast<uint8_t>((pair << 1) ^ (pair & 0x80 ? 0x1b : 0));
+      block[4 * column + row] = in[row] ^ all ^ pair ^ roundKey[4 * column + row];
+    }
+  }
+}
+
+void multiply(uint64_t a, uint64_t b, uint64_t& high, uint64_t& low)
+{
+  unsigned __int128 product = static_cast<unsigned __int128>(a) * b;
+  high = static_cast<uint64_t>(product >> 64);
+  low = static_cast<uint64_t>(product);
+}
+
+// fills the scratchpad from the state, runs the memory hard loop over it and folds it back into the
+// state's text, the kernels differ in how they do AES only
+void transformScalar(uint64_t* state, uint8_t* scratchpad)
+{
+  uint8_t* bytes = reinterpret_cast<uint8_t*>(state);
+  uint8_t roundKeys[AES_ROUNDS * AES_BLOCK_SIZE];
+  uint8_t text[TEXT_SIZE];
+
+  expandKey(bytes, roundKeys);
+  std::memcpy(text, bytes + 64, TEXT_SIZE);
+  for (std::size_t offset = 0; offset < CryptoNight::SCRATCHPAD_SIZE; offset += TEXT_SIZE)
+  {
+    for (std::size_t block = 0; block < TEXT_SIZE; block += AES_BLOCK_SIZE)
+    {
+      for (std::size_t round = 0; round < AES_ROUNDS; ++round)
+      {
+        aesRound(text + block, roundKeys + round * AES_BLOCK_SIZE);
+      }
+    }
+    std::memcpy(scratchpad + offset, text, TEXT_SIZE);
+  }
+
+  uint64_t a[2] = {state[0] ^ state[4], state[1] ^ state[5]};
+  uint64_t b[2] = {state[2] ^ state[6], state[3] ^ state[7]};
+  for (std::size_t i = 0; i < ITERATIONS / 2; ++i)
+  {
+    uint64_t c[2];
+    uint8_t* entry = scratchpad + (a[0] & ADDRESS_MASK);
+    std::memcpy(c, entry, sizeof(c));
+    aesRound(reinterpret_cast<uint8_t*>(c), reinterpret_cast<const uint8_t*>(a));
+    b[0] ^= c[0];
+    b[1] ^= c[1];
+    std::memcpy(entry, b, sizeof(b));
+
+    uint64_t d[2];
+    entry = scratchpad + (c[0] & ADDRESS_MASK);
+    std::memcpy(d, entry, sizeof(d));
+    uint64_t high, low;
+    multiply(c[0], d[0], high, low);
+    a[0] += high;
+    a[1] += low;
+    std::memcpy(entry, a, sizeof(a));
+    a[0] ^= d[0];
+    a[1] ^= d[1];
+    b[0] = c[0];
+    b[1] = c[1];
+  }
+
+  expandKey(bytes + 32, roundKeys);
+  std::memcpy(text, bytes + 64, TEXT_SIZE);
+  for (std::size_t offset = 0; offset < CryptoNight::SCRATCHPAD_SIZE; offset += TEXT_SIZE)
+  {
+    for (std::size_t block = 0; block < TEXT_SIZE; ++block)
+    {
+      text[block] ^= scratchpad[offset + block];
+    }
+    for (std::size_t block = 0; block < TEXT_SIZE; block += AES_BLOCK_SIZE)
+    {
+      for (std::size_t round = 0; round < AES_ROUNDS; ++round)
+      {
+        aesRound(text + block, roundKeys + round * AES_BLOCK_SIZE);
+      }
+    }
+  }
+  std::memcpy(bytes + 64, text, TEXT_SIZE);
+}
+
+__attribute__((target("aes,sse4.1")))
+void transformAesNi(uint64_t* state, uint8_t* scratchpad)
+{
+  uint8_t* bytes = reinterpret_cast<uint8_t*>(state);
+  uint8_t roundKeyBytes[AES_ROUNDS * AES_BLOCK_SIZE];
+  __m128i roundKeys[AES_ROUNDS];
+  __m128i text[TEXT_SIZE / AES_BLOCK_SIZE];
+
+  expandKey(bytes, roundKeyBytes);
+  for (std::size_t round = 0; round < AES_ROUNDS; ++round)
+  {
+    roundKeys[round] = _mm_loadu_si128(reinterpret_cast<const __m128i*>(roundKeyBytes) + round);
+  }
+  for (std::size_t block = 0; block < TEXT_SIZE / AES_BLOCK_SIZE; ++block)
+  {
+    text[block] = _mm_loadu_si128(reinterpret_cast<const __m128i*>(bytes + 64) + block);
+  }
+  for (std::size_t offset = 0; offset < CryptoNight::SCRATCHPAD_SIZE; offset += TEXT_SIZE)
+  {
+    for (std::size_t block = 0; block < TEXT_SIZE / AES_BLOCK_SIZE; ++block)
+    {
+      for (std::size_t round = 0; round < AES_ROUNDS; ++round)
+      {
+        text[block] = _mm_aesenc_si128(text[block], roundKeys[round]);
+      }
+      _mm_store_si128(reinterpret_cast<__m128i*>(scratchpad + offset) + block, text[block]);
+    }
+  }
+
+  uint64_t a0 = state[0] ^ state[4];
+  uint64_t a1 = state[1] ^ state[5];
+  __m128i b = _mm_set_epi64x(static_cast<int64_t>(state[3] ^ state[7]), static_cast<int64_t>(state[2] ^ state[6]));
+  for (std::size_t i = 0; i < ITERATIONS / 2; ++i)
+  {
+    __m128i* entry = reinterpret_cast<__m128i*>(scratchpad + (a0 & ADDRESS_MASK));
+    __m128i c = _mm_aesenc_si128(_mm_load_si128(entry),
+                                 _mm_set_epi64x(static_cast<int64_t>(a1), static_cast<int64_t>(a0)));
+    _mm_store_si128(entry, _mm_xor_si128(b, c));
+    b = c;
+
+    uint64_t c0 = static_cast<uint64_t>(_mm_cvtsi128_si64(c));
+    uint64_t* words = reinterpret_cast<uint64_t*>(scratchpad + (c0 & ADDRESS_MASK));
+    uint64_t d0 = words[0];
+    uint64_t d1 = words[1];
+    uint64_t high, low;
+    multiply(c0, d0, high, low);
+    a0 += high;
+    a1 += low;
+    words[0] = a0;
+    words[1] = a1;
+    a0 ^= d0;
+    a1 ^= d1;
+  }
+
+  expandKey(bytes + 32, roundKeyBytes);
+  for (std::size_t round = 0; round < AES_ROUNDS; ++round)
+  {
+    roundKeys[round] = _mm_loadu_si128(reinterpret_cast<const __m128i*>(roundKeyBytes) + round);
+  }
+  for (std::size_t block = 0; block < TEXT_SIZE / AES_BLOCK_SIZE; ++block)
+  {
+    text[block] = _mm_loadu_si128(reinterpret_cast<const __m128i*>(bytes + 64) + block);
+  }
+  for (std::size_t offset = 0; offset < CryptoNight::SCRATCHPAD_SIZE; offset += TEXT_SIZE)
+  {
+    for (std::size_t block = 0; block < TEXT_SIZE / AES_BLOCK_SIZE; ++block)
+    {
+      text[block] = _mm_xor_si128(text[block],
+                                  _mm_load_si128(reinterpret_cast<const __m128i*>(scratchpad + offset) + block));
+      for (std::size_t round = 0; round < AES_ROUNDS; ++round)
+      {
+        text[block] = _mm_aesenc_si128(text[block], roundKeys[round]);
+      }
+    }
+  }
+  for (std::size_t block = 0; block < TEXT_SIZE / AES_BLOCK_SIZE; ++block)
+  {
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(bytes + 64) + block, text[block]);
+  }
+}
+
+bool cpuSupportsAesNi()
+{
+  unsigned int eax, ebx, ecx, edx;
+  return __get_cpuid(1, &eax, &ebx, &ecx, &edx) && (ecx & bit_AES) && (ecx & bit_SSE4_1);
+}
+
+struct Kernels
+{
+  Kernels()
+  {
+    if (cpuSupportsAesNi())
+    {
+      transform_ = &transformAesNi;
+      name_ = "aes-ni";
+    }
+  }
+
+  void (* transform_)(uint64_t*, uint8_t*) = &transformScalar;
+  const char* name_ = "scalar";
+};
+
+const Kernels& kernels()
+{
+  static const Kernels kernels;
+  return kernels;
+}
+
+void blakeCompress(uint32_t* hash, const uint8_t* block, uint64_t counter)
+{
+  uint32_t message[16];
+  for (int i = 0; i < 16; ++i)
+  {
+    message[i] = readBigEndian(block + 4 * i);
+  }
+  uint32_t v[16];
+  std::memcpy(v, hash, 8 * sizeof(uint32_t));
+  for (int i = 0; i < 8; ++i)
+  {
+    v[8 + i] = BLAKE_CONSTANTS[i];
+  }
+  v[12] ^= static_cast<uint32_t>(counter);
+  v[13] ^= static_cast<uint32_t>(counter);
+  v[14] ^= static_cast<uint32_t>(counter >> 32);
+  v[15] ^= static_cast<uint32_t>(counter >> 32);
+
+  for (int round = 0; round < 14; ++round)
+  {
+    const uint8_t* permutation = BLAKE_PERMUTATIONS[round % 10];
+    auto mix = [&v, &message, permutation](int a, int b, int c, int d, int i)
+    {
+      v[a] += v[b] + (message[permutation[2 * i]] ^ BLAKE_CONSTANTS[permutation[2 * i + 1]]);
+      v[d] = rotateRight(v[d] ^ v[a], 16);
+      v[c] += v[d];
+      v[b] = rotateRight(v[b] ^ v[c], 12);
+      v[a] += v[b] + (message[permutation[2 * i + 1]] ^ BLAKE_CONSTANTS[permutation[2 * i]]);
+      v[d] = rotateRight(v[d] ^ v[a], 8);
+      v[c] += v[d];
+      v[b] = rotateRight(v[b] ^ v[c], 7);
+    };
+    mix(0, 4, 8, 12, 0);
+    mix(1, 5, 9, 13, 1);
+    mix(2, 6, 10, 14, 2);
+    mix(3, 7, 11, 15, 3);
+    mix(0, 5, 10, 15, 4);
+    mix(1, 6, 11, 12, 5);
+    mix(2, 7, 8, 13, 6);
+    mix(3, 4, 9, 14, 7);
+  }
+
+  for (int i = 0; i < 8; ++i)
+  {
+    hash[i] ^= v[i] ^ v[i + 8];
+  }
+}
+
+void blake256(const uint8_t* data, std::size_t size, uint8_t* out)
+{
+  uint32_t hash[8];
+  std::memcpy(hash, BLAKE_INITIAL_STATE, sizeof(hash));
+  const uint64_t bits = uint64_t(size) * 8;
+  uint64_t counter = 0;
+  for (; size >= 64; size -= 64, data += 64)
+  {
+    counter += 512;
+    blakeCompress(hash, data, counter);
+  }
+
+  // the counter excludes the padding and is zero for blocks of padding only
+  uint8_t blocks[128] = {};
+  std::memcpy(blocks, data, size);
+  blocks[size] = 0x80;
+  std::size_t paddedSize = size <= 55 ? 64 : 128;
+  blocks[paddedSize - 9] |= 0x01;
+  for (int i = 0; i < 8; ++i)
+  {
+    blocks[paddedSize - 1 - i] = static_cast<uint8_t>(bits >> (8 * i));
+  }
+  blakeCompress(hash, blocks, size > 0 ? bits : 0);
+  if (paddedSize == 128)
+  {
+    blakeCompress(hash, blocks + 64, 0);
+  }
+
+  for (int i = 0; i < 8; ++i)
+  {
+    out[4 * i] = static_cast<uint8_t>(hash[i] >> 24);
+    out[4 * i + 1] = static_cast<uint8_t>(hash[i] >> 16);
+    out[4 * i + 2] = static_cast<uint8_t>(hash[i] >> 8);
+    out[4 * i + 3] = static_cast<uint8_t>(hash[i]);
+  }
+}
+
+// the state is column major, byte 8 * column + row
+void groestlPermutation(uint8_t* state, bool q)
+{
+  const uint8_t* sbox = tables().sbox;
+  const int* shifts = q ? GROESTL_SHIFTS_Q : GROESTL_SHIFTS_P;
+  for (uint8_t round = 0; round < 10; ++round)
+  {
+    for (int column = 0; column < 8; ++column)
+    {
+      uint8_t constant = static_cast<uint8_t>((column << 4) ^ round);
+      if (q)
+      {
+        for (int row = 0; row < 7; ++row)
+        {
+          state[8 * column + row] ^= 0xff;
+        }
+        state[8 * column + 7] ^= 0xff ^ constant;
+      }
+      else
+      {
+        state[8 * column] ^= constant;
+      }
+    }
+
+    uint8_t shifted[64];
+    for (int column = 0; column < 8; ++column)
+    {
+      for (int row = 0; row < 8; ++row)
+      {
+        shifted[8 * column + row] = sbox[state[8 * ((column + shifts[row]) % 8) + row]];
+      }
+    }
+
+    for (int column = 0; column < 8; ++column)
+    {
+      for (int row = 0; row < 8; ++row)
+      {
+        uint8_t mixed = 0;
+        for (int k = 0; k < 8; ++k)
+        {
+          mixed ^= gfMultiply(shifted[8 * column + k], GROESTL_MIX[(k - row + 8) % 8]);
+        }
+        state[8 * column + row] = mixed;
+      }
+    }
+  }
+}
+
+void groestl256(const uint8_t* data, std::size_t size, uint8_t* out)
+{
+  uint8_t hash[64] = {};
+  hash[62] = 0x01;
+
+  std::size_t blockCount = (size + 9 + 63) / 64;
+  std::size_t paddedSize = blockCount * 64;
+  uint8_t tail[128] = {};
+  std::size_t tailOffset = size / 64 * 64;
+  std::memcpy(tail, data + tailOffset, size - tailOffset);
+  tail[size - tailOffset] = 0x80;
+  for (int i = 0; i < 8; ++i)
+  {
+    tail[paddedSize - tailOffset - 1 - i] = static_cast<uint8_t>(uint64_t(blockCount) >> (8 * i));
+  }
+
+  for (std::size_t offset = 0; offset < paddedSize; offset += 64)
+  {
+    const uint8_t* block = offset < tailOffset ? data + offset : tail + (offset - tailOffset);
+    uint8_t p[64];
+    uint8_t q[64];
+    for (int i = 0; i < 64; ++i)
+    {
+      p[i] = hash[i] ^ block[i];
+    }
+    std::memcpy(q, block, sizeof(q));
+    groestlPermutation(p, false);
+    groestlPermutation(q, true);
+    for (int i = 0; i < 64; ++i)
+    {
+      hash[i] ^= p[i] ^ q[i];
+    }
+  }
+
+  uint8_t p[64];
+  std::memcpy(p, hash, sizeof(p));
+  groestlPermutation(p, false);
+  for (int i = 0; i < 32; ++i)
+  {
+    out[i] = p[32 + i] ^ hash[32 + i];
+  }
+}
+
+void jhPermutation(uint8_t* state)
+{
+  // element 2i takes bits i, i + 256, i + 512 and i + 768, element 2i + 1 the ones 128 bits further
+  uint8_t elements[256];
+  for (std::size_t i = 0; i < 256; ++i)
+  {
+    elements[i % 128 * 2 + i / 128] =
+      static_cast<uint8_t>((bit(state, i) << 3) | (bit(state, i + 256) << 2) | (bit(state, i + 512) << 1) |
+                           bit(state, i + 768));
+  }
+  for (int round = 0; round < JH_ROUNDS; ++round)
+  {
+    Tables::jhRound(elements, 8, tables().jhRoundConstants[round]);
+  }
+  std::memset(state, 0, 128);
+  for (std::size_t i = 0; i < 256; ++i)
+  {
+    uint8_t element = elements[i % 128 * 2 + i / 128];
+    for (std::size_t j = 0; j < 4; ++j)
+    {
+      std::size_t index = i + 256 * j;
+      state[index / 8] |= static_cast<uint8_t>(((element >> (3 - j)) & 1) << (7 - index % 8));
+    }
+  }
+}
+
+void jh256(const uint8_t* data, std::size_t size, uint8_t* out)
+{
+  uint8_t state[128] = {};
+  state[0] = 0x01;
+  jhPermutation(state);
+
+  // padding takes at least a block, the bit length ends it
+  std::size_t paddedSize = size + (64 - size % 64) % 64 + 64;
+  uint8_t tail[128] = {};
+  std::size_t tailOffset = size / 64 * 64;
+  std::memcpy(tail, data + tailOffset, size - tailOffset);
+  tail[size - tailOffset] = 0x80;
+  const uint64_t bits = uint64_t(size) * 8;
+  for (int i = 0; i < 8; ++i)
+  {
+    tail[paddedSize - tailOffset - 1 - i] = static_cast<uint8_t>(bits >> (8 * i));
+  }
+
+  for (std::size_t offset = 0; offset < paddedSize; offset += 64)
+  {
+    const uint8_t* block = offset < tailOffset ? data + offset : tail + (offset - tailOffset);
+    for (int i = 0; i < 64; ++i)
+    {
+      state[i] ^= block[i];
+    }
+    jhPermutation(state);
+    for (int i = 0; i < 64; ++i)
+    {
+      state[64 + i] ^= block[i];
+    }
+  }
+  std::memcpy(out, state + 96, 32);
+}
+
+void threefish512(const uint64_t* key, const uint64_t* tweak, uint64_t* words)
+{
+  uint64_t keys[9];
+  std::memcpy(keys, key, 8 * sizeof(uint64_t));
+  keys[8] = SKEIN_KEY_PARITY;
+  for (int i = 0; i < 8; ++i)
+  {
+    keys[8] ^= key[i];
+  }
+  const uint64_t tweaks[3] = {tweak[0], tweak[1], tweak[0] ^ tweak[1]};
+
+  auto addSubkey = [&keys, &tweaks, words](int subkey)
+  {
+    for (int i = 0; i < 8; ++i)
+    {
+      words[i] += keys[(subkey + i) % 9];
+    }
+    words[5] += tweaks[subkey % 3];
+    words[6] += tweaks[(subkey + 1) % 3];
+    words[7] += static_cast<uint64_t>(subkey);
+  };
+
+  for (int round = 0; round < 72; ++round)
+  {
+    if (round % 4 == 0)
+    {
+      addSubkey(round / 4);
+    }
+    uint64_t mixed[8];
+    for (int j = 0; j < 4; ++j)
+    {
+      mixed[2 * j] = words[2 * j] + words[2 * j + 1];
+      mixed[2 * j + 1] = rotateLeft(words[2 * j + 1], SKEIN_ROTATIONS[round % 8][j]) ^ mixed[2 * j];
+    }
+    for (int i = 0; i < 8; ++i)
+    {
+      words[i] = mixed[SKEIN_PERMUTATION[i]];
+    }
+  }
+  addSubkey(18);
+}
+
+// unique block iteration, position counts the bytes processed including this block
+void skeinBlock(uint64_t* chain, const uint8_t* block, uint64_t position, uint64_t flags)
+{
+  uint64_t message[8];
+  std::memcpy(message, block, sizeof(message));
+  uint64_t words[8];
+  std::memcpy(words, message, sizeof(words));
+  const uint64_t tweak[2] = {position, flags};
+  threefish512(chain, tweak, words);
+  for (int i = 0; i < 8; ++i)
+  {
+    chain[i] = words[i] ^ message[i];
+  }
+}
+
+void skein512_256(const uint8_t* data, std::size_t size, uint8_t* out)
+{
+  uint64_t chain[8] = {};
+  uint8_t block[64] = {};
+  const uint64_t configuration[2] = {SKEIN_SCHEMA, 256};
+  std::memcpy(block, configuration, sizeof(configuration));
+  skeinBlock(chain, block, 32, SKEIN_FIRST | SKEIN_FINAL | SKEIN_CONFIGURATION);
+
+  std::size_t offset = 0;
+  for (; size - offset > 64; offset += 64)
+  {
+    skeinBlock(chain, data + offset, offset + 64, (offset == 0 ? SKEIN_FIRST : 0) | SKEIN_MESSAGE);
+  }
+  std::memset(block, 0, sizeof(block));
+  std::memcpy(block, data + offset, size - offset);
+  skeinBlock(chain, block, size, (offset == 0 ? SKEIN_FIRST : 0) | SKEIN_FINAL | SKEIN_MESSAGE);
+
+  std::memset(block, 0, sizeof(block));
+  skeinBlock(chain, block, 8, SKEIN_FIRST | SKEIN_FINAL | SKEIN_OUTPUT);
+  std::memcpy(out, chain, 32);
+}
+}
+
+CryptoNight::CryptoNight()
+  : scratchpad_(nullptr)
+  , hugePages_(true)
+{
+  void* memory = mmap(nullptr, SCRATCHPAD_SIZE, PROT_READ | PROT_WRITE,
+                      MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB | MAP_POPULATE, -1, 0);
+  if (memory == MAP_FAILED)
+  {
+    hugePages_ = false;
+    memory = mmap(nullptr, SCRATCHPAD_SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (memory == MAP_FAILED)
+    {
+      throw std::bad_alloc();
+    }
+    madvise(memory, SCRATCHPAD_SIZE, MADV_HUGEPAGE);
+  }
+  scratchpad_ = static_cast<uint8_t*>(memory);
+}
+
+CryptoNight::~CryptoNight()
+{
+  munmap(scratchpad_, SCRATCHPAD_SIZE);
+}
+
+CryptoNight::Hash CryptoNight::hash(const uint8_t* data, std::size_t size)
+{
+  uint64_t state[25];
+  keccak1600(data, size, state);
+  kernels().transform_(state, scratchpad_);
+  keccakPermutation(state);
+
+  Hash hash;
+  const uint8_t* bytes = reinterpret_cast<const uint8_t*>(state);
+  switch (bytes[0] & 3)
+  {
+    case 0:
+      blake256(bytes, sizeof(state), hash.data());
+      break;
+    case 1:
+      groestl256(bytes, sizeof(state), hash.data());
+      break;
+    case 2:
+      jh256(bytes, sizeof(state), hash.data());
+      break;
+    default:
+      skein512_256(bytes, sizeof(state), hash.data());
+      break;
+  }
+  return hash;
+}
+
+bool CryptoNight::usesHugePages() const
+{
+  return hugePages_;
+}
+
+const char* CryptoNight::implementation()
+{
+  return kernels().name_;
+}
+
+} // namespace util
+} // namespace ses
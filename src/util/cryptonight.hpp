@@ -0,0 +1,49 @@
+#ifndef SES_UTIL_CRYPTONIGHT_HPP
+#define SES_UTIL_CRYPTONIGHT_HPP
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+namespace ses {
+namespace util {
+
+/**
+ * The original CryptoNight proof of work, cn/0, using the CPU's AES instructions when available,
+ * selected once at runtime.
+ *
+ * Each hasher owns the 2 MiB scratchpad the hash runs through, allocated once in huge pages when
+ * the system has some reserved, otherwise in transparent huge pages if it grants them. Hashers are
+ * not thread safe, threads hashing in parallel need one each.
+ */
+class CryptoNight
+{
+public:
+  static const std::size_t HASH_SIZE = 32;
+  static const std::size_t SCRATCHPAD_SIZE = 2 * 1024 * 1024;
+  typedef std::array<uint8_t, HASH_SIZE> Hash;
+
+public:
+  CryptoNight();
+  ~CryptoNight();
+
+  CryptoNight(const CryptoNight&) = delete;
+  CryptoNight& operator=(const CryptoNight&) = delete;
+
+  Hash hash(const uint8_t* data, std::size_t size);
+
+  // false if the scratchpad could not be mapped in explicitly reserved huge pages
+  bool usesHugePages() const;
+
+  // name of the kernel in use, for diagnostics
+  static const char* implementation();
+
+private:
+  uint8_t* scratchpad_;
+  bool hugePages_;
+};
+
+} // namespace util
+} // namespace ses
+
+#endif //SES_UTIL_CRYPTONIGHT_HPP
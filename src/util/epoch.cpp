@@ -0,0 +1,172 @@
+#include <mutex>
+#include <vector>
+
+#include "util/epoch.hpp"
+
+namespace ses {
+namespace util {
+
+namespace {
+const uint64_t INACTIVE = 0;
+
+struct alignas(64) ReaderSlot
+{
+  // the epoch pinned by the owning thread, INACTIVE outside of guards
+  std::atomic<uint64_t> epoch{INACTIVE};
+  std::atomic<bool> owned{false};
+};
+
+struct RetiredObject
+{
+  uint64_t epoch;
+  void* object;
+  void (*deleter)(void*);
+};
+
+struct State
+{
+  std::atomic<uint64_t> epoch{1};
+  ReaderSlot readers[Epoch::MAX_READERS];
+  std::atomic<uint64_t> overflowReaders{0};
+
+  std::mutex retiredMutex;
+  std::vector<RetiredObject> retired;
+};
+
+State& state()
+{
+  // never destroyed, threads may still leave guards while the process exits
+  static State* state = new State();
+  return *state;
+}
+
+// the slot a thread pins its epoch in, handed back when the thread ends
+struct ThreadReader
+{
+  ~ThreadReader()
+  {
+    if (slot)
+    {
+      slot->owned.store(false, std::memory_order_release);
+    }
+  }
+
+  ReaderSlot* acquire()
+  {
+    if (!slot && !overflow)
+    {
+      for (ReaderSlot& candidate : state().readers)
+      {
+        bool owned = false;
+        if (!candidate.owned.load(std::memory_order_relaxed) &&
+            candidate.owned.compare_exchange_strong(owned, true, std::memory_order_acquire))
+        {
+          slot = &candidate;
+          break;
+        }
+      }
+      overflow = !slot;
+    }
+    return slot;
+  }
+
+  ReaderSlot* slot = nullptr;
+  bool overflow = false;
+  // guards of this thread nest, only the outermost pins the epoch
+  std::size_t depth = 0;
+};
+thread_local ThreadReader threadReader;
+}
+
+Epoch::ReadGuard::ReadGuard()
+{
+  if (threadReader.depth++ > 0)
+  {
+    return;
+  }
+
+  State& epochState = state();
+  ReaderSlot* slot = threadReader.acquire();
+  if (slot)
+  {
+    // sequentially consistent, so a writer scanning after replacing an object sees the pin
+    slot->epoch.store(epochState.epoch.load(std::memory_order_seq_cst), std::memory_order_seq_cst);
+  }
+  else
+  {
+    epochState.overflowReaders.fetch_add(1, std::memory_order_seq_cst);
+  }
+}
+
+Epoch::ReadGuard::~ReadGuard()
+{
+  if (--threadReader.depth > 0)
+  {
+    return;
+  }
+
+  if (threadReader.slot)
+  {
+    threadReader.slot->epoch.store(INACTIVE, std::memory_order_release);
+  }
+  else
+  {
+    state().overflowReaders.fetch_sub(1, std::memory_order_release);
+  }
+}
+
+void Epoch::retire(void* object, void (*deleter)(void*))
+{
+  State& epochState = state();
+  std::vector<RetiredObject> reclaimable;
+  {
+    std::lock_guard<std::mutex> lock(epochState.retiredMutex);
+    // readers that pinned this epoch or an older one may still see the object
+    epochState.retired.push_back(
+      RetiredObject{epochState.epoch.fetch_add(1, std::memory_order_seq_cst), object, deleter});
+
+    uint64_t oldestPinned = UINT64_MAX;
+    if (epochState.overflowReaders.load(std::memory_order_seq_cst) > 0)
+    {
+      oldestPinned = INACTIVE;
+    }
+    for (ReaderSlot& reader : epochState.readers)
+    {
+      uint64_t epoch = reader.epoch.load(std::memory_order_seq_cst);
+      if (epoch != INACTIVE && epoch < oldestPinned)
+      {
+        oldestPinned = epoch;
+      }
+    }
+
+    auto kept = epochState.retired.begin();
+    for (RetiredObject& retired : epochState.retired)
+    {
+      if (retired.epoch < oldestPinned)
+      {
+        reclaimable.push_back(retired);
+      }
+      else
+      {
+        *kept++ = retired;
+      }
+    }
+    epochState.retired.erase(kept, epochState.retired.end());
+  }
+
+  // deleters run unlocked, they may retire objects themselves
+  for (RetiredObject& retired : reclaimable)
+  {
+    retired.deleter(retired.object);
+  }
+}
+
+std::size_t Epoch::getPendingObjects()
+{
+  State& epochState = state();
+  std::lock_guard<std::mutex> lock(epochState.retiredMutex);
+  return epochState.retired.size();
+}
+
+} // namespace util
+} // namespace ses
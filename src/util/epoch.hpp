@@ -0,0 +1,98 @@
+#ifndef SES_UTIL_EPOCH_HPP
+#define SES_UTIL_EPOCH_HPP
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+#include <boost/noncopyable.hpp>
+
+namespace ses {
+namespace util {
+
+/**
+ * Epoch based reclamation of objects readers may still be looking at.
+ *
+ * A reader pins the current epoch in its thread's slot for the duration of a ReadGuard, which
+ * costs a load and two stores to its own slot, never a lock or a retry. Writers retire replaced
+ * objects tagged with the epoch they were replaced in and advance it. A retired object is deleted by
+ * a later retire() once every pinned epoch is younger than its tag, so no guard that could have seen
+ * it is still open. Threads beyond MAX_READERS share an overflow counter which defers all
+ * reclamation while non zero.
+ */
+class Epoch
+{
+public:
+  static const std::size_t MAX_READERS = 512;
+
+  class ReadGuard : private boost::noncopyable
+  {
+  public:
+    ReadGuard();
+    ~ReadGuard();
+  };
+
+  // deletes the object once no reader can reach it anymore, safe to call from any thread
+  static void retire(void* object, void (*deleter)(void*));
+
+  // retired objects not yet deleted
+  static std::size_t getPendingObjects();
+};
+
+/**
+ * Immutable snapshots of a value, replaced as a whole by the writer and read wait-free by any thread.
+ * Only one thread may publish at a time.
+ */
+template<class T>
+class Published : private boost::noncopyable
+{
+public:
+  Published()
+    : current_(nullptr)
+  {
+  }
+
+  ~Published()
+  {
+    const T* current = current_.load(std::memory_order_relaxed);
+    if (current)
+    {
+      Epoch::retire(const_cast<T*>(current), &destroy);
+    }
+  }
+
+  void publish(const T& value)
+  {
+    const T* previous = current_.exchange(new T(value), std::memory_order_seq_cst);
+    if (previous)
+    {
+      Epoch::retire(const_cast<T*>(previous), &destroy);
+    }
+  }
+
+  // copies the latest snapshot, false if none was published yet
+  bool read(T& value) const
+  {
+    Epoch::ReadGuard guard;
+    const T* current = current_.load(std::memory_order_seq_cst);
+    if (!current)
+    {
+      return false;
+    }
+    value = *current;
+    return true;
+  }
+
+private:
+  static void destroy(void* object)
+  {
+    delete static_cast<T*>(object);
+  }
+
+  std::atomic<const T*> current_;
+};
+
+} // namespace util
+} // namespace ses
+
+#endif //SES_UTIL_EPOCH_HPP
@@ -0,0 +1,250 @@
+#include <immintrin.h>
+
+#include "util/hex.hpp"
+
+namespace ses {
+namespace util {
+namespace hex {
+
+namespace {
+const char HEX_DIGITS[] = "0123456789abcdef";
+const uint8_t INVALID = 0xFF;
+
+struct DecodeTable
+{
+  DecodeTable()
+  {
+    for (int i = 0; i < 256; ++i)
+    {
+      values_[i] = INVALID;
+    }
+    for (int i = 0; i < 10; ++i)
+    {
+      values_['0' + i] = static_cast<uint8_t>(i);
+    }
+    for (int i = 0; i < 6; ++i)
+    {
+      values_['a' + i] = static_cast<uint8_t>(10 + i);
+      values_['A' + i] = static_cast<uint8_t>(10 + i);
+    }
+  }
+
+  uint8_t values_[256];
+};
+
+const DecodeTable DECODE_TABLE;
+
+void encodeScalar(const uint8_t* data, std::size_t size, char* out)
+{
+  for (std::size_t i = 0; i < size; ++i)
+  {
+    out[2 * i] = HEX_DIGITS[data[i] >> 4];
+    out[2 * i + 1] = HEX_DIGITS[data[i] & 0x0F];
+  }
+}
+
+bool decodeScalar(const char* hex, std::size_t size, uint8_t* out)
+{
+  uint8_t invalid = 0;
+  for (std::size_t i = 0; i < size / 2; ++i)
+  {
+    uint8_t high = DECODE_TABLE.values_[static_cast<uint8_t>(hex[2 * i])];
+    uint8_t low = DECODE_TABLE.values_[static_cast<uint8_t>(hex[2 * i + 1])];
+    invalid |= (high | low) & 0xF0;
+    out[i] = static_cast<uint8_t>((high << 4) | (low & 0x0F));
+  }
+  return invalid == 0;
+}
+
+// 16 input bytes to 32 characters
+__attribute__((target("ssse3")))
+inline void encodeBlockSsse3(const uint8_t* data, char* out)
+{
+  const __m128i digits = _mm_loadu_si128(reinterpret_cast<const __m128i*>(HEX_DIGITS));
+  const __m128i mask = _mm_set1_epi8(0x0F);
+  __m128i input = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data));
+  __m128i high = _mm_shuffle_epi8(digits, _mm_and_si128(_mm_srli_epi16(input, 4), mask));
+  __m128i low = _mm_shuffle_epi8(digits, _mm_and_si128(input, mask));
+  _mm_storeu_si128(reinterpret_cast<__m128i*>(out), _mm_unpacklo_epi8(high, low));
+  _mm_storeu_si128(reinterpret_cast<__m128i*>(out + 16), _mm_unpackhi_epi8(high, low));
+}
+
+// 16 characters to their nibble values, invalid characters are flagged in valid
+__attribute__((target("ssse3")))
+inline __m128i nibblesSsse3(__m128i input, __m128i& valid)
+{
+  __m128i digit = _mm_sub_epi8(input, _mm_set1_epi8('0'));
+  __m128i isDigit = _mm_cmpeq_epi8(_mm_min_epu8(digit, _mm_set1_epi8(9)), digit);
+  __m128i alpha = _mm_sub_epi8(_mm_or_si128(input, _mm_set1_epi8(0x20)), _mm_set1_epi8('a'));
+  __m128i isAlpha = _mm_cmpeq_epi8(_mm_min_epu8(alpha, _mm_set1_epi8(5)), alpha);
+  valid = _mm_and_si128(valid, _mm_or_si128(isDigit, isAlpha));
+  return _mm_or_si128(_mm_and_si128(isDigit, digit),
+                      _mm_and_si128(isAlpha, _mm_add_epi8(alpha, _mm_set1_epi8(10))));
+}
+
+__attribute__((target("ssse3")))
+void encodeSsse3(const uint8_t* data, std::size_t size, char* out)
+{
+  std::size_t i = 0;
+  for (; i + 16 <= size; i += 16)
+  {
+    encodeBlockSsse3(data + i, out + 2 * i);
+  }
+  encodeScalar(data + i, size - i, out + 2 * i);
+}
+
+// 32 characters to 16 output bytes
+__attribute__((target("ssse3")))
+inline bool decodeBlockSsse3(const char* hex, uint8_t* out)
+{
+  __m128i valid = _mm_set1_epi8(-1);
+  __m128i first = nibblesSsse3(_mm_loadu_si128(reinterpret_cast<const __m128i*>(hex)), valid);
+  __m128i second = nibblesSsse3(_mm_loadu_si128(reinterpret_cast<const __m128i*>(hex + 16)), valid);
+  // (high, low) pairs -> high * 16 + low
+  const __m128i weights = _mm_set1_epi16(0x0110);
+  __m128i packed = _mm_packus_epi16(_mm_maddubs_epi16(first, weights), _mm_maddubs_epi16(second, weights));
+  _mm_storeu_si128(reinterpret_cast<__m128i*>(out), packed);
+  return _mm_movemask_epi8(valid) == 0xFFFF;
+}
+
+__attribute__((target("ssse3")))
+bool decodeSsse3(const char* hex, std::size_t size, uint8_t* out)
+{
+  bool valid = true;
+  std::size_t i = 0;
+  for (; i + 32 <= size; i += 32)
+  {
+    valid &= decodeBlockSsse3(hex + i, out + i / 2);
+  }
+  return decodeScalar(hex + i, size - i, out + i / 2) && valid;
+}
+
+__attribute__((target("avx2")))
+void encodeAvx2(const uint8_t* data, std::size_t size, char* out)
+{
+  const __m256i digits = _mm256_broadcastsi128_si256(_mm_loadu_si128(reinterpret_cast<const __m128i*>(HEX_DIGITS)));
+  const __m256i mask = _mm256_set1_epi8(0x0F);
+  std::size_t i = 0;
+  for (; i + 32 <= size; i += 32)
+  {
+    __m256i input = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i));
+    __m256i high = _mm256_shuffle_epi8(digits, _mm256_and_si256(_mm256_srli_epi16(input, 4), mask));
+    __m256i low = _mm256_shuffle_epi8(digits, _mm256_and_si256(input, mask));
+    // unpacking works per 128 bit lane, the permutation restores the byte order
+    __m256i lowerHalves = _mm256_unpacklo_epi8(high, low);
+    __m256i upperHalves = _mm256_unpackhi_epi8(high, low);
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + 2 * i),
+                        _mm256_permute2x128_si256(lowerHalves, upperHalves, 0x20));
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + 2 * i + 32),
+                        _mm256_permute2x128_si256(lowerHalves, upperHalves, 0x31));
+  }
+  // avoids the AVX to SSE transition penalty in the legacy encoded tail
+  _mm256_zeroupper();
+  encodeSsse3(data + i, size - i, out + 2 * i);
+}
+
+__attribute__((target("avx2")))
+inline __m256i nibblesAvx2(__m256i input, __m256i& valid)
+{
+  __m256i digit = _mm256_sub_epi8(input, _mm256_set1_epi8('0'));
+  __m256i isDigit = _mm256_cmpeq_epi8(_mm256_min_epu8(digit, _mm256_set1_epi8(9)), digit);
+  __m256i alpha = _mm256_sub_epi8(_mm256_or_si256(input, _mm256_set1_epi8(0x20)), _mm256_set1_epi8('a'));
+  __m256i isAlpha = _mm256_cmpeq_epi8(_mm256_min_epu8(alpha, _mm256_set1_epi8(5)), alpha);
+  valid = _mm256_and_si256(valid, _mm256_or_si256(isDigit, isAlpha));
+  return _mm256_or_si256(_mm256_and_si256(isDigit, digit),
+                         _mm256_and_si256(isAlpha, _mm256_add_epi8(alpha, _mm256_set1_epi8(10))));
+}
+
+__attribute__((target("avx2")))
+bool decodeAvx2(const char* hex, std::size_t size, uint8_t* out)
+{
+  const __m256i weights = _mm256_set1_epi16(0x0110);
+  __m256i valid = _mm256_set1_epi8(-1);
+  std::size_t i = 0;
+  for (; i + 64 <= size; i += 64)
+  {
+    __m256i first = nibblesAvx2(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(hex + i)), valid);
+    __m256i second = nibblesAvx2(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(hex + i + 32)), valid);
+    __m256i packed = _mm256_packus_epi16(_mm256_maddubs_epi16(first, weights),
+                                         _mm256_maddubs_epi16(second, weights));
+    // packing works per 128 bit lane, the permutation restores the byte order
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i / 2), _mm256_permute4x64_epi64(packed, 0xD8));
+  }
+  bool blocksValid = static_cast<uint32_t>(_mm256_movemask_epi8(valid)) == 0xFFFFFFFF;
+  // avoids the AVX to SSE transition penalty in the legacy encoded tail
+  _mm256_zeroupper();
+  return decodeSsse3(hex + i, size - i, out + i / 2) && blocksValid;
+}
+
+struct Kernels
+{
+  Kernels()
+  {
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2"))
+    {
+      encode_ = &encodeAvx2;
+      decode_ = &decodeAvx2;
+      name_ = "avx2";
+    }
+    else if (__builtin_cpu_supports("ssse3"))
+    {
+      encode_ = &encodeSsse3;
+      decode_ = &decodeSsse3;
+      name_ = "ssse3";
+    }
+  }
+
+  void (* encode_)(const uint8_t*, std::size_t, char*) = &encodeScalar;
+  bool (* decode_)(const char*, std::size_t, uint8_t*) = &decodeScalar;
+  const char* name_ = "scalar";
+};
+
+const Kernels& kernels()
+{
+  static const Kernels kernels;
+  return kernels;
+}
+}
+
+void encode(const uint8_t* data, std::size_t size, char* out)
+{
+  kernels().encode_(data, size, out);
+}
+
+std::string encode(const uint8_t* data, std::size_t size)
+{
+  std::string result(2 * size, '\0');
+  encode(data, size, &result[0]);
+  return result;
+}
+
+bool decode(std::string_view hex, uint8_t* out)
+{
+  return hex.size() % 2 == 0 && kernels().decode_(hex.data(), hex.size(), out);
+}
+
+bool isValid(std::string_view hex)
+{
+  if (hex.size() % 2 != 0)
+  {
+    return false;
+  }
+  for (char c : hex)
+  {
+    if (DECODE_TABLE.values_[static_cast<uint8_t>(c)] == INVALID)
+    {
+      return false;
+    }
+  }
+  return true;
+}
+
+const char* implementation()
+{
+  return kernels().name_;
+}
+
+} // namespace hex
+} // namespace util
+} // namespace ses
@@ -0,0 +1,34 @@
+#ifndef SES_UTIL_HEX_HPP
+#define SES_UTIL_HEX_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+namespace ses {
+namespace util {
+namespace hex {
+
+/**
+ * Hex codec with SSSE3 and AVX2 kernels, selected once at runtime depending on the CPU.
+ * Encoding produces lower case characters, decoding accepts both cases and never throws.
+ */
+
+// writes 2 * size characters to out
+void encode(const uint8_t* data, std::size_t size, char* out);
+std::string encode(const uint8_t* data, std::size_t size);
+
+// writes hex.size() / 2 bytes to out, returns false for odd sizes and non hex characters
+bool decode(std::string_view hex, uint8_t* out);
+
+bool isValid(std::string_view hex);
+
+// name of the kernel in use, for diagnostics
+const char* implementation();
+
+} // namespace hex
+} // namespace util
+} // namespace ses
+
+#endif //SES_UTIL_HEX_HPP
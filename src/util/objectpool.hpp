@@ -0,0 +1,136 @@
+#ifndef SES_UTIL_OBJECTPOOL_HPP
+#define SES_UTIL_OBJECTPOOL_HPP
+
+#include <cstddef>
+#include <memory>
+#include <new>
+
+namespace ses {
+namespace util {
+
+/**
+ * Per thread free list of equally sized memory blocks.
+ *
+ * Blocks are taken from the global heap only while the free list of the calling thread is empty.
+ * A block released on another thread than the one it was taken from joins the free list of the
+ * releasing thread, so in steady state every thread recycles its own blocks without locking.
+ */
+template<std::size_t SIZE, std::size_t ALIGN>
+class BlockPool
+{
+public:
+  static const std::size_t MAX_FREE_BLOCKS = 4096;
+
+  static void* allocate()
+  {
+    FreeList& freeList = local();
+    if (freeList.head_)
+    {
+      Block* block = freeList.head_;
+      freeList.head_ = block->next_;
+      --freeList.size_;
+      return block;
+    }
+    return ::operator new(sizeof(Block), std::align_val_t(alignof(Block)));
+  }
+
+  static void deallocate(void* pointer)
+  {
+    FreeList& freeList = local();
+    if (freeList.size_ < MAX_FREE_BLOCKS)
+    {
+      Block* block = static_cast<Block*>(pointer);
+      block->next_ = freeList.head_;
+      freeList.head_ = block;
+      ++freeList.size_;
+    }
+    else
+    {
+      ::operator delete(pointer, std::align_val_t(alignof(Block)));
+    }
+  }
+
+private:
+  union Block
+  {
+    Block* next_;
+    alignas(ALIGN) unsigned char storage_[SIZE];
+  };
+
+  struct FreeList
+  {
+    ~FreeList()
+    {
+      while (head_)
+      {
+        Block* next = head_->next_;
+        ::operator delete(head_, std::align_val_t(alignof(Block)));
+        head_ = next;
+      }
+    }
+
+    Block* head_ = nullptr;
+    std::size_t size_ = 0;
+  };
+
+  static FreeList& local()
+  {
+    static thread_local FreeList freeList;
+    return freeList;
+  }
+};
+
+/**
+ * Allocator serving single object allocations from a BlockPool, e.g. for std::allocate_shared.
+ */
+template<class T>
+class PoolAllocator
+{
+public:
+  typedef T value_type;
+
+  PoolAllocator() = default;
+
+  template<class U>
+  PoolAllocator(const PoolAllocator<U>&)
+  {
+  }
+
+  T* allocate(std::size_t n)
+  {
+    if (n == 1)
+    {
+      return static_cast<T*>(BlockPool<sizeof(T), alignof(T)>::allocate());
+    }
+    return std::allocator<T>().allocate(n);
+  }
+
+  void deallocate(T* pointer, std::size_t n)
+  {
+    if (n == 1)
+    {
+      BlockPool<sizeof(T), alignof(T)>::deallocate(pointer);
+    }
+    else
+    {
+      std::allocator<T>().deallocate(pointer, n);
+    }
+  }
+
+  template<class U>
+  bool operator==(const PoolAllocator<U>&) const
+  {
+    return true;
+  }
+
+  template<class U>
+  bool operator!=(const PoolAllocator<U>&) const
+  {
+    return false;
+  }
+};
+
+} // namespace util
+} // namespace ses
+
+#endif //SES_UTIL_OBJECTPOOL_HPP
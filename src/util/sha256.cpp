@@ -0,0 +1,240 @@
+#include <cpuid.h>
+#include <cstring>
+#include <immintrin.h>
+
+#include "util/sha256.hpp"
+
+namespace ses {
+namespace util {
+
+namespace {
+alignas(16) const uint32_t K[64] = {
+  0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+  0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+  0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+  0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+  0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+  0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+  0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+  0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2};
+
+const uint32_t INITIAL_STATE[8] = {
+  0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19};
+
+inline uint32_t rotateRight(uint32_t value, int bits)
+{
+  return (value >> bits) | (value << (32 - bits));
+}
+
+inline uint32_t readBigEndian(const uint8_t* data)
+{
+  return (uint32_t(data[0]) << 24) | (uint32_t(data[1]) << 16) | (uint32_t(data[2]) << 8) | data[3];
+}
+
+void transformScalar(uint32_t* state, const uint8_t* data, std::size_t blocks)
+{
+  for (; blocks > 0; --blocks, data += Sha256::BLOCK_SIZE)
+  {
+    uint32_t w[64];
+    for (int i = 0; i < 16; ++i)
+    {
+      w[i] = readBigEndian(data + 4 * i);
+    }
+    for (int i = 16; i < 64; ++i)
+    {
+      uint32_t s0 = rotateRight(w[i - 15], 7) ^ rotateRight(w[i - 15], 18) ^ (w[i - 15] >> 3);
+      uint32_t s1 = rotateRight(w[i - 2], 17) ^ rotateRight(w[i - 2], 19) ^ (w[i - 2] >> 10);
+      w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+    }
+
+    uint32_t a = state[0], b = state[1], c = state[2], d = state[3];
+    uint32_t e = state[4], f = state[5], g = state[6], h = state[7];
+    for (int i = 0; i < 64; ++i)
+    {
+      uint32_t s1 = rotateRight(e, 6) ^ rotateRight(e, 11) ^ rotateRight(e, 25);
+      uint32_t t1 = h + s1 + ((e & f) ^ (~e & g)) + K[i] + w[i];
+      uint32_t s0 = rotateRight(a, 2) ^ rotateRight(a, 13) ^ rotateRight(a, 22);
+      uint32_t t2 = s0 + ((a & b) ^ (a & c) ^ (b & c));
+      h = g;
+      g = f;
+      f = e;
+      e = d + t1;
+      d = c;
+      c = b;
+      b = a;
+      a = t1 + t2;
+    }
+    state[0] += a;
+    state[1] += b;
+    state[2] += c;
+    state[3] += d;
+    state[4] += e;
+    state[5] += f;
+    state[6] += g;
+    state[7] += h;
+  }
+}
+
+// SHA-NI keeps the state as ABEF/CDGH and does two rounds per instruction
+__attribute__((target("sha,sse4.1")))
+void transformShaNi(uint32_t* state, const uint8_t* data, std::size_t blocks)
+{
+  const __m128i byteSwap = _mm_set_epi64x(0x0c0d0e0f08090a0bULL, 0x0405060700010203ULL);
+
+  __m128i cdab = _mm_shuffle_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(state)), 0xB1);
+  __m128i efgh = _mm_shuffle_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(state + 4)), 0x1B);
+  __m128i abef = _mm_alignr_epi8(cdab, efgh, 8);
+  __m128i cdgh = _mm_blend_epi16(efgh, cdab, 0xF0);
+
+  for (; blocks > 0; --blocks, data += Sha256::BLOCK_SIZE)
+  {
+    const __m128i abefSaved = abef;
+    const __m128i cdghSaved = cdgh;
+
+    // w[g % 4] holds the message words of the current group of four rounds, w[(g + 1) % 4] and
+    // onwards those of the previous groups needed for the message schedule
+    __m128i w[4];
+#pragma GCC unroll 16
+    for (int group = 0; group < 16; ++group)
+    {
+      if (group < 4)
+      {
+        w[group] = _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(data + 16 * group)),
+                                    byteSwap);
+      }
+      else
+      {
+        __m128i schedule = _mm_sha256msg1_epu32(w[group & 3], w[(group + 1) & 3]);
+        schedule = _mm_add_epi32(schedule, _mm_alignr_epi8(w[(group + 3) & 3], w[(group + 2) & 3], 4));
+        w[group & 3] = _mm_sha256msg2_epu32(schedule, w[(group + 3) & 3]);
+      }
+
+      __m128i message = _mm_add_epi32(w[group & 3], _mm_load_si128(reinterpret_cast<const __m128i*>(K + 4 * group)));
+      cdgh = _mm_sha256rnds2_epu32(cdgh, abef, message);
+      abef = _mm_sha256rnds2_epu32(abef, cdgh, _mm_shuffle_epi32(message, 0x0E));
+    }
+
+    abef = _mm_add_epi32(abef, abefSaved);
+    cdgh = _mm_add_epi32(cdgh, cdghSaved);
+  }
+
+  __m128i feba = _mm_shuffle_epi32(abef, 0x1B);
+  __m128i dchg = _mm_shuffle_epi32(cdgh, 0xB1);
+  _mm_storeu_si128(reinterpret_cast<__m128i*>(state), _mm_blend_epi16(feba, dchg, 0xF0));
+  _mm_storeu_si128(reinterpret_cast<__m128i*>(state + 4), _mm_alignr_epi8(dchg, feba, 8));
+}
+
+bool cpuSupportsShaNi()
+{
+  unsigned int eax, ebx, ecx, edx;
+  if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx) || !(ecx & bit_SSE4_1))
+  {
+    return false;
+  }
+  return __get_cpuid_count(7, 0, &eax, &ebx, &ecx, &edx) && (ebx & bit_SHA);
+}
+
+struct Kernels
+{
+  Kernels()
+  {
+    if (cpuSupportsShaNi())
+    {
+      transform_ = &transformShaNi;
+      name_ = "sha-ni";
+    }
+  }
+
+  void (* transform_)(uint32_t*, const uint8_t*, std::size_t) = &transformScalar;
+  const char* name_ = "scalar";
+};
+
+const Kernels& kernels()
+{
+  static const Kernels kernels;
+  return kernels;
+}
+}
+
+Sha256::Sha256()
+  : size_(0)
+{
+  std::memcpy(state_, INITIAL_STATE, sizeof(state_));
+}
+
+void Sha256::update(const uint8_t* data, std::size_t size)
+{
+  std::size_t buffered = size_ % BLOCK_SIZE;
+  size_ += size;
+
+  if (buffered > 0)
+  {
+    std::size_t missing = BLOCK_SIZE - buffered;
+    if (size < missing)
+    {
+      std::memcpy(buffer_ + buffered, data, size);
+      return;
+    }
+    std::memcpy(buffer_ + buffered, data, missing);
+    kernels().transform_(state_, buffer_, 1);
+    data += missing;
+    size -= missing;
+  }
+
+  std::size_t blocks = size / BLOCK_SIZE;
+  if (blocks > 0)
+  {
+    kernels().transform_(state_, data, blocks);
+  }
+  std::memcpy(buffer_, data + blocks * BLOCK_SIZE, size % BLOCK_SIZE);
+}
+
+Sha256::Hash Sha256::finalize() const
+{
+  uint32_t state[8];
+  std::memcpy(state, state_, sizeof(state));
+
+  // padding and the bit length fill one or two final blocks
+  uint8_t blocks[2 * BLOCK_SIZE] = {};
+  std::size_t buffered = size_ % BLOCK_SIZE;
+  std::memcpy(blocks, buffer_, buffered);
+  blocks[buffered] = 0x80;
+  std::size_t paddedSize = buffered + 9 <= BLOCK_SIZE ? BLOCK_SIZE : 2 * BLOCK_SIZE;
+  uint64_t bits = size_ * 8;
+  for (int i = 0; i < 8; ++i)
+  {
+    blocks[paddedSize - 1 - i] = static_cast<uint8_t>(bits >> (8 * i));
+  }
+  kernels().transform_(state, blocks, paddedSize / BLOCK_SIZE);
+
+  Hash hash;
+  for (int i = 0; i < 8; ++i)
+  {
+    hash[4 * i] = static_cast<uint8_t>(state[i] >> 24);
+    hash[4 * i + 1] = static_cast<uint8_t>(state[i] >> 16);
+    hash[4 * i + 2] = static_cast<uint8_t>(state[i] >> 8);
+    hash[4 * i + 3] = static_cast<uint8_t>(state[i]);
+  }
+  return hash;
+}
+
+Sha256::Hash Sha256::hash(const uint8_t* data, std::size_t size)
+{
+  Sha256 sha256;
+  sha256.update(data, size);
+  return sha256.finalize();
+}
+
+Sha256::Hash Sha256::doubleHash(const uint8_t* data, std::size_t size)
+{
+  Hash first = hash(data, size);
+  return hash(first.data(), first.size());
+}
+
+const char* Sha256::implementation()
+{
+  return kernels().name_;
+}
+
+} // namespace util
+} // namespace ses
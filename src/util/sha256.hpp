@@ -0,0 +1,45 @@
+#ifndef SES_UTIL_SHA256_HPP
+#define SES_UTIL_SHA256_HPP
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+namespace ses {
+namespace util {
+
+/**
+ * Incremental SHA-256 using the CPU's SHA extensions when available, selected once at runtime.
+ * finalize() leaves the state untouched, so a hasher that absorbed a common prefix can be copied
+ * and reused as midstate.
+ */
+class Sha256
+{
+public:
+  static const std::size_t HASH_SIZE = 32;
+  static const std::size_t BLOCK_SIZE = 64;
+  typedef std::array<uint8_t, HASH_SIZE> Hash;
+
+public:
+  Sha256();
+
+  void update(const uint8_t* data, std::size_t size);
+  Hash finalize() const;
+
+  static Hash hash(const uint8_t* data, std::size_t size);
+  // SHA-256d as used for bitcoin block headers and merkle trees
+  static Hash doubleHash(const uint8_t* data, std::size_t size);
+
+  // name of the kernel in use, for diagnostics
+  static const char* implementation();
+
+private:
+  uint32_t state_[8];
+  uint8_t buffer_[BLOCK_SIZE];
+  uint64_t size_;
+};
+
+} // namespace util
+} // namespace ses
+
+#endif //SES_UTIL_SHA256_HPP
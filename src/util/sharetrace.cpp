@@ -0,0 +1,217 @@
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "util/sharetrace.hpp"
+
+namespace ses {
+namespace util {
+
+namespace {
+const char MAGIC[8] = {'S', 'E', 'S', 'T', 'R', 'A', 'C', 'E'};
+const uint32_t VERSION = 1;
+
+// single producer, the owning thread, and single consumer, the exporter
+struct Ring
+{
+  std::atomic<bool> owned{false};
+  std::atomic<uint64_t> head{0};
+  std::atomic<uint64_t> tail{0};
+  ShareTrace::Record records[ShareTrace::RING_CAPACITY];
+};
+
+struct State
+{
+  std::mutex ringsMutex;
+  std::vector<Ring*> rings;
+  std::atomic<uint64_t> droppedRecords{0};
+};
+
+State& state()
+{
+  // never destroyed, threads may still finish traces while the process exits
+  static State* state = new State();
+  return *state;
+}
+
+// the ring a thread pushes into, handed back when the thread ends
+struct ThreadRing
+{
+  ~ThreadRing()
+  {
+    if (ring)
+    {
+      ring->owned.store(false, std::memory_order_release);
+    }
+  }
+
+  Ring* acquire()
+  {
+    if (!ring)
+    {
+      State& traceState = state();
+      std::lock_guard<std::mutex> lock(traceState.ringsMutex);
+      for (Ring* candidate : traceState.rings)
+      {
+        bool owned = false;
+        if (candidate->owned.compare_exchange_strong(owned, true, std::memory_order_acquire))
+        {
+          ring = candidate;
+          return ring;
+        }
+      }
+      ring = new Ring();
+      ring->owned.store(true, std::memory_order_relaxed);
+      traceState.rings.push_back(ring);
+    }
+    return ring;
+  }
+
+  Ring* ring = nullptr;
+};
+thread_local ThreadRing threadRing;
+
+double calibrate()
+{
+  auto start = std::chrono::steady_clock::now();
+  uint64_t startTicks = ShareTrace::now();
+  std::this_thread::sleep_for(std::chrono::milliseconds(50));
+  uint64_t ticks = ShareTrace::now() - startTicks;
+  auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start);
+  return static_cast<double>(ticks) / static_cast<double>(elapsed.count());
+}
+
+void exportRecords(std::FILE* file)
+{
+  State& traceState = state();
+  std::vector<Ring*> rings;
+  for (;;)
+  {
+    std::this_thread::sleep_for(ShareTrace::EXPORT_INTERVAL);
+    {
+      std::lock_guard<std::mutex> lock(traceState.ringsMutex);
+      rings = traceState.rings;
+    }
+    for (Ring* ring : rings)
+    {
+      uint64_t tail = ring->tail.load(std::memory_order_relaxed);
+      uint64_t head = ring->head.load(std::memory_order_acquire);
+      for (; tail != head; ++tail)
+      {
+        std::fwrite(&ring->records[tail % ShareTrace::RING_CAPACITY], sizeof(ShareTrace::Record), 1, file);
+      }
+      ring->tail.store(tail, std::memory_order_release);
+    }
+    std::fflush(file);
+  }
+}
+}
+
+constexpr std::chrono::milliseconds ShareTrace::EXPORT_INTERVAL;
+std::atomic<uint32_t> ShareTrace::sampleInterval_{0};
+thread_local ShareTrace::ThreadTrace ShareTrace::threadTrace_;
+
+bool ShareTrace::startExport(const std::string& path, uint32_t sampleInterval)
+{
+  std::FILE* file = std::fopen(path.c_str(), "wb");
+  if (!file)
+  {
+    std::cerr << "util::ShareTrace::startExport, cannot open " << path << std::endl;
+    return false;
+  }
+
+  FileHeader header;
+  std::memset(&header, 0, sizeof(header));
+  std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+  header.version = VERSION;
+  header.recordSize = sizeof(Record);
+  header.ticksPerMicrosecond = calibrate();
+  std::fwrite(&header, sizeof(header), 1, file);
+  std::fflush(file);
+
+  std::thread(exportRecords, file).detach();
+  sampleInterval_.store(sampleInterval, std::memory_order_relaxed);
+  return true;
+}
+
+bool ShareTrace::read(const std::string& path, double& ticksPerMicrosecond,
+                      const std::function<void(const Record& record)>& recordHandler)
+{
+  std::FILE* file = std::fopen(path.c_str(), "rb");
+  if (!file)
+  {
+    return false;
+  }
+
+  FileHeader header;
+  if (std::fread(&header, sizeof(header), 1, file) != 1 || std::memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0 ||
+      header.version != VERSION || header.recordSize != sizeof(Record))
+  {
+    std::fclose(file);
+    return false;
+  }
+  ticksPerMicrosecond = header.ticksPerMicrosecond;
+
+  Record record;
+  while (std::fread(&record, sizeof(record), 1, file) == 1)
+  {
+    recordHandler(record);
+  }
+  std::fclose(file);
+  return true;
+}
+
+uint64_t ShareTrace::getDroppedRecords()
+{
+  return state().droppedRecords.load(std::memory_order_relaxed);
+}
+
+const char* ShareTrace::toString(Stage stage)
+{
+  switch (stage)
+  {
+    case STAGE_READ:
+      return "read";
+    case STAGE_PARSE:
+      return "parse";
+    case STAGE_SUBMIT:
+      return "submit";
+    case STAGE_REPLY:
+      return "reply";
+    case STAGE_UPSTREAM_SEND:
+      return "upstream send";
+    case STAGE_POOL_RESPONSE:
+      return "pool response";
+    default:
+      return "unknown";
+  }
+}
+
+void ShareTrace::beginSampled(uint32_t sampleInterval)
+{
+  threadTrace_.active = ++threadTrace_.reads % sampleInterval == 0;
+  if (threadTrace_.active)
+  {
+    threadTrace_.record = Record{};
+    threadTrace_.record.stamps[STAGE_READ] = now();
+  }
+}
+
+void ShareTrace::push(const Record& record)
+{
+  Ring* ring = threadRing.acquire();
+  uint64_t head = ring->head.load(std::memory_order_relaxed);
+  if (head - ring->tail.load(std::memory_order_acquire) >= RING_CAPACITY)
+  {
+    state().droppedRecords.fetch_add(1, std::memory_order_relaxed);
+    return;
+  }
+  ring->records[head % RING_CAPACITY] = record;
+  ring->head.store(head + 1, std::memory_order_release);
+}
+
+} // namespace util
+} // namespace ses
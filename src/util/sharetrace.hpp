@@ -0,0 +1,149 @@
+#ifndef SES_UTIL_SHARETRACE_HPP
+#define SES_UTIL_SHARETRACE_HPP
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <string>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+namespace ses {
+namespace util {
+
+/**
+ * Sampled traces of shares on their way through the proxy, stamped with the time stamp counter at
+ * each stage.
+ *
+ * A trace begins with every sampleInterval-th read of a thread and collects the stages on that
+ * thread until its next read. Whoever takes a share further copies the trace along and finishes
+ * it, which pushes it into a lock-free ring of the finishing thread. An exporter thread drains the
+ * rings into a file every EXPORT_INTERVAL, ses_proxy_tracereport prints the latency per stage.
+ * Until startExport() each read costs a load and a branch, stamps only a branch.
+ */
+class ShareTrace
+{
+public:
+  // in the order a share passes them, stages a share skips are not stamped
+  enum Stage
+  {
+    STAGE_READ,
+    STAGE_PARSE,
+    STAGE_SUBMIT,
+    STAGE_REPLY,
+    STAGE_UPSTREAM_SEND,
+    STAGE_POOL_RESPONSE,
+    STAGE_COUNT
+  };
+
+  // all zero unless sampled
+  struct Record
+  {
+    uint64_t stamps[STAGE_COUNT];
+  };
+
+  struct FileHeader
+  {
+    char magic[8];
+    uint32_t version;
+    uint32_t recordSize;
+    // calibrated against the steady clock when the export started
+    double ticksPerMicrosecond;
+    uint8_t reserved[8];
+  };
+
+  // traces a thread may finish between two exports, further ones are dropped and counted
+  static const std::size_t RING_CAPACITY = 4096;
+  static constexpr std::chrono::milliseconds EXPORT_INTERVAL{1000};
+
+public:
+  // starts sampling and exporting to path, false if it is not writable
+  static bool startExport(const std::string& path, uint32_t sampleInterval);
+
+  // reads the traces of an export, false if it is not readable
+  static bool read(const std::string& path, double& ticksPerMicrosecond,
+                   const std::function<void(const Record& record)>& recordHandler);
+
+  static uint64_t now()
+  {
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    return static_cast<uint64_t>(std::chrono::steady_clock::now().time_since_epoch().count());
+#endif
+  }
+
+  // called for each read of a connection, ends the thread's previous trace
+  static void begin()
+  {
+    uint32_t sampleInterval = sampleInterval_.load(std::memory_order_relaxed);
+    if (sampleInterval != 0)
+    {
+      beginSampled(sampleInterval);
+    }
+  }
+
+  // stamps the trace of the current thread
+  static void stamp(Stage stage)
+  {
+    if (threadTrace_.active)
+    {
+      threadTrace_.record.stamps[stage] = now();
+    }
+  }
+
+  // the trace of the current thread, all zero if the last read was not sampled
+  static Record current()
+  {
+    return threadTrace_.active ? threadTrace_.record : Record{};
+  }
+
+  // continues a trace taken along with current() on the current thread, for shares handled later
+  static void resume(const Record& record)
+  {
+    threadTrace_.active = record.stamps[STAGE_READ] != 0;
+    threadTrace_.record = record;
+  }
+
+  static void stamp(Record& record, Stage stage)
+  {
+    if (record.stamps[STAGE_READ] != 0)
+    {
+      record.stamps[stage] = now();
+    }
+  }
+
+  static void finish(const Record& record)
+  {
+    if (record.stamps[STAGE_READ] != 0)
+    {
+      push(record);
+    }
+  }
+
+  // traces dropped because a ring was full
+  static uint64_t getDroppedRecords();
+
+  static const char* toString(Stage stage);
+
+private:
+  struct ThreadTrace
+  {
+    bool active;
+    uint32_t reads;
+    Record record;
+  };
+
+  static void beginSampled(uint32_t sampleInterval);
+  static void push(const Record& record);
+
+  static std::atomic<uint32_t> sampleInterval_;
+  static thread_local ThreadTrace threadTrace_;
+};
+
+} // namespace util
+} // namespace ses
+
+#endif //SES_UTIL_SHARETRACE_HPP
@@ -0,0 +1,155 @@
+#include "util/timingwheel.hpp"
+
+namespace ses {
+namespace util {
+
+TimingWheel::Timer::Timer(const Callback& callback)
+  : Link{nullptr, nullptr}
+  , callback_(callback)
+  , wheel_(nullptr)
+  , expiryTick_(0)
+{
+}
+
+TimingWheel::Timer::~Timer()
+{
+  cancel();
+}
+
+bool TimingWheel::Timer::isArmed() const
+{
+  return wheel_ != nullptr;
+}
+
+void TimingWheel::Timer::cancel()
+{
+  if (wheel_)
+  {
+    TimingWheel::unlink(*this);
+    --wheel_->size_;
+    wheel_ = nullptr;
+  }
+}
+
+TimingWheel::TimingWheel(std::chrono::milliseconds tickDuration)
+  : tickDuration_(tickDuration)
+  , start_(Clock::now())
+  , currentTick_(0)
+  , size_(0)
+{
+  for (auto& level : slots_)
+  {
+    for (auto& slot : level)
+    {
+      slot.prev_ = &slot;
+      slot.next_ = &slot;
+    }
+  }
+}
+
+TimingWheel::~TimingWheel()
+{
+  for (auto& level : slots_)
+  {
+    for (auto& slot : level)
+    {
+      while (slot.next_ != &slot)
+      {
+        static_cast<Timer*>(slot.next_)->cancel();
+      }
+    }
+  }
+}
+
+void TimingWheel::arm(Timer& timer, std::chrono::milliseconds timeout)
+{
+  timer.cancel();
+  uint64_t ticks = (timeout.count() + tickDuration_.count() - 1) / tickDuration_.count();
+  timer.expiryTick_ = currentTick_ + (ticks > 0 ? ticks : 1);
+  timer.wheel_ = this;
+  ++size_;
+  insert(timer);
+}
+
+void TimingWheel::advance(Clock::time_point now)
+{
+  uint64_t targetTick = static_cast<uint64_t>((now - start_) / tickDuration_);
+  while (currentTick_ < targetTick)
+  {
+    ++currentTick_;
+
+    // higher levels first, so their timers can cascade all the way down within this tick
+    int level = 0;
+    while (level + 1 < LEVELS && (currentTick_ & ((uint64_t(1) << (SLOT_BITS * (level + 1))) - 1)) == 0)
+    {
+      ++level;
+    }
+    for (; level > 0; --level)
+    {
+      cascade(level);
+    }
+    expire();
+  }
+}
+
+std::size_t TimingWheel::size() const
+{
+  return size_;
+}
+
+void TimingWheel::insert(Timer& timer)
+{
+  const uint64_t maxDelta = (uint64_t(1) << (SLOT_BITS * LEVELS)) - 1;
+  if (timer.expiryTick_ - currentTick_ > maxDelta)
+  {
+    timer.expiryTick_ = currentTick_ + maxDelta;
+  }
+
+  uint64_t delta = timer.expiryTick_ - currentTick_;
+  int level = 0;
+  while (level + 1 < LEVELS && delta >= (uint64_t(1) << (SLOT_BITS * (level + 1))))
+  {
+    ++level;
+  }
+
+  Link& slot = slots_[level][(timer.expiryTick_ >> (SLOT_BITS * level)) & (SLOTS - 1)];
+  timer.prev_ = slot.prev_;
+  timer.next_ = &slot;
+  slot.prev_->next_ = &timer;
+  slot.prev_ = &timer;
+}
+
+void TimingWheel::unlink(Link& link)
+{
+  link.prev_->next_ = link.next_;
+  link.next_->prev_ = link.prev_;
+  link.prev_ = nullptr;
+  link.next_ = nullptr;
+}
+
+void TimingWheel::cascade(int level)
+{
+  Link& slot = slots_[level][(currentTick_ >> (SLOT_BITS * level)) & (SLOTS - 1)];
+  while (slot.next_ != &slot)
+  {
+    Timer& timer = static_cast<Timer&>(*slot.next_);
+    unlink(timer);
+    insert(timer);
+  }
+}
+
+void TimingWheel::expire()
+{
+  Link& slot = slots_[0][currentTick_ & (SLOTS - 1)];
+  while (slot.next_ != &slot)
+  {
+    Timer& timer = static_cast<Timer&>(*slot.next_);
+    timer.cancel();
+    // the callback may re-arm or destroy the timer
+    Timer::Callback callback = timer.callback_;
+    callback();
+  }
+}
+
+} // namespace util
+} // namespace ses
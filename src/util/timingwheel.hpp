@@ -0,0 +1,87 @@
+#ifndef SES_UTIL_TIMINGWHEEL_HPP
+#define SES_UTIL_TIMINGWHEEL_HPP
+
+#include <chrono>
+#include <cstdint>
+#include <functional>
+
+#include <boost/noncopyable.hpp>
+
+namespace ses {
+namespace util {
+
+/**
+ * Hierarchical hashed timing wheel for large numbers of coarse timeouts, e.g. one per connection.
+ *
+ * Timers are intrusive list nodes embedded in their owner, so arming and cancelling is O(1) and
+ * does not allocate. Expiry is driven by calling advance() periodically. Timers on higher levels
+ * cascade down to lower levels as time approaches their expiry. A wheel and its timers must only
+ * be used from one thread.
+ */
+class TimingWheel : private boost::noncopyable
+{
+public:
+  typedef std::chrono::steady_clock Clock;
+
+private:
+  struct Link
+  {
+    Link* prev_;
+    Link* next_;
+  };
+
+public:
+  class Timer : private Link, private boost::noncopyable
+  {
+  public:
+    typedef std::function<void()> Callback;
+
+  public:
+    explicit Timer(const Callback& callback);
+    ~Timer();
+
+    bool isArmed() const;
+    void cancel();
+
+  private:
+    friend class TimingWheel;
+
+    Callback callback_;
+    TimingWheel* wheel_;
+    uint64_t expiryTick_;
+  };
+
+public:
+  explicit TimingWheel(std::chrono::milliseconds tickDuration);
+  ~TimingWheel();
+
+  // (re-)arms the timer to expire after timeout, rounded up to the next tick
+  void arm(Timer& timer, std::chrono::milliseconds timeout);
+
+  // expires all timers due until now
+  void advance(Clock::time_point now = Clock::now());
+
+  std::size_t size() const;
+
+private:
+  static const int SLOT_BITS = 8;
+  static const std::size_t SLOTS = 1 << SLOT_BITS;
+  static const int LEVELS = 4;
+
+  void insert(Timer& timer);
+  static void unlink(Link& link);
+  void cascade(int level);
+  void expire();
+
+private:
+  std::chrono::milliseconds tickDuration_;
+  Clock::time_point start_;
+  uint64_t currentTick_;
+  std::size_t size_;
+  Link slots_[LEVELS][SLOTS];
+};
+
+} // namespace util
+} // namespace ses
+
+#endif //SES_UTIL_TIMINGWHEEL_HPP